@@ -50,6 +50,7 @@ extern "C" {
 #include "mlt_log.h"
 #include "mlt_multitrack.h"
 #include "mlt_parser.h"
+#include "mlt_peaks.h"
 #include "mlt_playlist.h"
 #include "mlt_producer.h"
 #include "mlt_profile.h"
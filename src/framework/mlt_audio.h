@@ -70,5 +70,33 @@ extern const char *mlt_audio_channel_layout_name(mlt_channel_layout layout);
 extern mlt_channel_layout mlt_audio_channel_layout_id(const char *name);
 extern int mlt_audio_channel_layout_channels(mlt_channel_layout layout);
 extern mlt_channel_layout mlt_audio_channel_layout_default(int channels);
+extern int mlt_audio_convert_samples(void *dest,
+                                     mlt_audio_format dest_format,
+                                     const void *src,
+                                     mlt_audio_format src_format,
+                                     int samples,
+                                     int channels);
+extern void mlt_audio_interleave(
+    uint8_t *dest, uint8_t *const *planes, int samples, int channels, int bytes_per_sample);
+extern void mlt_audio_deinterleave(
+    uint8_t *const *planes, const uint8_t *src, int samples, int channels, int bytes_per_sample);
+extern void mlt_audio_mix_float(float *dest,
+                                const float *src,
+                                int dest_channels,
+                                int src_channels,
+                                int channels,
+                                int samples,
+                                double weight_start,
+                                double weight_end);
+extern void mlt_audio_sum_float(float *dest,
+                                const float *src,
+                                int dest_channels,
+                                int src_channels,
+                                int channels,
+                                int samples,
+                                double weight_start,
+                                double weight_end);
+extern void mlt_audio_gain_float(
+    float *buffer, int channels, int samples, double gain_start, double gain_end);
 
 #endif
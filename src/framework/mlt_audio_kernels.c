@@ -0,0 +1,731 @@
+/**
+ * \file mlt_audio_kernels.c
+ * \brief Audio sample processing functions
+ * \see mlt_audio_s
+ *
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mlt_audio.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/** The number of samples of all channels converted at once when changing the layout */
+#define BLOCK_SIZE (4096)
+
+typedef enum { sample_u8, sample_s16, sample_s32, sample_float } sample_type;
+
+typedef enum { ramp_mix, ramp_sum, ramp_gain } ramp_op;
+
+static int sample_info(mlt_audio_format format, sample_type *type, int *planar)
+{
+    switch (format) {
+    case mlt_audio_s16:
+        *type = sample_s16;
+        *planar = 0;
+        return 0;
+    case mlt_audio_s32:
+        *type = sample_s32;
+        *planar = 1;
+        return 0;
+    case mlt_audio_float:
+        *type = sample_float;
+        *planar = 1;
+        return 0;
+    case mlt_audio_s32le:
+        *type = sample_s32;
+        *planar = 0;
+        return 0;
+    case mlt_audio_f32le:
+        *type = sample_float;
+        *planar = 0;
+        return 0;
+    case mlt_audio_u8:
+        *type = sample_u8;
+        *planar = 0;
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+static int sample_size(sample_type type)
+{
+    return type == sample_u8 ? 1 : type == sample_s16 ? 2 : 4;
+}
+
+static inline int16_t float_to_s16(float f)
+{
+    f = CLAMP(f, -1.0f, 1.0f);
+    return 32767 * f;
+}
+
+static inline int32_t float_to_s32(float f)
+{
+    f = CLAMP(f, -1.0f, 1.0f);
+    int64_t pcm = (f > 0.0f ? 2147483647LL : 2147483648LL) * f;
+    return CLAMP(pcm, -2147483648LL, 2147483647LL);
+}
+
+/** Convert a run of samples from one sample type to another.
+ *
+ * The layout does not matter here, the samples are converted in order.
+ */
+
+static void convert_run(
+    void *dest, sample_type dest_type, const void *src, sample_type src_type, int count)
+{
+    int i = 0;
+
+    if (dest_type == src_type) {
+        memcpy(dest, src, count * sample_size(src_type));
+        return;
+    }
+    switch (src_type) {
+    case sample_s16: {
+        const int16_t *q = src;
+        if (dest_type == sample_s32) {
+            int32_t *p = dest;
+#ifdef USE_SSE2
+            __m128i zero = _mm_setzero_si128();
+            for (; i + 8 <= count; i += 8) {
+                __m128i x = _mm_loadu_si128((const __m128i *) (q + i));
+                _mm_storeu_si128((__m128i *) (p + i), _mm_unpacklo_epi16(zero, x));
+                _mm_storeu_si128((__m128i *) (p + i + 4), _mm_unpackhi_epi16(zero, x));
+            }
+#endif
+            for (; i < count; i++)
+                p[i] = (int32_t) q[i] << 16;
+        } else if (dest_type == sample_float) {
+            float *p = dest;
+#ifdef USE_SSE2
+            __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+            for (; i + 8 <= count; i += 8) {
+                __m128i x = _mm_loadu_si128((const __m128i *) (q + i));
+                __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+                __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+                _mm_storeu_ps(p + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+                _mm_storeu_ps(p + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+            }
+#endif
+            for (; i < count; i++)
+                p[i] = (float) q[i] / 32768.0;
+        } else {
+            uint8_t *p = dest;
+            for (; i < count; i++)
+                p[i] = (q[i] >> 8) + 128;
+        }
+        break;
+    }
+    case sample_s32: {
+        const int32_t *q = src;
+        if (dest_type == sample_s16) {
+            int16_t *p = dest;
+#ifdef USE_SSE2
+            for (; i + 8 <= count; i += 8) {
+                __m128i lo = _mm_srai_epi32(_mm_loadu_si128((const __m128i *) (q + i)), 16);
+                __m128i hi = _mm_srai_epi32(_mm_loadu_si128((const __m128i *) (q + i + 4)), 16);
+                _mm_storeu_si128((__m128i *) (p + i), _mm_packs_epi32(lo, hi));
+            }
+#endif
+            for (; i < count; i++)
+                p[i] = q[i] >> 16;
+        } else if (dest_type == sample_float) {
+            float *p = dest;
+#ifdef USE_SSE2
+            __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+            for (; i + 4 <= count; i += 4) {
+                __m128 x = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) (q + i)));
+                _mm_storeu_ps(p + i, _mm_mul_ps(x, scale));
+            }
+#endif
+            for (; i < count; i++)
+                p[i] = (float) q[i] / 2147483648.0;
+        } else {
+            uint8_t *p = dest;
+            for (; i < count; i++)
+                p[i] = (q[i] >> 24) + 128;
+        }
+        break;
+    }
+    case sample_float: {
+        const float *q = src;
+        if (dest_type == sample_s16) {
+            int16_t *p = dest;
+#ifdef USE_SSE2
+            __m128 min = _mm_set1_ps(-1.0f);
+            __m128 max = _mm_set1_ps(1.0f);
+            __m128 scale = _mm_set1_ps(32767.0f);
+            for (; i + 8 <= count; i += 8) {
+                __m128 lo = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(q + i), min), max);
+                __m128 hi = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(q + i + 4), min), max);
+                _mm_storeu_si128((__m128i *) (p + i),
+                                 _mm_packs_epi32(_mm_cvttps_epi32(_mm_mul_ps(lo, scale)),
+                                                 _mm_cvttps_epi32(_mm_mul_ps(hi, scale))));
+            }
+#endif
+            for (; i < count; i++)
+                p[i] = float_to_s16(q[i]);
+        } else if (dest_type == sample_s32) {
+            int32_t *p = dest;
+#ifdef USE_SSE2
+            __m128 min = _mm_set1_ps(-1.0f);
+            __m128 max = _mm_set1_ps(1.0f);
+            __m128 scale = _mm_set1_ps(2147483648.0f);
+            for (; i + 4 <= count; i += 4) {
+                __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(q + i), min), max);
+                x = _mm_mul_ps(x, scale);
+                // Full scale overflows to INT32_MIN, flip it to INT32_MAX
+                __m128i overflow = _mm_castps_si128(_mm_cmpge_ps(x, scale));
+                _mm_storeu_si128((__m128i *) (p + i),
+                                 _mm_xor_si128(_mm_cvttps_epi32(x), overflow));
+            }
+#endif
+            for (; i < count; i++)
+                p[i] = float_to_s32(q[i]);
+        } else {
+            uint8_t *p = dest;
+            for (; i < count; i++) {
+                float f = CLAMP(q[i], -1.0f, 1.0f);
+                p[i] = (127 * f) + 128;
+            }
+        }
+        break;
+    }
+    case sample_u8: {
+        const uint8_t *q = src;
+        if (dest_type == sample_s16) {
+            int16_t *p = dest;
+            for (; i < count; i++)
+                p[i] = ((int16_t) q[i] - 128) << 8;
+        } else if (dest_type == sample_s32) {
+            int32_t *p = dest;
+            for (; i < count; i++)
+                p[i] = ((int32_t) q[i] - 128) << 24;
+        } else {
+            float *p = dest;
+            for (; i < count; i++)
+                p[i] = ((float) q[i] - 128) / 256.0f;
+        }
+        break;
+    }
+    }
+}
+
+/** Convert audio samples to another format.
+ *
+ * All of the 8, 16 and 32 bit integer and floating point formats are supported,
+ * both interleaved and planar.
+ * \public \memberof mlt_audio_s
+ * \param dest the output buffer with room for the converted samples
+ * \param dest_format the format of the output
+ * \param src the samples to convert
+ * \param src_format the format of the samples
+ * \param samples the number of samples per channel
+ * \param channels the number of channels
+ * \return true if one of the formats is not supported
+ */
+
+int mlt_audio_convert_samples(void *dest,
+                              mlt_audio_format dest_format,
+                              const void *src,
+                              mlt_audio_format src_format,
+                              int samples,
+                              int channels)
+{
+    sample_type dest_type, src_type;
+    int dest_planar, src_planar;
+    int s, c;
+
+    if (sample_info(dest_format, &dest_type, &dest_planar)
+        || sample_info(src_format, &src_type, &src_planar))
+        return 1;
+    if (dest_planar == src_planar || channels == 1) {
+        convert_run(dest, dest_type, src, src_type, samples * channels);
+        return 0;
+    }
+
+    int dest_size = sample_size(dest_type);
+    int src_size = sample_size(src_type);
+    uint8_t **planes = malloc(channels * sizeof(*planes));
+    if (!planes)
+        return 1;
+    if (dest_type == src_type) {
+        if (dest_planar) {
+            for (c = 0; c < channels; c++)
+                planes[c] = (uint8_t *) dest + c * samples * dest_size;
+            mlt_audio_deinterleave(planes, src, samples, channels, dest_size);
+        } else {
+            for (c = 0; c < channels; c++)
+                planes[c] = (uint8_t *) src + c * samples * src_size;
+            mlt_audio_interleave(dest, planes, samples, channels, dest_size);
+        }
+    } else if (channels > BLOCK_SIZE) {
+        for (s = 0; s < samples; s++) {
+            for (c = 0; c < channels; c++) {
+                int d = dest_planar ? c * samples + s : s * channels + c;
+                int i = src_planar ? c * samples + s : s * channels + c;
+                convert_run((uint8_t *) dest + d * dest_size,
+                            dest_type,
+                            (const uint8_t *) src + i * src_size,
+                            src_type,
+                            1);
+            }
+        }
+    } else {
+        // Convert blocks of samples into a buffer and change their layout from there
+        int32_t buffer[BLOCK_SIZE];
+        int block = BLOCK_SIZE / channels;
+        for (s = 0; s < samples; s += block) {
+            int n = MIN(block, samples - s);
+            if (src_planar) {
+                for (c = 0; c < channels; c++) {
+                    planes[c] = (uint8_t *) buffer + c * n * dest_size;
+                    convert_run(planes[c],
+                                dest_type,
+                                (const uint8_t *) src + (c * samples + s) * src_size,
+                                src_type,
+                                n);
+                }
+                mlt_audio_interleave((uint8_t *) dest + s * channels * dest_size,
+                                     planes,
+                                     n,
+                                     channels,
+                                     dest_size);
+            } else {
+                convert_run(buffer,
+                            dest_type,
+                            (const uint8_t *) src + s * channels * src_size,
+                            src_type,
+                            n * channels);
+                for (c = 0; c < channels; c++)
+                    planes[c] = (uint8_t *) dest + (c * samples + s) * dest_size;
+                mlt_audio_deinterleave(planes, (uint8_t *) buffer, n, channels, dest_size);
+            }
+        }
+    }
+    free(planes);
+    return 0;
+}
+
+#ifdef USE_SSE2
+static inline void transpose_4x4_epi32(__m128i *r)
+{
+    __m128i t0 = _mm_unpacklo_epi32(r[0], r[1]);
+    __m128i t1 = _mm_unpacklo_epi32(r[2], r[3]);
+    __m128i t2 = _mm_unpackhi_epi32(r[0], r[1]);
+    __m128i t3 = _mm_unpackhi_epi32(r[2], r[3]);
+    r[0] = _mm_unpacklo_epi64(t0, t1);
+    r[1] = _mm_unpackhi_epi64(t0, t1);
+    r[2] = _mm_unpacklo_epi64(t2, t3);
+    r[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+static inline void transpose_8x8_epi16(__m128i *r)
+{
+    __m128i b[8], c[8];
+    int i;
+    for (i = 0; i < 4; i++) {
+        b[2 * i] = _mm_unpacklo_epi16(r[2 * i], r[2 * i + 1]);
+        b[2 * i + 1] = _mm_unpackhi_epi16(r[2 * i], r[2 * i + 1]);
+    }
+    for (i = 0; i < 2; i++) {
+        c[4 * i] = _mm_unpacklo_epi32(b[4 * i], b[4 * i + 2]);
+        c[4 * i + 1] = _mm_unpackhi_epi32(b[4 * i], b[4 * i + 2]);
+        c[4 * i + 2] = _mm_unpacklo_epi32(b[4 * i + 1], b[4 * i + 3]);
+        c[4 * i + 3] = _mm_unpackhi_epi32(b[4 * i + 1], b[4 * i + 3]);
+    }
+    for (i = 0; i < 4; i++) {
+        r[2 * i] = _mm_unpacklo_epi64(c[i], c[i + 4]);
+        r[2 * i + 1] = _mm_unpackhi_epi64(c[i], c[i + 4]);
+    }
+}
+
+/** Interleave whole vectors of 16 or 32 bit samples.
+ *
+ * Stereo is handled with unpacks and multiples of 4 or 8 channels with a
+ * transpose of each block of channels. Returns the number of samples done.
+ */
+
+static int interleave_sse2(
+    uint8_t *dest, uint8_t *const *planes, int samples, int channels, int bytes_per_sample)
+{
+    int lanes = 16 / bytes_per_sample;
+    int n = samples - samples % lanes;
+    int s, c, k;
+    __m128i r[8];
+
+    if (bytes_per_sample != 2 && bytes_per_sample != 4)
+        return 0;
+    if (channels == 2) {
+        for (s = 0; s < n; s += lanes) {
+            __m128i a = _mm_loadu_si128((const __m128i *) (planes[0] + s * bytes_per_sample));
+            __m128i b = _mm_loadu_si128((const __m128i *) (planes[1] + s * bytes_per_sample));
+            __m128i *d = (__m128i *) (dest + s * 2 * bytes_per_sample);
+            if (bytes_per_sample == 2) {
+                _mm_storeu_si128(d, _mm_unpacklo_epi16(a, b));
+                _mm_storeu_si128(d + 1, _mm_unpackhi_epi16(a, b));
+            } else {
+                _mm_storeu_si128(d, _mm_unpacklo_epi32(a, b));
+                _mm_storeu_si128(d + 1, _mm_unpackhi_epi32(a, b));
+            }
+        }
+        return n;
+    }
+    if (channels % lanes)
+        return 0;
+    for (c = 0; c < channels; c += lanes) {
+        for (s = 0; s < n; s += lanes) {
+            for (k = 0; k < lanes; k++)
+                r[k] = _mm_loadu_si128((const __m128i *) (planes[c + k] + s * bytes_per_sample));
+            if (lanes == 4)
+                transpose_4x4_epi32(r);
+            else
+                transpose_8x8_epi16(r);
+            for (k = 0; k < lanes; k++)
+                _mm_storeu_si128((__m128i *) (dest + ((s + k) * channels + c) * bytes_per_sample),
+                                 r[k]);
+        }
+    }
+    return n;
+}
+
+/** Deinterleave whole vectors of 16 or 32 bit samples.
+ *
+ * Returns the number of samples done.
+ */
+
+static int deinterleave_sse2(
+    uint8_t *const *planes, const uint8_t *src, int samples, int channels, int bytes_per_sample)
+{
+    int lanes = 16 / bytes_per_sample;
+    int n = samples - samples % lanes;
+    int s, c, k;
+    __m128i r[8];
+
+    if (bytes_per_sample != 2 && bytes_per_sample != 4)
+        return 0;
+    if (channels == 2) {
+        for (s = 0; s < n; s += lanes) {
+            const __m128i *p = (const __m128i *) (src + s * 2 * bytes_per_sample);
+            __m128i a = _mm_loadu_si128(p);
+            __m128i b = _mm_loadu_si128(p + 1);
+            __m128i left, right;
+            if (bytes_per_sample == 2) {
+                // Sign extend each half of the 32 bit pairs and pack them back
+                left = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+                                       _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+                right = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+            } else {
+                a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+                b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+                left = _mm_unpacklo_epi64(a, b);
+                right = _mm_unpackhi_epi64(a, b);
+            }
+            _mm_storeu_si128((__m128i *) (planes[0] + s * bytes_per_sample), left);
+            _mm_storeu_si128((__m128i *) (planes[1] + s * bytes_per_sample), right);
+        }
+        return n;
+    }
+    if (channels % lanes)
+        return 0;
+    for (c = 0; c < channels; c += lanes) {
+        for (s = 0; s < n; s += lanes) {
+            for (k = 0; k < lanes; k++)
+                r[k] = _mm_loadu_si128(
+                    (const __m128i *) (src + ((s + k) * channels + c) * bytes_per_sample));
+            if (lanes == 4)
+                transpose_4x4_epi32(r);
+            else
+                transpose_8x8_epi16(r);
+            for (k = 0; k < lanes; k++)
+                _mm_storeu_si128((__m128i *) (planes[c + k] + s * bytes_per_sample), r[k]);
+        }
+    }
+    return n;
+}
+#endif
+
+/** Interleave planar audio.
+ *
+ * \public \memberof mlt_audio_s
+ * \param dest the interleaved output with room for samples * channels samples
+ * \param planes a pointer to the samples of each channel
+ * \param samples the number of samples per channel
+ * \param channels the number of channels
+ * \param bytes_per_sample the size of one sample of one channel
+ */
+
+void mlt_audio_interleave(
+    uint8_t *dest, uint8_t *const *planes, int samples, int channels, int bytes_per_sample)
+{
+    int s = 0, c;
+
+    if (channels == 1) {
+        memcpy(dest, planes[0], samples * bytes_per_sample);
+        return;
+    }
+#ifdef USE_SSE2
+    s = interleave_sse2(dest, planes, samples, channels, bytes_per_sample);
+#endif
+    switch (bytes_per_sample) {
+    case 1:
+        for (; s < samples; s++)
+            for (c = 0; c < channels; c++)
+                dest[s * channels + c] = planes[c][s];
+        break;
+    case 2:
+        for (; s < samples; s++)
+            for (c = 0; c < channels; c++)
+                ((int16_t *) dest)[s * channels + c] = ((const int16_t *) planes[c])[s];
+        break;
+    case 4:
+        for (; s < samples; s++)
+            for (c = 0; c < channels; c++)
+                ((int32_t *) dest)[s * channels + c] = ((const int32_t *) planes[c])[s];
+        break;
+    default:
+        for (; s < samples; s++)
+            for (c = 0; c < channels; c++)
+                memcpy(dest + (s * channels + c) * bytes_per_sample,
+                       planes[c] + s * bytes_per_sample,
+                       bytes_per_sample);
+    }
+}
+
+/** Deinterleave audio into planes.
+ *
+ * \public \memberof mlt_audio_s
+ * \param planes a pointer to the output buffer of each channel
+ * \param src the interleaved samples
+ * \param samples the number of samples per channel
+ * \param channels the number of channels
+ * \param bytes_per_sample the size of one sample of one channel
+ */
+
+void mlt_audio_deinterleave(
+    uint8_t *const *planes, const uint8_t *src, int samples, int channels, int bytes_per_sample)
+{
+    int s = 0, c, i;
+
+    if (channels == 1) {
+        memcpy(planes[0], src, samples * bytes_per_sample);
+        return;
+    }
+#ifdef USE_SSE2
+    s = deinterleave_sse2(planes, src, samples, channels, bytes_per_sample);
+#endif
+    switch (bytes_per_sample) {
+    case 1:
+        for (c = 0; c < channels; c++)
+            for (i = s; i < samples; i++)
+                planes[c][i] = src[i * channels + c];
+        break;
+    case 2:
+        for (c = 0; c < channels; c++)
+            for (i = s; i < samples; i++)
+                ((int16_t *) planes[c])[i] = ((const int16_t *) src)[i * channels + c];
+        break;
+    case 4:
+        for (c = 0; c < channels; c++)
+            for (i = s; i < samples; i++)
+                ((int32_t *) planes[c])[i] = ((const int32_t *) src)[i * channels + c];
+        break;
+    default:
+        for (c = 0; c < channels; c++)
+            for (i = s; i < samples; i++)
+                memcpy(planes[c] + i * bytes_per_sample,
+                       src + (i * channels + c) * bytes_per_sample,
+                       bytes_per_sample);
+    }
+}
+
+static inline float ramp_sample(ramp_op op, float a, float b, float w)
+{
+    switch (op) {
+    case ramp_mix:
+        return w * b + (1.0f - w) * a;
+    case ramp_sum:
+        return w * b + a;
+    default:
+        return w * a;
+    }
+}
+
+#ifdef USE_SSE2
+static inline __m128 ramp_ps(ramp_op op, __m128 a, __m128 b, __m128 w)
+{
+    switch (op) {
+    case ramp_mix:
+        return _mm_add_ps(_mm_mul_ps(w, b), _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), w), a));
+    case ramp_sum:
+        return _mm_add_ps(_mm_mul_ps(w, b), a);
+    default:
+        return _mm_mul_ps(w, a);
+    }
+}
+#endif
+
+/** Apply an operation with a weight ramped linearly over the samples.
+ *
+ * The weight of sample i is start + i * (end - start) / samples.
+ */
+
+static inline void ramp_float(ramp_op op,
+                              float *dest,
+                              const float *src,
+                              int dest_channels,
+                              int src_channels,
+                              int channels,
+                              int samples,
+                              double weight_start,
+                              double weight_end)
+{
+    float start = weight_start;
+    float step = (weight_end - weight_start) / samples;
+    int s = 0, c;
+
+    if (samples <= 0 || channels <= 0)
+        return;
+    if (!src) {
+        src = dest;
+        src_channels = dest_channels;
+    }
+#ifdef USE_SSE2
+    if (channels <= 2 && dest_channels == channels && src_channels == channels) {
+        // Vectorize along the samples with the weight of each lane
+        int count = samples * channels;
+        int i;
+        __m128i index = channels == 1 ? _mm_setr_epi32(0, 1, 2, 3) : _mm_setr_epi32(0, 0, 1, 1);
+        __m128i next = _mm_set1_epi32(4 / channels);
+        __m128 vstart = _mm_set1_ps(start);
+        __m128 vstep = _mm_set1_ps(step);
+        for (i = 0; i + 4 <= count; i += 4) {
+            __m128 w = _mm_add_ps(vstart, _mm_mul_ps(vstep, _mm_cvtepi32_ps(index)));
+            __m128 a = _mm_loadu_ps(dest + i);
+            __m128 b = _mm_loadu_ps(src + i);
+            _mm_storeu_ps(dest + i, ramp_ps(op, a, b, w));
+            index = _mm_add_epi32(index, next);
+        }
+        s = i / channels;
+    }
+#endif
+    for (; s < samples; s++) {
+        float w = start + step * (float) s;
+        float *a = dest + s * dest_channels;
+        const float *b = src + s * src_channels;
+        c = 0;
+#ifdef USE_SSE2
+        __m128 vw = _mm_set1_ps(w);
+        for (; c + 4 <= channels; c += 4)
+            _mm_storeu_ps(a + c, ramp_ps(op, _mm_loadu_ps(a + c), _mm_loadu_ps(b + c), vw));
+#endif
+        for (; c < channels; c++)
+            a[c] = ramp_sample(op, a[c], b[c], w);
+    }
+}
+
+/** Crossfade interleaved floating point audio into another.
+ *
+ * Each sample becomes w * src + (1 - w) * dest with the weight w ramped
+ * linearly over the samples.
+ * \public \memberof mlt_audio_s
+ * \param dest the audio to mix into
+ * \param src the audio to mix
+ * \param dest_channels the number of channels of dest
+ * \param src_channels the number of channels of src
+ * \param channels the number of channels to mix
+ * \param samples the number of samples per channel
+ * \param weight_start the weight of src at the first sample
+ * \param weight_end the weight of src after the last sample
+ */
+
+void mlt_audio_mix_float(float *dest,
+                         const float *src,
+                         int dest_channels,
+                         int src_channels,
+                         int channels,
+                         int samples,
+                         double weight_start,
+                         double weight_end)
+{
+    ramp_float(ramp_mix,
+               dest,
+               src,
+               dest_channels,
+               src_channels,
+               channels,
+               samples,
+               weight_start,
+               weight_end);
+}
+
+/** Add interleaved floating point audio to another.
+ *
+ * Each sample becomes w * src + dest with the weight w ramped linearly over the samples.
+ * \public \memberof mlt_audio_s
+ * \param dest the audio to add to
+ * \param src the audio to add
+ * \param dest_channels the number of channels of dest
+ * \param src_channels the number of channels of src
+ * \param channels the number of channels to add
+ * \param samples the number of samples per channel
+ * \param weight_start the weight of src at the first sample
+ * \param weight_end the weight of src after the last sample
+ */
+
+void mlt_audio_sum_float(float *dest,
+                         const float *src,
+                         int dest_channels,
+                         int src_channels,
+                         int channels,
+                         int samples,
+                         double weight_start,
+                         double weight_end)
+{
+    ramp_float(ramp_sum,
+               dest,
+               src,
+               dest_channels,
+               src_channels,
+               channels,
+               samples,
+               weight_start,
+               weight_end);
+}
+
+/** Apply a gain ramp to interleaved floating point audio.
+ *
+ * \public \memberof mlt_audio_s
+ * \param buffer the audio
+ * \param channels the number of channels
+ * \param samples the number of samples per channel
+ * \param gain_start the gain of the first sample
+ * \param gain_end the gain after the last sample
+ */
+
+void mlt_audio_gain_float(
+    float *buffer, int channels, int samples, double gain_start, double gain_end)
+{
+    ramp_float(
+        ramp_gain, buffer, NULL, channels, channels, channels, samples, gain_start, gain_end);
+}
@@ -27,11 +27,14 @@
 #include "mlt_producer.h"
 #include "mlt_profile.h"
 
+#include <inttypes.h>
+#include <limits.h>
 #include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 /** Define this if you want an automatic deinterlace (if necessary) when the
  * consumer's producer is not running at normal speed.
@@ -46,6 +49,59 @@ pthread_mutex_t mlt_sdl_mutex = PTHREAD_MUTEX_INITIALIZER;
  */
 pthread_mutex_t mlt_frame_processing_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/** The number of hash buckets in the render cache
+*/
+
+#define RENDER_CACHE_BUCKETS (1024)
+
+/** The frame properties set while rendering an image that are kept with it
+*/
+
+static const char *render_cache_properties[] = {"aspect_ratio",
+                                                "progressive",
+                                                "distort",
+                                                "colorspace",
+                                                "full_range",
+                                                "force_full_luma",
+                                                "top_field_first",
+                                                "color_trc"};
+
+#define RENDER_CACHE_PROPERTIES \
+    (sizeof(render_cache_properties) / sizeof(render_cache_properties[0]))
+
+/** \brief an image in the render cache */
+
+typedef struct render_cache_entry_s
+{
+    uint64_t key;
+    mlt_image_format format;
+    int width;
+    int height;
+    int size;       /**< the bytes of the image followed by the alpha channel */
+    int alpha_size; /**< the bytes of the alpha channel or 0 if there is none */
+    char *properties[RENDER_CACHE_PROPERTIES];
+    uint8_t *image; /**< NULL when the image was spilled to disk */
+    int on_disk;
+    struct render_cache_entry_s *bucket_next;
+    struct render_cache_entry_s *prev; /**< more recently used */
+    struct render_cache_entry_s *next; /**< less recently used */
+} render_cache_entry;
+
+/** \brief rendered images of the connected producer kept for reuse */
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    render_cache_entry *buckets[RENDER_CACHE_BUCKETS];
+    render_cache_entry *head; /**< the most recently used */
+    render_cache_entry *tail; /**< the least recently used */
+    int64_t memory;           /**< the bytes of images in memory */
+    int64_t disk;             /**< the bytes of images spilled to disk */
+    char *path;               /**< the directory for spilled images */
+    atomic_int_fast64_t hits;
+    atomic_int_fast64_t misses;
+} render_cache;
+
 /** \brief private members of mlt_consumer */
 
 typedef struct
@@ -67,6 +123,9 @@ typedef struct
     mlt_position position;
     pthread_mutex_t position_mutex;
     int is_purge;
+    mlt_position purge_position; /**< where to resume after a selective purge */
+    atomic_int last_position;    /**< the position of the frame read ahead most recently */
+    render_cache *render_cache;
     int aud_counter;
     double fps;
     int channels;
@@ -88,6 +147,9 @@ static void apply_profile_properties(mlt_consumer self,
                                      mlt_profile profile,
                                      mlt_properties properties);
 static void on_consumer_frame_show(mlt_properties owner, mlt_consumer self, mlt_event_data);
+static render_cache *render_cache_init(const char *path);
+static void render_cache_clear(render_cache *cache);
+static void render_cache_close(render_cache *cache);
 static void mlt_thread_create(mlt_consumer self, mlt_thread_function_t function);
 static void mlt_thread_join(mlt_consumer self);
 static void consumer_read_ahead_start(mlt_consumer self);
@@ -396,6 +458,11 @@ mlt_properties mlt_consumer_properties(mlt_consumer self)
 
 int mlt_consumer_connect(mlt_consumer self, mlt_service producer)
 {
+    consumer_private *priv = self->local;
+
+    // The cached images belong to the previous producer
+    if (priv->render_cache)
+        render_cache_clear(priv->render_cache);
     return mlt_service_connect_producer(&self->parent, producer, 0);
 }
 
@@ -537,6 +604,10 @@ int mlt_consumer_start(mlt_consumer self)
                     "system(%s) failed!\n",
                     mlt_properties_get(properties, "ante"));
 
+    // Create the render cache on request
+    if (!priv->render_cache && mlt_properties_get_int64(properties, "render_cache") > 0)
+        priv->render_cache = render_cache_init(mlt_properties_get(properties, "render_cache_path"));
+
     // Set the real_time preference
     priv->real_time = mlt_properties_get_int(properties, "real_time");
 
@@ -608,6 +679,448 @@ int mlt_consumer_put_frame(mlt_consumer self, mlt_frame frame)
     return error;
 }
 
+/** Initialize a render cache.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param path a directory to spill images to or NULL to keep them only in memory
+ * \return a new render cache
+ */
+
+static render_cache *render_cache_init(const char *path)
+{
+    render_cache *cache = calloc(1, sizeof(render_cache));
+    if (cache) {
+        pthread_mutex_init(&cache->mutex, NULL);
+        if (path && strcmp(path, ""))
+            cache->path = strdup(path);
+    }
+    return cache;
+}
+
+/** Get the name of the file of a spilled image.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param cache a render cache
+ * \param key the key of the image
+ * \param[out] name the file name
+ * \param size the size of \p name
+ */
+
+static void render_cache_file(render_cache *cache, uint64_t key, char *name, size_t size)
+{
+    snprintf(name,
+             size,
+             "%s/mlt-render-%d-%p-%016" PRIx64 ".raw",
+             cache->path,
+             (int) getpid(),
+             (void *) cache,
+             key);
+}
+
+/** Remove an entry from the list of recently used entries.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param cache a render cache
+ * \param entry an entry in the cache
+ */
+
+static void render_cache_unlink(render_cache *cache, render_cache_entry *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        cache->head = entry->next;
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        cache->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+/** Make an entry the most recently used.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param cache a render cache
+ * \param entry an entry that is not in the list
+ */
+
+static void render_cache_push_front(render_cache *cache, render_cache_entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head)
+        cache->head->prev = entry;
+    else
+        cache->tail = entry;
+    cache->head = entry;
+}
+
+/** Find an entry by its key.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param cache a render cache
+ * \param key the key of the image
+ * \return the entry or NULL if the image is not cached
+ */
+
+static render_cache_entry *render_cache_find(render_cache *cache, uint64_t key)
+{
+    render_cache_entry *entry = cache->buckets[key % RENDER_CACHE_BUCKETS];
+    while (entry && entry->key != key)
+        entry = entry->bucket_next;
+    return entry;
+}
+
+/** Remove an entry and release its image.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param cache a render cache
+ * \param entry an entry in the cache
+ */
+
+static void render_cache_remove(render_cache *cache, render_cache_entry *entry)
+{
+    render_cache_entry **link = &cache->buckets[entry->key % RENDER_CACHE_BUCKETS];
+    while (*link != entry)
+        link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+    render_cache_unlink(cache, entry);
+
+    if (entry->image) {
+        mlt_pool_release(entry->image);
+        cache->memory -= entry->size;
+    }
+    if (entry->on_disk) {
+        char name[PATH_MAX];
+        render_cache_file(cache, entry->key, name, sizeof(name));
+        remove(name);
+        cache->disk -= entry->size;
+    }
+    for (size_t i = 0; i < RENDER_CACHE_PROPERTIES; i++)
+        free(entry->properties[i]);
+    free(entry);
+}
+
+/** Release the image of an entry from memory and keep it on disk.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param cache a render cache
+ * \param entry an entry in the cache with an image in memory
+ * \return true if the image could not be written
+ */
+
+static int render_cache_spill(render_cache *cache, render_cache_entry *entry)
+{
+    if (!entry->on_disk) {
+        char name[PATH_MAX];
+        FILE *file;
+        int error = 1;
+
+        render_cache_file(cache, entry->key, name, sizeof(name));
+        file = fopen(name, "wb");
+        if (file) {
+            error = fwrite(entry->image, entry->size, 1, file) != 1;
+            error |= fclose(file) != 0;
+            if (error)
+                remove(name);
+        }
+        if (error)
+            return error;
+        entry->on_disk = 1;
+        cache->disk += entry->size;
+    }
+    mlt_pool_release(entry->image);
+    entry->image = NULL;
+    cache->memory -= entry->size;
+    return 0;
+}
+
+/** Evict the least recently used images until the cache is within its budget.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param cache a render cache
+ * \param memory the maximum number of bytes of images to keep in memory
+ * \param disk the maximum number of bytes of images to keep on disk or 0 for no limit
+ */
+
+static void render_cache_trim(render_cache *cache, int64_t memory, int64_t disk)
+{
+    render_cache_entry *entry = cache->tail;
+    while (cache->memory > memory && entry) {
+        render_cache_entry *prev = entry->prev;
+        if (entry->image && (!cache->path || render_cache_spill(cache, entry)))
+            render_cache_remove(cache, entry);
+        entry = prev;
+    }
+    entry = cache->tail;
+    while (disk > 0 && cache->disk > disk && entry) {
+        render_cache_entry *prev = entry->prev;
+        if (entry->on_disk)
+            render_cache_remove(cache, entry);
+        entry = prev;
+    }
+}
+
+/** Remove all images from a render cache.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param cache a render cache
+ */
+
+static void render_cache_clear(render_cache *cache)
+{
+    pthread_mutex_lock(&cache->mutex);
+    while (cache->head)
+        render_cache_remove(cache, cache->head);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+/** Close a render cache and delete its spilled images.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param cache a render cache
+ */
+
+static void render_cache_close(render_cache *cache)
+{
+    if (cache) {
+        render_cache_clear(cache);
+        pthread_mutex_destroy(&cache->mutex);
+        free(cache->path);
+        free(cache);
+    }
+}
+
+/** Restore a cached image on a frame.
+ *
+ * This sets a copy of the image, its alpha channel and the frame properties
+ * that were set while rendering it.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param cache a render cache
+ * \param key the key of the image
+ * \param frame the frame to set the image on
+ * \param[out] format the format of the image
+ * \param[out] width the width of the image
+ * \param[out] height the height of the image
+ * \param memory the maximum number of bytes of images to keep in memory
+ * \param disk the maximum number of bytes of images to keep on disk or 0 for no limit
+ * \return the image set on the frame or NULL if it is not cached
+ */
+
+static uint8_t *render_cache_get(render_cache *cache,
+                                 uint64_t key,
+                                 mlt_frame frame,
+                                 mlt_image_format *format,
+                                 int *width,
+                                 int *height,
+                                 int64_t memory,
+                                 int64_t disk)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+    uint8_t *image = NULL;
+
+    pthread_mutex_lock(&cache->mutex);
+    render_cache_entry *entry = render_cache_find(cache, key);
+    if (entry && !entry->image) {
+        // Bring a spilled image back into memory
+        char name[PATH_MAX];
+        FILE *file;
+        render_cache_file(cache, key, name, sizeof(name));
+        file = fopen(name, "rb");
+        entry->image = mlt_pool_alloc(entry->size);
+        if (!file || !entry->image || fread(entry->image, entry->size, 1, file) != 1) {
+            mlt_pool_release(entry->image);
+            entry->image = NULL;
+            render_cache_remove(cache, entry);
+            entry = NULL;
+        } else {
+            cache->memory += entry->size;
+        }
+        if (file)
+            fclose(file);
+    }
+    if (entry) {
+        int image_size = entry->size - entry->alpha_size;
+        uint8_t *alpha = entry->alpha_size ? mlt_pool_alloc(entry->alpha_size) : NULL;
+        image = mlt_pool_alloc(image_size);
+        if (image && (alpha || !entry->alpha_size)) {
+            memcpy(image, entry->image, image_size);
+            mlt_frame_set_image(frame, image, image_size, mlt_pool_release);
+            if (alpha) {
+                memcpy(alpha, entry->image + image_size, entry->alpha_size);
+                mlt_frame_set_alpha(frame, alpha, entry->alpha_size, mlt_pool_release);
+            }
+            for (size_t i = 0; i < RENDER_CACHE_PROPERTIES; i++)
+                mlt_properties_set(properties,
+                                   render_cache_properties[i],
+                                   entry->properties[i]);
+            *format = entry->format;
+            *width = entry->width;
+            *height = entry->height;
+        } else {
+            mlt_pool_release(image);
+            mlt_pool_release(alpha);
+            image = NULL;
+        }
+        render_cache_unlink(cache, entry);
+        render_cache_push_front(cache, entry);
+        render_cache_trim(cache, memory, disk);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    return image;
+}
+
+/** Add a copy of the rendered image of a frame to a render cache.
+ *
+ * The alpha channel and the frame properties that were set while rendering
+ * are kept with the image.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param cache a render cache
+ * \param key the key of the image
+ * \param frame the frame that rendered the image
+ * \param image the image
+ * \param format the format of the image
+ * \param width the width of the image
+ * \param height the height of the image
+ * \param memory the maximum number of bytes of images to keep in memory
+ * \param disk the maximum number of bytes of images to keep on disk or 0 for no limit
+ */
+
+static void render_cache_put(render_cache *cache,
+                             uint64_t key,
+                             mlt_frame frame,
+                             uint8_t *image,
+                             mlt_image_format format,
+                             int width,
+                             int height,
+                             int64_t memory,
+                             int64_t disk)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+    int image_size = mlt_image_format_size(format, width, height, NULL);
+    int alpha_size = 0;
+    uint8_t *alpha = mlt_frame_get_alpha_size(frame, &alpha_size);
+    if (!alpha || alpha_size < width * height)
+        alpha_size = 0;
+    int size = image_size + alpha_size;
+    if (image_size <= 0 || size > memory)
+        return;
+
+    pthread_mutex_lock(&cache->mutex);
+    if (!render_cache_find(cache, key)) {
+        render_cache_entry *entry = calloc(1, sizeof(*entry));
+        if (entry && (entry->image = mlt_pool_alloc(size))) {
+            memcpy(entry->image, image, image_size);
+            if (alpha_size)
+                memcpy(entry->image + image_size, alpha, alpha_size);
+            for (size_t i = 0; i < RENDER_CACHE_PROPERTIES; i++) {
+                const char *value = mlt_properties_get(properties, render_cache_properties[i]);
+                entry->properties[i] = value ? strdup(value) : NULL;
+            }
+            entry->key = key;
+            entry->format = format;
+            entry->width = width;
+            entry->height = height;
+            entry->size = size;
+            entry->alpha_size = alpha_size;
+            entry->bucket_next = cache->buckets[key % RENDER_CACHE_BUCKETS];
+            cache->buckets[key % RENDER_CACHE_BUCKETS] = entry;
+            render_cache_push_front(cache, entry);
+            cache->memory += size;
+            render_cache_trim(cache, memory, disk);
+        } else {
+            free(entry);
+        }
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+/** Compute the key of the image of a frame in the render cache.
+ *
+ * The key covers the position, the content of the services that produced the
+ * frame, the options that the consumer passes on the frame and the requested
+ * image format and size.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param frame a frame
+ * \param format the requested image format
+ * \param width the requested width
+ * \param height the requested height
+ * \return the key or 0 if the image can not be cached
+ */
+
+static uint64_t render_cache_key(mlt_frame frame, mlt_image_format format, int width, int height)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+    uint64_t key = mlt_frame_graph_hash(frame);
+    int64_t values[] = {mlt_frame_get_position(frame), format, width, height};
+    const uint8_t *p;
+    size_t i;
+
+    if (!key || format == mlt_image_none || format == mlt_image_movit
+        || format == mlt_image_opengl_texture)
+        return 0;
+    for (p = (const uint8_t *) values; p < (const uint8_t *) (values + 4); p++)
+        key = (key ^ *p) * 0x100000001b3ULL;
+    for (i = 0; i < mlt_properties_count(properties); i++) {
+        const char *name = mlt_properties_get_name(properties, i);
+        const char *value = mlt_properties_get_value(properties, i);
+        if (name && value && !strncmp(name, "consumer.", 9)) {
+            for (p = (const uint8_t *) name; *p; p++)
+                key = (key ^ *p) * 0x100000001b3ULL;
+            for (p = (const uint8_t *) value; *p; p++)
+                key = (key ^ *p) * 0x100000001b3ULL;
+            key = (key ^ '\n') * 0x100000001b3ULL;
+        }
+    }
+    return key ? key : 1;
+}
+
+/** Get the image of a frame from the render cache or render it and cache it.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param frame a frame
+ * \param[out] image the image
+ * \param[in,out] format the image format
+ * \param[in,out] width the image width
+ * \param[in,out] height the image height
+ * \param writable whether the image must be writable
+ * \return true on error
+ */
+
+static int render_cache_get_image(mlt_frame frame,
+                                  uint8_t **image,
+                                  mlt_image_format *format,
+                                  int *width,
+                                  int *height,
+                                  int writable)
+{
+    mlt_consumer self = mlt_frame_pop_service(frame);
+    consumer_private *priv = self->local;
+    render_cache *cache = priv->render_cache;
+    mlt_properties properties = MLT_CONSUMER_PROPERTIES(self);
+    int64_t memory = mlt_properties_get_int64(properties, "render_cache");
+    int64_t disk = mlt_properties_get_int64(properties, "render_cache_disk");
+    uint64_t key = render_cache_key(frame, *format, *width, *height);
+    int error = 0;
+
+    uint8_t *cached = key ? render_cache_get(cache, key, frame, format, width, height, memory, disk)
+                          : NULL;
+    if (cached) {
+        *image = cached;
+        mlt_properties_set_int64(properties, "render_cache_hits", ++cache->hits);
+    } else {
+        error = mlt_frame_get_image(frame, image, format, width, height, writable);
+        if (!error && key && *image && !mlt_frame_is_stale(frame))
+            render_cache_put(cache, key, frame, *image, *format, *width, *height, memory, disk);
+        mlt_properties_set_int64(properties, "render_cache_misses", ++cache->misses);
+    }
+    return error;
+}
+
 /** Protected method for consumer to get frames from connected service
  *
  * \public \memberof mlt_consumer_s
@@ -652,6 +1165,8 @@ mlt_frame mlt_consumer_get_frame(mlt_consumer self)
     }
 
     if (frame != NULL) {
+        consumer_private *priv = self->local;
+
         // Get the frame properties
         mlt_properties frame_properties = MLT_FRAME_PROPERTIES(frame);
 
@@ -688,6 +1203,12 @@ mlt_frame mlt_consumer_get_frame(mlt_consumer self)
         mlt_properties_set(frame_properties,
                            "consumer.color_range",
                            mlt_properties_get(properties, "color_range"));
+
+        // Serve the image from the render cache where possible
+        if (priv->render_cache && mlt_properties_get_int64(properties, "render_cache") > 0) {
+            mlt_frame_push_service(frame, self);
+            mlt_frame_push_get_image(frame, render_cache_get_image);
+        }
     }
 
     // Return the frame
@@ -801,6 +1322,7 @@ static void *consumer_read_ahead_thread(void *arg)
         // Mark as rendered
         mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "rendered", 1);
         last_pos = start_pos = pos = mlt_frame_get_position(frame);
+        priv->last_position = pos;
     }
 
     // Get the starting time (can ignore the times above)
@@ -816,11 +1338,20 @@ static void *consumer_read_ahead_thread(void *arg)
         pthread_mutex_lock(&priv->queue_mutex);
         while (priv->ahead && mlt_deque_count(priv->queue) >= buffer)
             pthread_cond_wait(&priv->queue_cond, &priv->queue_mutex);
-        if (priv->is_purge) {
+        if (priv->is_purge == 2 && frame
+            && (mlt_frame_get_position(frame) != priv->purge_position
+                || mlt_frame_is_stale(frame))) {
+            // Resume reading after the frames that a selective purge kept
+            mlt_frame_close(frame);
+            mlt_producer_seek(MLT_PRODUCER(mlt_service_producer(MLT_CONSUMER_SERVICE(self))),
+                              priv->purge_position);
+            priv->is_purge = 0;
+        } else if (priv->is_purge == 1) {
             mlt_frame_close(frame);
             priv->is_purge = 0;
         } else {
             mlt_deque_push_back(priv->queue, frame);
+            priv->is_purge = 0;
         }
         pthread_cond_broadcast(&priv->queue_cond);
         pthread_mutex_unlock(&priv->queue_mutex);
@@ -834,6 +1365,7 @@ static void *consumer_read_ahead_thread(void *arg)
         if (frame == NULL)
             continue;
         pos = mlt_frame_get_position(frame);
+        priv->last_position = pos;
         priv->speed = mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame), "_speed");
 
         // WebVfx uses this to setup a consumer-stopping event handler.
@@ -1303,10 +1835,81 @@ static void consumer_work_stop(mlt_consumer self)
     }
 }
 
+/** Drop only the buffered frames that are out of date.
+ *
+ * This applies while a single read-ahead thread plays forward at normal speed
+ * and nobody has moved the producer since it was last read. The frames at the
+ * front of the queue that no changed service contributed to are kept, and the
+ * read-ahead thread resumes after them. The caller holds the queue mutex.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ * \return true if the queue was purged selectively
+ */
+
+static int purge_selectively(mlt_consumer self)
+{
+    consumer_private *priv = self->local;
+    mlt_service service = mlt_service_producer(MLT_CONSUMER_SERVICE(self));
+    int count = mlt_deque_count(priv->queue);
+    mlt_position last_position = priv->last_position;
+    int i;
+
+    if (abs(priv->real_time) != 1 || priv->speed != 1 || priv->is_purge || count == 0)
+        return 0;
+    switch (mlt_service_identify(service)) {
+    case mlt_service_producer_type:
+    case mlt_service_playlist_type:
+    case mlt_service_tractor_type:
+    case mlt_service_chain_type:
+        break;
+    default:
+        return 0;
+    }
+
+    // The queue and the producer must continue from each other without a seek
+    mlt_frame tail = mlt_deque_peek_back(priv->queue);
+    mlt_position tail_position = mlt_frame_get_position(tail);
+    if (mlt_producer_position(MLT_PRODUCER(service)) != last_position + 1
+        || (last_position != tail_position && last_position != tail_position + 1))
+        return 0;
+    for (i = 1; i < count; i++) {
+        mlt_frame frame = mlt_deque_peek(priv->queue, i);
+        mlt_frame previous = mlt_deque_peek(priv->queue, i - 1);
+        if (mlt_frame_get_position(frame) != mlt_frame_get_position(previous) + 1)
+            return 0;
+    }
+
+    // Keep the frames before the first stale one
+    for (i = 0; i < count; i++)
+        if (mlt_frame_is_stale(mlt_deque_peek(priv->queue, i)))
+            break;
+    priv->purge_position = tail_position + 1;
+    while (mlt_deque_count(priv->queue) > i) {
+        mlt_frame frame = mlt_deque_pop_back(priv->queue);
+        priv->purge_position = mlt_frame_get_position(frame);
+        mlt_frame_close(frame);
+    }
+    mlt_log_debug(MLT_CONSUMER_SERVICE(self),
+                  "purge kept %d of %d frames and resumes at %d\n",
+                  i,
+                  count,
+                  priv->purge_position);
+
+    // The read-ahead thread checks the frame it is reading now
+    priv->is_purge = 2;
+    return 1;
+}
+
 /** Flush the read/render thread's buffer.
+ *
+ * Where the consumer plays forward at normal speed with one read-ahead thread
+ * and the producer was not moved, only the buffered frames that depend on a
+ * service that changed are dropped. Otherwise, the whole buffer is dropped.
  *
  * \public \memberof mlt_consumer_s
  * \param self a consumer
+ * \see mlt_frame_is_stale
  */
 
 void mlt_consumer_purge(mlt_consumer self)
@@ -1328,11 +1931,14 @@ void mlt_consumer_purge(mlt_consumer self)
         if (priv->started && priv->real_time)
             pthread_mutex_lock(&priv->queue_mutex);
 
-        while (priv->started && mlt_deque_count(priv->queue))
+        int is_selective = priv->started && priv->real_time && purge_selectively(self);
+
+        while (priv->started && !is_selective && mlt_deque_count(priv->queue))
             mlt_frame_close(mlt_deque_pop_back(priv->queue));
 
         if (priv->started && priv->real_time) {
-            priv->is_purge = 1;
+            if (!is_selective)
+                priv->is_purge = 1;
             pthread_cond_broadcast(&priv->queue_cond);
             pthread_mutex_unlock(&priv->queue_mutex);
             if (abs(priv->real_time) > 1) {
@@ -1717,6 +2323,7 @@ void mlt_consumer_close(mlt_consumer self)
             pthread_mutex_destroy(&priv->position_mutex);
 
             mlt_service_close(&self->parent);
+            render_cache_close(priv->render_cache);
             free(priv);
         }
     }
@@ -88,6 +88,16 @@
  * \properties \em color_range the color range as tv/mpeg (limited) or pc/jpeg (full); default is unset, which implies tv/mpeg
  * \properties \em color_trc the color transfer characteristic (gamma), default is unset
  * \properties \em deinterlacer the deinterlace algorithm to pass to deinterlace filters, defaults to "yadif"
+ * \properties \em render_cache the maximum number of bytes of rendered images to keep in memory
+ *   for positions that are rendered again without a change, defaults to 0 (disabled).
+ *   The cache is created when the consumer starts.
+ * \properties \em render_cache_path a directory to which images are moved when the memory of the
+ *   render cache is full instead of discarding them
+ * \properties \em render_cache_disk the maximum number of bytes of images to keep in
+ *   render_cache_path, defaults to 0 (no limit)
+ * \properties \em render_cache_hits the number of images served from the render cache (read only)
+ * \properties \em render_cache_misses the number of images rendered with the render cache
+ *   enabled (read only)
  */
 
 struct mlt_consumer_s
@@ -509,6 +509,7 @@ void mlt_factory_register_for_clean_up(void *ptr, mlt_destructor destructor)
 void mlt_factory_close()
 {
     if (mlt_directory != NULL) {
+        mlt_peaks_stop_jobs();
         mlt_properties_close(event_object);
         event_object = NULL;
 #if !defined(_WIN32)
@@ -523,6 +524,7 @@ void mlt_factory_close()
         }
         free(mlt_directory);
         mlt_directory = NULL;
+        mlt_frame_pool_close();
         mlt_pool_close();
     }
 }
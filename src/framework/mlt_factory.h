@@ -37,6 +37,9 @@
  * \envvar \em MLT_PRESETS_PATH overrides the default full path to the properties preset files, defaults to \p MLT_DATA/presets
  * \envvar \em MLT_REPOSITORY_DENY colon separated list of modules to skip. Example: libmltplus:libmltavformat:libmltfrei0r
  * In case both qt5 and qt6 modules are found and none of both is blocked by MLT_REPOSITORY_DENY, qt6 will be blocked
+ * \envvar \em MLT_REPOSITORY_MANIFEST the full path of a file that lists the services of each module.
+ * It is written when missing or out of date, otherwise modules are only opened when one of their services is first used.
+ * \envvar \em MLT_FRAME_POOL the number of closed frames kept for reuse by mlt_frame_init, defaults to 64; 0 disables it
  * \event \em producer-create-request fired when mlt_factory_producer is called;
  *   the event data is a pointer to mlt_factory_event_data
  * \event \em producer-create-done fired when a producer registers itself;
@@ -24,14 +24,127 @@
 #include "mlt_factory.h"
 #include "mlt_image.h"
 #include "mlt_log.h"
+#include "mlt_peaks.h"
 #include "mlt_producer.h"
 #include "mlt_profile.h"
 
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/** The default number of closed frames kept for reuse
+*/
+
+#define FRAME_POOL_SIZE (64)
+
+/** \brief a service that contributed to a frame, its generation and the position of its frame */
+
+typedef struct
+{
+    mlt_service service;
+    int generation;
+    mlt_position position;
+} frame_dependency;
+
+/** \brief the services that contributed to a frame */
+
+typedef struct
+{
+    int count;
+    int size;
+    frame_dependency items[];
+} frame_dependencies;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static mlt_deque pool = NULL;
+static int pool_size = FRAME_POOL_SIZE;
+
+/** Read the size of the frame pool from the environment.
+ *
+ * \private \memberof mlt_frame_s
+ */
+
+static void pool_init()
+{
+    const char *size = getenv("MLT_FRAME_POOL");
+    if (size)
+        pool_size = MAX(0, atoi(size));
+}
+
+/** Free a frame and the storage that the pool would keep.
+ *
+ * \private \memberof mlt_frame_s
+ * \param self a frame that nothing references anymore
+ */
+
+static void frame_destroy(mlt_frame self)
+{
+    mlt_deque_close(self->stack_image);
+    mlt_deque_close(self->stack_audio);
+    mlt_deque_close(self->stack_service);
+    mlt_properties_close(&self->parent);
+    free(self);
+}
+
+/** Take a closed frame from the pool.
+ *
+ * \private \memberof mlt_frame_s
+ * \return a frame with empty properties and stacks or NULL if the pool is empty
+ */
+
+static mlt_frame pool_take()
+{
+    mlt_frame self = NULL;
+    pthread_once(&pool_once, pool_init);
+    pthread_mutex_lock(&pool_mutex);
+    if (pool)
+        self = mlt_deque_pop_back(pool);
+    pthread_mutex_unlock(&pool_mutex);
+    return self;
+}
+
+/** Return a frame to the pool after emptying it.
+ *
+ * \private \memberof mlt_frame_s
+ * \param self a frame that nothing references anymore
+ * \return true if the pool is full and the frame must be destroyed instead
+ */
+
+static int pool_give(mlt_frame self)
+{
+    int error = 1;
+    pthread_once(&pool_once, pool_init);
+    pthread_mutex_lock(&pool_mutex);
+    error = (pool ? mlt_deque_count(pool) : 0) >= pool_size;
+    pthread_mutex_unlock(&pool_mutex);
+    if (!error) {
+        while (mlt_deque_count(self->stack_image))
+            mlt_deque_pop_back(self->stack_image);
+        while (mlt_deque_count(self->stack_audio))
+            mlt_deque_pop_back(self->stack_audio);
+        while (mlt_deque_count(self->stack_service))
+            mlt_deque_pop_back(self->stack_service);
+        mlt_properties_reset(&self->parent);
+        self->convert_image = NULL;
+        self->convert_audio = NULL;
+        self->is_processing = 0;
+        pthread_mutex_lock(&pool_mutex);
+        if (!pool)
+            pool = mlt_deque_init();
+        mlt_deque_push_back(pool, self);
+        pthread_mutex_unlock(&pool_mutex);
+    }
+    return error;
+}
+
 /** Construct a frame object.
+ *
+ * Frames are taken from a pool of closed frames when possible, which keeps the
+ * storage of their properties and stacks. Set the MLT_FRAME_POOL environment
+ * variable to the number of frames to keep; 0 disables the pool.
  *
  * \public \memberof mlt_frame_s
  * \param service the pointer to any service that can provide access to the profile
@@ -40,15 +153,24 @@
 
 mlt_frame mlt_frame_init(mlt_service service)
 {
-    // Allocate a frame
-    mlt_frame self = calloc(1, sizeof(struct mlt_frame_s));
+    // Reuse a closed frame or allocate a new one
+    mlt_frame self = pool_take();
 
     if (self != NULL) {
-        mlt_profile profile = mlt_service_profile(service);
-
+        mlt_properties_inc_ref(&self->parent);
+    } else if ((self = calloc(1, sizeof(struct mlt_frame_s)))) {
         // Initialise the properties
+        mlt_properties_init(&self->parent, self);
+
+        // Construct stacks for frames and methods
+        self->stack_image = mlt_deque_init();
+        self->stack_audio = mlt_deque_init();
+        self->stack_service = mlt_deque_init();
+    }
+
+    if (self != NULL) {
+        mlt_profile profile = mlt_service_profile(service);
         mlt_properties properties = &self->parent;
-        mlt_properties_init(properties, self);
 
         // Set default properties on the frame
         mlt_properties_set_position(properties, "_position", 0.0);
@@ -58,11 +180,6 @@ mlt_frame mlt_frame_init(mlt_service service)
         mlt_properties_set_double(properties, "aspect_ratio", mlt_profile_sar(NULL));
         mlt_properties_set_data(properties, "audio", NULL, 0, NULL, NULL);
         mlt_properties_set_data(properties, "alpha", NULL, 0, NULL, NULL);
-
-        // Construct stacks for frames and methods
-        self->stack_image = mlt_deque_init();
-        self->stack_audio = mlt_deque_init();
-        self->stack_service = mlt_deque_init();
     }
 
     return self;
@@ -321,6 +438,241 @@ mlt_deque mlt_frame_service_stack(mlt_frame self)
     return self->stack_service;
 }
 
+/** Release the services recorded by a frame.
+ *
+ * \private \memberof mlt_frame_s
+ * \param dependencies the dependencies of a frame
+ */
+
+static void close_dependencies(frame_dependencies *dependencies)
+{
+    int i;
+    for (i = 0; i < dependencies->count; i++)
+        mlt_service_close(dependencies->items[i].service);
+    free(dependencies);
+}
+
+/** Record a service and its generation on a frame.
+ *
+ * \private \memberof mlt_frame_s
+ * \param self a frame
+ * \param service the service
+ * \param generation the generation of the service when it contributed to the frame
+ * \param position the position of the frame the service contributed to
+ */
+
+static void add_dependency(mlt_frame self,
+                           mlt_service service,
+                           int generation,
+                           mlt_position position)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(self);
+    frame_dependencies *dependencies = mlt_properties_get_data(properties, "_dependencies", NULL);
+    int i;
+
+    // Keep the oldest generation of a service that is seen more than once
+    for (i = 0; dependencies && i < dependencies->count; i++) {
+        if (dependencies->items[i].service == service) {
+            if (generation < dependencies->items[i].generation)
+                dependencies->items[i].generation = generation;
+            return;
+        }
+    }
+
+    if (dependencies == NULL || dependencies->count == dependencies->size) {
+        int size = dependencies ? dependencies->size * 2 : 8;
+        frame_dependencies *grown = malloc(sizeof(*grown) + size * sizeof(frame_dependency));
+        if (grown == NULL)
+            return;
+        grown->count = 0;
+        grown->size = size;
+        if (dependencies) {
+            // The services move to the new list without releasing them
+            memcpy(grown->items,
+                   dependencies->items,
+                   dependencies->count * sizeof(frame_dependency));
+            grown->count = dependencies->count;
+            dependencies->count = 0;
+        }
+        mlt_properties_set_data(properties,
+                                "_dependencies",
+                                grown,
+                                0,
+                                (mlt_destructor) close_dependencies,
+                                NULL);
+        dependencies = grown;
+    }
+    mlt_properties_inc_ref(MLT_SERVICE_PROPERTIES(service));
+    dependencies->items[dependencies->count].service = service;
+    dependencies->items[dependencies->count].generation = generation;
+    dependencies->items[dependencies->count].position = position;
+    dependencies->count++;
+}
+
+/** Record that a service contributed to a frame.
+ *
+ * \p mlt_service_get_frame records the service and its filters on every frame,
+ * so most services never need to call this.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param service the service
+ * \see mlt_frame_is_stale
+ */
+
+void mlt_frame_add_dependency(mlt_frame self, mlt_service service)
+{
+    if (self && service)
+        add_dependency(self,
+                       service,
+                       mlt_service_generation(service),
+                       mlt_frame_get_position(self));
+}
+
+/** Record the services that contributed to another frame on a frame.
+ *
+ * Use this when a frame is composed from other frames, for example the frames
+ * of the tracks of a tractor.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \param that the frame that contributed to \p self
+ */
+
+void mlt_frame_add_dependencies(mlt_frame self, mlt_frame that)
+{
+    if (!self || !that || self == that)
+        return;
+    frame_dependencies *dependencies = mlt_properties_get_data(MLT_FRAME_PROPERTIES(that),
+                                                               "_dependencies",
+                                                               NULL);
+    int i;
+    for (i = 0; dependencies && i < dependencies->count; i++)
+        add_dependency(self,
+                       dependencies->items[i].service,
+                       dependencies->items[i].generation,
+                       dependencies->items[i].position);
+}
+
+/** Determine if a frame is out of date.
+ *
+ * A frame is stale when any service that contributed to it has changed since.
+ * A consumer or cache may keep a frame that is not stale instead of rendering
+ * its position again.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \return true if a service that contributed to the frame has changed
+ */
+
+int mlt_frame_is_stale(mlt_frame self)
+{
+    if (!self)
+        return 1;
+    frame_dependencies *dependencies = mlt_properties_get_data(MLT_FRAME_PROPERTIES(self),
+                                                               "_dependencies",
+                                                               NULL);
+    int i;
+    for (i = 0; dependencies && i < dependencies->count; i++)
+        if (mlt_service_generation(dependencies->items[i].service)
+            != dependencies->items[i].generation)
+            return 1;
+    return 0;
+}
+
+/** Mix bytes into a 64-bit FNV-1a hash.
+ *
+ * \private \memberof mlt_frame_s
+ * \param hash the hash so far
+ * \param data the bytes
+ * \param size the number of bytes
+ * \return the new hash
+ */
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    while (size--) {
+        hash ^= *p++;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/** Hash the public properties of a service.
+ *
+ * The hash is kept on the service until its generation changes.
+ *
+ * \private \memberof mlt_frame_s
+ * \param service a service
+ * \param generation the current generation of the service
+ * \return the hash of the names and values of the public properties
+ */
+
+static uint64_t service_state_hash(mlt_service service, int generation)
+{
+    mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    int i;
+
+    if (mlt_properties_get(properties, "_state_hash")
+        && mlt_properties_get_int(properties, "_state_generation") == generation)
+        return (uint64_t) mlt_properties_get_int64(properties, "_state_hash");
+
+    mlt_properties_lock(properties);
+    for (i = 0; i < mlt_properties_count(properties); i++) {
+        const char *name = mlt_properties_get_name(properties, i);
+        const char *value = mlt_properties_get_value(properties, i);
+        if (name && name[0] != '_' && value) {
+            hash = hash_bytes(hash, name, strlen(name) + 1);
+            hash = hash_bytes(hash, value, strlen(value) + 1);
+        }
+    }
+    mlt_properties_unlock(properties);
+    mlt_properties_set_int64(properties, "_state_hash", (int64_t) hash);
+    mlt_properties_set_int(properties, "_state_generation", generation);
+    return hash;
+}
+
+/** Hash the content of the services that contributed to a frame.
+ *
+ * The hash covers, in order, the type and public properties of every service
+ * recorded on the frame (such as its resource, in and out points and filter
+ * parameters) and the position of the frame it contributed to. It does not
+ * depend on the addresses or generations of the services, so it stays the
+ * same when a producer sets its properties again to the same values, and a
+ * graph that is rebuilt with the same content gets the same hash. Two frames
+ * with the same hash and position were produced by the same content.
+ *
+ * \public \memberof mlt_frame_s
+ * \param self a frame
+ * \return the hash or 0 if no service was recorded on the frame
+ * \see mlt_frame_add_dependency
+ */
+
+uint64_t mlt_frame_graph_hash(mlt_frame self)
+{
+    frame_dependencies *dependencies = self ? mlt_properties_get_data(MLT_FRAME_PROPERTIES(self),
+                                                                      "_dependencies",
+                                                                      NULL)
+                                            : NULL;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    int i;
+
+    if (dependencies == NULL || dependencies->count == 0)
+        return 0;
+    for (i = 0; i < dependencies->count; i++) {
+        frame_dependency *item = &dependencies->items[i];
+        uint64_t state = service_state_hash(item->service,
+                                            mlt_service_generation(item->service));
+        int type = mlt_service_identify(item->service);
+        hash = hash_bytes(hash, &type, sizeof(type));
+        hash = hash_bytes(hash, &item->position, sizeof(item->position));
+        hash = hash_bytes(hash, &state, sizeof(state));
+    }
+    return hash ? hash : 1;
+}
+
 /** Set a new image on the frame.
   *
   * \public \memberof mlt_frame_s
@@ -710,10 +1062,57 @@ int mlt_frame_set_audio(
                                    NULL);
 }
 
+/** Draw the waveform of a frame from the peak index of its producer.
+ *
+ * Each column is a line from the lowest to the highest sample that it covers.
+ */
+
+static unsigned char *get_peaks_waveform(mlt_frame self, mlt_peaks peaks, double fps, int w, int h)
+{
+    int channels = mlt_peaks_channels(peaks);
+    int frequency = mlt_peaks_frequency(peaks);
+    mlt_position position = mlt_frame_original_position(self);
+    int64_t start = mlt_audio_calculate_samples_to_position(fps, frequency, position);
+    int64_t end = start + mlt_audio_calculate_frame_samples(fps, frequency, position);
+    mlt_peak *columns = malloc(w * sizeof(mlt_peak));
+    unsigned char *bitmap = mlt_pool_alloc(w * h);
+    int i, j, y;
+
+    if (!columns || !bitmap) {
+        free(columns);
+        mlt_pool_release(bitmap);
+        return NULL;
+    }
+    memset(bitmap, 0, w * h);
+    mlt_properties_set_data(MLT_FRAME_PROPERTIES(self),
+                            "waveform",
+                            bitmap,
+                            w * h,
+                            (mlt_destructor) mlt_pool_release,
+                            NULL);
+
+    // Each channel has a band of the height, the first one at the top
+    for (j = 0; j < channels && !mlt_peaks_get(peaks, j, start, end, columns, w); j++) {
+        int center = h * (j * 2 + 1) / channels / 2;
+        int half = h / channels / 2;
+        for (i = 0; i < w; i++) {
+            int top = center - lrintf(columns[i].max * half);
+            int bottom = center - lrintf(columns[i].min * half);
+            for (y = top < 0 ? 0 : top; y <= bottom && y < h; y++)
+                bitmap[y * w + i] = 0xFF;
+        }
+    }
+    free(columns);
+
+    return bitmap;
+}
+
 /** Get audio on a frame as a waveform image.
  *
  * This generates an 8-bit grayscale image representation of the audio in a
  * frame. Currently, this only really works for 2 channels.
+ * When the producer of the frame has a peak index (see mlt_peaks_for_producer)
+ * the image is drawn from it without getting the audio of the frame.
  * This allocates the bitmap using mlt_pool so you should release the return
  * value with \p mlt_pool_release.
  *
@@ -734,6 +1133,10 @@ unsigned char *mlt_frame_get_waveform(mlt_frame self, int w, int h)
     mlt_producer producer = mlt_frame_get_original_producer(self);
     double fps = mlt_producer_get_fps(mlt_producer_cut_parent(producer));
     int samples = mlt_audio_calculate_frame_samples(fps, frequency, mlt_frame_get_position(self));
+    mlt_peaks peaks = mlt_peaks_for_producer(producer);
+
+    if (peaks && w > 0 && h > 0)
+        return get_peaks_waveform(self, peaks, fps, w, h);
 
     // Increase audio resolution proportional to requested image size
     while (samples < w) {
@@ -819,14 +1222,32 @@ mlt_producer mlt_frame_get_original_producer(mlt_frame self)
 void mlt_frame_close(mlt_frame self)
 {
     if (self != NULL && mlt_properties_dec_ref(MLT_FRAME_PROPERTIES(self)) <= 0) {
-        mlt_deque_close(self->stack_image);
-        mlt_deque_close(self->stack_audio);
         while (mlt_deque_peek_back(self->stack_service))
             mlt_service_close(mlt_deque_pop_back(self->stack_service));
-        mlt_deque_close(self->stack_service);
-        mlt_properties_close(&self->parent);
-        free(self);
+        if (pool_give(self))
+            frame_destroy(self);
+    }
+}
+
+/** Free the frames kept for reuse by mlt_frame_init.
+ *
+ * This is called by mlt_factory_close.
+ *
+ * \public \memberof mlt_frame_s
+ */
+
+void mlt_frame_pool_close()
+{
+    mlt_frame self;
+
+    pthread_mutex_lock(&pool_mutex);
+    if (pool) {
+        while ((self = mlt_deque_pop_back(pool)))
+            frame_destroy(self);
+        mlt_deque_close(pool);
+        pool = NULL;
     }
+    pthread_mutex_unlock(&pool_mutex);
 }
 
 /***** convenience functions *****/
@@ -166,8 +166,13 @@ extern int mlt_frame_pop_service_int(mlt_frame self);
 extern int mlt_frame_push_audio(mlt_frame self, void *that);
 extern void *mlt_frame_pop_audio(mlt_frame self);
 extern mlt_deque mlt_frame_service_stack(mlt_frame self);
+extern void mlt_frame_add_dependency(mlt_frame self, mlt_service service);
+extern void mlt_frame_add_dependencies(mlt_frame self, mlt_frame that);
+extern int mlt_frame_is_stale(mlt_frame self);
+extern uint64_t mlt_frame_graph_hash(mlt_frame self);
 extern mlt_producer mlt_frame_get_original_producer(mlt_frame self);
 extern void mlt_frame_close(mlt_frame self);
+extern void mlt_frame_pool_close();
 extern mlt_properties mlt_frame_unique_properties(mlt_frame self, mlt_service service);
 extern mlt_properties mlt_frame_get_unique_properties(mlt_frame self, mlt_service service);
 extern mlt_frame mlt_frame_clone(mlt_frame self, int is_deep);
@@ -0,0 +1,931 @@
+/**
+ * \file mlt_peaks.c
+ * \brief Peak index of audio for waveform displays
+ * \see mlt_peaks_s
+ *
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mlt_peaks.h"
+#include "mlt_audio.h"
+#include "mlt_factory.h"
+#include "mlt_frame.h"
+#include "mlt_log.h"
+#include "mlt_pool.h"
+#include "mlt_producer.h"
+#include "mlt_profile.h"
+#include "mlt_properties.h"
+#include "mlt_service.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PEAKS_MAGIC "MLTPEAKS"
+#define PEAKS_VERSION (2)
+/** The number of samples summarized by each entry of the first level */
+#define PEAKS_BLOCK (256)
+/** The number of entries of a level that make up one entry of the next */
+#define PEAKS_FACTOR (4)
+#define PEAKS_MAX_LEVELS (16)
+#define PEAKS_MAX_CHANNELS (1024)
+#define PEAKS_MAX_SOURCE (4096)
+#define PEAKS_SCALE (32767.0)
+
+/** Guards storing the index of a producer and starting its generation */
+static pthread_mutex_t producer_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief the generation of an index file in a thread of its own */
+
+typedef struct peaks_job_s
+{
+    mlt_profile profile;
+    mlt_properties properties; /**< the properties of the producer to copy */
+    mlt_producer producer;     /**< a copy of the producer opened by the job */
+    char *filename;
+    char *source; /**< the fingerprint of the audio to store in the file */
+    pthread_t thread;
+    atomic_int cancel;
+    atomic_int done;
+    struct peaks_job_s *next;
+} peaks_job;
+
+/** Guards the list of jobs */
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static peaks_job *jobs = NULL;
+
+/** An entry of the index, in the sample range of 16 bit audio */
+
+typedef struct
+{
+    int16_t min;
+    int16_t max;
+    int16_t rms;
+} peak_entry;
+
+/** \brief Peaks class
+ *
+ * The peaks of a stream of audio are a pyramid of levels. Each entry of the
+ * first level has the minimum, maximum and RMS of one block of samples of a
+ * channel, and each entry of the next level summarizes PEAKS_FACTOR entries
+ * of the level below. A query uses the coarsest level that still resolves it.
+ */
+
+struct mlt_peaks_s
+{
+    int frequency;
+    int channels;
+    int64_t samples;
+    int levels; /**< the number of levels built, 0 after audio was added */
+    int64_t count[PEAKS_MAX_LEVELS];     /**< the number of entries of each channel */
+    int64_t allocated[PEAKS_MAX_LEVELS]; /**< the capacity of each level in entries */
+    peak_entry *entries[PEAKS_MAX_LEVELS]; /**< the entries with the channels interleaved */
+    int64_t complete;                      /**< the number of full blocks added */
+    int block_used;                        /**< the samples in the block being added */
+    float *block_min;
+    float *block_max;
+    double *block_squares;
+    int sealed;   /**< loaded from a file, no more audio can be added */
+    char *source; /**< identifies the audio the index was made from, saved with it */
+};
+
+static int64_t block_size(int level)
+{
+    int64_t size = PEAKS_BLOCK;
+    while (level--)
+        size *= PEAKS_FACTOR;
+    return size;
+}
+
+/** Get the number of samples of a channel that an entry summarizes.
+ */
+
+static int64_t entry_samples(mlt_peaks self, int level, int64_t index)
+{
+    int64_t size = block_size(level);
+    int64_t remaining = self->samples - index * size;
+    return remaining < size ? remaining : size;
+}
+
+static int16_t scale_sample(double value)
+{
+    value = value < -1.0 ? -1.0 : value > 1.0 ? 1.0 : value;
+    return lrint(value * PEAKS_SCALE);
+}
+
+static int reserve_entries(mlt_peaks self, int level, int64_t count)
+{
+    if (count > self->allocated[level]) {
+        int64_t allocated = self->allocated[level] ? self->allocated[level] * 2 : 1024;
+        while (allocated < count)
+            allocated *= 2;
+        peak_entry *entries = realloc(self->entries[level],
+                                      allocated * self->channels * sizeof(peak_entry));
+        if (!entries)
+            return 1;
+        self->entries[level] = entries;
+        self->allocated[level] = allocated;
+    }
+    return 0;
+}
+
+/** Write the block being added as an entry of the first level.
+ */
+
+static int store_block(mlt_peaks self, int64_t index)
+{
+    int c;
+
+    if (reserve_entries(self, 0, index + 1))
+        return 1;
+    for (c = 0; c < self->channels; c++) {
+        peak_entry *entry = &self->entries[0][index * self->channels + c];
+        entry->min = scale_sample(self->block_min[c]);
+        entry->max = scale_sample(self->block_max[c]);
+        entry->rms = scale_sample(sqrt(self->block_squares[c] / self->block_used));
+    }
+    return 0;
+}
+
+/** Build the levels of the pyramid from the audio added so far.
+ */
+
+static void build_levels(mlt_peaks self)
+{
+    int level;
+
+    if (self->levels)
+        return;
+
+    // A partial block at the end is kept as the last entry until it is complete
+    self->count[0] = self->complete;
+    if (self->block_used > 0 && !store_block(self, self->complete))
+        self->count[0]++;
+    self->levels = 1;
+
+    for (level = 1; level < PEAKS_MAX_LEVELS && self->count[level - 1] > 1; level++) {
+        int64_t count = (self->count[level - 1] + PEAKS_FACTOR - 1) / PEAKS_FACTOR;
+        int64_t i, j;
+        int c;
+
+        if (reserve_entries(self, level, count))
+            break;
+        for (i = 0; i < count; i++) {
+            int64_t first = i * PEAKS_FACTOR;
+            int64_t last = first + PEAKS_FACTOR;
+            if (last > self->count[level - 1])
+                last = self->count[level - 1];
+            for (c = 0; c < self->channels; c++) {
+                peak_entry *entry = &self->entries[level][i * self->channels + c];
+                double squares = 0.0;
+                int64_t samples = 0;
+                entry->min = INT16_MAX;
+                entry->max = INT16_MIN;
+                for (j = first; j < last; j++) {
+                    const peak_entry *below = &self->entries[level - 1][j * self->channels + c];
+                    int64_t n = entry_samples(self, level - 1, j);
+                    if (below->min < entry->min)
+                        entry->min = below->min;
+                    if (below->max > entry->max)
+                        entry->max = below->max;
+                    squares += (double) below->rms * below->rms * n;
+                    samples += n;
+                }
+                entry->rms = samples > 0 ? lrint(sqrt(squares / samples)) : 0;
+            }
+        }
+        self->count[level] = count;
+        self->levels = level + 1;
+    }
+}
+
+/** Create an empty index of peaks.
+ *
+ * Add the audio with mlt_peaks_add().
+ * \public \memberof mlt_peaks_s
+ * \param frequency the sample rate of the audio
+ * \param channels the number of channels of the audio
+ * \return a new index or NULL on error
+ */
+
+mlt_peaks mlt_peaks_new(int frequency, int channels)
+{
+    mlt_peaks self;
+
+    if (frequency <= 0 || channels <= 0 || channels > PEAKS_MAX_CHANNELS)
+        return NULL;
+    self = calloc(1, sizeof(struct mlt_peaks_s));
+    if (self) {
+        self->frequency = frequency;
+        self->channels = channels;
+        self->block_min = calloc(channels, sizeof(float));
+        self->block_max = calloc(channels, sizeof(float));
+        self->block_squares = calloc(channels, sizeof(double));
+        if (!self->block_min || !self->block_max || !self->block_squares) {
+            mlt_peaks_close(self);
+            self = NULL;
+        }
+    }
+    return self;
+}
+
+/** Add audio to the end of the index.
+ *
+ * Nothing is added to an index loaded from a file.
+ * \public \memberof mlt_peaks_s
+ * \param self an index
+ * \param samples interleaved 32-bit floating point samples (mlt_audio_f32le)
+ * \param count the number of samples per channel
+ */
+
+void mlt_peaks_add(mlt_peaks self, const float *samples, int count)
+{
+    int i, c;
+
+    if (!self || !samples || count <= 0 || self->sealed)
+        return;
+    for (i = 0; i < count; i++) {
+        if (self->block_used == 0) {
+            for (c = 0; c < self->channels; c++) {
+                self->block_min[c] = INFINITY;
+                self->block_max[c] = -INFINITY;
+                self->block_squares[c] = 0.0;
+            }
+        }
+        for (c = 0; c < self->channels; c++) {
+            float sample = *samples++;
+            if (sample < self->block_min[c])
+                self->block_min[c] = sample;
+            if (sample > self->block_max[c])
+                self->block_max[c] = sample;
+            self->block_squares[c] += (double) sample * sample;
+        }
+        if (++self->block_used == PEAKS_BLOCK) {
+            if (!store_block(self, self->complete))
+                self->complete++;
+            self->block_used = 0;
+        }
+    }
+    self->samples += count;
+    self->levels = 0;
+}
+
+/** Get the sample rate of the audio of an index.
+ *
+ * \public \memberof mlt_peaks_s
+ * \param self an index
+ * \return the sample rate
+ */
+
+int mlt_peaks_frequency(mlt_peaks self)
+{
+    return self ? self->frequency : 0;
+}
+
+/** Get the number of channels of an index.
+ *
+ * \public \memberof mlt_peaks_s
+ * \param self an index
+ * \return the number of channels
+ */
+
+int mlt_peaks_channels(mlt_peaks self)
+{
+    return self ? self->channels : 0;
+}
+
+/** Get the length of the audio of an index.
+ *
+ * \public \memberof mlt_peaks_s
+ * \param self an index
+ * \return the number of samples per channel
+ */
+
+int64_t mlt_peaks_samples(mlt_peaks self)
+{
+    return self ? self->samples : 0;
+}
+
+/** Set what identifies the audio of an index.
+ *
+ * The source is saved with the index, so that a file can be checked against
+ * the audio it is meant for when it is loaded.
+ * \public \memberof mlt_peaks_s
+ * \param self an index
+ * \param source a string that changes when the audio changes, or NULL
+ */
+
+void mlt_peaks_set_source(mlt_peaks self, const char *source)
+{
+    if (!self)
+        return;
+    free(self->source);
+    self->source = source && strlen(source) <= PEAKS_MAX_SOURCE ? strdup(source) : NULL;
+}
+
+/** Get what identifies the audio of an index.
+ *
+ * \public \memberof mlt_peaks_s
+ * \param self an index
+ * \return the source set by mlt_peaks_set_source() or loaded with the index, or NULL
+ */
+
+const char *mlt_peaks_source(mlt_peaks self)
+{
+    return self && self->source && self->source[0] ? self->source : NULL;
+}
+
+/** Summarize the entries of a level that cover a range of samples.
+ */
+
+static void combine_entries(
+    mlt_peaks self, int level, int channel, int64_t start, int64_t end, mlt_peak *peak)
+{
+    int64_t size = block_size(level);
+    int64_t i, first, last;
+    int c, first_channel, last_channel;
+    int min = INT16_MAX;
+    int max = INT16_MIN;
+    double squares = 0.0;
+    int64_t samples = 0;
+
+    peak->min = peak->max = peak->rms = 0.0f;
+    if (start < 0)
+        start = 0;
+    if (end > self->samples)
+        end = self->samples;
+    if (end <= start)
+        return;
+
+    first = start / size;
+    last = (end - 1) / size;
+    if (last >= self->count[level])
+        last = self->count[level] - 1;
+    first_channel = channel < 0 ? 0 : channel;
+    last_channel = channel < 0 ? self->channels - 1 : channel;
+    for (i = first; i <= last; i++) {
+        int64_t n = entry_samples(self, level, i);
+        for (c = first_channel; c <= last_channel; c++) {
+            const peak_entry *entry = &self->entries[level][i * self->channels + c];
+            if (entry->min < min)
+                min = entry->min;
+            if (entry->max > max)
+                max = entry->max;
+            squares += (double) entry->rms * entry->rms * n;
+            samples += n;
+        }
+    }
+    if (samples > 0) {
+        peak->min = min / PEAKS_SCALE;
+        peak->max = max / PEAKS_SCALE;
+        peak->rms = sqrt(squares / samples) / PEAKS_SCALE;
+    }
+}
+
+/** Get the peaks of a range of audio at any zoom.
+ *
+ * The range is divided into \p count equal parts and one peak is computed for
+ * each from the coarsest level that resolves the part. The resolution is
+ * limited to blocks of 256 samples. Parts outside of the audio are silent.
+ * \public \memberof mlt_peaks_s
+ * \param self an index
+ * \param channel the channel to summarize or -1 for all channels together
+ * \param start the first sample of the range
+ * \param end the sample after the range
+ * \param peaks the array that receives the peaks
+ * \param count the number of peaks to get
+ * \return true on error
+ */
+
+int mlt_peaks_get(
+    mlt_peaks self, int channel, int64_t start, int64_t end, mlt_peak *peaks, int count)
+{
+    int i;
+
+    if (!self || !peaks || count <= 0 || end <= start || channel < -1
+        || channel >= self->channels)
+        return 1;
+    build_levels(self);
+    for (i = 0; i < count; i++) {
+        int64_t first = start + (end - start) * i / count;
+        int64_t last = start + (end - start) * (i + 1) / count;
+        int64_t size = PEAKS_BLOCK;
+        int level = 0;
+
+        if (last <= first)
+            last = first + 1;
+        while (level + 1 < self->levels && size * PEAKS_FACTOR <= last - first) {
+            size *= PEAKS_FACTOR;
+            level++;
+        }
+        combine_entries(self, level, channel, first, last, &peaks[i]);
+    }
+    return 0;
+}
+
+/** Save an index to a file.
+ *
+ * The file has a header, with the source set by mlt_peaks_set_source(), followed
+ * by the entries of every level, in the byte order of this machine.
+ * \public \memberof mlt_peaks_s
+ * \param self an index
+ * \param filename the name of the file
+ * \return true on error
+ */
+
+int mlt_peaks_save(mlt_peaks self, const char *filename)
+{
+    FILE *file;
+    int32_t header[6];
+    int32_t source_size;
+    int error, i;
+
+    if (!self || !filename)
+        return 1;
+    build_levels(self);
+    source_size = self->source ? strlen(self->source) : 0;
+    file = mlt_fopen(filename, "wb");
+    if (!file)
+        return 1;
+    header[0] = PEAKS_VERSION;
+    header[1] = self->frequency;
+    header[2] = self->channels;
+    header[3] = PEAKS_BLOCK;
+    header[4] = PEAKS_FACTOR;
+    header[5] = self->levels;
+    error = fwrite(PEAKS_MAGIC, strlen(PEAKS_MAGIC), 1, file) != 1
+            || fwrite(header, sizeof(header), 1, file) != 1
+            || fwrite(&self->samples, sizeof(self->samples), 1, file) != 1
+            || fwrite(&source_size, sizeof(source_size), 1, file) != 1
+            || (source_size > 0 && fwrite(self->source, source_size, 1, file) != 1)
+            || fwrite(self->count, sizeof(int64_t), self->levels, file) != (size_t) self->levels;
+    for (i = 0; i < self->levels && !error; i++) {
+        size_t size = self->count[i] * self->channels;
+        error = fwrite(self->entries[i], sizeof(peak_entry), size, file) != size;
+    }
+    error |= fclose(file) != 0;
+    return error;
+}
+
+/** Load an index from a file written by mlt_peaks_save().
+ *
+ * \public \memberof mlt_peaks_s
+ * \param filename the name of the file
+ * \return an index or NULL if the file is missing or not valid
+ */
+
+mlt_peaks mlt_peaks_load(const char *filename)
+{
+    FILE *file = filename ? mlt_fopen(filename, "rb") : NULL;
+    char magic[sizeof(PEAKS_MAGIC)] = "";
+    int32_t header[6];
+    int64_t samples;
+    int32_t source_size = 0;
+    mlt_peaks self = NULL;
+    int error, i;
+
+    if (!file)
+        return NULL;
+    error = fread(magic, strlen(PEAKS_MAGIC), 1, file) != 1 || strcmp(magic, PEAKS_MAGIC)
+            || fread(header, sizeof(header), 1, file) != 1 || header[0] != PEAKS_VERSION
+            || header[3] != PEAKS_BLOCK || header[4] != PEAKS_FACTOR || header[5] < 1
+            || header[5] > PEAKS_MAX_LEVELS || fread(&samples, sizeof(samples), 1, file) != 1
+            || samples < 0 || fread(&source_size, sizeof(source_size), 1, file) != 1
+            || source_size < 0 || source_size > PEAKS_MAX_SOURCE;
+    if (!error)
+        self = mlt_peaks_new(header[1], header[2]);
+    if (self) {
+        self->source = calloc(1, source_size + 1);
+        error = !self->source
+                || (source_size > 0 && fread(self->source, source_size, 1, file) != 1);
+        self->samples = samples;
+        self->levels = header[5];
+        self->sealed = 1;
+        error = error
+                || fread(self->count, sizeof(int64_t), self->levels, file) != (size_t) self->levels
+                || self->count[0] != (samples + PEAKS_BLOCK - 1) / PEAKS_BLOCK;
+        for (i = 1; i < self->levels && !error; i++)
+            error = self->count[i] != (self->count[i - 1] + PEAKS_FACTOR - 1) / PEAKS_FACTOR;
+        for (i = 0; i < self->levels && !error; i++) {
+            size_t size = self->count[i] * self->channels;
+            error = reserve_entries(self, i, self->count[i])
+                    || fread(self->entries[i], sizeof(peak_entry), size, file) != size;
+        }
+        self->complete = self->count[0];
+        if (error) {
+            mlt_peaks_close(self);
+            self = NULL;
+        }
+    }
+    fclose(file);
+    return self;
+}
+
+/** Add audio of any format to an index, or silence if it does not fit the index.
+ */
+
+static void add_frame_audio(mlt_peaks self,
+                            void *buffer,
+                            mlt_audio_format format,
+                            int frequency,
+                            int channels,
+                            int samples,
+                            int expected)
+{
+    int size = mlt_audio_format_size(mlt_audio_f32le, expected, self->channels);
+    float *converted = mlt_pool_alloc(size);
+
+    if (!converted)
+        return;
+    if (!buffer || frequency != self->frequency || channels != self->channels
+        || samples != expected
+        || mlt_audio_convert_samples(converted, mlt_audio_f32le, buffer, format, samples, channels))
+        memset(converted, 0, size);
+    mlt_peaks_add(self, converted, expected);
+    mlt_pool_release(converted);
+}
+
+/** Create the index of the audio of a producer unless cancelled.
+ *
+ * \private \memberof mlt_peaks_s
+ * \param producer a producer
+ * \param cancel stop reading when this becomes true (optional)
+ * \return a new index or NULL on error or when cancelled
+ */
+
+static mlt_peaks generate(mlt_producer producer, atomic_int *cancel)
+{
+    mlt_peaks self = NULL;
+    mlt_position length = producer ? mlt_producer_get_length(producer) : 0;
+    double fps = producer ? mlt_producer_get_fps(producer) : 0.0;
+    mlt_position position;
+
+    if (fps <= 0.0)
+        return NULL;
+    for (position = 0; position < length; position++) {
+        mlt_frame frame = NULL;
+        void *buffer = NULL;
+        mlt_audio_format format = mlt_audio_f32le;
+        int frequency, channels, samples, expected;
+
+        if (cancel && atomic_load(cancel)) {
+            mlt_peaks_close(self);
+            return NULL;
+        }
+        mlt_producer_seek(producer, position);
+        if (mlt_service_get_frame(MLT_PRODUCER_SERVICE(producer), &frame, 0) || !frame)
+            break;
+        if (!self) {
+            frequency = mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame), "audio_frequency");
+            channels = mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame), "audio_channels");
+            self = mlt_peaks_new(frequency > 0 ? frequency : 48000, channels > 0 ? channels : 2);
+            if (!self) {
+                mlt_frame_close(frame);
+                break;
+            }
+        }
+        frequency = self->frequency;
+        channels = self->channels;
+        expected = mlt_audio_calculate_frame_samples(fps, frequency, position);
+        samples = expected;
+        if (mlt_frame_get_audio(frame, &buffer, &format, &frequency, &channels, &samples))
+            buffer = NULL;
+        add_frame_audio(self, buffer, format, frequency, channels, samples, expected);
+        mlt_frame_close(frame);
+    }
+    return self;
+}
+
+/** Create the index of the audio of a producer.
+ *
+ * This reads all of the audio of the producer from the start, so it is
+ * normally run on a copy of the producer in a thread of its own.
+ * \public \memberof mlt_peaks_s
+ * \param producer a producer
+ * \return a new index or NULL on error
+ */
+
+mlt_peaks mlt_peaks_generate(mlt_producer producer)
+{
+    return generate(producer, NULL);
+}
+
+/** Get what identifies the audio of a producer for its index file.
+ *
+ * This is the service, the resource, the size and modification time of the
+ * file of the resource if it is one, and the properties that select the
+ * stream or change the length.
+ * \return a new string
+ */
+
+static char *producer_source(mlt_producer producer)
+{
+    mlt_properties properties = MLT_PRODUCER_PROPERTIES(producer);
+    const char *service = mlt_properties_get(properties, "mlt_service");
+    const char *resource = mlt_properties_get(properties, "resource");
+    const char *audio_index = mlt_properties_get(properties, "audio_index");
+    struct stat info;
+    size_t size;
+    char *source;
+
+    memset(&info, 0, sizeof(info));
+    if (resource && mlt_stat(resource, &info))
+        memset(&info, 0, sizeof(info));
+    size = (service ? strlen(service) : 0) + (resource ? strlen(resource) : 0)
+           + (audio_index ? strlen(audio_index) : 0) + 128;
+    source = malloc(size);
+    if (source)
+        snprintf(source,
+                 size,
+                 "%s:%s size=%lld mtime=%lld audio_index=%s length=%d",
+                 service ? service : "",
+                 resource ? resource : "",
+                 (long long) info.st_size,
+                 (long long) info.st_mtime,
+                 audio_index ? audio_index : "",
+                 mlt_properties_get_int(properties, "length"));
+    return source;
+}
+
+/** Release a job and the copy of the producer it read from.
+ */
+
+static void job_close(peaks_job *job)
+{
+    mlt_producer_close(job->producer);
+    mlt_properties_close(job->properties);
+    mlt_profile_close(job->profile);
+    free(job->filename);
+    free(job->source);
+    free(job);
+}
+
+/** Open a copy of the producer of a job.
+ *
+ * This opens and probes the media, so it is done on the thread of the job.
+ */
+
+static mlt_producer open_producer(peaks_job *job)
+{
+    mlt_properties properties = job->properties;
+    mlt_producer producer = mlt_factory_producer(job->profile,
+                                                 mlt_properties_get(properties, "mlt_service"),
+                                                 mlt_properties_get(properties, "resource"));
+    int i, count = mlt_properties_count(properties);
+
+    // Copy the properties that select the stream, like audio_index
+    for (i = 0; producer && i < count; i++) {
+        const char *name = mlt_properties_get_name(properties, i);
+        if (strcmp(name, "mlt_service") && strcmp(name, "resource"))
+            mlt_properties_set(MLT_PRODUCER_PROPERTIES(producer),
+                               name,
+                               mlt_properties_get_value(properties, i));
+    }
+    return producer;
+}
+
+static void *generate_file(void *arg)
+{
+    peaks_job *job = arg;
+    mlt_peaks peaks = NULL;
+
+    job->producer = open_producer(job);
+    if (job->producer)
+        peaks = generate(job->producer, &job->cancel);
+    else
+        mlt_log_warning(NULL, "[peaks] failed to open the audio of %s\n", job->filename);
+
+    if (peaks) {
+        mlt_peaks_set_source(peaks, job->source);
+        // Write a file of this process and job first so that a reader never
+        // sees a partial index
+        size_t size = strlen(job->filename) + 64;
+        char *temp = malloc(size);
+        if (temp) {
+            snprintf(temp, size, "%s.%d.%p.tmp", job->filename, (int) getpid(), (void *) job);
+            if (mlt_peaks_save(peaks, temp) || rename(temp, job->filename)) {
+                mlt_log_warning(NULL, "[peaks] failed to write %s\n", job->filename);
+                remove(temp);
+            }
+            free(temp);
+        }
+        mlt_peaks_close(peaks);
+    }
+    atomic_store(&job->done, 1);
+    return NULL;
+}
+
+/** Take the jobs that have finished out of the list.
+ *
+ * The caller must hold jobs_mutex and release the jobs with job_close()
+ * after unlocking it.
+ * \return the finished jobs
+ */
+
+static peaks_job *reap_jobs()
+{
+    peaks_job **link = &jobs;
+    peaks_job *finished = NULL;
+    while (*link) {
+        peaks_job *job = *link;
+        if (atomic_load(&job->done)) {
+            *link = job->next;
+            pthread_join(job->thread, NULL);
+            job->next = finished;
+            finished = job;
+        } else {
+            link = &job->next;
+        }
+    }
+    return finished;
+}
+
+/** Start generating the index file of a producer from a copy of it.
+ *
+ * Only one job writes a given file at a time. The copy is opened by the job.
+ */
+
+static int start_job(mlt_producer producer, const char *filename)
+{
+    mlt_properties properties = MLT_PRODUCER_PROPERTIES(producer);
+    const char *service = mlt_properties_get(properties, "mlt_service");
+    const char *resource = mlt_properties_get(properties, "resource");
+    peaks_job *job, *other, *finished;
+    int i, count, error = 0;
+
+    if (!service || !resource)
+        return 1;
+
+    job = calloc(1, sizeof(peaks_job));
+    if (!job)
+        return 1;
+    job->profile = mlt_profile_clone(mlt_service_profile(MLT_PRODUCER_SERVICE(producer)));
+    job->properties = mlt_properties_new();
+    job->filename = strdup(filename);
+    job->source = producer_source(producer);
+    count = mlt_properties_count(properties);
+    for (i = 0; i < count; i++) {
+        const char *name = mlt_properties_get_name(properties, i);
+        const char *value = mlt_properties_get_value(properties, i);
+        if (name && value && name[0] != '_' && strcmp(name, "mlt_type") && strcmp(name, "peaks"))
+            mlt_properties_set(job->properties, name, value);
+    }
+
+    pthread_mutex_lock(&jobs_mutex);
+    finished = reap_jobs();
+    for (other = jobs; other; other = other->next)
+        if (!strcmp(other->filename, filename))
+            break;
+    if (!other) {
+        error = pthread_create(&job->thread, NULL, generate_file, job);
+        if (!error) {
+            job->next = jobs;
+            jobs = job;
+        }
+    }
+    pthread_mutex_unlock(&jobs_mutex);
+
+    if (other || error)
+        job_close(job);
+    while (finished) {
+        other = finished;
+        finished = finished->next;
+        job_close(other);
+    }
+    return error;
+}
+
+/** Stop generating index files.
+ *
+ * This cancels the jobs started by \p mlt_peaks_for_producer and waits for
+ * them to finish. \p mlt_factory_close calls this before it unloads the
+ * modules that the jobs may be using.
+ * \public \memberof mlt_peaks_s
+ */
+
+void mlt_peaks_stop_jobs()
+{
+    peaks_job *job;
+
+    pthread_mutex_lock(&jobs_mutex);
+    for (job = jobs; job; job = job->next)
+        atomic_store(&job->cancel, 1);
+    while (jobs) {
+        job = jobs;
+        jobs = job->next;
+        pthread_join(job->thread, NULL);
+        job_close(job);
+    }
+    pthread_mutex_unlock(&jobs_mutex);
+}
+
+/** Get the index of the audio of a producer.
+ *
+ * The index is the file named by the "peaks" property of the producer. When
+ * the file does not exist yet, or was made from other audio than that of the
+ * producer, it is generated from a copy of the producer in the background and
+ * NULL is returned until it is ready. Producers without
+ * the property have no index.
+ * \public \memberof mlt_peaks_s
+ * \param producer a producer or a cut of it
+ * \return the index, owned by the producer, or NULL
+ */
+
+mlt_peaks mlt_peaks_for_producer(mlt_producer producer)
+{
+    mlt_properties properties;
+    const char *filename;
+    mlt_peaks self, loaded;
+    char *source;
+    int start = 0;
+
+    if (!producer)
+        return NULL;
+    producer = mlt_producer_cut_parent(producer);
+    properties = MLT_PRODUCER_PROPERTIES(producer);
+    filename = mlt_properties_get(properties, "peaks");
+    if (!filename || !filename[0])
+        return NULL;
+
+    pthread_mutex_lock(&producer_mutex);
+    self = mlt_properties_get_data(properties, "_peaks", NULL);
+    pthread_mutex_unlock(&producer_mutex);
+    if (self)
+        return self;
+
+    // Load without the lock so that other producers are not held up by the file.
+    // An index of other audio, or of an older version of the file, is made again.
+    source = producer_source(producer);
+    loaded = mlt_peaks_load(filename);
+    if (loaded
+        && (!source || !mlt_peaks_source(loaded) || strcmp(mlt_peaks_source(loaded), source))) {
+        mlt_peaks_close(loaded);
+        loaded = NULL;
+    }
+    free(source);
+
+    pthread_mutex_lock(&producer_mutex);
+    self = mlt_properties_get_data(properties, "_peaks", NULL);
+    if (!self && loaded) {
+        mlt_properties_set_data(properties,
+                                "_peaks",
+                                loaded,
+                                0,
+                                (mlt_destructor) mlt_peaks_close,
+                                NULL);
+        self = loaded;
+        loaded = NULL;
+    } else if (!self && !mlt_properties_get_int(properties, "_peaks_started")) {
+        mlt_properties_set_int(properties, "_peaks_started", 1);
+        start = 1;
+    }
+    pthread_mutex_unlock(&producer_mutex);
+
+    // Another thread stored an index first
+    mlt_peaks_close(loaded);
+    if (start && start_job(producer, filename))
+        mlt_log_warning(MLT_PRODUCER_SERVICE(producer),
+                        "[peaks] failed to start generating %s\n",
+                        filename);
+    return self;
+}
+
+/** Destroy an index.
+ *
+ * \public \memberof mlt_peaks_s
+ * \param self an index
+ */
+
+void mlt_peaks_close(mlt_peaks self)
+{
+    int i;
+
+    if (!self)
+        return;
+    for (i = 0; i < PEAKS_MAX_LEVELS; i++)
+        free(self->entries[i]);
+    free(self->block_min);
+    free(self->block_max);
+    free(self->block_squares);
+    free(self->source);
+    free(self);
+}
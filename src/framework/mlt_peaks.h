@@ -0,0 +1,53 @@
+/**
+ * \file mlt_peaks.h
+ * \brief Peak index of audio for waveform displays
+ * \see mlt_peaks_s
+ *
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MLT_PEAKS_H
+#define MLT_PEAKS_H
+
+#include "mlt_types.h"
+
+/** The extent of the samples of a range of audio, scaled to -1.0 .. 1.0 */
+
+typedef struct
+{
+    float min; /**< the lowest sample */
+    float max; /**< the highest sample */
+    float rms; /**< the root mean square of the samples */
+} mlt_peak;
+
+extern mlt_peaks mlt_peaks_new(int frequency, int channels);
+extern void mlt_peaks_add(mlt_peaks self, const float *samples, int count);
+extern int mlt_peaks_frequency(mlt_peaks self);
+extern int mlt_peaks_channels(mlt_peaks self);
+extern int64_t mlt_peaks_samples(mlt_peaks self);
+extern void mlt_peaks_set_source(mlt_peaks self, const char *source);
+extern const char *mlt_peaks_source(mlt_peaks self);
+extern int mlt_peaks_get(
+    mlt_peaks self, int channel, int64_t start, int64_t end, mlt_peak *peaks, int count);
+extern int mlt_peaks_save(mlt_peaks self, const char *filename);
+extern mlt_peaks mlt_peaks_load(const char *filename);
+extern mlt_peaks mlt_peaks_generate(mlt_producer producer);
+extern mlt_peaks mlt_peaks_for_producer(mlt_producer producer);
+extern void mlt_peaks_close(mlt_peaks self);
+extern void mlt_peaks_stop_jobs();
+
+#endif
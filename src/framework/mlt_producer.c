@@ -251,6 +251,79 @@ mlt_producer mlt_producer_cut_parent(mlt_producer self)
         return self;
 }
 
+static void copy_clone_properties(mlt_properties dest, mlt_properties src)
+{
+    int i, count = mlt_properties_count(src);
+
+    for (i = 0; i < count; i++) {
+        const char *name = mlt_properties_get_name(src, i);
+        const char *value = mlt_properties_get_value(src, i);
+        if (name && value && name[0] != '_' && strcmp(name, "mlt_type")
+            && strcmp(name, "mlt_service") && strcmp(name, "resource"))
+            mlt_properties_set(dest, name, value);
+    }
+}
+
+/** Create a copy of a producer with the filters that precede a filter attached to it.
+ *
+ * This is for filters that analyze their input on a thread of their own. The copy
+ * is loaded from the service and resource of the parent of \p self, so it is
+ * normalized like the original, and it has the public properties of the parent.
+ * The filters attached before \p filter are copied in order, except those the
+ * loader added.
+ *
+ * \public \memberof mlt_producer_s
+ * \param self a producer
+ * \param profile the profile of the copy
+ * \param filter a filter attached to \p self
+ * \return a new producer or NULL if \p filter is not attached to \p self or a copy fails
+ */
+
+mlt_producer mlt_producer_clone_before(mlt_producer self, mlt_profile profile, mlt_filter filter)
+{
+    mlt_producer parent = mlt_producer_cut_parent(self);
+    mlt_properties parent_properties = MLT_PRODUCER_PROPERTIES(parent);
+    const char *service = mlt_properties_get(parent_properties, "mlt_service");
+    const char *resource = mlt_properties_get(parent_properties, "resource");
+    mlt_service source = MLT_PRODUCER_SERVICE(self);
+    mlt_filter other = NULL;
+    int index;
+
+    for (index = 0; (other = mlt_service_filter(source, index)) && other != filter; index++)
+        ;
+    if (other != filter || !service || !resource)
+        return NULL;
+
+    // Let the loader normalize the copy like the original
+    char *id = malloc(strlen(service) + strlen(resource) + 2);
+    if (strcmp(service, "chain"))
+        sprintf(id, "%s:%s", service, resource);
+    else
+        strcpy(id, resource);
+    mlt_producer clone = mlt_factory_producer(profile, NULL, id);
+    free(id);
+    if (!clone)
+        return NULL;
+    copy_clone_properties(MLT_PRODUCER_PROPERTIES(clone), parent_properties);
+
+    for (int i = 0; i < index; i++) {
+        mlt_properties properties = MLT_FILTER_PROPERTIES(mlt_service_filter(source, i));
+        if (mlt_properties_get_int(properties, "_loader"))
+            continue;
+        mlt_filter copy = mlt_factory_filter(profile,
+                                             mlt_properties_get(properties, "mlt_service"),
+                                             NULL);
+        if (!copy) {
+            mlt_producer_close(clone);
+            return NULL;
+        }
+        copy_clone_properties(MLT_FILTER_PROPERTIES(copy), properties);
+        mlt_producer_attach(clone, copy);
+        mlt_filter_close(copy);
+    }
+    return clone;
+}
+
 /** Create a cut of this producer.
  *
  * A "cut" is a portion of another (parent) producer.
@@ -140,6 +140,9 @@ extern int mlt_producer_is_cut(mlt_producer self);
 extern int mlt_producer_is_mix(mlt_producer self);
 extern int mlt_producer_is_blank(mlt_producer self);
 extern mlt_producer mlt_producer_cut_parent(mlt_producer self);
+extern mlt_producer mlt_producer_clone_before(mlt_producer self,
+                                              mlt_profile profile,
+                                              mlt_filter filter);
 extern int mlt_producer_optimise(mlt_producer self);
 extern void mlt_producer_close(mlt_producer self);
 int64_t mlt_producer_get_creation_time(mlt_producer self);
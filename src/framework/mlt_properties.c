@@ -41,6 +41,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -62,6 +63,9 @@ typedef struct
     mlt_properties *children_properties;
     char **children_names;
     int children_count;
+    mlt_properties lookup;
+    char *lookup_prefix;
+    atomic_int generation;
 } property_list;
 
 /* Memory leak checks */
@@ -405,6 +409,27 @@ int mlt_properties_ref_count(mlt_properties self)
     return 0;
 }
 
+/** Get the generation of a properties list.
+ *
+ * The generation increases whenever a property whose name does not begin with
+ * an underscore is set to a different value. Private properties, data, and
+ * setting a string or number property again to the value it already holds do
+ * not change it.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \return a number that changes whenever the public properties change
+ */
+
+int mlt_properties_generation(mlt_properties self)
+{
+    if (self != NULL) {
+        property_list *list = self->local;
+        return atomic_load(&list->generation);
+    }
+    return 0;
+}
+
 /** Set a properties list to be a mirror copy of another.
  *
  * Note that this does not copy all existing properties. Rather, you must
@@ -466,6 +491,49 @@ int mlt_properties_inherit(mlt_properties self, mlt_properties that)
     return 0;
 }
 
+/** Resolve the properties that match a prefix from another properties object.
+ *
+ * This is a cheaper alternative to mlt_properties_copy() for a short-lived list
+ * that only reads the properties: a name with the prefix that is not set in
+ * \p self is looked up in \p that, which may have a lookup of its own. Matching
+ * properties that are already set in \p self are overwritten by the values in
+ * \p that, and setting one on \p self afterwards hides \p that. They are not
+ * listed or counted in \p self, but mlt_properties_copy() includes them. No
+ * reference is held on \p that, so clear the lookup before \p that is closed.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self the properties that look up
+ * \param that the properties to look in or NULL to clear the lookup
+ * \param prefix the property names to match (required unless clearing)
+ */
+
+void mlt_properties_set_lookup(mlt_properties self, mlt_properties that, const char *prefix)
+{
+    if (!self)
+        return;
+    property_list *list = self->local;
+    mlt_properties_lock(self);
+    free(list->lookup_prefix);
+    list->lookup_prefix = that && prefix ? strdup(prefix) : NULL;
+    list->lookup = list->lookup_prefix ? that : NULL;
+    mlt_properties_unlock(self);
+
+    // Values already set here are replaced as mlt_properties_copy() would
+    if (list->lookup) {
+        int length = strlen(prefix);
+        int count = mlt_properties_count(self);
+        int i;
+        for (i = 0; i < count; i++) {
+            char *name = mlt_properties_get_name(self, i);
+            if (name && !strncmp(name, prefix, length)) {
+                char *value = mlt_properties_get(that, name);
+                if (value != NULL)
+                    mlt_properties_set_string(self, name, value);
+            }
+        }
+    }
+}
+
 /** Copy all serializable properties that match a prefix to another properties object
  *
  * \public \memberof mlt_properties_s
@@ -482,6 +550,17 @@ int mlt_properties_copy(mlt_properties self, mlt_properties that, const char *pr
     int count = mlt_properties_count(that);
     int length = strlen(prefix);
     int i = 0;
+
+    // Copy the matching properties resolved by the lookup first so that local ones win
+    property_list *list = that->local;
+    if (list->lookup) {
+        int lookup_length = strlen(list->lookup_prefix);
+        if (!strncmp(prefix, list->lookup_prefix, MIN(length, lookup_length)))
+            mlt_properties_copy(self,
+                                list->lookup,
+                                length > lookup_length ? prefix : list->lookup_prefix);
+    }
+
     for (i = 0; i < count; i++) {
         char *name = mlt_properties_get_name(that, i);
         if (!strncmp(name, prefix, length)) {
@@ -523,7 +602,7 @@ int mlt_properties_pass(mlt_properties self, mlt_properties that, const char *pr
     return 0;
 }
 
-/** Locate a property by name.
+/** Locate a property by name in this list only.
  *
  * \private \memberof mlt_properties_s
  * \param self a properties list
@@ -531,7 +610,7 @@ int mlt_properties_pass(mlt_properties self, mlt_properties that, const char *pr
  * \return the property or NULL for failure
  */
 
-static inline mlt_property mlt_properties_find(mlt_properties self, const char *name)
+static inline mlt_property mlt_properties_find_local(mlt_properties self, const char *name)
 {
     if (!self || !name)
         return NULL;
@@ -557,6 +636,28 @@ static inline mlt_property mlt_properties_find(mlt_properties self, const char *
     return value;
 }
 
+/** Locate a property by name.
+ *
+ * Names that match the lookup prefix and are not in this list are resolved in the
+ * lookup list.
+ *
+ * \private \memberof mlt_properties_s
+ * \param self a properties list
+ * \param name the property to lookup by name
+ * \return the property or NULL for failure
+ */
+
+static inline mlt_property mlt_properties_find(mlt_properties self, const char *name)
+{
+    mlt_property value = mlt_properties_find_local(self, name);
+    if (value == NULL && self && name) {
+        property_list *list = self->local;
+        if (list->lookup && !strncmp(name, list->lookup_prefix, strlen(list->lookup_prefix)))
+            value = mlt_properties_find(list->lookup, name);
+    }
+    return value;
+}
+
 /** Add a new property.
  *
  * \private \memberof mlt_properties_s
@@ -578,11 +679,17 @@ static mlt_property mlt_properties_add(mlt_properties self, const char *name)
         list->size += 50;
         list->name = realloc(list->name, list->size * sizeof(const char *));
         list->value = realloc(list->value, list->size * sizeof(mlt_property));
+        memset(list->name + list->count, 0, 50 * sizeof(const char *));
+        memset(list->value + list->count, 0, 50 * sizeof(mlt_property));
     }
 
-    // Assign name/value pair
-    list->name[list->count] = strdup(name);
-    list->value[list->count] = mlt_property_init();
+    // Assign name/value pair, reusing what a reset left in the slot
+    if (!list->name[list->count] || strcmp(list->name[list->count], name)) {
+        free(list->name[list->count]);
+        list->name[list->count] = strdup(name);
+    }
+    if (!list->value[list->count])
+        list->value[list->count] = mlt_property_init();
 
     // Assign to hash table
     if (list->hash[key] == 0)
@@ -607,7 +714,7 @@ static mlt_property mlt_properties_add(mlt_properties self, const char *name)
 static mlt_property mlt_properties_fetch(mlt_properties self, const char *name)
 {
     // Try to find an existing property first
-    mlt_property property = mlt_properties_find(self, name);
+    mlt_property property = mlt_properties_find_local(self, name);
 
     // If it wasn't found, create one
     if (property == NULL)
@@ -617,8 +724,11 @@ static mlt_property mlt_properties_fetch(mlt_properties self, const char *name)
     return property;
 }
 
-static void fire_property_changed(mlt_properties self, const char *name)
+static void fire_property_changed(mlt_properties self, const char *name, int changed)
 {
+    // Private properties and values set again unchanged do not change the output
+    if (changed && name[0] != '_')
+        atomic_fetch_add(&((property_list *) self->local)->generation, 1);
     mlt_events_fire(self, "property-changed", mlt_event_data_from_string(name));
 }
 
@@ -639,7 +749,7 @@ void mlt_properties_pass_property(mlt_properties self, mlt_properties that, cons
         return;
 
     mlt_property_pass(mlt_properties_fetch(self, name), that_prop);
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, 1);
 }
 
 /** Copy all properties specified in a comma-separated list to another properties list.
@@ -727,6 +837,7 @@ static int is_valid_expression(mlt_properties self, const char *value)
 int mlt_properties_set(mlt_properties self, const char *name, const char *value)
 {
     int error = 1;
+    int changed = 1;
 
     if (!self || !name)
         return error;
@@ -738,6 +849,7 @@ int mlt_properties_set(mlt_properties self, const char *name, const char *value)
     if (property == NULL) {
         mlt_log(NULL, MLT_LOG_FATAL, "Whoops - %s not found (should never occur)\n", name);
     } else if (value == NULL) {
+        changed = !mlt_property_equals_string(property, value);
         error = mlt_property_set_string(property, value);
         mlt_properties_do_mirror(self, name);
     } else if (value[0] == '@' && is_valid_expression(self, &value[1])) {
@@ -790,16 +902,18 @@ int mlt_properties_set(mlt_properties self, const char *name, const char *value)
             op = *value != '\0' ? *value++ : ' ';
         }
 
+        changed = !mlt_property_equals_double(property, total);
         error = mlt_property_set_double(property, total);
         mlt_properties_do_mirror(self, name);
     } else {
+        changed = !mlt_property_equals_string(property, value);
         error = mlt_property_set_string(property, value);
         mlt_properties_do_mirror(self, name);
         if (!strcmp(name, "properties"))
             mlt_properties_preset(self, value);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, changed);
 
     return error;
 }
@@ -840,6 +954,7 @@ int mlt_properties_set_or_default(mlt_properties self,
 int mlt_properties_set_string(mlt_properties self, const char *name, const char *value)
 {
     int error = 1;
+    int changed = 1;
 
     if (!self || !name)
         return error;
@@ -851,16 +966,18 @@ int mlt_properties_set_string(mlt_properties self, const char *name, const char
     if (property == NULL) {
         mlt_log(NULL, MLT_LOG_FATAL, "Whoops - %s not found (should never occur)\n", name);
     } else if (value == NULL) {
+        changed = !mlt_property_equals_string(property, value);
         error = mlt_property_set_string(property, value);
         mlt_properties_do_mirror(self, name);
     } else {
+        changed = !mlt_property_equals_string(property, value);
         error = mlt_property_set_string(property, value);
         mlt_properties_do_mirror(self, name);
         if (!strcmp(name, "properties"))
             mlt_properties_preset(self, value);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, changed);
 
     return error;
 }
@@ -1047,6 +1164,7 @@ int mlt_properties_get_int(mlt_properties self, const char *name)
 int mlt_properties_set_int(mlt_properties self, const char *name, int value)
 {
     int error = 1;
+    int changed = 1;
 
     if (!self || !name)
         return error;
@@ -1056,11 +1174,12 @@ int mlt_properties_set_int(mlt_properties self, const char *name, int value)
 
     // Set it if not NULL
     if (property != NULL) {
+        changed = !mlt_property_equals_int(property, value);
         error = mlt_property_set_int(property, value);
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, changed);
 
     return error;
 }
@@ -1091,6 +1210,7 @@ int64_t mlt_properties_get_int64(mlt_properties self, const char *name)
 int mlt_properties_set_int64(mlt_properties self, const char *name, int64_t value)
 {
     int error = 1;
+    int changed = 1;
 
     if (!self || !name)
         return error;
@@ -1100,11 +1220,12 @@ int mlt_properties_set_int64(mlt_properties self, const char *name, int64_t valu
 
     // Set it if not NULL
     if (property != NULL) {
+        changed = !mlt_property_equals_int64(property, value);
         error = mlt_property_set_int64(property, value);
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, changed);
 
     return error;
 }
@@ -1142,6 +1263,7 @@ double mlt_properties_get_double(mlt_properties self, const char *name)
 int mlt_properties_set_double(mlt_properties self, const char *name, double value)
 {
     int error = 1;
+    int changed = 1;
 
     if (!self || !name)
         return error;
@@ -1151,11 +1273,12 @@ int mlt_properties_set_double(mlt_properties self, const char *name, double valu
 
     // Set it if not NULL
     if (property != NULL) {
+        changed = !mlt_property_equals_double(property, value);
         error = mlt_property_set_double(property, value);
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, changed);
 
     return error;
 }
@@ -1193,6 +1316,7 @@ mlt_position mlt_properties_get_position(mlt_properties self, const char *name)
 int mlt_properties_set_position(mlt_properties self, const char *name, mlt_position value)
 {
     int error = 1;
+    int changed = 1;
 
     if (!self || !name)
         return error;
@@ -1202,11 +1326,12 @@ int mlt_properties_set_position(mlt_properties self, const char *name, mlt_posit
 
     // Set it if not NULL
     if (property != NULL) {
+        changed = !mlt_property_equals_position(property, value);
         error = mlt_property_set_position(property, value);
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, changed);
 
     return error;
 }
@@ -1258,7 +1383,8 @@ int mlt_properties_set_data(mlt_properties self,
     if (property != NULL)
         error = mlt_property_set_data(property, value, length, destroy, serialise);
 
-    fire_property_changed(self, name);
+    // Data is usually state that a service keeps for itself
+    mlt_events_fire(self, "property-changed", mlt_event_data_from_string(name));
 
     return error;
 }
@@ -1274,7 +1400,7 @@ int mlt_properties_set_data(mlt_properties self,
 
 int mlt_properties_rename(mlt_properties self, const char *source, const char *dest)
 {
-    mlt_property value = mlt_properties_find(self, dest);
+    mlt_property value = mlt_properties_find_local(self, dest);
 
     if (value == NULL) {
         property_list *list = self->local;
@@ -1470,6 +1596,50 @@ int mlt_properties_dir_list(mlt_properties self, const char *dirname, const char
     return mlt_properties_count(self);
 }
 
+/** Remove all the properties from a properties list.
+ *
+ * The list keeps its storage and the removed property objects so that setting
+ * properties again allocates less, for example when the object is recycled.
+ * Properties are cleared in the same order as mlt_properties_close() would
+ * destroy them. The mirror, lookup and locale are also removed, but the
+ * reference count is unchanged.
+ *
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ */
+
+void mlt_properties_reset(mlt_properties self)
+{
+    if (!self)
+        return;
+    property_list *list = self->local;
+    int count;
+    int i;
+
+    // A destructor may set more properties, so repeat until none are added
+    do {
+        count = list->count;
+        for (i = count - 1; i >= 0; i--)
+            mlt_property_clear(list->value[i]);
+    } while (count != list->count);
+
+    mlt_properties_lock(self);
+    list->count = 0;
+    memset(list->hash, 0, sizeof(list->hash));
+    list->mirror = NULL;
+    list->lookup = NULL;
+    free(list->lookup_prefix);
+    list->lookup_prefix = NULL;
+#if defined(__GLIBC__) || defined(__APPLE__)
+    if (list->locale)
+        freelocale(list->locale);
+#else
+    free(list->locale);
+#endif
+    list->locale = NULL;
+    mlt_properties_unlock(self);
+}
+
 /** Close a properties object.
  *
  * Deallocates the properties object and everything it contains.
@@ -1503,11 +1673,16 @@ void mlt_properties_close(mlt_properties self)
                     properties_destroyed);
 #endif
 
-            // Clean up names and values
+            // Clean up names and values, including those kept by a reset
             for (index = list->count - 1; index >= 0; index--) {
                 mlt_property_close(list->value[index]);
                 free(list->name[index]);
             }
+            for (index = list->count; index < list->size; index++) {
+                if (list->value[index])
+                    mlt_property_close(list->value[index]);
+                free(list->name[index]);
+            }
 
 #if defined(__GLIBC__) || defined(__APPLE__)
             // Cleanup locale
@@ -1520,6 +1695,7 @@ void mlt_properties_close(mlt_properties self)
 
             // Clear up the list
             pthread_mutex_destroy(&list->mutex);
+            free(list->lookup_prefix);
             free(list->name);
             free(list->value);
             free(list);
@@ -2220,7 +2396,7 @@ void mlt_properties_clear(mlt_properties self, const char *name)
     if (property)
         mlt_property_clear(property);
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, 1);
 }
 
 /** Check if a property exists.
@@ -2321,7 +2497,7 @@ int mlt_properties_set_color(mlt_properties self, const char *name, mlt_color co
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, 1);
 
     return error;
 }
@@ -2393,7 +2569,7 @@ extern int mlt_properties_anim_set_color(mlt_properties self,
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, 1);
 
     return error;
 }
@@ -2487,7 +2663,7 @@ int mlt_properties_anim_set(
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, 1);
 
     return error;
 }
@@ -2556,7 +2732,7 @@ int mlt_properties_anim_set_int(mlt_properties self,
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, 1);
 
     return error;
 }
@@ -2628,7 +2804,7 @@ int mlt_properties_anim_set_double(mlt_properties self,
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, 1);
 
     return error;
 }
@@ -2672,7 +2848,7 @@ extern int mlt_properties_set_rect(mlt_properties self, const char *name, mlt_re
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, 1);
 
     return error;
 }
@@ -2736,7 +2912,7 @@ extern int mlt_properties_anim_set_rect(mlt_properties self,
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, 1);
 
     return error;
 }
@@ -2818,7 +2994,7 @@ int mlt_properties_set_properties(mlt_properties self, const char *name, mlt_pro
         mlt_properties_do_mirror(self, name);
     }
 
-    fire_property_changed(self, name);
+    fire_property_changed(self, name, 1);
 
     return error;
 }
@@ -55,9 +55,11 @@ extern int mlt_properties_preset(mlt_properties self, const char *name);
 extern int mlt_properties_inc_ref(mlt_properties self);
 extern int mlt_properties_dec_ref(mlt_properties self);
 extern int mlt_properties_ref_count(mlt_properties self);
+extern int mlt_properties_generation(mlt_properties self);
 extern void mlt_properties_mirror(mlt_properties self, mlt_properties that);
 extern int mlt_properties_inherit(mlt_properties self, mlt_properties that);
 extern int mlt_properties_copy(mlt_properties self, mlt_properties that, const char *prefix);
+extern void mlt_properties_set_lookup(mlt_properties self, mlt_properties that, const char *prefix);
 extern int mlt_properties_pass(mlt_properties self, mlt_properties that, const char *prefix);
 extern void mlt_properties_pass_property(mlt_properties self, mlt_properties that, const char *name);
 extern int mlt_properties_pass_list(mlt_properties self, mlt_properties that, const char *list);
@@ -90,6 +92,7 @@ extern void mlt_properties_dump(mlt_properties self, FILE *output);
 extern void mlt_properties_debug(mlt_properties self, const char *title, FILE *output);
 extern int mlt_properties_save(mlt_properties, const char *);
 extern int mlt_properties_dir_list(mlt_properties, const char *, const char *, int);
+extern void mlt_properties_reset(mlt_properties self);
 extern void mlt_properties_close(mlt_properties self);
 extern int mlt_properties_is_sequence(mlt_properties self);
 extern mlt_properties mlt_properties_parse_yaml(const char *file);
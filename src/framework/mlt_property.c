@@ -299,6 +299,92 @@ int mlt_property_set_data(mlt_property self,
     return 0;
 }
 
+/** Determine whether a property already holds a string value.
+ *
+ * \public \memberof mlt_property_s
+ * \param self a property
+ * \param value the string to compare with (may be NULL)
+ * \return true if setting \p value would not change the property
+ */
+
+int mlt_property_equals_string(mlt_property self, const char *value)
+{
+    int result = 0;
+    pthread_mutex_lock(&self->mutex);
+    if (value == NULL)
+        result = (self->types == mlt_prop_none || self->types == mlt_prop_string)
+                 && self->prop_string == NULL && self->animation == NULL;
+    else if (self->types & mlt_prop_string && self->prop_string)
+        result = !strcmp(self->prop_string, value);
+    pthread_mutex_unlock(&self->mutex);
+    return result;
+}
+
+/** Determine whether a property already holds an integer value.
+ *
+ * \public \memberof mlt_property_s
+ * \param self a property
+ * \param value the integer to compare with
+ * \return true if setting \p value would not change the property
+ */
+
+int mlt_property_equals_int(mlt_property self, int value)
+{
+    pthread_mutex_lock(&self->mutex);
+    int result = self->types & mlt_prop_int && !self->animation && self->prop_int == value;
+    pthread_mutex_unlock(&self->mutex);
+    return result;
+}
+
+/** Determine whether a property already holds a floating point value.
+ *
+ * \public \memberof mlt_property_s
+ * \param self a property
+ * \param value the double to compare with
+ * \return true if setting \p value would not change the property
+ */
+
+int mlt_property_equals_double(mlt_property self, double value)
+{
+    pthread_mutex_lock(&self->mutex);
+    int result = self->types & mlt_prop_double && !self->animation && self->prop_double == value;
+    pthread_mutex_unlock(&self->mutex);
+    return result;
+}
+
+/** Determine whether a property already holds a position value.
+ *
+ * \public \memberof mlt_property_s
+ * \param self a property
+ * \param value the position to compare with
+ * \return true if setting \p value would not change the property
+ */
+
+int mlt_property_equals_position(mlt_property self, mlt_position value)
+{
+    pthread_mutex_lock(&self->mutex);
+    int result = self->types & mlt_prop_position && !self->animation
+                 && self->prop_position == value;
+    pthread_mutex_unlock(&self->mutex);
+    return result;
+}
+
+/** Determine whether a property already holds a 64-bit integer value.
+ *
+ * \public \memberof mlt_property_s
+ * \param self a property
+ * \param value the 64-bit integer to compare with
+ * \return true if setting \p value would not change the property
+ */
+
+int mlt_property_equals_int64(mlt_property self, int64_t value)
+{
+    pthread_mutex_lock(&self->mutex);
+    int result = self->types & mlt_prop_int64 && !self->animation && self->prop_int64 == value;
+    pthread_mutex_unlock(&self->mutex);
+    return result;
+}
+
 /** Parse a SMIL clock value.
  *
  * \private \memberof mlt_property_s
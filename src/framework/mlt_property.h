@@ -58,6 +58,11 @@ extern int mlt_property_set_data(mlt_property self,
                                  int length,
                                  mlt_destructor destructor,
                                  mlt_serialiser serialiser);
+extern int mlt_property_equals_string(mlt_property self, const char *value);
+extern int mlt_property_equals_int(mlt_property self, int value);
+extern int mlt_property_equals_double(mlt_property self, double value);
+extern int mlt_property_equals_position(mlt_property self, mlt_position value);
+extern int mlt_property_equals_int64(mlt_property self, int64_t value);
 extern int mlt_property_get_int(mlt_property self, double fps, mlt_locale_t);
 extern double mlt_property_get_double(mlt_property self, double fps, mlt_locale_t);
 extern mlt_position mlt_property_get_position(mlt_property self, double fps, mlt_locale_t);
@@ -25,14 +25,17 @@
 #include "mlt_log.h"
 #include "mlt_properties.h"
 #include "mlt_tokeniser.h"
+#include "mlt_version.h"
 
 #include <dirent.h>
 #include <dlfcn.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 /** \brief Repository class
  *
@@ -50,9 +53,272 @@ struct mlt_repository_s
     mlt_properties links;           /// a list of entry points for links
     mlt_properties producers;       /// a list of entry points for producers
     mlt_properties transitions;     /// a list of entry points for transitions
+    pthread_mutex_t mutex;          /// protects loading modules on demand
+    const char *object;             /// the object file whose services are being registered
+    int lazy;                       /// services were read from a manifest
 };
 
+/** The names used for the service classes in a manifest. */
+
+static const struct
+{
+    const char *name;
+    mlt_service_type type;
+} service_classes[] = {
+    {"consumer", mlt_service_consumer_type},
+    {"filter", mlt_service_filter_type},
+    {"link", mlt_service_link_type},
+    {"producer", mlt_service_producer_type},
+    {"transition", mlt_service_transition_type},
+};
+
+/** Get the list of entry points for a service class.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \param type a service class
+ * \return a properties list or NULL if the class is invalid
+ */
+
+static mlt_properties service_list(mlt_repository self, mlt_service_type type)
+{
+    switch (type) {
+    case mlt_service_consumer_type:
+        return self->consumers;
+    case mlt_service_filter_type:
+        return self->filters;
+    case mlt_service_link_type:
+        return self->links;
+    case mlt_service_producer_type:
+        return self->producers;
+    case mlt_service_transition_type:
+        return self->transitions;
+    default:
+        return NULL;
+    }
+}
+
+/** Determine whether a module registers services for plugins found elsewhere.
+ *
+ * Modules like frei0r and jackrack register a service for each plugin in their
+ * own search paths, avformat for each filter of the installed FFmpeg and sox for
+ * each effect of the installed libsox. A manifest can not tell when those
+ * change, so these modules are always loaded.
+ *
+ * \private \memberof mlt_repository_s
+ * \param object_name the full path of an object file
+ * \return true if the module must not be loaded from a manifest
+ */
+
+static int is_eager_module(const char *object_name)
+{
+    static const char *modules[] = {"mltfrei0r.", "mltjackrack.", "mltavformat.", "mltsox."};
+    const char *base = strrchr(object_name, '/');
+    size_t i;
+
+    base = base ? base + 1 : object_name;
+    for (i = 0; i < sizeof(modules) / sizeof(modules[0]); i++)
+        if (strstr(base, modules[i]))
+            return 1;
+    return 0;
+}
+
+/** Get a string that changes when an object file is replaced.
+ *
+ * \private \memberof mlt_repository_s
+ * \param object_name the full path of a file
+ * \param stamp a buffer to receive the modification time and size
+ * \param size the size of the buffer
+ * \return true if the file is not a regular file
+ */
+
+static int object_stamp(const char *object_name, char *stamp, size_t size)
+{
+    struct stat info;
+    if (mlt_stat(object_name, &info) || !S_ISREG(info.st_mode))
+        return 1;
+    snprintf(stamp, size, "%lld:%lld", (long long) info.st_mtime, (long long) info.st_size);
+    return 0;
+}
+
+/** Open an object file and let it register its services.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \param object_name the full path of the object file
+ * \return true if the object file is a module
+ */
+
+static int load_module(mlt_repository self, const char *object_name)
+{
+    // Open the shared object
+    void *object = dlopen(object_name, RTLD_NOW);
+    if (object != NULL) {
+        // Get the registration function
+        mlt_repository_callback symbol_ptr = dlsym(object, "mlt_register");
+
+        // Call the registration function
+        if (symbol_ptr != NULL) {
+            self->object = object_name;
+            symbol_ptr(self);
+            self->object = NULL;
+
+            // Register the object file for closure
+            mlt_properties_set_data(&self->parent,
+                                    object_name,
+                                    object,
+                                    0,
+                                    (mlt_destructor) dlclose,
+                                    NULL);
+            return 1;
+        } else {
+            dlclose(object);
+        }
+    } else if (strstr(object_name, "libmlt")) {
+        mlt_log_warning(NULL,
+                        "%s: failed to dlopen %s\n  (%s)\n",
+                        __FUNCTION__,
+                        object_name,
+                        dlerror());
+    }
+    return 0;
+}
+
+/** Register the services listed in a manifest without loading their modules.
+ *
+ * The manifest is only used when it was written by this version of MLT with the
+ * same MLT_REPOSITORY_DENY and every file in the directory is unchanged.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \param filename the manifest file
+ * \param dir the list of files in the module directory
+ * \return the number of services registered, 0 if the manifest is missing or stale
+ */
+
+static int read_manifest(mlt_repository self, const char *filename, mlt_properties dir)
+{
+    mlt_properties manifest = mlt_properties_load(filename);
+    const char *deny = getenv("MLT_REPOSITORY_DENY");
+    char key[PATH_MAX + 10];
+    char stamp[64];
+    int files = 0;
+    int count = 0;
+    int i, j;
+
+    if (mlt_properties_get(manifest, "version") == NULL
+        || strcmp(mlt_properties_get(manifest, "version"), mlt_version_get_string())
+        || strcmp(mlt_properties_get(manifest, "deny") ? mlt_properties_get(manifest, "deny") : "",
+                  deny ? deny : "")) {
+        mlt_properties_close(manifest);
+        return 0;
+    }
+
+    // Every file must be listed with the same modification time and size
+    for (i = 0; i < mlt_properties_count(dir); i++) {
+        const char *object_name = mlt_properties_get_value(dir, i);
+        if (!object_stamp(object_name, stamp, sizeof(stamp))) {
+            snprintf(key, sizeof(key), "module.%s", object_name);
+            const char *value = mlt_properties_get(manifest, key);
+            if (!value || strcmp(value, stamp)) {
+                mlt_log_verbose(NULL, "%s: %s has changed\n", __FUNCTION__, object_name);
+                mlt_properties_close(manifest);
+                return 0;
+            }
+            files++;
+        }
+    }
+    for (i = 0; i < mlt_properties_count(manifest); i++)
+        if (!strncmp(mlt_properties_get_name(manifest, i), "module.", 7))
+            files--;
+    if (files != 0) {
+        mlt_properties_close(manifest);
+        return 0;
+    }
+
+    // Register the services as not yet loaded
+    for (i = 0; i < mlt_properties_count(manifest); i++) {
+        const char *name = mlt_properties_get_name(manifest, i);
+        for (j = 0; j < sizeof(service_classes) / sizeof(service_classes[0]); j++) {
+            size_t length = strlen(service_classes[j].name);
+            if (!strncmp(name, service_classes[j].name, length) && name[length] == '.') {
+                mlt_properties properties = mlt_properties_new();
+                mlt_properties_set(properties, "object", mlt_properties_get_value(manifest, i));
+                mlt_properties_set_data(service_list(self, service_classes[j].type),
+                                        name + length + 1,
+                                        properties,
+                                        0,
+                                        (mlt_destructor) mlt_properties_close,
+                                        NULL);
+                count++;
+                break;
+            }
+        }
+    }
+    mlt_properties_close(manifest);
+    return count;
+}
+
+/** Save the services registered by each module so that the next repository can
+ * load the modules on demand.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \param filename the manifest file
+ * \param dir the list of files in the module directory
+ */
+
+static void write_manifest(mlt_repository self, const char *filename, mlt_properties dir)
+{
+    mlt_properties manifest = mlt_properties_new();
+    const char *deny = getenv("MLT_REPOSITORY_DENY");
+    char key[PATH_MAX + 10];
+    char stamp[64];
+    int i, j;
+
+    mlt_properties_set(manifest, "version", mlt_version_get_string());
+    mlt_properties_set(manifest, "deny", deny ? deny : "");
+    for (i = 0; i < mlt_properties_count(dir); i++) {
+        const char *object_name = mlt_properties_get_value(dir, i);
+        if (!object_stamp(object_name, stamp, sizeof(stamp))) {
+            snprintf(key, sizeof(key), "module.%s", object_name);
+            mlt_properties_set(manifest, key, stamp);
+        }
+    }
+    for (j = 0; j < sizeof(service_classes) / sizeof(service_classes[0]); j++) {
+        mlt_properties services = service_list(self, service_classes[j].type);
+        for (i = 0; i < mlt_properties_count(services); i++) {
+            mlt_properties properties = mlt_properties_get_data_at(services, i, NULL);
+            const char *object = mlt_properties_get(properties, "object");
+            if (object && !is_eager_module(object)) {
+                snprintf(key,
+                         sizeof(key),
+                         "%s.%s",
+                         service_classes[j].name,
+                         mlt_properties_get_name(services, i));
+                mlt_properties_set(manifest, key, object);
+            }
+        }
+    }
+
+    // Write to a temporary file first because other processes may be reading it
+    char *temp = calloc(1, strlen(filename) + 20);
+    sprintf(temp, "%s.%d", filename, (int) getpid());
+    if (!mlt_properties_save(manifest, temp) && !rename(temp, filename))
+        mlt_log_verbose(NULL, "%s: wrote %s\n", __FUNCTION__, filename);
+    else
+        remove(temp);
+    free(temp);
+    mlt_properties_close(manifest);
+}
+
 /** Construct a new repository.
+ *
+ * When the environment variable MLT_REPOSITORY_MANIFEST names a file, the services
+ * of each module are saved to it. When it is up to date, a new repository reads it
+ * instead of opening every module, and opens a module the first time one of its
+ * services is created or its metadata is requested. Modules that register
+ * services for plugins outside of the module directory are always opened.
  *
  * \public \memberof mlt_repository_s
  * \param directory the full path of a directory from which to read modules
@@ -73,12 +339,19 @@ mlt_repository mlt_repository_init(const char *directory)
     self->links = mlt_properties_new();
     self->producers = mlt_properties_new();
     self->transitions = mlt_properties_new();
+    pthread_mutex_init(&self->mutex, NULL);
 
     // Get the directory list
     mlt_properties dir = mlt_properties_new();
     int count = mlt_properties_dir_list(dir, directory, NULL, 0);
     int i;
     int plugin_count = 0;
+    const char *manifest = getenv("MLT_REPOSITORY_MANIFEST");
+
+    if (manifest && strcmp(manifest, "") && read_manifest(self, manifest, dir)) {
+        mlt_log_debug(NULL, "%s: using manifest %s\n", __FUNCTION__, manifest);
+        self->lazy = 1;
+    }
 
 #ifdef _WIN32
     char *syspath = getenv("PATH");
@@ -120,7 +393,6 @@ mlt_repository mlt_repository_init(const char *directory)
 
     // Iterate over files
     for (i = 0; i < count; i++) {
-        int flags = RTLD_NOW;
         const char *object_name = mlt_properties_get_value(dir, i);
 
         // check if the plugin was asked to be skipped through MLT_REPOSITORY_DENY
@@ -144,40 +416,21 @@ mlt_repository mlt_repository_init(const char *directory)
             continue;
         }
 
-        mlt_log_debug(NULL, "%s: processing plugin at %s\n", __FUNCTION__, object_name);
-
-        // Open the shared object
-        void *object = dlopen(object_name, flags);
-        if (object != NULL) {
-            // Get the registration function
-            mlt_repository_callback symbol_ptr = dlsym(object, "mlt_register");
+        // The other modules are loaded on demand from the manifest
+        if (self->lazy && !is_eager_module(object_name))
+            continue;
 
-            // Call the registration function
-            if (symbol_ptr != NULL) {
-                symbol_ptr(self);
+        mlt_log_debug(NULL, "%s: processing plugin at %s\n", __FUNCTION__, object_name);
 
-                // Register the object file for closure
-                mlt_properties_set_data(&self->parent,
-                                        object_name,
-                                        object,
-                                        0,
-                                        (mlt_destructor) dlclose,
-                                        NULL);
-                ++plugin_count;
-            } else {
-                dlclose(object);
-            }
-        } else if (strstr(object_name, "libmlt")) {
-            mlt_log_warning(NULL,
-                            "%s: failed to dlopen %s\n  (%s)\n",
-                            __FUNCTION__,
-                            object_name,
-                            dlerror());
-        }
+        plugin_count += load_module(self, object_name);
     }
 
-    if (!plugin_count)
-        mlt_log_error(NULL, "%s: no plugins found in \"%s\"\n", __FUNCTION__, directory);
+    if (!self->lazy) {
+        if (!plugin_count)
+            mlt_log_error(NULL, "%s: no plugins found in \"%s\"\n", __FUNCTION__, directory);
+        else if (manifest && strcmp(manifest, ""))
+            write_manifest(self, manifest, dir);
+    }
 
     mlt_properties_close(dir);
 
@@ -189,14 +442,17 @@ mlt_repository mlt_repository_init(const char *directory)
 /** Create a properties list for a service holding a function pointer to its constructor function.
  *
  * \private \memberof mlt_repository_s
+ * \param self a repository
  * \param symbol a pointer to a function that can create the service.
  * \return a properties list
  */
 
-static mlt_properties new_service(void *symbol)
+static mlt_properties new_service(mlt_repository self, void *symbol)
 {
     mlt_properties properties = mlt_properties_new();
     mlt_properties_set_data(properties, "symbol", symbol, 0, NULL, NULL);
+    if (self->object)
+        mlt_properties_set(properties, "object", self->object);
     return properties;
 }
 
@@ -217,51 +473,29 @@ void mlt_repository_register(mlt_repository self,
                              mlt_register_callback symbol)
 {
     // Add the entry point to the corresponding service list
-    switch (service_type) {
-    case mlt_service_consumer_type:
-        mlt_properties_set_data(self->consumers,
-                                service,
-                                new_service(symbol),
-                                0,
-                                (mlt_destructor) mlt_properties_close,
-                                NULL);
-        break;
-    case mlt_service_filter_type:
-        mlt_properties_set_data(self->filters,
-                                service,
-                                new_service(symbol),
-                                0,
-                                (mlt_destructor) mlt_properties_close,
-                                NULL);
-        break;
-    case mlt_service_link_type:
-        mlt_properties_set_data(self->links,
-                                service,
-                                new_service(symbol),
-                                0,
-                                (mlt_destructor) mlt_properties_close,
-                                NULL);
-        break;
-    case mlt_service_producer_type:
-        mlt_properties_set_data(self->producers,
-                                service,
-                                new_service(symbol),
-                                0,
-                                (mlt_destructor) mlt_properties_close,
-                                NULL);
-        break;
-    case mlt_service_transition_type:
-        mlt_properties_set_data(self->transitions,
-                                service,
-                                new_service(symbol),
-                                0,
-                                (mlt_destructor) mlt_properties_close,
-                                NULL);
-        break;
-    default:
+    mlt_properties services = service_list(self, service_type);
+    if (services == NULL) {
         mlt_log_error(NULL, "%s: Unable to register \"%s\"\n", __FUNCTION__, service);
-        break;
+        return;
+    }
+
+    // A module loaded on demand only completes the services the manifest gave it
+    if (self->lazy && self->object) {
+        mlt_properties properties = mlt_properties_get_data(services, service, NULL);
+        if (properties) {
+            const char *object = mlt_properties_get(properties, "object");
+            if (!mlt_properties_get_data(properties, "symbol", NULL) && object
+                && !strcmp(object, self->object))
+                mlt_properties_set_data(properties, "symbol", symbol, 0, NULL, NULL);
+            return;
+        }
     }
+    mlt_properties_set_data(services,
+                            service,
+                            new_service(self, symbol),
+                            0,
+                            (mlt_destructor) mlt_properties_close,
+                            NULL);
 }
 
 /** Get the repository properties for particular service class.
@@ -277,29 +511,41 @@ static mlt_properties get_service_properties(mlt_repository self,
                                              mlt_service_type type,
                                              const char *service)
 {
-    mlt_properties service_properties = NULL;
+    mlt_properties services = service_list(self, type);
+    return services ? mlt_properties_get_data(services, service, NULL) : NULL;
+}
 
-    // Get the entry point from the corresponding service list
-    switch (type) {
-    case mlt_service_consumer_type:
-        service_properties = mlt_properties_get_data(self->consumers, service, NULL);
-        break;
-    case mlt_service_filter_type:
-        service_properties = mlt_properties_get_data(self->filters, service, NULL);
-        break;
-    case mlt_service_link_type:
-        service_properties = mlt_properties_get_data(self->links, service, NULL);
-        break;
-    case mlt_service_producer_type:
-        service_properties = mlt_properties_get_data(self->producers, service, NULL);
-        break;
-    case mlt_service_transition_type:
-        service_properties = mlt_properties_get_data(self->transitions, service, NULL);
-        break;
-    default:
-        break;
+/** Get the repository properties for a service and load its module if needed.
+ *
+ * \private \memberof mlt_repository_s
+ * \param self a repository
+ * \param type a service class
+ * \param service the name of a service
+ * \return a properties list or NULL if error
+ */
+
+static mlt_properties get_loaded_service_properties(mlt_repository self,
+                                                    mlt_service_type type,
+                                                    const char *service)
+{
+    mlt_properties properties;
+
+    pthread_mutex_lock(&self->mutex);
+    properties = get_service_properties(self, type, service);
+    if (properties && !mlt_properties_get_data(properties, "symbol", NULL)) {
+        const char *object = mlt_properties_get(properties, "object");
+
+        // Only try each module once
+        if (object && !mlt_properties_exists(&self->parent, object)) {
+            char *object_name = strdup(object);
+            mlt_log_debug(NULL, "%s: loading %s for %s\n", __FUNCTION__, object_name, service);
+            if (!load_module(self, object_name))
+                mlt_properties_set_int(&self->parent, object_name, 0);
+            free(object_name);
+        }
     }
-    return service_properties;
+    pthread_mutex_unlock(&self->mutex);
+    return properties;
 }
 
 /** Construct a new instance of a service.
@@ -318,7 +564,7 @@ void *mlt_repository_create(mlt_repository self,
                             const char *service,
                             const void *input)
 {
-    mlt_properties properties = get_service_properties(self, type, service);
+    mlt_properties properties = get_loaded_service_properties(self, type, service);
     if (properties != NULL) {
         mlt_register_callback symbol_ptr = mlt_properties_get_data(properties, "symbol", NULL);
 
@@ -342,6 +588,7 @@ void mlt_repository_close(mlt_repository self)
     mlt_properties_close(self->links);
     mlt_properties_close(self->transitions);
     mlt_properties_close(&self->parent);
+    pthread_mutex_destroy(&self->mutex);
     free(self);
 }
 
@@ -425,6 +672,13 @@ void mlt_repository_register_metadata(mlt_repository self,
                                       void *callback_data)
 {
     mlt_properties service_properties = get_service_properties(self, type, service);
+
+    // Skip services that the manifest gave to another module
+    if (self->lazy && self->object && service_properties) {
+        const char *object = mlt_properties_get(service_properties, "object");
+        if (object && strcmp(object, self->object))
+            return;
+    }
     mlt_properties_set_data(service_properties, "metadata_cb", callback, 0, NULL, NULL);
     mlt_properties_set_data(service_properties, "metadata_cb_data", callback_data, 0, NULL, NULL);
 }
@@ -445,7 +699,7 @@ mlt_properties mlt_repository_metadata(mlt_repository self,
                                        const char *service)
 {
     mlt_properties metadata = NULL;
-    mlt_properties properties = get_service_properties(self, type, service);
+    mlt_properties properties = get_loaded_service_properties(self, type, service);
 
     // If this is a valid service
     if (properties) {
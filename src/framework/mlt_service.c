@@ -29,6 +29,7 @@
 #include "mlt_producer.h"
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -55,6 +56,7 @@ typedef struct
     int filter_size;
     mlt_filter *filters;
     pthread_mutex_t mutex;
+    atomic_int generation;
 } mlt_service_base;
 
 /* Private methods
@@ -63,6 +65,7 @@ typedef struct
 static void mlt_service_disconnect(mlt_service self);
 static void mlt_service_connect(mlt_service self, mlt_service that);
 static int service_get_frame(mlt_service self, mlt_frame_ptr frame, int index);
+static void mlt_service_changed(mlt_service owner, mlt_service self);
 
 /** Initialize a service.
  *
@@ -97,12 +100,49 @@ int mlt_service_init(mlt_service self, void *child)
         mlt_events_init(&self->parent);
         mlt_events_register(&self->parent, "service-changed");
         mlt_events_register(&self->parent, "property-changed");
+        mlt_events_listen(&self->parent,
+                          self,
+                          "service-changed",
+                          (mlt_listener) mlt_service_changed);
         pthread_mutex_init(&((mlt_service_base *) self->local)->mutex, NULL);
     }
 
     return error;
 }
 
+/** The service-changed event handler for the service itself.
+ *
+ * \private \memberof mlt_service_s
+ * \param owner ignored
+ * \param self the service on which the "service-changed" event is fired
+ */
+
+static void mlt_service_changed(mlt_service owner, mlt_service self)
+{
+    atomic_fetch_add(&((mlt_service_base *) self->local)->generation, 1);
+}
+
+/** Get the generation of a service.
+ *
+ * The generation changes whenever a public property of the service changes, a
+ * filter is attached or detached, a producer is connected or the service fires
+ * "service-changed". A frame records the generation of every service that
+ * contributed to it so that it can tell later whether it is out of date.
+ *
+ * \public \memberof mlt_service_s
+ * \param self a service
+ * \return a number that changes whenever the output of the service may change
+ * \see mlt_frame_is_stale
+ */
+
+int mlt_service_generation(mlt_service self)
+{
+    if (self == NULL)
+        return 0;
+    mlt_service_base *base = self->local;
+    return mlt_properties_generation(MLT_SERVICE_PROPERTIES(self)) + atomic_load(&base->generation);
+}
+
 /** Acquire a mutual exclusion lock on this service.
  *
  * \public \memberof mlt_service_s
@@ -227,6 +267,7 @@ int mlt_service_connect_producer(mlt_service self, mlt_service producer, int ind
 
         // Now we connect the producer to its connected consumer
         mlt_service_connect(producer, self);
+        atomic_fetch_add(&base->generation, 1);
 
         // Close the current service
         mlt_service_close(current);
@@ -519,6 +560,8 @@ void mlt_service_apply_filters(mlt_service self, mlt_frame frame, int index)
         // Process the frame with the attached filters
         for (i = 0; i < base->filter_count; i++) {
             if (base->filters[i] != NULL) {
+                // The frame depends on the filter even where it is disabled or out of range
+                mlt_frame_add_dependency(frame, MLT_FILTER_SERVICE(base->filters[i]));
                 mlt_position in = mlt_filter_get_in(base->filters[i]);
                 mlt_position out = mlt_filter_get_out(base->filters[i]);
                 int disable = mlt_properties_get_int(MLT_FILTER_PROPERTIES(base->filters[i]),
@@ -538,6 +581,93 @@ void mlt_service_apply_filters(mlt_service self, mlt_frame frame, int index)
     }
 }
 
+/** The number of unfiltered neighbour frames kept for reuse */
+
+#define NEIGHBOUR_WINDOW_SIZE (3)
+
+/** \brief unfiltered frames near the last position requested from a service */
+
+typedef struct
+{
+    mlt_frame frames[NEIGHBOUR_WINDOW_SIZE];
+    mlt_position positions[NEIGHBOUR_WINDOW_SIZE];
+    int indices[NEIGHBOUR_WINDOW_SIZE];
+    int generations[NEIGHBOUR_WINDOW_SIZE];
+} neighbour_window;
+
+/** Close the frames in a neighbour window.
+ *
+ * \private \memberof mlt_service_s
+ * \param window a neighbour window
+ */
+
+static void neighbour_window_close(neighbour_window *window)
+{
+    int i;
+    for (i = 0; i < NEIGHBOUR_WINDOW_SIZE; i++)
+        mlt_frame_close(window->frames[i]);
+    free(window);
+}
+
+/** Get an unfiltered frame for a position next to the one requested.
+ *
+ * Frames are taken from the window of the service where possible. During
+ * sequential playback the previous frame of one request was the next frame of
+ * the request before the last one, so only one new frame is fetched per
+ * request instead of two. The window keeps the frames within one position of
+ * \p position.
+ *
+ * \private \memberof mlt_service_s
+ * \param self a producer service
+ * \param window the neighbour window of the service
+ * \param position the position of the requested frame
+ * \param neighbour the position of the neighbour to get
+ * \param index as determined by the producer
+ * \return a frame with a reference for the caller or NULL on error
+ */
+
+static mlt_frame neighbour_window_get(mlt_service self,
+                                      neighbour_window *window,
+                                      mlt_position position,
+                                      mlt_position neighbour,
+                                      int index)
+{
+    int generation = mlt_service_generation(self);
+    mlt_frame frame = NULL;
+    int i;
+
+    for (i = 0; i < NEIGHBOUR_WINDOW_SIZE; i++) {
+        if (window->frames[i]
+            && (window->generations[i] != generation || window->positions[i] < position - 1
+                || window->positions[i] > position + 1)) {
+            mlt_frame_close(window->frames[i]);
+            window->frames[i] = NULL;
+        } else if (window->frames[i] && window->positions[i] == neighbour
+                   && window->indices[i] == index) {
+            frame = window->frames[i];
+        }
+    }
+
+    if (!frame) {
+        mlt_producer_seek(MLT_PRODUCER(self), neighbour);
+        if (self->get_frame(self, &frame, index))
+            return NULL;
+        for (i = 0; i < NEIGHBOUR_WINDOW_SIZE && window->frames[i]; i++)
+            ;
+        if (i < NEIGHBOUR_WINDOW_SIZE) {
+            mlt_properties_inc_ref(MLT_FRAME_PROPERTIES(frame));
+            window->frames[i] = frame;
+            window->positions[i] = neighbour;
+            window->indices[i] = index;
+            // The fetch itself may have set properties of the service
+            window->generations[i] = mlt_service_generation(self);
+        }
+    } else {
+        mlt_properties_inc_ref(MLT_FRAME_PROPERTIES(frame));
+    }
+    return frame;
+}
+
 /** Obtain a frame.
  *
  * \public \memberof mlt_service_s
@@ -563,8 +693,8 @@ int mlt_service_get_frame(mlt_service self, mlt_frame_ptr frame, int index)
         mlt_position in = mlt_properties_get_position(properties, "in");
         mlt_position out = mlt_properties_get_position(properties, "out");
         mlt_position position = -1;
-        if (mlt_service_identify(self) == mlt_service_producer_type
-            || mlt_service_identify(self) == mlt_service_chain_type) {
+        mlt_service_type type = mlt_service_identify(self);
+        if (type == mlt_service_producer_type || type == mlt_service_chain_type) {
             position = mlt_producer_position(MLT_PRODUCER(self));
         }
 
@@ -580,39 +710,66 @@ int mlt_service_get_frame(mlt_service self, mlt_frame_ptr frame, int index)
             }
             mlt_service_apply_filters(self, *frame, 1);
             mlt_deque_push_back(MLT_FRAME_SERVICE_STACK(*frame), self);
+            // A consumer passes its options on the frame instead
+            if (type != mlt_service_consumer_type)
+                mlt_frame_add_dependency(*frame, self);
 
             if (position > -1
                 && mlt_properties_get_int(MLT_SERVICE_PROPERTIES(self), "_need_previous_next")) {
+                mlt_properties service_properties = MLT_SERVICE_PROPERTIES(self);
+                neighbour_window *window = mlt_properties_get_data(service_properties,
+                                                                   "_neighbour_window",
+                                                                   NULL);
+                if (!window) {
+                    window = calloc(1, sizeof(*window));
+                    mlt_properties_set_data(service_properties,
+                                            "_neighbour_window",
+                                            window,
+                                            0,
+                                            (mlt_destructor) neighbour_window_close,
+                                            NULL);
+                }
+
                 // Save the new position from self->get_frame
                 mlt_position new_position = mlt_producer_position(MLT_PRODUCER(self));
 
-                // Get the preceding frame, unfiltered
-                mlt_frame previous_frame;
-                mlt_producer_seek(MLT_PRODUCER(self), position - 1);
-                result = self->get_frame(self, &previous_frame, index);
-                if (!result)
+                // Get the preceding and following frames, unfiltered
+                mlt_frame previous_frame = neighbour_window_get(self,
+                                                                window,
+                                                                position,
+                                                                position - 1,
+                                                                index);
+                if (previous_frame)
                     mlt_properties_set_data(properties,
                                             "previous frame",
                                             previous_frame,
                                             0,
                                             (mlt_destructor) mlt_frame_close,
                                             NULL);
-
-                // Get the following frame, unfiltered
-                mlt_frame next_frame;
-                mlt_producer_seek(MLT_PRODUCER(self), position + 1);
-                result = self->get_frame(self, &next_frame, index);
-                if (!result) {
+                mlt_frame next_frame
+                    = neighbour_window_get(self, window, position, position + 1, index);
+                if (next_frame)
                     mlt_properties_set_data(properties,
                                             "next frame",
                                             next_frame,
                                             0,
                                             (mlt_destructor) mlt_frame_close,
                                             NULL);
-                }
+                result = next_frame == NULL;
 
                 // Restore the new position
                 mlt_producer_seek(MLT_PRODUCER(self), new_position);
+            } else if (position > -1
+                       && mlt_properties_get_data(MLT_SERVICE_PROPERTIES(self),
+                                                  "_neighbour_window",
+                                                  NULL)) {
+                // Release the frames that are no longer needed
+                mlt_properties_set_data(MLT_SERVICE_PROPERTIES(self),
+                                        "_neighbour_window",
+                                        NULL,
+                                        0,
+                                        NULL,
+                                        NULL);
             }
         }
     }
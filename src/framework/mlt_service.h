@@ -51,7 +51,8 @@
  * \properties \em _profile stores the mlt_profile for a service
  * \properties \em _unique_id is a unique identifier
  * \properties \em _need_previous_next boolean that instructs producers to get
- * preceding and following frames inside of \p mlt_service_get_frame
+ * preceding and following frames inside of \p mlt_service_get_frame;
+ * these unfiltered frames are shared between consecutive requests and must be treated as read-only
  */
 
 struct mlt_service_s
@@ -81,6 +82,7 @@ extern int mlt_service_init(mlt_service self, void *child);
 extern void mlt_service_lock(mlt_service self);
 extern void mlt_service_unlock(mlt_service self);
 extern mlt_service_type mlt_service_identify(mlt_service self);
+extern int mlt_service_generation(mlt_service self);
 extern int mlt_service_connect_producer(mlt_service self, mlt_service producer, int index);
 extern int mlt_service_insert_producer(mlt_service self, mlt_service producer, int index);
 extern int mlt_service_disconnect_producer(mlt_service self, int index);
@@ -364,7 +364,8 @@ static int producer_get_image(mlt_frame self,
     mlt_properties_set_int(frame_properties,
                            "distort",
                            mlt_properties_get_int(properties, "distort"));
-    mlt_properties_copy(frame_properties, properties, "consumer.");
+    // Resolve the consumer properties from this frame instead of copying them to every track
+    mlt_properties_set_lookup(frame_properties, properties, "consumer.");
     // WebVfx uses this to setup a consumer-stopping event handler.
     mlt_properties_set_data(frame_properties,
                             "consumer",
@@ -386,31 +387,26 @@ static int producer_get_image(mlt_frame self,
         frame_properties,
         "progressive,distort,colorspace,full_range,force_full_luma,top_field_first,color_trc");
 
-    mlt_properties_set_data(properties,
-                            "movit.convert.fence",
-                            mlt_properties_get_data(frame_properties, "movit.convert.fence", NULL),
-                            0,
-                            NULL,
-                            NULL);
-    mlt_properties_set_data(properties,
-                            "movit.convert.texture",
-                            mlt_properties_get_data(frame_properties, "movit.convert.texture", NULL),
-                            0,
-                            NULL,
-                            NULL);
-    mlt_properties_set_int(properties,
-                           "movit.convert.use_texture",
-                           mlt_properties_get_int(frame_properties, "movit.convert.use_texture"));
-    int i;
-    for (i = 0; i < mlt_properties_count(frame_properties); i++) {
-        char *name = mlt_properties_get_name(frame_properties, i);
-        if (name && !strncmp(name, "_movit ", 7)) {
-            mlt_properties_set_data(properties,
-                                    name,
-                                    mlt_properties_get_data_at(frame_properties, i, NULL),
-                                    0,
-                                    NULL,
-                                    NULL);
+    // Only GPU images carry the movit state to hand on
+    if (*format == mlt_image_movit || *format == mlt_image_opengl_texture
+        || mlt_properties_get_data(frame_properties, "movit.convert.texture", NULL)) {
+        void *fence = mlt_properties_get_data(frame_properties, "movit.convert.fence", NULL);
+        void *texture = mlt_properties_get_data(frame_properties, "movit.convert.texture", NULL);
+        int i;
+        mlt_properties_set_data(properties, "movit.convert.fence", fence, 0, NULL, NULL);
+        mlt_properties_set_data(properties, "movit.convert.texture", texture, 0, NULL, NULL);
+        int use_texture = mlt_properties_get_int(frame_properties, "movit.convert.use_texture");
+        mlt_properties_set_int(properties, "movit.convert.use_texture", use_texture);
+        for (i = 0; i < mlt_properties_count(frame_properties); i++) {
+            char *name = mlt_properties_get_name(frame_properties, i);
+            if (name && !strncmp(name, "_movit ", 7)) {
+                mlt_properties_set_data(properties,
+                                        name,
+                                        mlt_properties_get_data_at(frame_properties, i, NULL),
+                                        0,
+                                        NULL,
+                                        NULL);
+            }
         }
     }
 
@@ -451,6 +447,27 @@ static int producer_get_audio(mlt_frame self,
     return 0;
 }
 
+/** Close the track frames of an output frame.
+ *
+ * \private \memberof mlt_tractor_s
+ * \param frames the track frames
+ */
+
+static void close_frames(mlt_deque frames)
+{
+    int i;
+
+    // A frame may outlive the frame it looks up its consumer properties in
+    for (i = 0; i < mlt_deque_count(frames); i++) {
+        mlt_frame frame = mlt_deque_peek(frames, i);
+        mlt_properties_set_lookup(MLT_FRAME_PROPERTIES(frame), NULL, NULL);
+    }
+    // Close in the reverse order of creation like the other frame properties
+    while (mlt_deque_count(frames))
+        mlt_frame_close(mlt_deque_pop_back(frames));
+    mlt_deque_close(frames);
+}
+
 /** Get the next frame.
  *
  * \private \memberof mlt_tractor_s
@@ -469,7 +486,6 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int trac
         int i = 0;
         int done = 0;
         mlt_frame temp = NULL;
-        int count = 0;
         int image_count = 0;
 
         // Get the properties of the parent producer
@@ -484,14 +500,7 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int trac
         // If we don't have one, we're in trouble...
         if (multitrack != NULL) {
             // Used to garbage collect all frames
-            char label[64];
-
-            // Get the id of the tractor
-            char *id = mlt_properties_get(properties, "_unique_id");
-            if (!id) {
-                mlt_properties_set_int64(properties, "_unique_id", (int64_t) properties);
-                id = mlt_properties_get(properties, "_unique_id");
-            }
+            mlt_deque frames = mlt_deque_init();
 
             // Will be used to store the frame properties object
             mlt_properties frame_properties = NULL;
@@ -514,6 +523,12 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int trac
 
             // Get the properties of the frame
             frame_properties = MLT_FRAME_PROPERTIES(*frame);
+            mlt_properties_set_data(frame_properties,
+                                    "mlt_tractor frames",
+                                    frames,
+                                    0,
+                                    (mlt_destructor) close_frames,
+                                    NULL);
 
             // Loop through each of the tracks we're harvesting
             for (i = 0; !done; i++) {
@@ -544,13 +559,8 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int trac
                 }
 
                 // We store all frames with a destructor on the output frame
-                snprintf(label, sizeof(label), "mlt_tractor %s_%d", id, count++);
-                mlt_properties_set_data(frame_properties,
-                                        label,
-                                        temp,
-                                        0,
-                                        (mlt_destructor) mlt_frame_close,
-                                        NULL);
+                mlt_deque_push_back(frames, temp);
+                mlt_frame_add_dependencies(*frame, temp);
 
                 // Pick up first video and audio frames
                 if (!done && !mlt_frame_is_test_audio(temp)
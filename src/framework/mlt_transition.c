@@ -374,7 +374,8 @@ static int get_image_b(mlt_frame b_frame,
                                    mlt_profile_sar(
                                        mlt_service_profile(MLT_TRANSITION_SERVICE(self))));
 
-    mlt_properties_copy(b_props, a_props, "consumer.");
+    // Both frames belong to the tractor, which clears the lookup before closing them
+    mlt_properties_set_lookup(b_props, a_props, "consumer.");
 
     return mlt_frame_get_image(b_frame, image, format, width, height, writable);
 }
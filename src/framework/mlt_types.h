@@ -265,6 +265,7 @@ typedef struct mlt_animation_s *mlt_animation;          /**< pointer to Property
 typedef struct mlt_slices_s *mlt_slices; /**< pointer to Sliced processing context object */
 typedef struct mlt_link_s *mlt_link;     /**< pointer to Link object */
 typedef struct mlt_chain_s *mlt_chain;   /**< pointer to Chain object */
+typedef struct mlt_peaks_s *mlt_peaks;   /**< pointer to Peaks object */
 
 typedef void (*mlt_destructor)(void *);              /**< pointer to destructor function */
 typedef char *(*mlt_serialiser)(void *, int length); /**< pointer to serialization function */
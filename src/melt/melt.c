@@ -37,6 +37,7 @@
 #endif
 
 #include "io.h"
+#include "server.h"
 
 static mlt_producer melt = NULL;
 
@@ -527,6 +528,7 @@ static void show_usage(char *program_name)
             "  -repeat times                            Repeat the last cut\n"
             "  -repository path                         Set the directory of MLT modules\n"
             "  -serialise [filename]                    Write the commands to a text file\n"
+            "  -serve socket                            Render jobs received on a UNIX socket\n"
             "  -setlocale                               Make numeric strings locale-sensitive\n"
             "  -silent                                  Do not display position/transport\n"
             "  -split relative-frame                    Split the last cut into two cuts\n"
@@ -756,6 +758,7 @@ int main(int argc, char **argv)
     const char *repo_path = NULL;
     int is_consumer_explicit = 0;
     int is_setlocale = 0;
+    const char *serve_path = NULL;
 
     // Handle abnormal exit situations.
     signal(SIGSEGV, abnormal_exit_handler);
@@ -891,6 +894,8 @@ int main(int argc, char **argv)
                 repo_path = argv[++i];
         } else if (!strcmp(argv[i], "-consumer")) {
             is_consumer_explicit = 1;
+        } else if (!strcmp(argv[i], "-serve") && i + 1 < argc) {
+            serve_path = argv[++i];
         }
     }
     if (!is_silent && !isatty(STDIN_FILENO) && !is_progress)
@@ -900,6 +905,13 @@ int main(int argc, char **argv)
     if (!repo)
         repo = setup_factory(repo_path, is_setlocale);
 
+    // Keep the factory for all of the jobs sent to the server
+    if (serve_path) {
+        mlt_profile_close(profile);
+        error = melt_serve(serve_path);
+        goto exit_factory;
+    }
+
     // Create profile if not set explicitly
     if (getenv("MLT_PROFILE"))
         profile = mlt_profile_init(NULL);
@@ -0,0 +1,363 @@
+/*
+ * server.c -- melt render server
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* The render server keeps the factory, its modules and their cached metadata
+ * loaded between jobs so that a job only pays for its own producers and consumer.
+ *
+ * A client connects to the UNIX socket and sends one job as melt arguments, one
+ * per line, ending with an empty line. The producer arguments come first and the
+ * consumer is last, for example:
+ *
+ *     project.mlt
+ *     -consumer
+ *     avformat:out.mp4
+ *     vcodec=libx264
+ *
+ * "-profile name" may appear before the consumer. The server renders the job and
+ * replies with a single line, either "OK" followed by the timings or "ERROR"
+ * followed by a message, and then closes the connection. Jobs are rendered one at
+ * a time in the order they connect.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#include <framework/mlt.h>
+
+#include "server.h"
+
+#ifndef _WIN32
+
+static volatile sig_atomic_t serving = 1;
+
+static void stop_serving(int signum)
+{
+    serving = 0;
+}
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void on_fatal_error(mlt_properties owner, mlt_consumer consumer)
+{
+    mlt_properties_set_int(MLT_CONSUMER_PROPERTIES(consumer), "melt_error", 1);
+}
+
+static mlt_consumer create_consumer(mlt_profile profile, const char *id)
+{
+    char *myid = strdup(id);
+    char *arg = strchr(myid, ':');
+    if (arg != NULL)
+        *arg++ = '\0';
+    mlt_consumer consumer = mlt_factory_consumer(profile, myid, arg);
+    free(myid);
+    return consumer;
+}
+
+/** Load the services that nearly every job uses before the first job arrives.
+ */
+
+static void warm_up()
+{
+    mlt_profile profile = mlt_profile_init(NULL);
+
+    // The loader reads its dictionary and creates the normalizing filters
+    mlt_producer producer = mlt_factory_producer(profile, NULL, "colour:black");
+    mlt_producer_close(producer);
+    mlt_profile_close(profile);
+}
+
+/** Render one job and write the result to the client.
+ */
+
+static void run_job(FILE *reply, char **args, int count)
+{
+    double start = now_seconds();
+    double loaded = start;
+    mlt_profile profile = NULL;
+    mlt_producer producer = NULL;
+    mlt_consumer consumer = NULL;
+    char **producer_args = calloc(count + 1, sizeof(char *));
+    int producer_count = 0;
+    int consumer_index = -1;
+    const char *error = NULL;
+    int frames = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (!strcmp(args[i], "-profile") && i + 1 < count) {
+            mlt_profile_close(profile);
+            profile = mlt_profile_init(args[++i]);
+            if (profile)
+                profile->is_explicit = 1;
+        } else if (!strcmp(args[i], "-consumer") && i + 1 < count) {
+            consumer_index = ++i;
+            break;
+        } else {
+            producer_args[producer_count++] = args[i];
+        }
+    }
+    if (profile == NULL)
+        profile = mlt_profile_init(NULL);
+    if (producer_count == 0 || consumer_index < 0) {
+        error = "a job needs a producer and a consumer";
+        goto done;
+    }
+
+    // Get the producer and generate an automatic profile if needed
+    producer = mlt_factory_producer(profile, "melt", producer_args);
+    if (producer && !profile->is_explicit) {
+        mlt_producer first_producer = mlt_properties_get_data(MLT_PRODUCER_PROPERTIES(producer),
+                                                              "first_producer",
+                                                              NULL);
+        mlt_profile_from_producer(profile, first_producer);
+        mlt_producer_close(producer);
+        producer = mlt_factory_producer(profile, "melt", producer_args);
+    }
+    if (producer == NULL || mlt_producer_get_length(producer) <= 0) {
+        error = "failed to load the producer";
+        goto done;
+    }
+
+    consumer = create_consumer(profile, args[consumer_index]);
+    if (consumer == NULL) {
+        error = "failed to create the consumer";
+        goto done;
+    }
+    mlt_properties properties = MLT_CONSUMER_PROPERTIES(consumer);
+    for (i = consumer_index + 1; i < count && strchr(args[i], '='); i++)
+        mlt_properties_parse(properties, args[i]);
+    if (i < count) {
+        error = "the consumer must be the last argument";
+        goto done;
+    }
+    if (!mlt_properties_get(properties, "terminate_on_pause"))
+        mlt_properties_set_int(properties, "terminate_on_pause", 1);
+
+    int in = mlt_properties_get_int(properties, "in");
+    int out = mlt_properties_get_int(properties, "out");
+    if (in > 0 || out > 0) {
+        if (out == 0)
+            out = mlt_producer_get_length(producer) - 1;
+        mlt_producer_set_in_and_out(producer, in, out);
+        mlt_producer_seek(producer, 0);
+    }
+    mlt_consumer_connect(consumer, MLT_PRODUCER_SERVICE(producer));
+    mlt_events_listen(properties, consumer, "consumer-fatal-error", (mlt_listener) on_fatal_error);
+
+    loaded = now_seconds();
+    if (mlt_consumer_start(consumer) == 0) {
+        struct timespec tm = {0, 10000000};
+        while (serving && !mlt_consumer_is_stopped(consumer))
+            nanosleep(&tm, NULL);
+        mlt_consumer_stop(consumer);
+        frames = mlt_producer_get_playtime(producer);
+        if (!serving)
+            error = "the server is stopping";
+        else if (mlt_properties_get_int(properties, "melt_error"))
+            error = "the consumer failed";
+    } else {
+        error = "failed to start the consumer";
+    }
+
+done:
+    if (consumer) {
+        mlt_consumer_connect(consumer, NULL);
+        mlt_events_fire(MLT_CONSUMER_PROPERTIES(consumer),
+                        "consumer-cleanup",
+                        mlt_event_data_none());
+        mlt_consumer_close(consumer);
+    }
+    mlt_producer_close(producer);
+    mlt_profile_close(profile);
+    free(producer_args);
+
+    double end = now_seconds();
+    if (error) {
+        fprintf(reply, "ERROR %s\n", error);
+        fprintf(stderr, "Job failed: %s\n", error);
+    } else {
+        double render = end - loaded;
+        fprintf(reply,
+                "OK frames=%d load=%.3f render=%.3f total=%.3f fps=%.2f\n",
+                frames,
+                loaded - start,
+                render,
+                end - start,
+                render > 0.0 ? frames / render : 0.0);
+        fprintf(stderr,
+                "Job done: %d frames, load %.3fs, render %.3fs, total %.3fs\n",
+                frames,
+                loaded - start,
+                render,
+                end - start);
+    }
+    fflush(reply);
+}
+
+/** Read a job from a client and render it.
+ */
+
+static void handle_client(int client)
+{
+    FILE *input = fdopen(client, "r");
+    FILE *reply = fdopen(dup(client), "w");
+    char **args = NULL;
+    int count = 0;
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+
+    if (input == NULL || reply == NULL) {
+        if (input)
+            fclose(input);
+        else
+            close(client);
+        if (reply)
+            fclose(reply);
+        return;
+    }
+
+    // One argument per line until an empty line
+    while ((length = getline(&line, &size, input)) > 0) {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+            line[--length] = '\0';
+        if (length == 0)
+            break;
+        args = realloc(args, (count + 1) * sizeof(char *));
+        args[count++] = strdup(line);
+    }
+    free(line);
+
+    if (count > 0)
+        run_job(reply, args, count);
+
+    while (count--)
+        free(args[count]);
+    free(args);
+    fclose(reply);
+    fclose(input);
+}
+
+#endif
+
+/** Render jobs received on a UNIX socket until interrupted.
+ *
+ * \param path the file name of the socket
+ * \return the exit status
+ */
+
+int melt_serve(const char *path)
+{
+#ifdef _WIN32
+    fprintf(stderr, "The render server is not supported on this platform.\n");
+    return EXIT_FAILURE;
+#else
+    struct sockaddr_un address;
+    struct sigaction action;
+    int fd;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "The socket name %s is too long.\n", path);
+        return EXIT_FAILURE;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+
+    // Replace a socket left behind by a previous server but not a running one or another file
+    struct stat info;
+    if (lstat(path, &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            fprintf(stderr, "%s exists and is not a socket.\n", path);
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        if (connect(fd, (struct sockaddr *) &address, sizeof(address)) == 0) {
+            fprintf(stderr, "Another server is using %s.\n", path);
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        if (errno != ECONNREFUSED) {
+            perror(path);
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        unlink(path);
+    } else if (errno != ENOENT) {
+        perror(path);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &address, sizeof(address)) || listen(fd, 16)) {
+        perror(path);
+        if (fd >= 0)
+            close(fd);
+        return EXIT_FAILURE;
+    }
+
+    // Stop after the current job on these signals
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_serving;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    warm_up();
+    fprintf(stderr, "Serving on %s\n", path);
+
+    while (serving) {
+        int client = accept(fd, NULL, NULL);
+        if (client >= 0)
+            handle_client(client);
+        else if (errno != EINTR)
+            break;
+    }
+
+    close(fd);
+    unlink(path);
+    return EXIT_SUCCESS;
+#endif
+}
@@ -27,6 +27,8 @@
 #include <framework/mlt_profile.h>
 
 // System header files
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <pthread.h>
 #include <stdio.h>
@@ -64,10 +66,12 @@
 // This structure should be extended and made globally available in mlt
 //
 
+// The samples are kept in a ring buffer that only grows when it is full.
 typedef struct
 {
     uint8_t *buffer;
     int size;
+    int start;
     int used;
     double time;
     int frequency;
@@ -85,12 +89,29 @@ sample_fifo sample_fifo_init(int frequency, int channels)
 // count is the number of samples multiplied by the number of bytes per sample
 void sample_fifo_append(sample_fifo fifo, uint8_t *samples, int count)
 {
+    if (count <= 0)
+        return;
+
     if ((fifo->size - fifo->used) < count) {
-        fifo->size += count * 5;
-        fifo->buffer = realloc(fifo->buffer, fifo->size);
+        // Grow and move the contents to the start of the new buffer
+        int size = fifo->size + count * 5;
+        uint8_t *buffer = malloc(size);
+        int first = FFMIN(fifo->used, fifo->size - fifo->start);
+
+        if (fifo->used) {
+            memcpy(buffer, &fifo->buffer[fifo->start], first);
+            memcpy(&buffer[first], fifo->buffer, fifo->used - first);
+        }
+        free(fifo->buffer);
+        fifo->buffer = buffer;
+        fifo->size = size;
+        fifo->start = 0;
     }
 
-    memcpy(&fifo->buffer[fifo->used], samples, count);
+    int end = (fifo->start + fifo->used) % fifo->size;
+    int first = FFMIN(count, fifo->size - end);
+    memcpy(&fifo->buffer[end], samples, first);
+    memcpy(fifo->buffer, samples + first, count - first);
     fifo->used += count;
 }
 
@@ -104,9 +125,13 @@ int sample_fifo_fetch(sample_fifo fifo, uint8_t *samples, int count)
     if (count > fifo->used)
         count = fifo->used;
 
-    memcpy(samples, fifo->buffer, count);
-    fifo->used -= count;
-    memmove(fifo->buffer, &fifo->buffer[count], fifo->used);
+    if (count > 0) {
+        int first = FFMIN(count, fifo->size - fifo->start);
+        memcpy(samples, &fifo->buffer[fifo->start], first);
+        memcpy(samples + first, fifo->buffer, count - first);
+        fifo->start = (fifo->start + count) % fifo->size;
+        fifo->used -= count;
+    }
 
     fifo->time += (double) count / fifo->channels / fifo->frequency;
 
@@ -288,6 +313,13 @@ mlt_consumer consumer_avformat_init(mlt_profile profile, char *arg)
         mlt_properties_set_int(properties, "real_time", -1);
         mlt_properties_set_int(properties, "prefill", 1);
 
+        // Queue depths between the stages of the pipelined encoder
+        mlt_properties_set_int(properties, "pipeline.convert_queue", 2);
+        mlt_properties_set_int(properties, "pipeline.video_queue", 2);
+        mlt_properties_set_int(properties, "pipeline.mux_queue", 64);
+        mlt_properties_set_int(properties, "write_behind.buffer", 4 * 1024 * 1024);
+        mlt_properties_set_int(properties, "write_behind.queue", 16);
+
         // Set up start/stop/terminated callbacks
         consumer->start = consumer_start;
         consumer->stop = consumer_stop;
@@ -690,28 +722,6 @@ static int pick_sample_fmt(mlt_properties properties, const AVCodec *codec)
     return AV_SAMPLE_FMT_NONE;
 }
 
-static uint8_t *interleaved_to_planar(int samples,
-                                      int channels,
-                                      uint8_t *audio,
-                                      int bytes_per_sample)
-{
-    uint8_t *buffer = mlt_pool_alloc(AUDIO_ENCODE_BUFFER_SIZE);
-    uint8_t *p = buffer;
-    int c;
-
-    memset(buffer, 0, AUDIO_ENCODE_BUFFER_SIZE);
-    for (c = 0; c < channels; c++) {
-        uint8_t *q = audio + c * bytes_per_sample;
-        int i = samples + 1;
-        while (--i) {
-            memcpy(p, q, bytes_per_sample);
-            p += bytes_per_sample;
-            q += channels * bytes_per_sample;
-        }
-    }
-    return buffer;
-}
-
 /** Add an audio output stream
 */
 
@@ -1203,6 +1213,319 @@ static int mlt_write(void *h, uint8_t *buf, int size)
     return 0;
 }
 
+/** A bounded queue joining two stages of the encoding pipeline.
+*/
+
+typedef struct
+{
+    mlt_deque deque;
+    int size;
+    int closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} * stage_queue, stage_queue_s;
+
+static stage_queue stage_queue_init(int size)
+{
+    stage_queue queue = calloc(1, sizeof(stage_queue_s));
+    queue->deque = mlt_deque_init();
+    queue->size = FFMAX(size, 1);
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+    return queue;
+}
+
+// Blocks while the queue is full and returns non-zero if it has been closed
+static int stage_queue_push(stage_queue queue, void *item)
+{
+    int error = 0;
+    pthread_mutex_lock(&queue->mutex);
+    while (!queue->closed && mlt_deque_count(queue->deque) >= queue->size)
+        pthread_cond_wait(&queue->cond, &queue->mutex);
+    if (queue->closed)
+        error = 1;
+    else
+        mlt_deque_push_back(queue->deque, item);
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+    return error;
+}
+
+// Blocks while the queue is empty and returns NULL once it is closed and drained
+static void *stage_queue_pop(stage_queue queue)
+{
+    void *item;
+    pthread_mutex_lock(&queue->mutex);
+    while (!queue->closed && !mlt_deque_count(queue->deque))
+        pthread_cond_wait(&queue->cond, &queue->mutex);
+    item = mlt_deque_pop_front(queue->deque);
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+    return item;
+}
+
+static int stage_queue_count(stage_queue queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    int count = mlt_deque_count(queue->deque);
+    pthread_mutex_unlock(&queue->mutex);
+    return count;
+}
+
+static void stage_queue_close(stage_queue queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static void stage_queue_free(stage_queue queue)
+{
+    mlt_deque_close(queue->deque);
+    pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->cond);
+    free(queue);
+}
+
+#ifndef _WIN32
+/** The state of the write-behind output.
+ *
+ * The muxer writes into a large AVIO buffer. Each time that fills, it is
+ * copied to a chunk and queued for a writer thread so that the encoder
+ * only blocks when the queue is full.
+ */
+
+typedef struct
+{
+    int fd;
+    AVIOContext *io;
+    stage_queue queue;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    int64_t position;
+    int64_t size;
+    int64_t queued;
+    int blocked;
+    int error;
+    mlt_consumer consumer;
+} write_behind_t;
+
+typedef struct
+{
+    int64_t offset;
+    int size;
+    uint8_t data[];
+} write_chunk;
+
+static void *write_behind_thread(void *arg)
+{
+    write_behind_t *wb = arg;
+    write_chunk *chunk;
+
+    while ((chunk = stage_queue_pop(wb->queue))) {
+        int done = 0;
+
+        while (!wb->error && done < chunk->size) {
+            ssize_t n = pwrite(wb->fd, chunk->data + done, chunk->size - done, chunk->offset + done);
+            if (n >= 0) {
+                done += n;
+            } else if (errno != EINTR) {
+                mlt_log_error(MLT_CONSUMER_SERVICE(wb->consumer),
+                              "write failed: %s\n",
+                              strerror(errno));
+                mlt_events_fire(MLT_CONSUMER_PROPERTIES(wb->consumer),
+                                "consumer-fatal-error",
+                                mlt_event_data_none());
+                pthread_mutex_lock(&wb->mutex);
+                wb->error = 1;
+                pthread_mutex_unlock(&wb->mutex);
+            }
+        }
+        pthread_mutex_lock(&wb->mutex);
+        wb->queued -= chunk->size;
+        pthread_mutex_unlock(&wb->mutex);
+        free(chunk);
+    }
+    return NULL;
+}
+
+static int write_behind_write(void *opaque, uint8_t *buf, int size)
+{
+    write_behind_t *wb = opaque;
+    mlt_properties properties = MLT_CONSUMER_PROPERTIES(wb->consumer);
+    // Chunks are as large as the AVIO buffer, too large to recycle in the pool
+    write_chunk *chunk = malloc(sizeof(write_chunk) + size);
+
+    pthread_mutex_lock(&wb->mutex);
+    int error = wb->error;
+    wb->queued += size;
+    int64_t queued = wb->queued;
+    pthread_mutex_unlock(&wb->mutex);
+    if (error || !chunk) {
+        free(chunk);
+        return AVERROR(EIO);
+    }
+
+    chunk->offset = wb->position;
+    chunk->size = size;
+    memcpy(chunk->data, buf, size);
+    if (stage_queue_count(wb->queue) >= wb->queue->size)
+        mlt_properties_set_int(properties, "write_behind.blocked", ++wb->blocked);
+    stage_queue_push(wb->queue, chunk);
+    mlt_properties_set_int64(properties, "write_behind.queued", queued);
+
+    wb->position += size;
+    wb->size = FFMAX(wb->size, wb->position);
+    return size;
+}
+
+static int64_t write_behind_seek(void *opaque, int64_t offset, int whence)
+{
+    write_behind_t *wb = opaque;
+
+    // Chunks carry their own file offset so seeking needs no flush
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return wb->size;
+    case SEEK_SET:
+        wb->position = offset;
+        break;
+    case SEEK_CUR:
+        wb->position += offset;
+        break;
+    case SEEK_END:
+        wb->position = wb->size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    return wb->position;
+}
+
+static write_behind_t *write_behind_open(mlt_consumer consumer, const char *filename)
+{
+    mlt_properties properties = MLT_CONSUMER_PROPERTIES(consumer);
+    int buffer_size = FFMAX(mlt_properties_get_int(properties, "write_behind.buffer"), 4096);
+    write_behind_t *wb = calloc(1, sizeof(write_behind_t));
+    uint8_t *buffer = av_malloc(buffer_size);
+
+    if (!strncmp(filename, "file:", 5))
+        filename += 5;
+    wb->consumer = consumer;
+    wb->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (buffer && wb->fd >= 0)
+        wb->io = avio_alloc_context(buffer,
+                                    buffer_size,
+                                    1,
+                                    wb,
+                                    NULL,
+                                    write_behind_write,
+                                    write_behind_seek);
+    if (!wb->io) {
+        av_free(buffer);
+        if (wb->fd >= 0)
+            close(wb->fd);
+        free(wb);
+        return NULL;
+    }
+    wb->queue = stage_queue_init(mlt_properties_get_int(properties, "write_behind.queue"));
+    pthread_mutex_init(&wb->mutex, NULL);
+    pthread_create(&wb->thread, NULL, write_behind_thread, wb);
+    mlt_properties_set_int64(properties, "write_behind.queued", 0);
+    mlt_properties_set_int(properties, "write_behind.blocked", 0);
+    return wb;
+}
+
+/** Flush the AVIO buffer, wait for the writer to drain and close the file.
+ *
+ * Returns non-zero if a write failed.
+ */
+
+static int write_behind_close(write_behind_t *wb)
+{
+    avio_flush(wb->io);
+    stage_queue_close(wb->queue);
+    pthread_join(wb->thread, NULL);
+
+    int error = wb->error;
+    if (close(wb->fd))
+        error = 1;
+    mlt_properties_set_int64(MLT_CONSUMER_PROPERTIES(wb->consumer), "write_behind.queued", 0);
+    stage_queue_free(wb->queue);
+    pthread_mutex_destroy(&wb->mutex);
+    av_freep(&wb->io->buffer);
+    avio_context_free(&wb->io);
+    free(wb);
+    return error;
+}
+#endif
+
+typedef enum {
+    stage_fetch,
+    stage_convert,
+    stage_audio,
+    stage_video,
+    stage_mux,
+    stage_count
+} pipeline_stage;
+
+static const char *stage_names[stage_count] = {"fetch", "convert", "audio", "video", "mux"};
+
+/** The state of the pipelined encoder.
+ *
+ * The consumer thread fetches frames and encodes audio, a convert thread
+ * does the colour space conversion, a video thread runs the video encoder,
+ * and a mux thread writes the packets of all streams.
+ */
+
+typedef struct
+{
+    pthread_t convert_thread;
+    pthread_t video_thread;
+    pthread_t mux_thread;
+    stage_queue convert_queue; // mlt_frame
+    stage_queue video_queue;   // AVFrame
+    stage_queue mux_queue;     // AVPacket
+    AVFrame *last_avframe;
+    int64_t queued_count;
+    int flush;
+    int error;
+    int64_t start_time;
+    int64_t busy[stage_count];
+    pthread_mutex_t mutex;
+} pipeline_t;
+
+/** The state of a segmented render.
+ *
+ * The video is encoded in parallel by one nested avformat consumer per
+ * segment, each rendering its own copy of the producer graph to a temporary
+ * file. This consumer encodes the audio and copies the video packets of the
+ * segments into the output in order as they become available.
+ */
+
+typedef struct
+{
+    int count;
+    mlt_profile *profiles;
+    mlt_producer *producers;
+    mlt_consumer *consumers;
+    char **files;
+    mlt_position *starts; // first frame of each segment relative to the in point
+    int current;
+    AVFormatContext *input;
+    AVStream *input_st;
+    int64_t input_base;
+    AVRational frame_tb;
+} segments_t;
+
+static inline int64_t time_now()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
 typedef struct encode_ctx_desc
 {
     mlt_consumer consumer;
@@ -1229,7 +1552,9 @@ typedef struct encode_ctx_desc
     int video_codec_id;
     int audio_codec_id;
 
-    int error_count;
+    // Separate because audio and video are encoded on different threads when pipelined
+    int audio_error_count;
+    int video_error_count;
     int frame_count;
 
     double audio_pts;
@@ -1241,8 +1566,38 @@ typedef struct encode_ctx_desc
     mlt_properties frame_meta_properties;
 
     AVFrame *audio_avframe;
+
+    int width;
+    int height;
+    enum AVPixelFormat pix_fmt;
+    mlt_image_format img_fmt;
+    int dst_colorspace;
+    int dst_full_range;
+    int video_outbuf_size;
+    uint8_t *video_outbuf;
+
+    pipeline_t *pipeline;
+    segments_t *segments;
 } encode_ctx_t;
 
+static int write_packet(encode_ctx_t *ctx, AVPacket *pkt)
+{
+    if (ctx->pipeline) {
+        // Hand a reference to the mux stage
+        AVPacket *copy = av_packet_alloc();
+        if (!copy || av_packet_ref(copy, pkt) < 0) {
+            av_packet_free(&copy);
+            return AVERROR(ENOMEM);
+        }
+        if (stage_queue_push(ctx->pipeline->mux_queue, copy)) {
+            av_packet_free(&copy);
+            return AVERROR_EOF;
+        }
+        return ctx->pipeline->error ? AVERROR_EXTERNAL : 0;
+    }
+    return av_interleaved_write_frame(ctx->oc, pkt);
+}
+
 static int encode_audio(encode_ctx_t *ctx)
 {
     char key[27];
@@ -1282,24 +1637,29 @@ static int encode_audio(encode_ctx_t *ctx)
 
         // Optimized for single track and no channel remap
         if (!ctx->audio_st[1] && !mlt_properties_count(ctx->frame_meta_properties)) {
-            void *p = ctx->audio_buf_1;
-            if (codec->sample_fmt == AV_SAMPLE_FMT_FLTP)
-                p = interleaved_to_planar(samples, ctx->channels, p, sizeof(float));
-            else if (codec->sample_fmt == AV_SAMPLE_FMT_S16P)
-                p = interleaved_to_planar(samples, ctx->channels, p, sizeof(int16_t));
-            else if (codec->sample_fmt == AV_SAMPLE_FMT_S32P)
-                p = interleaved_to_planar(samples, ctx->channels, p, sizeof(int32_t));
-            else if (codec->sample_fmt == AV_SAMPLE_FMT_U8P)
-                p = interleaved_to_planar(samples, ctx->channels, p, sizeof(uint8_t));
+            int planar = av_sample_fmt_is_planar(codec->sample_fmt);
             ctx->audio_avframe->nb_samples = FFMAX(samples, ctx->audio_input_frame_size);
             ctx->audio_avframe->pts = ctx->sample_count[i];
             ctx->sample_count[i] += ctx->audio_avframe->nb_samples;
             avcodec_fill_audio_frame(ctx->audio_avframe,
                                      codec->channels,
                                      codec->sample_fmt,
-                                     (const uint8_t *) p,
+                                     planar ? ctx->audio_buf_2 : ctx->audio_buf_1,
                                      AUDIO_ENCODE_BUFFER_SIZE,
                                      0);
+            if (planar) {
+                // Deinterleave straight into the planes of the frame
+                mlt_audio_deinterleave(ctx->audio_avframe->extended_data,
+                                       ctx->audio_buf_1,
+                                       samples,
+                                       ctx->channels,
+                                       ctx->sample_bytes);
+                av_samples_set_silence(ctx->audio_avframe->extended_data,
+                                       samples,
+                                       ctx->audio_avframe->nb_samples - samples,
+                                       ctx->channels,
+                                       codec->sample_fmt);
+            }
             int ret = avcodec_send_frame(codec, samples ? ctx->audio_avframe : NULL);
             if (ret < 0) {
                 pkt.size = ret;
@@ -1310,8 +1670,6 @@ static int encode_audio(encode_ctx_t *ctx)
                 else if (ret < 0)
                     pkt.size = ret;
             }
-            if (p != ctx->audio_buf_1)
-                mlt_pool_release(p);
         } else {
             // Extract the audio channels according to channel mapping
             int dest_offset = 0; // channel offset into interleaved dest buffer
@@ -1349,17 +1707,21 @@ static int encode_audio(encode_ctx_t *ctx)
                 // Copy samples if source offset valid
                 if (source_offset < ctx->channels) {
                     // Interleave the audio buffer with the # channels for this stream/mapping.
-                    for (k = 0; k < map_channels; k++, j++, source_offset++, dest_offset++) {
-                        void *src = ctx->audio_buf_1 + source_offset * ctx->sample_bytes;
-                        void *dest = ctx->audio_buf_2 + dest_offset * ctx->sample_bytes;
-                        int s = samples + 1;
-
-                        while (--s) {
-                            memcpy(dest, src, ctx->sample_bytes);
-                            dest += current_channels * ctx->sample_bytes;
-                            src += ctx->channels * ctx->sample_bytes;
-                        }
+                    // The mapped channels are adjacent so copy them a sample at a time.
+                    int count = FFMIN(map_channels, ctx->channels - source_offset);
+                    count = FFMIN(count, current_channels - dest_offset) * ctx->sample_bytes;
+                    uint8_t *src = ctx->audio_buf_1 + source_offset * ctx->sample_bytes;
+                    uint8_t *dest = ctx->audio_buf_2 + dest_offset * ctx->sample_bytes;
+                    int s = samples + 1;
+
+                    while (--s) {
+                        memcpy(dest, src, count);
+                        dest += current_channels * ctx->sample_bytes;
+                        src += ctx->channels * ctx->sample_bytes;
                     }
+                    j += map_channels;
+                    source_offset += map_channels;
+                    dest_offset += map_channels;
                 }
                 // Otherwise silence
                 else {
@@ -1393,12 +1755,12 @@ static int encode_audio(encode_ctx_t *ctx)
             // Write the compressed frame in the media file
             av_packet_rescale_ts(&pkt, codec->time_base, stream->time_base);
             pkt.stream_index = stream->index;
-            if (av_interleaved_write_frame(ctx->oc, &pkt)) {
+            if (write_packet(ctx, &pkt)) {
                 mlt_log_fatal(MLT_CONSUMER_SERVICE(ctx->consumer), "error writing audio frame\n");
                 mlt_events_fire(ctx->properties, "consumer-fatal-error", mlt_event_data_none());
                 return -1;
             }
-            ctx->error_count = 0;
+            ctx->audio_error_count = 0;
             mlt_log_debug(MLT_CONSUMER_SERVICE(ctx->consumer),
                           "audio stream %d pkt pts %" PRId64 " frame_size %d\n",
                           stream->index,
@@ -1411,13 +1773,13 @@ static int encode_audio(encode_ctx_t *ctx)
                             "error with audio encode: %d (frame %d)\n",
                             pkt.size,
                             ctx->frame_count);
-            if (++ctx->error_count > 2)
+            if (++ctx->audio_error_count > 2)
                 return -1;
         } else if (!samples) // flushing
         {
             pkt.stream_index = stream->index;
             av_packet_rescale_ts(&pkt, codec->time_base, stream->time_base);
-            av_interleaved_write_frame(ctx->oc, &pkt);
+            write_packet(ctx, &pkt);
         }
 
         if (i == 0) {
@@ -1428,6 +1790,772 @@ static int encode_audio(encode_ctx_t *ctx)
     return 0;
 }
 
+/** Convert the image of a frame into the pixel format of the video encoder.
+*/
+
+static void convert_image(encode_ctx_t *ctx, mlt_frame frame, AVFrame *converted_avframe)
+{
+    mlt_properties properties = ctx->properties;
+    mlt_properties frame_properties = MLT_FRAME_PROPERTIES(frame);
+    AVCodecContext *c = ctx->vcodec_ctx;
+    enum AVPixelFormat pix_fmt = ctx->pix_fmt;
+    int width = ctx->width;
+    int height = ctx->height;
+    int img_width = width;
+    int img_height = height;
+    AVFrame video_avframe;
+    uint8_t *image;
+    int is_interlaced_chroma_correction = 0;
+    int i;
+
+    mlt_frame_get_image(frame, &image, &ctx->img_fmt, &img_width, &img_height, 0);
+
+    // Interlaced 420 correction
+    if (!mlt_properties_get_int(frame_properties, "progressive")
+        && pix_fmt == AV_PIX_FMT_YUV420P // dst
+        && ctx->img_fmt == mlt_image_yuv422 // src. It looks like rgb and 444 go as 422 too.
+        && height % 4 == 0                  // because reducing twice
+        && width == converted_avframe->linesize[1] * 2) // if != things become too complicated
+    {
+        width *= 2; // substitute resolution, to appear each half-frame side-by-side
+        height /= 2;
+        for (i = 0; i < 3; ++i)
+            converted_avframe->linesize[i] *= 2;
+        is_interlaced_chroma_correction = 1;
+        mlt_log_debug(MLT_CONSUMER_SERVICE(ctx->consumer),
+                      "interlaced chroma correction is activated\n");
+    }
+
+    mlt_image_format_planes(ctx->img_fmt,
+                            width,
+                            height,
+                            image,
+                            video_avframe.data,
+                            video_avframe.linesize);
+
+    // Do the colour space conversion
+    int srcfmt = pick_pix_fmt(ctx->img_fmt);
+    int flags = mlt_get_sws_flags(width, height, srcfmt, width, height, pix_fmt);
+    struct SwsContext *context
+        = sws_getContext(width, height, srcfmt, width, height, pix_fmt, flags, NULL, NULL, NULL);
+    int src_colorspace = mlt_properties_get_int(frame_properties, "colorspace");
+    int src_full_range = mlt_properties_get_int(frame_properties, "full_range");
+    mlt_set_luma_transfer(context,
+                          src_colorspace,
+                          ctx->dst_colorspace,
+                          src_full_range,
+                          ctx->dst_full_range);
+    sws_scale(context,
+              (const uint8_t *const *) video_avframe.data,
+              video_avframe.linesize,
+              0,
+              height,
+              converted_avframe->data,
+              converted_avframe->linesize);
+    sws_freeContext(context);
+
+    if (is_interlaced_chroma_correction) // restoring everything back
+    {
+        width /= 2;
+        height *= 2;
+        for (i = 0; i < 3; ++i)
+            converted_avframe->linesize[i] /= 2;
+    }
+
+    // Apply the alpha if applicable
+    if (!mlt_properties_get(properties, "mlt_image_format")
+        || strcmp(mlt_properties_get(properties, "mlt_image_format"), "rgba"))
+        if (c->pix_fmt == AV_PIX_FMT_RGBA || c->pix_fmt == AV_PIX_FMT_ARGB
+            || c->pix_fmt == AV_PIX_FMT_BGRA) {
+            uint8_t *p;
+            uint8_t *alpha = mlt_frame_get_alpha(frame);
+            if (alpha) {
+                register int n;
+
+                for (i = 0; i < height; i++) {
+                    n = (width + 7) / 8;
+                    p = converted_avframe->data[0] + i * converted_avframe->linesize[0] + 3;
+
+                    switch (width % 8) {
+                    case 0:
+                        do {
+                            *p = *alpha++;
+                            p += 4;
+                        case 7:
+                            *p = *alpha++;
+                            p += 4;
+                        case 6:
+                            *p = *alpha++;
+                            p += 4;
+                        case 5:
+                            *p = *alpha++;
+                            p += 4;
+                        case 4:
+                            *p = *alpha++;
+                            p += 4;
+                        case 3:
+                            *p = *alpha++;
+                            p += 4;
+                        case 2:
+                            *p = *alpha++;
+                            p += 4;
+                        case 1:
+                            *p = *alpha++;
+                            p += 4;
+                        } while (--n);
+                    }
+                }
+            } else {
+                for (i = 0; i < height; i++) {
+                    int n = width;
+                    uint8_t *p = converted_avframe->data[0] + i * converted_avframe->linesize[0]
+                                 + 3;
+                    while (n) {
+                        *p = 255;
+                        p += 4;
+                        n--;
+                    }
+                }
+            }
+        }
+}
+
+/** Encode a video frame and write out the resulting packets.
+ *
+ * Returns non-zero on a fatal error.
+ */
+
+static int encode_video(encode_ctx_t *ctx, AVFrame *avframe)
+{
+    mlt_properties properties = ctx->properties;
+    AVCodecContext *c = ctx->vcodec_ctx;
+    AVPacket pkt;
+    int ret;
+
+    av_init_packet(&pkt);
+    if (c->codec->id == AV_CODEC_ID_RAWVIDEO) {
+        pkt.data = NULL;
+        pkt.size = 0;
+    } else {
+        pkt.data = ctx->video_outbuf;
+        pkt.size = ctx->video_outbuf_size;
+    }
+
+    // Set the quality
+    avframe->quality = c->global_quality;
+    avframe->pts = ctx->frame_count;
+
+    // Set frame interlace hints
+    if (!avframe->interlaced_frame)
+        c->field_order = AV_FIELD_PROGRESSIVE;
+    else if (c->codec_id == AV_CODEC_ID_MJPEG)
+        c->field_order = avframe->top_field_first ? AV_FIELD_TT : AV_FIELD_BB;
+    else
+        c->field_order = avframe->top_field_first ? AV_FIELD_TB : AV_FIELD_BT;
+
+    // Encode the image
+    ret = avcodec_send_frame(c, avframe);
+    if (ret < 0) {
+        pkt.size = ret;
+    } else {
+    receive_video_packet:
+        ret = avcodec_receive_packet(c, &pkt);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            pkt.size = ret = 0;
+        else if (ret < 0)
+            pkt.size = ret;
+    }
+
+    // If zero size, it means the image was buffered
+    if (pkt.size > 0) {
+        av_packet_rescale_ts(&pkt, c->time_base, ctx->video_st->time_base);
+        pkt.stream_index = ctx->video_st->index;
+
+        // write the compressed frame in the media file
+        ret = write_packet(ctx, &pkt);
+        mlt_log_debug(MLT_CONSUMER_SERVICE(ctx->consumer), " frame_size %d\n", c->frame_size);
+
+        // Dual pass logging
+        if (mlt_properties_get_data(properties, "_logfile", NULL) && c->stats_out)
+            fprintf(mlt_properties_get_data(properties, "_logfile", NULL), "%s", c->stats_out);
+
+        ctx->video_error_count = 0;
+
+        if (!ret)
+            goto receive_video_packet;
+    } else if (pkt.size < 0) {
+        mlt_log_warning(MLT_CONSUMER_SERVICE(ctx->consumer),
+                        "error with video encode: %d (frame %d)\n",
+                        pkt.size,
+                        ctx->frame_count);
+        if (++ctx->video_error_count > 2)
+            return -1;
+        ret = 0;
+    }
+    if (ret) {
+        mlt_log_fatal(MLT_CONSUMER_SERVICE(ctx->consumer), "error writing video frame: %d\n", ret);
+        mlt_events_fire(properties, "consumer-fatal-error", mlt_event_data_none());
+        return -1;
+    }
+    return 0;
+}
+
+/** Drain the packets buffered in the video encoder.
+ *
+ * Returns non-zero on a fatal error.
+ */
+
+static int flush_video(encode_ctx_t *ctx)
+{
+    mlt_properties properties = ctx->properties;
+    AVCodecContext *c = ctx->vcodec_ctx;
+
+    for (;;) {
+        AVPacket pkt;
+        av_init_packet(&pkt);
+        if (c->codec->id == AV_CODEC_ID_RAWVIDEO) {
+            pkt.data = NULL;
+            pkt.size = 0;
+        } else {
+            pkt.data = ctx->video_outbuf;
+            pkt.size = ctx->video_outbuf_size;
+        }
+
+        // Encode the image
+        int ret;
+        while ((ret = avcodec_receive_packet(c, &pkt)) == AVERROR(EAGAIN)) {
+            ret = avcodec_send_frame(c, NULL);
+            if (ret < 0) {
+                mlt_log_warning(MLT_CONSUMER_SERVICE(ctx->consumer),
+                                "error with video encode: %d\n",
+                                ret);
+                break;
+            }
+        }
+        mlt_log_debug(MLT_CONSUMER_SERVICE(ctx->consumer), "flushing video size %d\n", pkt.size);
+        if (pkt.size < 0)
+            break;
+        // Dual pass logging
+        if (mlt_properties_get_data(properties, "_logfile", NULL) && c->stats_out)
+            fprintf(mlt_properties_get_data(properties, "_logfile", NULL), "%s", c->stats_out);
+        if (!pkt.size)
+            break;
+
+        av_packet_rescale_ts(&pkt, c->time_base, ctx->video_st->time_base);
+        pkt.stream_index = ctx->video_st->index;
+
+        // write the compressed frame in the media file
+        if (write_packet(ctx, &pkt) != 0) {
+            mlt_log_fatal(MLT_CONSUMER_SERVICE(ctx->consumer), "error writing flushed video frame\n");
+            mlt_events_fire(properties, "consumer-fatal-error", mlt_event_data_none());
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void pipeline_busy(pipeline_t *pipeline, pipeline_stage stage, int64_t start)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->busy[stage] += time_now() - start;
+    pthread_mutex_unlock(&pipeline->mutex);
+}
+
+static void pipeline_fail(pipeline_t *pipeline)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->error = 1;
+    pthread_mutex_unlock(&pipeline->mutex);
+}
+
+static int pipeline_failed(pipeline_t *pipeline)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    int error = pipeline->error;
+    pthread_mutex_unlock(&pipeline->mutex);
+    return error;
+}
+
+/** Report the queue fill levels and the share of time each stage has been busy.
+*/
+
+static void pipeline_report(encode_ctx_t *ctx, mlt_frame frame)
+{
+    pipeline_t *pipeline = ctx->pipeline;
+    mlt_properties frame_properties = MLT_FRAME_PROPERTIES(frame);
+    char key[30];
+    int i;
+
+    pthread_mutex_lock(&pipeline->mutex);
+    double elapsed = FFMAX(time_now() - pipeline->start_time, 1);
+    for (i = 0; i < stage_count; i++) {
+        snprintf(key, sizeof(key), "pipeline.%s", stage_names[i]);
+        mlt_properties_set_double(frame_properties, key, pipeline->busy[i] / elapsed);
+    }
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    mlt_properties_set_int(ctx->properties,
+                           "pipeline.convert_queued",
+                           stage_queue_count(pipeline->convert_queue));
+    mlt_properties_set_int(ctx->properties,
+                           "pipeline.video_queued",
+                           stage_queue_count(pipeline->video_queue));
+    mlt_properties_set_int(ctx->properties,
+                           "pipeline.mux_queued",
+                           stage_queue_count(pipeline->mux_queue));
+}
+
+static void *pipeline_convert_thread(void *arg)
+{
+    encode_ctx_t *ctx = arg;
+    pipeline_t *pipeline = ctx->pipeline;
+    mlt_frame frame;
+
+    while ((frame = stage_queue_pop(pipeline->convert_queue))) {
+        mlt_properties frame_properties = MLT_FRAME_PROPERTIES(frame);
+        int rendered = mlt_properties_get_int(frame_properties, "rendered");
+        AVFrame *avframe = NULL;
+
+        if (!pipeline_failed(pipeline)) {
+            int64_t start = time_now();
+
+            if (rendered || !pipeline->last_avframe) {
+                avframe = av_frame_alloc();
+                if (avframe) {
+                    avframe->format = ctx->pix_fmt;
+                    avframe->width = ctx->width;
+                    avframe->height = ctx->height;
+                    if (av_frame_get_buffer(avframe, IMAGE_ALIGN) < 0)
+                        av_frame_free(&avframe);
+                }
+                if (avframe) {
+                    convert_image(ctx, frame, avframe);
+                    av_frame_free(&pipeline->last_avframe);
+                    pipeline->last_avframe = av_frame_clone(avframe);
+                } else {
+                    mlt_log_error(MLT_CONSUMER_SERVICE(ctx->consumer),
+                                  "failed to allocate video AVFrame\n");
+                    mlt_events_fire(ctx->properties,
+                                    "consumer-fatal-error",
+                                    mlt_event_data_none());
+                    pipeline_fail(pipeline);
+                }
+            } else {
+                // Repeat the previous image for a frame that was not rendered
+                avframe = av_frame_clone(pipeline->last_avframe);
+            }
+            if (avframe) {
+                avframe->interlaced_frame = !mlt_properties_get_int(frame_properties,
+                                                                    "progressive");
+                avframe->top_field_first = mlt_properties_get_int(frame_properties,
+                                                                  "top_field_first");
+            }
+            pipeline_busy(pipeline, stage_convert, start);
+
+            if (rendered) {
+                pipeline_report(ctx, frame);
+                mlt_events_fire(ctx->properties,
+                                "consumer-frame-show",
+                                mlt_event_data_from_frame(frame));
+            }
+        }
+        mlt_frame_close(frame);
+        if (avframe && stage_queue_push(pipeline->video_queue, avframe))
+            av_frame_free(&avframe);
+    }
+    return NULL;
+}
+
+static void *pipeline_video_thread(void *arg)
+{
+    encode_ctx_t *ctx = arg;
+    pipeline_t *pipeline = ctx->pipeline;
+    AVFrame *avframe;
+
+    while ((avframe = stage_queue_pop(pipeline->video_queue))) {
+        if (!pipeline_failed(pipeline)) {
+            int64_t start = time_now();
+            if (encode_video(ctx, avframe))
+                pipeline_fail(pipeline);
+            ctx->frame_count++;
+            pipeline_busy(pipeline, stage_video, start);
+        }
+        av_frame_free(&avframe);
+    }
+    if (pipeline->flush && !pipeline_failed(pipeline) && flush_video(ctx))
+        pipeline_fail(pipeline);
+    return NULL;
+}
+
+static void *pipeline_mux_thread(void *arg)
+{
+    encode_ctx_t *ctx = arg;
+    pipeline_t *pipeline = ctx->pipeline;
+    AVPacket *pkt;
+
+    while ((pkt = stage_queue_pop(pipeline->mux_queue))) {
+        if (!pipeline_failed(pipeline)) {
+            int64_t start = time_now();
+            int size = pkt->size;
+            // Empty packets are only written when flushing audio and may fail harmlessly
+            if (av_interleaved_write_frame(ctx->oc, pkt) && size > 0) {
+                mlt_log_fatal(MLT_CONSUMER_SERVICE(ctx->consumer),
+                              "error writing packet for stream %d\n",
+                              pkt->stream_index);
+                mlt_events_fire(ctx->properties, "consumer-fatal-error", mlt_event_data_none());
+                pipeline_fail(pipeline);
+            }
+            pipeline_busy(pipeline, stage_mux, start);
+        }
+        av_packet_free(&pkt);
+    }
+    return NULL;
+}
+
+static void pipeline_start(encode_ctx_t *ctx)
+{
+    mlt_properties properties = ctx->properties;
+    pipeline_t *pipeline = calloc(1, sizeof(pipeline_t));
+
+    pipeline->convert_queue = stage_queue_init(
+        mlt_properties_get_int(properties, "pipeline.convert_queue"));
+    pipeline->video_queue = stage_queue_init(
+        mlt_properties_get_int(properties, "pipeline.video_queue"));
+    pipeline->mux_queue = stage_queue_init(mlt_properties_get_int(properties, "pipeline.mux_queue"));
+    pthread_mutex_init(&pipeline->mutex, NULL);
+    pipeline->start_time = time_now();
+    ctx->pipeline = pipeline;
+
+    pthread_create(&pipeline->convert_thread, NULL, pipeline_convert_thread, ctx);
+    pthread_create(&pipeline->video_thread, NULL, pipeline_video_thread, ctx);
+    pthread_create(&pipeline->mux_thread, NULL, pipeline_mux_thread, ctx);
+}
+
+/** Drain and stop the pipeline stages in order.
+ *
+ * When flush is set the video encoder is also flushed.
+ * Returns non-zero if a stage failed.
+ */
+
+static int pipeline_finish(encode_ctx_t *ctx, int flush)
+{
+    pipeline_t *pipeline = ctx->pipeline;
+
+    pipeline->flush = flush;
+    stage_queue_close(pipeline->convert_queue);
+    pthread_join(pipeline->convert_thread, NULL);
+    stage_queue_close(pipeline->video_queue);
+    pthread_join(pipeline->video_thread, NULL);
+    stage_queue_close(pipeline->mux_queue);
+    pthread_join(pipeline->mux_thread, NULL);
+
+    int error = pipeline->error;
+    stage_queue_free(pipeline->convert_queue);
+    stage_queue_free(pipeline->video_queue);
+    stage_queue_free(pipeline->mux_queue);
+    av_frame_free(&pipeline->last_avframe);
+    pthread_mutex_destroy(&pipeline->mutex);
+    free(pipeline);
+    ctx->pipeline = NULL;
+
+    return error;
+}
+
+static void on_segment_error(mlt_properties owner, void *object, mlt_event_data event_data)
+{
+    mlt_properties_set_int(owner, "_segment_failed", 1);
+}
+
+/** Stop the segment renders and remove their temporary files.
+*/
+
+static void segments_close(segments_t *segments)
+{
+    int i;
+
+    avformat_close_input(&segments->input);
+    for (i = 0; i < segments->count; i++) {
+        if (segments->consumers[i]) {
+            mlt_consumer_stop(segments->consumers[i]);
+            mlt_consumer_close(segments->consumers[i]);
+        }
+        mlt_producer_close(segments->producers[i]);
+        mlt_profile_close(segments->profiles[i]);
+        if (segments->files[i]) {
+            remove(segments->files[i]);
+            free(segments->files[i]);
+        }
+    }
+    free(segments->profiles);
+    free(segments->producers);
+    free(segments->consumers);
+    free(segments->files);
+    free(segments->starts);
+    free(segments);
+}
+
+/** Split the connected producer into GOP aligned segments and start rendering their video.
+ *
+ * Returns NULL if there is not enough material for more than one segment or
+ * the segment renders could not be started.
+ */
+
+static segments_t *segments_start(encode_ctx_t *ctx,
+                                  const AVOutputFormat *fmt,
+                                  const char *filename,
+                                  int count)
+{
+    mlt_consumer consumer = ctx->consumer;
+    mlt_properties properties = ctx->properties;
+    mlt_service service = mlt_service_producer(MLT_CONSUMER_SERVICE(consumer));
+    mlt_profile profile = mlt_service_profile(MLT_CONSUMER_SERVICE(consumer));
+    int i;
+
+    if (!service)
+        return NULL;
+
+    // Align the segments to whole GOPs
+    mlt_properties service_properties = MLT_SERVICE_PROPERTIES(service);
+    mlt_position in = mlt_properties_get_position(service_properties, "in");
+    int length = mlt_properties_get_position(service_properties, "out") - in + 1;
+    int gop = mlt_properties_get_int(properties, "g");
+    if (gop <= 0)
+        gop = FFMAX(1, (int) (2.0 * mlt_profile_fps(profile) + 0.5));
+    int size = (length + count * gop - 1) / (count * gop) * gop;
+    count = size > 0 ? (length + size - 1) / size : 0;
+    if (count < 2)
+        return NULL;
+
+    // Serialise the graph so that each segment can load its own copy
+    char *doc = NULL;
+    mlt_consumer xml = mlt_factory_consumer(profile, "xml", "string");
+    if (xml) {
+        // Connecting makes the producer report the xml consumer, so restore this one after
+        mlt_properties_inc_ref(service_properties);
+        mlt_consumer_connect(xml, service);
+        mlt_consumer_start(xml);
+        if (mlt_properties_get(MLT_CONSUMER_PROPERTIES(xml), "string"))
+            doc = strdup(mlt_properties_get(MLT_CONSUMER_PROPERTIES(xml), "string"));
+        mlt_service_disconnect_producer(MLT_CONSUMER_SERVICE(xml), 0);
+        mlt_consumer_close(xml);
+        mlt_service_disconnect_producer(MLT_CONSUMER_SERVICE(consumer), 0);
+        mlt_consumer_connect(consumer, service);
+        mlt_service_close(service);
+    }
+    if (!doc) {
+        mlt_log_error(MLT_CONSUMER_SERVICE(consumer), "failed to serialise the producer\n");
+        return NULL;
+    }
+
+    segments_t *segments = calloc(1, sizeof(segments_t));
+    segments->count = count;
+    segments->profiles = calloc(count, sizeof(mlt_profile));
+    segments->producers = calloc(count, sizeof(mlt_producer));
+    segments->consumers = calloc(count, sizeof(mlt_consumer));
+    segments->files = calloc(count, sizeof(char *));
+    segments->starts = calloc(count, sizeof(mlt_position));
+    segments->frame_tb = (AVRational){profile->frame_rate_den, profile->frame_rate_num};
+
+    for (i = 0; i < count; i++) {
+        mlt_profile segment_profile = segments->profiles[i] = mlt_profile_clone(profile);
+        mlt_producer producer = segments->producers[i] = mlt_factory_producer(segment_profile,
+                                                                              NULL,
+                                                                              doc);
+        segments->files[i] = malloc(strlen(filename) + 20);
+        sprintf(segments->files[i], "%s.segment%d", filename, i);
+        mlt_consumer segment = segments->consumers[i]
+            = mlt_factory_consumer(segment_profile, "avformat", segments->files[i]);
+        if (!producer || !segment) {
+            mlt_log_error(MLT_CONSUMER_SERVICE(consumer), "failed to create segment %d\n", i);
+            break;
+        }
+
+        segments->starts[i] = i * size;
+        int segment_length = FFMIN(segments->starts[i] + size, length) - segments->starts[i];
+        mlt_producer_set_in_and_out(producer,
+                                    in + segments->starts[i],
+                                    in + segments->starts[i] + segment_length - 1);
+        mlt_producer_seek(producer, 0);
+
+        // The segment renders only the video with the settings of this consumer
+        mlt_properties segment_properties = MLT_CONSUMER_PROPERTIES(segment);
+        mlt_properties_inherit(segment_properties, properties);
+
+        // But not with its range or the threading modes of this consumer
+        mlt_properties_set_position(segment_properties, "in", 0);
+        mlt_properties_set_position(segment_properties, "out", segment_length - 1);
+        mlt_properties_set_int(segment_properties, "real_time", -1);
+        mlt_properties_set_int(segment_properties, "pipeline", 0);
+        mlt_properties_set_int(segment_properties, "write_behind", 0);
+        mlt_properties_set_int(segment_properties, "render_cache", 0);
+        mlt_properties_set(segment_properties, "target", segments->files[i]);
+        mlt_properties_set(segment_properties, "f", fmt->name);
+        mlt_properties_set_int(segment_properties, "g", gop);
+        mlt_properties_set_int(segment_properties, "segments", 0);
+        mlt_properties_set_int(segment_properties, "an", 1);
+        mlt_properties_set_int(segment_properties, "audio_off", 1);
+        mlt_properties_set_int(segment_properties, "video_off", 0);
+        mlt_properties_set_int(segment_properties, "terminate_on_pause", 1);
+        mlt_properties_set_int(segment_properties, "running", 0);
+        mlt_events_listen(segment_properties,
+                          NULL,
+                          "consumer-fatal-error",
+                          (mlt_listener) on_segment_error);
+        mlt_consumer_connect(segment, MLT_PRODUCER_SERVICE(producer));
+        if (mlt_consumer_start(segment)) {
+            mlt_log_error(MLT_CONSUMER_SERVICE(consumer), "failed to start segment %d\n", i);
+            break;
+        }
+    }
+    free(doc);
+
+    if (i < count) {
+        segments_close(segments);
+        segments = NULL;
+    }
+    return segments;
+}
+
+/** Wait for the current segment to finish and open it for reading.
+*/
+
+static int segments_open(encode_ctx_t *ctx)
+{
+    segments_t *segments = ctx->segments;
+    mlt_consumer segment = segments->consumers[segments->current];
+    struct timespec tm = {0, 10000000};
+
+    while (!mlt_consumer_is_stopped(segment) && mlt_properties_get_int(ctx->properties, "running"))
+        nanosleep(&tm, NULL);
+    if (!mlt_consumer_is_stopped(segment))
+        return AVERROR_EXIT;
+    mlt_consumer_stop(segment);
+
+    const char *file = segments->files[segments->current];
+    if (mlt_properties_get_int(MLT_CONSUMER_PROPERTIES(segment), "_segment_failed")
+        || avformat_open_input(&segments->input, file, NULL, NULL) < 0
+        || avformat_find_stream_info(segments->input, NULL) < 0) {
+        mlt_log_error(MLT_CONSUMER_SERVICE(ctx->consumer), "failed to read segment '%s'\n", file);
+        return AVERROR_INVALIDDATA;
+    }
+    int index = av_find_best_stream(segments->input, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (index < 0) {
+        mlt_log_error(MLT_CONSUMER_SERVICE(ctx->consumer), "no video in segment '%s'\n", file);
+        return AVERROR_STREAM_NOT_FOUND;
+    }
+    segments->input_st = segments->input->streams[index];
+    segments->input_base = segments->input_st->start_time != AV_NOPTS_VALUE
+                               ? segments->input_st->start_time
+                               : 0;
+
+    // The output stream was set up from the first segment
+    if (segments->current > 0) {
+        AVCodecParameters *first = ctx->video_st->codecpar;
+        AVCodecParameters *par = segments->input_st->codecpar;
+        if (par->codec_id != first->codec_id || par->width != first->width
+            || par->height != first->height || par->format != first->format
+            || par->extradata_size != first->extradata_size
+            || (par->extradata_size
+                && memcmp(par->extradata, first->extradata, par->extradata_size))) {
+            mlt_log_error(MLT_CONSUMER_SERVICE(ctx->consumer),
+                          "segment '%s' does not match the codec parameters of the first segment\n",
+                          file);
+            return AVERROR_INVALIDDATA;
+        }
+    }
+    return 0;
+}
+
+/** Set up the output video stream from the first segment.
+ *
+ * This must be called before writing the header.
+ */
+
+static int segments_open_stream(encode_ctx_t *ctx)
+{
+    segments_t *segments = ctx->segments;
+    AVStream *st = ctx->video_st;
+    int ret = segments_open(ctx);
+
+    if (!ret)
+        ret = avcodec_parameters_copy(st->codecpar, segments->input_st->codecpar);
+    if (!ret) {
+        st->codecpar->codec_tag = 0;
+        st->sample_aspect_ratio = segments->input_st->sample_aspect_ratio;
+        st->avg_frame_rate = av_inv_q(segments->frame_tb);
+        st->time_base = segments->frame_tb;
+    }
+    return ret;
+}
+
+static int64_t segments_rescale(segments_t *segments, int64_t ts, AVRational time_base)
+{
+    if (ts == AV_NOPTS_VALUE)
+        return ts;
+
+    // Map by frame number to drop the time offset of the segment file
+    int64_t position = av_rescale_q_rnd(ts - segments->input_base,
+                                        segments->input_st->time_base,
+                                        segments->frame_tb,
+                                        AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX);
+    return av_rescale_q(position + segments->starts[segments->current],
+                        segments->frame_tb,
+                        time_base);
+}
+
+/** Copy the next video packet from the segments to the output.
+ *
+ * Returns AVERROR_EOF when all of the segments have been copied.
+ */
+
+static int segments_write_packet(encode_ctx_t *ctx)
+{
+    segments_t *segments = ctx->segments;
+    AVPacket *pkt = av_packet_alloc();
+    int ret = 0;
+
+    if (!pkt)
+        return AVERROR(ENOMEM);
+
+    while (1) {
+        if (!segments->input) {
+            if (segments->current >= segments->count) {
+                ret = AVERROR_EOF;
+                break;
+            }
+            if ((ret = segments_open(ctx)))
+                break;
+        }
+        ret = av_read_frame(segments->input, pkt);
+        if (ret == AVERROR_EOF) {
+            // Move on to the next segment
+            avformat_close_input(&segments->input);
+            remove(segments->files[segments->current]);
+            segments->current++;
+        } else if (ret < 0 || pkt->stream_index == segments->input_st->index) {
+            break;
+        } else {
+            av_packet_unref(pkt);
+        }
+    }
+
+    if (!ret) {
+        AVRational time_base = ctx->video_st->time_base;
+        pkt->pts = segments_rescale(segments, pkt->pts, time_base);
+        pkt->dts = segments_rescale(segments, pkt->dts, time_base);
+        pkt->duration = av_rescale_q(pkt->duration, segments->input_st->time_base, time_base);
+        pkt->stream_index = ctx->video_st->index;
+        pkt->pos = -1;
+        ret = av_interleaved_write_frame(ctx->oc, pkt);
+    }
+    if (ret < 0 && ret != AVERROR_EOF && ret != AVERROR_EXIT) {
+        mlt_log_fatal(MLT_CONSUMER_SERVICE(ctx->consumer), "error writing video segment\n");
+        mlt_events_fire(ctx->properties, "consumer-fatal-error", mlt_event_data_none());
+    }
+    av_packet_free(&pkt);
+    return ret;
+}
+
 /** The main thread - the argument is simply the consumer.
 */
 
@@ -1458,10 +2586,8 @@ static void *consumer_thread(void *arg)
     double fps = mlt_properties_get_double(properties, "fps");
 
     // Get width and height
-    int width = mlt_properties_get_int(properties, "width");
-    int height = mlt_properties_get_int(properties, "height");
-    int img_width = width;
-    int img_height = height;
+    int width = enc_ctx->width = mlt_properties_get_int(properties, "width");
+    int height = enc_ctx->height = mlt_properties_get_int(properties, "height");
 
     // Get default audio properties
     enc_ctx->total_channels = enc_ctx->channels = mlt_properties_get_int(properties, "channels");
@@ -1473,8 +2599,8 @@ static void *consumer_thread(void *arg)
     enc_ctx->audio_outbuf_size = AUDIO_BUFFER_SIZE;
 
     // AVFormat video buffer and frame count
-    int video_outbuf_size = VIDEO_BUFFER_SIZE;
-    uint8_t *video_outbuf = av_malloc(video_outbuf_size);
+    enc_ctx->video_outbuf_size = VIDEO_BUFFER_SIZE;
+    enc_ctx->video_outbuf = av_malloc(enc_ctx->video_outbuf_size);
 
     // Used for the frame properties
     mlt_frame frame = NULL;
@@ -1485,8 +2611,7 @@ static void *consumer_thread(void *arg)
     enc_ctx->fifo = mlt_properties_get_data(properties, "sample_fifo", NULL);
 
     // For receiving images from an mlt_frame
-    uint8_t *image;
-    mlt_image_format img_fmt = mlt_image_yuv422;
+    enc_ctx->img_fmt = mlt_image_yuv422;
 
     // Need two av pictures for converting
     AVFrame *converted_avframe = NULL;
@@ -1512,10 +2637,13 @@ static void *consumer_thread(void *arg)
     char key[27];
     enc_ctx->frame_meta_properties = mlt_properties_new();
     int header_written = 0;
-    int dst_colorspace = mlt_properties_get_int(properties, "colorspace");
+#ifndef _WIN32
+    write_behind_t *write_behind = NULL;
+#endif
+    enc_ctx->dst_colorspace = mlt_properties_get_int(properties, "colorspace");
     const char *color_range = mlt_properties_get(properties, "color_range");
-    int dst_full_range = color_range
-                         && (!strcmp("pc", color_range) || !strcmp("jpeg", color_range));
+    enc_ctx->dst_full_range = color_range
+                              && (!strcmp("pc", color_range) || !strcmp("jpeg", color_range));
 
     // Check for user selected format first
     if (format != NULL)
@@ -1599,8 +2727,31 @@ static void *consumer_thread(void *arg)
         }
     }
 
+    // Render the video in parallel segments if requested
+    int segment_count = mlt_properties_get_int(properties, "segments");
+    int video_off = mlt_properties_get_int(properties, "video_off");
+    if (segment_count > 1 && enc_ctx->video_codec_id != AV_CODEC_ID_NONE) {
+        if (mlt_properties_get_int(properties, "redirect")
+            || mlt_properties_get_int(properties, "pass") || (fmt->flags & AVFMT_NOFILE)
+            || !strncmp(filename, "pipe:", 5) || strstr(filename, "://"))
+            mlt_log_warning(MLT_CONSUMER_SERVICE(consumer),
+                            "segments are not supported for this output - disabling\n");
+        else if ((enc_ctx->segments = segments_start(enc_ctx, fmt, filename, segment_count))) {
+            // Only the audio is rendered here
+            mlt_properties_set_int(properties, "video_off", 1);
+        }
+    }
+
     // Add audio and video streams
-    if (enc_ctx->video_codec_id != AV_CODEC_ID_NONE) {
+    if (enc_ctx->video_codec_id != AV_CODEC_ID_NONE && enc_ctx->segments) {
+        // The video packets are copied from the segments
+        enc_ctx->video_st = avformat_new_stream(enc_ctx->oc, NULL);
+        if (!enc_ctx->video_st) {
+            segments_close(enc_ctx->segments);
+            enc_ctx->segments = NULL;
+            mlt_properties_set_int(properties, "video_off", video_off);
+        }
+    } else if (enc_ctx->video_codec_id != AV_CODEC_ID_NONE) {
         if ((enc_ctx->video_st
              = add_video_stream(consumer, enc_ctx->oc, video_codec, &enc_ctx->vcodec_ctx))) {
             const char *img_fmt_name = mlt_properties_get(properties, "mlt_image_format");
@@ -1608,17 +2759,17 @@ static void *consumer_thread(void *arg)
                 // Set the mlt_image_format from explicit property.
                 mlt_image_format f = mlt_image_format_id(img_fmt_name);
                 if (mlt_image_invalid != f)
-                    img_fmt = f;
+                    enc_ctx->img_fmt = f;
             } else {
                 // Set the mlt_image_format from the selected pix_fmt.
                 const char *pix_fmt_name = av_get_pix_fmt_name(enc_ctx->vcodec_ctx->pix_fmt);
                 if (!strcmp(pix_fmt_name, "rgba") || !strcmp(pix_fmt_name, "argb")
                     || !strcmp(pix_fmt_name, "bgra")) {
                     mlt_properties_set(properties, "mlt_image_format", "rgba");
-                    img_fmt = mlt_image_rgba;
+                    enc_ctx->img_fmt = mlt_image_rgba;
                 } else if (strstr(pix_fmt_name, "rgb") || strstr(pix_fmt_name, "bgr")) {
                     mlt_properties_set(properties, "mlt_image_format", "rgb");
-                    img_fmt = mlt_image_rgb;
+                    enc_ctx->img_fmt = mlt_image_rgb;
                 }
             }
         }
@@ -1692,7 +2843,7 @@ static void *consumer_thread(void *arg)
         if (enc_ctx->oc->oformat && enc_ctx->oc->oformat->priv_class && enc_ctx->oc->priv_data)
             apply_properties(enc_ctx->oc->priv_data, properties, AV_OPT_FLAG_ENCODING_PARAM);
 
-        if (enc_ctx->video_st
+        if (enc_ctx->video_st && !enc_ctx->segments
             && !open_video(properties,
                            enc_ctx->oc,
                            enc_ctx->video_st,
@@ -1717,6 +2868,14 @@ static void *consumer_thread(void *arg)
             }
         }
 
+#ifndef _WIN32
+        // The faststart rewrite reopens the file and needs all of it on disk
+        const char *movflags = mlt_properties_get(properties, "movflags");
+        int use_write_behind = mlt_properties_get_int(properties, "write_behind")
+                               && strncmp(filename, "pipe:", 5) && !strstr(filename, "://")
+                               && !(movflags && strstr(movflags, "faststart"));
+#endif
+
         // Setup custom I/O if redirecting
         if (mlt_properties_get_int(properties, "redirect")) {
             int buffer_size = 32768;
@@ -1740,6 +2899,19 @@ static void *consumer_thread(void *arg)
                               "failed to setup output redirection\n");
             }
         }
+#ifndef _WIN32
+        // Open the output file with a writer thread if requested
+        else if (!(fmt->flags & AVFMT_NOFILE) && use_write_behind) {
+            write_behind = write_behind_open(consumer, filename);
+            if (!write_behind) {
+                mlt_log_error(MLT_CONSUMER_SERVICE(consumer), "Could not open '%s'\n", filename);
+                mlt_events_fire(properties, "consumer-fatal-error", mlt_event_data_none());
+                goto on_fatal_error;
+            }
+            enc_ctx->oc->pb = write_behind->io;
+            enc_ctx->oc->flags |= AVFMT_FLAG_CUSTOM_IO;
+        }
+#endif
         // Open the output file, if needed
         else if (!(fmt->flags & AVFMT_NOFILE)) {
             if (avio_open(&enc_ctx->oc->pb, filename, AVIO_FLAG_WRITE) < 0) {
@@ -1758,13 +2930,14 @@ static void *consumer_thread(void *arg)
 
     // Allocate picture
     enum AVPixelFormat pix_fmt = AV_PIX_FMT_YUV420P;
-    if (enc_ctx->video_st) {
+    if (enc_ctx->video_st && !enc_ctx->segments) {
 #if defined(AVFILTER)
         pix_fmt = enc_ctx->vcodec_ctx->pix_fmt == AV_PIX_FMT_VAAPI ? AV_PIX_FMT_NV12
                                                                    : enc_ctx->vcodec_ctx->pix_fmt;
 #else
         pix_fmt = enc_ctx->vcodec_ctx->pix_fmt;
 #endif
+        enc_ctx->pix_fmt = pix_fmt;
         converted_avframe = alloc_picture(pix_fmt, width, height);
         if (!converted_avframe) {
             mlt_log_error(MLT_CONSUMER_SERVICE(consumer), "failed to allocate video AVFrame\n");
@@ -1789,12 +2962,35 @@ static void *consumer_thread(void *arg)
         }
     }
 
+    // Start the encoding pipeline if requested
+    if (mlt_properties_get_int(properties, "pipeline") && !enc_ctx->segments) {
+        int supported = 1;
+#if defined(AVFILTER)
+        if (enc_ctx->video_st && AV_PIX_FMT_VAAPI == enc_ctx->vcodec_ctx->pix_fmt)
+            supported = 0;
+#endif
+#ifdef AVFMT_RAWPICTURE
+        if (enc_ctx->oc->oformat->flags & AVFMT_RAWPICTURE)
+            supported = 0;
+#endif
+        if (supported)
+            pipeline_start(enc_ctx);
+        else
+            mlt_log_warning(MLT_CONSUMER_SERVICE(consumer),
+                            "pipeline is not supported for this output - disabling\n");
+    }
+
     // Get the starting time (can ignore the times above)
     gettimeofday(&ante, NULL);
 
     // Loop while running
     while (mlt_properties_get_int(properties, "running")
            && (!enc_ctx->terminated || (enc_ctx->video_st && mlt_deque_count(queue)))) {
+        int64_t fetch_start = time_now();
+
+        if (enc_ctx->pipeline && pipeline_failed(enc_ctx->pipeline))
+            goto on_fatal_error;
+
         if (!frame)
             frame = mlt_consumer_rt_frame(consumer);
 
@@ -1817,6 +3013,13 @@ static void *consumer_thread(void *arg)
                     };
                 };
 
+                if (enc_ctx->segments && segments_open_stream(enc_ctx)) {
+                    mlt_log_error(MLT_CONSUMER_SERVICE(consumer),
+                                  "Could not set up the video stream from segments\n");
+                    mlt_events_fire(properties, "consumer-fatal-error", mlt_event_data_none());
+                    goto on_fatal_error;
+                }
+
                 if (avformat_write_header(enc_ctx->oc, NULL) < 0) {
                     mlt_log_error(MLT_CONSUMER_SERVICE(consumer),
                                   "Could not write header '%s'\n",
@@ -1873,6 +3076,8 @@ static void *consumer_thread(void *arg)
                     total_time += (samples * 1000000) / enc_ctx->frequency;
                 }
                 if (!enc_ctx->video_st) {
+                    if (enc_ctx->pipeline)
+                        pipeline_report(enc_ctx, frame);
                     mlt_events_fire(properties,
                                     "consumer-frame-show",
                                     mlt_event_data_from_frame(frame));
@@ -1886,6 +3091,8 @@ static void *consumer_thread(void *arg)
                 mlt_frame_close(frame);
             frame = NULL;
         }
+        if (enc_ctx->pipeline)
+            pipeline_busy(enc_ctx->pipeline, stage_fetch, fetch_start);
 
         // While we have stuff to process, process...
         while (1) {
@@ -1898,8 +3105,12 @@ static void *consumer_thread(void *arg)
                                   / (enc_ctx->audio_input_frame_size * enc_ctx->channels
                                      * enc_ctx->sample_bytes);
                 if ((enc_ctx->video_st && enc_ctx->terminated) || fifo_frames) {
+                    int64_t audio_start = time_now();
                     int r = encode_audio(enc_ctx);
 
+                    if (enc_ctx->pipeline)
+                        pipeline_busy(enc_ctx->pipeline, stage_audio, audio_start);
+
                     if (r > 0)
                         break;
                     else if (r < 0)
@@ -1909,135 +3120,39 @@ static void *consumer_thread(void *arg)
                 }
             } else if (enc_ctx->video_st) {
                 // Write video
-                if (mlt_deque_count(queue)) {
-                    int ret = 0;
+                if (mlt_deque_count(queue) && enc_ctx->segments) {
+                    // Copy the next packet of the segments instead of encoding
+                    frame = mlt_deque_pop_front(queue);
+                    mlt_events_fire(properties,
+                                    "consumer-frame-show",
+                                    mlt_event_data_from_frame(frame));
+                    mlt_frame_close(frame);
+                    frame = NULL;
+                    int ret = segments_write_packet(enc_ctx);
+                    if (ret < 0 && ret != AVERROR_EOF)
+                        goto on_fatal_error;
+                    enc_ctx->frame_count++;
+                    enc_ctx->video_pts = (double) enc_ctx->frame_count / fps;
+                } else if (mlt_deque_count(queue) && enc_ctx->pipeline) {
+                    // Hand the frame over to the colour conversion stage
+                    frame = mlt_deque_pop_front(queue);
+                    if (stage_queue_push(enc_ctx->pipeline->convert_queue, frame))
+                        mlt_frame_close(frame);
+                    frame = NULL;
+                    enc_ctx->video_pts = (double) ++enc_ctx->pipeline->queued_count
+                                         * av_q2d(enc_ctx->vcodec_ctx->time_base);
+                } else if (mlt_deque_count(queue)) {
                     AVCodecContext *c = enc_ctx->vcodec_ctx;
 
                     frame = mlt_deque_pop_front(queue);
                     frame_properties = MLT_FRAME_PROPERTIES(frame);
 
                     if (mlt_properties_get_int(frame_properties, "rendered")) {
-                        AVFrame video_avframe;
-                        int is_interlaced_chroma_correction = 0;
-
-                        mlt_frame_get_image(frame, &image, &img_fmt, &img_width, &img_height, 0);
-
-                        // Interlaced 420 correction
-                        if (!mlt_properties_get_int(frame_properties, "progressive")
-                            && pix_fmt == AV_PIX_FMT_YUV420P // dst
-                            && img_fmt
-                                   == mlt_image_yuv422 // src. It looks like rgb and 444 go as 422 too.
-                            && height % 4 == 0         // because reducing twice
-                            && width
-                                   == converted_avframe->linesize[1]
-                                          * 2) // if != things become too complicated
-                        {
-                            width *= 2; // substitute resolution, to appear each half-frame side-by-side
-                            height /= 2;
-                            for (int i = 0; i < 3; ++i)
-                                converted_avframe->linesize[i] *= 2;
-                            is_interlaced_chroma_correction = 1;
-                            mlt_log_debug(MLT_CONSUMER_SERVICE(consumer),
-                                          "interlaced chroma correction is activated\n");
-                        }
-
-                        mlt_image_format_planes(img_fmt,
-                                                width,
-                                                height,
-                                                image,
-                                                video_avframe.data,
-                                                video_avframe.linesize);
-
-                        // Do the colour space conversion
-                        int srcfmt = pick_pix_fmt(img_fmt);
-                        int flags = mlt_get_sws_flags(width, height, srcfmt, width, height, pix_fmt);
-                        struct SwsContext *context = sws_getContext(
-                            width, height, srcfmt, width, height, pix_fmt, flags, NULL, NULL, NULL);
-                        int src_colorspace = mlt_properties_get_int(frame_properties, "colorspace");
-                        int src_full_range = mlt_properties_get_int(frame_properties, "full_range");
-                        mlt_set_luma_transfer(context,
-                                              src_colorspace,
-                                              dst_colorspace,
-                                              src_full_range,
-                                              dst_full_range);
-                        sws_scale(context,
-                                  (const uint8_t *const *) video_avframe.data,
-                                  video_avframe.linesize,
-                                  0,
-                                  height,
-                                  converted_avframe->data,
-                                  converted_avframe->linesize);
-                        sws_freeContext(context);
-
-                        if (is_interlaced_chroma_correction) // restoring everything back
-                        {
-                            width /= 2;
-                            height *= 2;
-                            for (int i = 0; i < 3; ++i)
-                                converted_avframe->linesize[i] /= 2;
-                        }
+                        convert_image(enc_ctx, frame, converted_avframe);
 
                         mlt_events_fire(properties,
                                         "consumer-frame-show",
                                         mlt_event_data_from_frame(frame));
-
-                        // Apply the alpha if applicable
-                        if (!mlt_properties_get(properties, "mlt_image_format")
-                            || strcmp(mlt_properties_get(properties, "mlt_image_format"), "rgba"))
-                            if (c->pix_fmt == AV_PIX_FMT_RGBA || c->pix_fmt == AV_PIX_FMT_ARGB
-                                || c->pix_fmt == AV_PIX_FMT_BGRA) {
-                                uint8_t *p;
-                                uint8_t *alpha = mlt_frame_get_alpha(frame);
-                                if (alpha) {
-                                    register int n;
-
-                                    for (i = 0; i < height; i++) {
-                                        n = (width + 7) / 8;
-                                        p = converted_avframe->data[0]
-                                            + i * converted_avframe->linesize[0] + 3;
-
-                                        switch (width % 8) {
-                                        case 0:
-                                            do {
-                                                *p = *alpha++;
-                                                p += 4;
-                                            case 7:
-                                                *p = *alpha++;
-                                                p += 4;
-                                            case 6:
-                                                *p = *alpha++;
-                                                p += 4;
-                                            case 5:
-                                                *p = *alpha++;
-                                                p += 4;
-                                            case 4:
-                                                *p = *alpha++;
-                                                p += 4;
-                                            case 3:
-                                                *p = *alpha++;
-                                                p += 4;
-                                            case 2:
-                                                *p = *alpha++;
-                                                p += 4;
-                                            case 1:
-                                                *p = *alpha++;
-                                                p += 4;
-                                            } while (--n);
-                                        }
-                                    }
-                                } else {
-                                    for (i = 0; i < height; i++) {
-                                        int n = width;
-                                        uint8_t *p = converted_avframe->data[0]
-                                                     + i * converted_avframe->linesize[0] + 3;
-                                        while (n) {
-                                            *p = 255;
-                                            p += 4;
-                                            n--;
-                                        }
-                                    }
-                                }
-                            }
 #if defined(AVFILTER)
                         if (AV_PIX_FMT_VAAPI == c->pix_fmt) {
                             AVFilterContext *vfilter_in = mlt_properties_get_data(properties,
@@ -2049,16 +3164,15 @@ static void *consumer_thread(void *arg)
                             if (vfilter_in && vfilter_out) {
                                 if (!avframe)
                                     avframe = av_frame_alloc();
-                                ret = av_buffersrc_add_frame(vfilter_in, converted_avframe);
+                                int ret = av_buffersrc_add_frame(vfilter_in, converted_avframe);
                                 ret = av_buffersink_get_frame(vfilter_out, avframe);
                                 if (ret < 0) {
                                     mlt_log_warning(MLT_CONSUMER_SERVICE(consumer),
                                                     "error with hwupload: %d (frame %d)\n",
                                                     ret,
                                                     enc_ctx->frame_count);
-                                    if (++enc_ctx->error_count > 2)
+                                    if (++enc_ctx->video_error_count > 2)
                                         goto on_fatal_error;
-                                    ret = 0;
                                 }
                             }
                         } else {
@@ -2088,97 +3202,30 @@ static void *consumer_thread(void *arg)
                         pkt.data = (uint8_t *) avframe;
                         pkt.size = sizeof(AVPicture);
 
-                        ret = av_write_frame(enc_ctx->oc, &pkt);
+                        int ret = av_write_frame(enc_ctx->oc, &pkt);
+                        if (ret) {
+                            mlt_log_fatal(MLT_CONSUMER_SERVICE(consumer),
+                                          "error writing video frame: %d\n",
+                                          ret);
+                            mlt_events_fire(properties,
+                                            "consumer-fatal-error",
+                                            mlt_event_data_none());
+                            goto on_fatal_error;
+                        }
                     } else
 #endif
                     {
-                        AVPacket pkt;
-                        av_init_packet(&pkt);
-                        if (c->codec->id == AV_CODEC_ID_RAWVIDEO) {
-                            pkt.data = NULL;
-                            pkt.size = 0;
-                        } else {
-                            pkt.data = video_outbuf;
-                            pkt.size = video_outbuf_size;
-                        }
-
-                        // Set the quality
-                        avframe->quality = c->global_quality;
-                        avframe->pts = enc_ctx->frame_count;
-
                         // Set frame interlace hints
                         avframe->interlaced_frame = !mlt_properties_get_int(frame_properties,
                                                                             "progressive");
                         avframe->top_field_first = mlt_properties_get_int(frame_properties,
                                                                           "top_field_first");
-                        if (mlt_properties_get_int(frame_properties, "progressive"))
-                            c->field_order = AV_FIELD_PROGRESSIVE;
-                        else if (c->codec_id == AV_CODEC_ID_MJPEG)
-                            c->field_order = (mlt_properties_get_int(frame_properties,
-                                                                     "top_field_first"))
-                                                 ? AV_FIELD_TT
-                                                 : AV_FIELD_BB;
-                        else
-                            c->field_order = (mlt_properties_get_int(frame_properties,
-                                                                     "top_field_first"))
-                                                 ? AV_FIELD_TB
-                                                 : AV_FIELD_BT;
-
-                        // Encode the image
-                        ret = avcodec_send_frame(c, avframe);
-                        if (ret < 0) {
-                            pkt.size = ret;
-                        } else {
-                        receive_video_packet:
-                            ret = avcodec_receive_packet(c, &pkt);
-                            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-                                pkt.size = ret = 0;
-                            else if (ret < 0)
-                                pkt.size = ret;
-                        }
-
-                        // If zero size, it means the image was buffered
-                        if (pkt.size > 0) {
-                            av_packet_rescale_ts(&pkt, c->time_base, enc_ctx->video_st->time_base);
-                            pkt.stream_index = enc_ctx->video_st->index;
-
-                            // write the compressed frame in the media file
-                            ret = av_interleaved_write_frame(enc_ctx->oc, &pkt);
-                            mlt_log_debug(MLT_CONSUMER_SERVICE(consumer),
-                                          " frame_size %d\n",
-                                          c->frame_size);
-
-                            // Dual pass logging
-                            if (mlt_properties_get_data(properties, "_logfile", NULL)
-                                && c->stats_out)
-                                fprintf(mlt_properties_get_data(properties, "_logfile", NULL),
-                                        "%s",
-                                        c->stats_out);
-
-                            enc_ctx->error_count = 0;
-
-                            if (!ret)
-                                goto receive_video_packet;
-                        } else if (pkt.size < 0) {
-                            mlt_log_warning(MLT_CONSUMER_SERVICE(consumer),
-                                            "error with video encode: %d (frame %d)\n",
-                                            pkt.size,
-                                            enc_ctx->frame_count);
-                            if (++enc_ctx->error_count > 2)
-                                goto on_fatal_error;
-                            ret = 0;
-                        }
+                        if (encode_video(enc_ctx, avframe))
+                            goto on_fatal_error;
                     }
                     enc_ctx->frame_count++;
                     enc_ctx->video_pts = (double) enc_ctx->frame_count
                                          * av_q2d(enc_ctx->vcodec_ctx->time_base);
-                    if (ret) {
-                        mlt_log_fatal(MLT_CONSUMER_SERVICE(consumer),
-                                      "error writing video frame: %d\n",
-                                      ret);
-                        mlt_events_fire(properties, "consumer-fatal-error", mlt_event_data_none());
-                        goto on_fatal_error;
-                    }
                     mlt_frame_close(frame);
                     frame = NULL;
 #if defined(AVFILTER)
@@ -2230,64 +3277,41 @@ static void *consumer_thread(void *arg)
                 if (!sz || ret < 0)
                     break;
             }
+    }
 
-            // Flush video
+    if (enc_ctx->pipeline) {
+        // Drain the pipeline stages, which also flushes the video encoder
+        if (pipeline_finish(enc_ctx, real_time_output <= 0))
+            goto on_fatal_error;
+    } else if (enc_ctx->segments && header_written) {
+        // Copy the video remaining in the segments
+        int ret;
+        while (!(ret = segments_write_packet(enc_ctx)))
+            ;
+        if (ret != AVERROR_EOF)
+            goto on_fatal_error;
+    }
+    // Flush video
 #ifdef AVFMT_RAWPICTURE
-        if (enc_ctx->video_st && !(enc_ctx->oc->oformat->flags & AVFMT_RAWPICTURE))
-            for (;;)
+    else if (real_time_output <= 0 && enc_ctx->video_st
+             && !(enc_ctx->oc->oformat->flags & AVFMT_RAWPICTURE)) {
 #else
-        if (enc_ctx->video_st)
-            for (;;)
+    else if (real_time_output <= 0 && enc_ctx->video_st) {
 #endif
-            {
-                AVCodecContext *c = enc_ctx->vcodec_ctx;
-                AVPacket pkt;
-                av_init_packet(&pkt);
-                if (c->codec->id == AV_CODEC_ID_RAWVIDEO) {
-                    pkt.data = NULL;
-                    pkt.size = 0;
-                } else {
-                    pkt.data = video_outbuf;
-                    pkt.size = video_outbuf_size;
-                }
+        if (flush_video(enc_ctx))
+            goto on_fatal_error;
+    }
 
-                // Encode the image
-                int ret;
-                while ((ret = avcodec_receive_packet(c, &pkt)) == AVERROR(EAGAIN)) {
-                    ret = avcodec_send_frame(c, NULL);
-                    if (ret < 0) {
-                        mlt_log_warning(MLT_CONSUMER_SERVICE(consumer),
-                                        "error with video encode: %d\n",
-                                        ret);
-                        break;
-                    }
-                }
-                mlt_log_debug(MLT_CONSUMER_SERVICE(consumer), "flushing video size %d\n", pkt.size);
-                if (pkt.size < 0)
-                    break;
-                // Dual pass logging
-                if (mlt_properties_get_data(properties, "_logfile", NULL) && c->stats_out)
-                    fprintf(mlt_properties_get_data(properties, "_logfile", NULL),
-                            "%s",
-                            c->stats_out);
-                if (!pkt.size)
-                    break;
+on_fatal_error:
 
-                av_packet_rescale_ts(&pkt, c->time_base, enc_ctx->video_st->time_base);
-                pkt.stream_index = enc_ctx->video_st->index;
+    if (enc_ctx->pipeline)
+        pipeline_finish(enc_ctx, 0);
 
-                // write the compressed frame in the media file
-                if (av_interleaved_write_frame(enc_ctx->oc, &pkt) != 0) {
-                    mlt_log_fatal(MLT_CONSUMER_SERVICE(consumer),
-                                  "error writing flushed video frame\n");
-                    mlt_events_fire(properties, "consumer-fatal-error", mlt_event_data_none());
-                    goto on_fatal_error;
-                }
-            }
+    if (enc_ctx->segments) {
+        segments_close(enc_ctx->segments);
+        mlt_properties_set_int(properties, "video_off", video_off);
     }
 
-on_fatal_error:
-
     if (frame)
         mlt_frame_close(frame);
 
@@ -2303,7 +3327,7 @@ on_fatal_error:
     if (enc_ctx->video_st && enc_ctx->vcodec_ctx && AV_PIX_FMT_VAAPI == enc_ctx->vcodec_ctx->pix_fmt)
         av_frame_free(&avframe);
 #endif
-    av_free(video_outbuf);
+    av_free(enc_ctx->video_outbuf);
     av_free(enc_ctx->audio_avframe);
 
     // close each codec
@@ -2316,6 +3340,12 @@ on_fatal_error:
         av_freep(&enc_ctx->oc->streams[i]);
 
     // Close the output file
+#ifndef _WIN32
+    if (write_behind) {
+        if (write_behind_close(write_behind))
+            mlt_log_error(MLT_CONSUMER_SERVICE(consumer), "failed to write '%s'\n", filename);
+    } else
+#endif
     if (!(fmt->flags & AVFMT_NOFILE) && !mlt_properties_get_int(properties, "redirect")) {
         if (enc_ctx->oc->pb)
             avio_close(enc_ctx->oc->pb);
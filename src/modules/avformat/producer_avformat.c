@@ -68,6 +68,8 @@
 #include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <wchar.h>
 
 #define POSITION_INITIAL (-2)
@@ -78,6 +80,22 @@
 #define IMAGE_ALIGN (1)
 #define VFR_THRESHOLD \
     (3) // The minimum number of video frames with differing durations to be considered VFR.
+#define MAX_AUDIO_PREFETCH (60) // seconds
+
+/** A frame of decoded audio in the prefetch ring.
+*/
+
+typedef struct
+{
+    mlt_position position; // POSITION_INVALID when empty
+    uint8_t *buffer;
+    int size; // bytes allocated
+    mlt_audio_format format;
+    int frequency;
+    int channels;
+    int samples;
+    mlt_channel_layout layout;
+} audio_slot;
 
 struct producer_avformat_s
 {
@@ -143,6 +161,22 @@ struct producer_avformat_s
     int is_audio_synchronizing;
     int video_send_result;
     int reset_image_cache;
+    mlt_properties probe_cache; // probe results of the default streams to save
+    int probe_cache_dirty;      // probe_cache gained the first PTS and needs saving
+    struct
+    {
+        audio_slot *slots; // indexed by position modulo count
+        int count;
+        int ahead; // frames to decode ahead of the playhead
+        mlt_position playhead;
+        int sequential; // non-zero while the consumer reads forward one frame at a time
+        double fps;
+        int frequency;
+        int channels;
+        pthread_t thread;
+        pthread_cond_t cond;
+        int stop;
+    } audio_ring;
 #if USE_HWACCEL
     struct
     {
@@ -165,12 +199,17 @@ static void producer_avformat_close(producer_avformat);
 static void producer_close(mlt_producer parent);
 static void producer_set_up_video(producer_avformat self, mlt_frame frame);
 static void producer_set_up_audio(producer_avformat self, mlt_frame frame);
+static void audio_ring_clear(producer_avformat self);
+static void audio_ring_close(producer_avformat self);
 static void apply_properties(void *obj, mlt_properties properties, int flags);
 static int video_codec_init(producer_avformat self, int index, mlt_properties properties);
 static void get_audio_streams_info(producer_avformat self);
 static mlt_audio_format pick_audio_format(int sample_fmt);
 static int pick_av_pixel_format(int *pix_fmt, int full_range);
 static void property_changed(mlt_service owner, producer_avformat self, char *name);
+static int probe_cache_load(producer_avformat self, mlt_profile profile);
+static void probe_cache_save(producer_avformat self);
+static void probe_cache_write(producer_avformat self);
 
 static int absolute_stream_index(AVFormatContext *context, enum AVMediaType media_type, int relative)
 {
@@ -241,7 +280,8 @@ mlt_producer producer_avformat_init(mlt_profile profile, const char *service, ch
             mlt_properties_set_position(properties, "length", 0);
             mlt_properties_set_position(properties, "out", 0);
 
-            if (strcmp(service, "avformat-novalidate")) {
+            // A probe cache hit defers opening the file until the first get_frame
+            if (strcmp(service, "avformat-novalidate") && !probe_cache_load(self, profile)) {
                 // Open the file
                 if (producer_open(self, profile, mlt_properties_get(properties, "resource"), 1, 1)
                     != 0) {
@@ -250,6 +290,8 @@ mlt_producer producer_avformat_init(mlt_profile profile, const char *service, ch
                     mlt_producer_close(producer);
                     producer = NULL;
                 } else if (self->seekable) {
+                    probe_cache_save(self);
+
                     // Close the file to release resources for large playlists - reopen later as needed
                     if (self->audio_format)
                         avformat_close_input(&self->audio_format);
@@ -841,6 +883,192 @@ static int get_basic_info(producer_avformat self, mlt_profile profile, const cha
     return error;
 }
 
+static void init_mutexes(producer_avformat self)
+{
+    if (!self->is_mutex_init) {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&self->audio_mutex, &attr);
+        pthread_mutex_init(&self->video_mutex, &attr);
+        pthread_mutex_init(&self->packets_mutex, &attr);
+        pthread_mutex_init(&self->open_mutex, &attr);
+        pthread_mutex_init(&self->close_mutex, &attr);
+        self->is_mutex_init = 1;
+    }
+}
+
+/** Get the probe cache file name for a resource.
+ *
+ * The probe cache is enabled by setting the environment variable
+ * MLT_AVFORMAT_PROBE_CACHE to an existing directory. Entries are named by a
+ * hash of the resource and validated against its size and modification time.
+ * \return a new string to free or NULL if the resource can not be cached
+ */
+
+static char *probe_cache_file(const char *resource, struct stat *st)
+{
+    const char *dir = getenv("MLT_AVFORMAT_PROBE_CACHE");
+    if (!dir || !*dir || !resource || stat(resource, st) || !S_ISREG(st->st_mode))
+        return NULL;
+
+    // 64-bit FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const unsigned char *p = (const unsigned char *) resource; *p; p++) {
+        hash ^= *p;
+        hash *= 0x100000001b3ULL;
+    }
+    size_t size = strlen(dir) + 32;
+    char *file = malloc(size);
+    if (file)
+        snprintf(file, size, "%s/%016" PRIx64 ".txt", dir, hash);
+    return file;
+}
+
+static int probe_cache_property(const char *name)
+{
+    return !strncmp(name, "meta.", 5) || !strcmp(name, "seekable") || !strcmp(name, "width")
+           || !strcmp(name, "height") || !strcmp(name, "aspect_ratio")
+           || !strcmp(name, "format");
+}
+
+/** Save the probe results of an open, seekable file to the probe cache.
+ *
+ * This must be called right after producer_open in the constructor, before a
+ * user selection of streams changes the indices and the properties of the
+ * selected streams. The results are kept so the first PTS of the default
+ * video stream can be added to the entry when it is found.
+ */
+
+static void probe_cache_save(producer_avformat self)
+{
+    mlt_properties properties = MLT_PRODUCER_PROPERTIES(self->parent);
+    AVFormatContext *format = self->video_format ? self->video_format : self->audio_format;
+    const char *resource = mlt_properties_get(properties, "resource");
+    struct stat st;
+
+    if (!self->seekable || !format || format->duration == AV_NOPTS_VALUE)
+        return;
+    char *file = probe_cache_file(resource, &st);
+    if (!file)
+        return;
+    free(file);
+
+    mlt_properties cache = mlt_properties_new();
+    int i, n = mlt_properties_count(properties);
+    int error = 0;
+    for (i = 0; i < n && !error; i++) {
+        const char *name = mlt_properties_get_name(properties, i);
+        const char *value = mlt_properties_get_value(properties, i);
+        if (name && value && probe_cache_property(name)) {
+            // Values must survive the line-based format of mlt_properties_save
+            error = strlen(value) > 4000 || value[0] == '"' || strchr(value, '\n')
+                    || strchr(value, '\r');
+            mlt_properties_set(cache, name, value);
+        }
+    }
+    if (error) {
+        mlt_properties_close(cache);
+        return;
+    }
+    mlt_properties_set(cache, "cache.resource", resource);
+    mlt_properties_set_int64(cache, "cache.duration", format->duration);
+    mlt_properties_set_int(cache, "cache.audio_index", self->audio_index);
+    mlt_properties_set_int(cache, "cache.video_index", self->video_index);
+    if (self->first_pts != AV_NOPTS_VALUE)
+        mlt_properties_set_int64(cache, "cache.first_pts", self->first_pts);
+    mlt_properties_close(self->probe_cache);
+    self->probe_cache = cache;
+    probe_cache_write(self);
+}
+
+/** Write the kept probe results to the probe cache.
+ *
+ * Do not call this with packets_mutex locked because it writes a file.
+ */
+
+static void probe_cache_write(producer_avformat self)
+{
+    mlt_properties cache = self->probe_cache;
+    const char *resource = cache ? mlt_properties_get(cache, "cache.resource") : NULL;
+    struct stat st;
+    char *file = probe_cache_file(resource, &st);
+    char *temp = file ? malloc(strlen(file) + 16) : NULL;
+
+    if (temp) {
+        mlt_properties_set_int64(cache, "cache.size", st.st_size);
+        mlt_properties_set_int64(cache, "cache.mtime", st.st_mtime);
+
+        // Write a temporary file and rename it so readers never see a partial entry
+        sprintf(temp, "%s.%d", file, (int) getpid());
+        if (!mlt_properties_save(cache, temp) && rename(temp, file))
+            remove(temp);
+    }
+    free(temp);
+    free(file);
+}
+
+/** Restore the probe results of an unchanged file from the probe cache.
+ *
+ * \return true if the file does not need to be opened now
+ */
+
+static int probe_cache_load(producer_avformat self, mlt_profile profile)
+{
+    mlt_properties properties = MLT_PRODUCER_PROPERTIES(self->parent);
+    const char *resource = mlt_properties_get(properties, "resource");
+    struct stat st;
+    char *file = probe_cache_file(resource, &st);
+    if (!file)
+        return 0;
+
+    mlt_properties cache = mlt_properties_load(file);
+    free(file);
+    if (!cache)
+        return 0;
+
+    int hit = mlt_properties_get(cache, "cache.resource")
+              && !strcmp(mlt_properties_get(cache, "cache.resource"), resource)
+              && mlt_properties_get_int64(cache, "cache.size") == (int64_t) st.st_size
+              && mlt_properties_get_int64(cache, "cache.mtime") == (int64_t) st.st_mtime
+              && mlt_properties_exists(cache, "cache.duration");
+    if (hit) {
+        int i, n = mlt_properties_count(cache);
+        for (i = 0; i < n; i++) {
+            const char *name = mlt_properties_get_name(cache, i);
+            if (probe_cache_property(name))
+                mlt_properties_set(properties, name, mlt_properties_get_value(cache, i));
+        }
+
+        // This is what get_basic_info does with the duration
+        mlt_position frames = (mlt_position) lrint(
+            mlt_properties_get_int64(cache, "cache.duration") * mlt_profile_fps(profile)
+            / AV_TIME_BASE);
+        if (mlt_properties_get_position(properties, "out") <= 0)
+            mlt_properties_set_position(properties, "out", frames - 1);
+        if (mlt_properties_get_position(properties, "length") <= 0)
+            mlt_properties_set_position(properties, "length", frames);
+
+        if (mlt_properties_exists(cache, "cache.first_pts"))
+            mlt_properties_set_int64(properties,
+                                     "_first_pts",
+                                     mlt_properties_get_int64(cache, "cache.first_pts"));
+        else
+            // Keep the entry to add the first PTS once it is found
+            self->probe_cache = cache;
+        self->audio_index = mlt_properties_get_int(cache, "cache.audio_index");
+        self->video_index = mlt_properties_get_int(cache, "cache.video_index");
+        self->seekable = self->video_seekable = 1;
+        self->first_pts = AV_NOPTS_VALUE;
+        self->last_position = POSITION_INITIAL;
+        init_mutexes(self);
+        mlt_log_debug(MLT_PRODUCER_SERVICE(self->parent), "probe cache hit %s\n", resource);
+    }
+    if (cache != self->probe_cache)
+        mlt_properties_close(cache);
+    return hit;
+}
+
 #ifdef AVFILTER
 static int setup_video_filters(producer_avformat self)
 {
@@ -1016,17 +1244,7 @@ static int producer_open(
     int error = 0;
     mlt_properties properties = MLT_PRODUCER_PROPERTIES(self->parent);
 
-    if (!self->is_mutex_init) {
-        pthread_mutexattr_t attr;
-        pthread_mutexattr_init(&attr);
-        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
-        pthread_mutex_init(&self->audio_mutex, &attr);
-        pthread_mutex_init(&self->video_mutex, &attr);
-        pthread_mutex_init(&self->packets_mutex, &attr);
-        pthread_mutex_init(&self->open_mutex, &attr);
-        pthread_mutex_init(&self->close_mutex, &attr);
-        self->is_mutex_init = 1;
-    }
+    init_mutexes(self);
 
     // Lock the service
     if (take_lock) {
@@ -1066,7 +1284,9 @@ static int producer_open(
             error = get_basic_info(self, profile, filename);
 
             // Initialize position info
-            self->first_pts = AV_NOPTS_VALUE;
+            self->first_pts = mlt_properties_exists(properties, "_first_pts")
+                                  ? mlt_properties_get_int64(properties, "_first_pts")
+                                  : AV_NOPTS_VALUE;
             self->last_position = POSITION_INITIAL;
 
 #if USE_HWACCEL
@@ -1176,6 +1396,7 @@ static void prepare_reopen(producer_avformat self)
     pthread_mutex_lock(&self->audio_mutex);
     pthread_mutex_lock(&self->open_mutex);
 
+    audio_ring_clear(self);
     int i;
     for (i = 0; i < MAX_AUDIO_STREAMS; i++) {
         mlt_pool_release(self->audio_buffer[i]);
@@ -1288,6 +1509,18 @@ static void find_first_pts(producer_avformat self, int video_index)
         mlt_properties_set_int(MLT_PRODUCER_PROPERTIES(self->parent),
                                "meta.media.variable_frame_rate",
                                1);
+    if (self->first_pts != AV_NOPTS_VALUE) {
+        mlt_properties_set_int64(MLT_PRODUCER_PROPERTIES(self->parent),
+                                 "_first_pts",
+                                 self->first_pts);
+        // Only the first PTS of the default video stream belongs in the probe cache
+        if (self->probe_cache
+            && video_index == mlt_properties_get_int(self->probe_cache, "cache.video_index")
+            && !mlt_properties_exists(self->probe_cache, "cache.first_pts")) {
+            mlt_properties_set_int64(self->probe_cache, "cache.first_pts", self->first_pts);
+            self->probe_cache_dirty = 1;
+        }
+    }
     av_seek_frame(context, -1, 0, AVSEEK_FLAG_BACKWARD);
 }
 
@@ -1369,7 +1602,11 @@ static int seek_video(producer_avformat self,
             av_frame_unref(self->video_frame);
         }
     }
+    int save_probe = self->probe_cache_dirty;
+    self->probe_cache_dirty = 0;
     pthread_mutex_unlock(&self->packets_mutex);
+    if (save_probe)
+        probe_cache_write(self);
     return paused;
 }
 
@@ -3034,7 +3271,11 @@ static int seek_audio(producer_avformat self, mlt_position position, double time
                 self->audio_used[i - 1] = 0;
         }
     }
+    int save_probe = self->probe_cache_dirty;
+    self->probe_cache_dirty = 0;
     pthread_mutex_unlock(&self->packets_mutex);
+    if (save_probe)
+        probe_cache_write(self);
     return paused;
 }
 
@@ -3043,19 +3284,6 @@ static int sample_bytes(AVCodecContext *context)
     return av_get_bytes_per_sample(context->sample_fmt);
 }
 
-static void planar_to_interleaved(
-    uint8_t *dest, AVFrame *src, int samples, int channels, int bytes_per_sample)
-{
-    int s, c;
-    for (s = 0; s < samples; s++) {
-        for (c = 0; c < channels; c++) {
-            if (c < AV_NUM_DATA_POINTERS)
-                memcpy(dest, &src->data[c][s * bytes_per_sample], bytes_per_sample);
-            dest += bytes_per_sample;
-        }
-    }
-}
-
 static int decode_audio(producer_avformat self,
                         int *ignore,
                         const AVPacket *pkt,
@@ -3125,11 +3353,11 @@ static int decode_audio(producer_avformat self,
                 case AV_SAMPLE_FMT_S16P:
                 case AV_SAMPLE_FMT_S32P:
                 case AV_SAMPLE_FMT_FLTP:
-                    planar_to_interleaved(dest,
-                                          self->audio_frame,
-                                          convert_samples,
-                                          channels,
-                                          sizeof_sample);
+                    mlt_audio_interleave(dest,
+                                         self->audio_frame->extended_data,
+                                         convert_samples,
+                                         channels,
+                                         sizeof_sample);
                     break;
                 default: {
                     int data_size = av_samples_get_buffer_size(NULL,
@@ -3219,6 +3447,202 @@ static int decode_audio(producer_avformat self,
     return ret;
 }
 
+static void *audio_ring_thread(void *arg);
+
+/** Start decoding audio ahead of the consumer if the audio_prefetch property asks for it.
+ * The audio mutex must be locked.
+ */
+
+static void audio_ring_init(producer_avformat self, mlt_frame frame)
+{
+    double seconds = mlt_properties_get_double(MLT_PRODUCER_PROPERTIES(self->parent),
+                                               "audio_prefetch");
+    double fps = mlt_producer_get_fps(self->parent);
+    int i;
+
+    if (mlt_properties_get(MLT_FRAME_PROPERTIES(frame), "producer_consumer_fps"))
+        fps = mlt_properties_get_double(MLT_FRAME_PROPERTIES(frame), "producer_consumer_fps");
+    if (seconds <= 0.0 || fps <= 0.0)
+        return;
+    seconds = FFMIN(seconds, MAX_AUDIO_PREFETCH);
+
+    // Keep the frame at the playhead and one more so that the ring never wraps onto them
+    self->audio_ring.ahead = FFMAX(1, lrint(ceil(seconds * fps)));
+    self->audio_ring.count = self->audio_ring.ahead + 2;
+    self->audio_ring.slots = calloc(self->audio_ring.count, sizeof(audio_slot));
+    for (i = 0; i < self->audio_ring.count; i++)
+        self->audio_ring.slots[i].position = POSITION_INVALID;
+    self->audio_ring.playhead = POSITION_INVALID;
+    self->audio_ring.sequential = 0;
+    self->audio_ring.fps = fps;
+    self->audio_ring.stop = 0;
+    pthread_cond_init(&self->audio_ring.cond, NULL);
+    if (pthread_create(&self->audio_ring.thread, NULL, audio_ring_thread, self)) {
+        mlt_log_warning(MLT_PRODUCER_SERVICE(self->parent), "failed to start audio prefetch\n");
+        pthread_cond_destroy(&self->audio_ring.cond);
+        free(self->audio_ring.slots);
+        self->audio_ring.slots = NULL;
+        self->audio_ring.count = 0;
+    }
+}
+
+/** Stop the audio prefetch thread and free the ring.
+*/
+
+static void audio_ring_close(producer_avformat self)
+{
+    int i;
+
+    if (!self->audio_ring.slots)
+        return;
+    pthread_mutex_lock(&self->audio_mutex);
+    self->audio_ring.stop = 1;
+    pthread_cond_signal(&self->audio_ring.cond);
+    pthread_mutex_unlock(&self->audio_mutex);
+    pthread_join(self->audio_ring.thread, NULL);
+    pthread_cond_destroy(&self->audio_ring.cond);
+    for (i = 0; i < self->audio_ring.count; i++)
+        mlt_pool_release(self->audio_ring.slots[i].buffer);
+    free(self->audio_ring.slots);
+    self->audio_ring.slots = NULL;
+    self->audio_ring.count = 0;
+}
+
+/** Forget the decoded audio in the ring.
+ * The audio mutex must be locked.
+ */
+
+static void audio_ring_clear(producer_avformat self)
+{
+    int i;
+
+    for (i = 0; i < self->audio_ring.count; i++)
+        self->audio_ring.slots[i].position = POSITION_INVALID;
+    self->audio_ring.sequential = 0;
+}
+
+static audio_slot *audio_ring_slot(producer_avformat self, mlt_position position)
+{
+    audio_slot *slot;
+
+    if (!self->audio_ring.count || position < 0)
+        return NULL;
+    slot = &self->audio_ring.slots[position % self->audio_ring.count];
+    return slot->position == position ? slot : NULL;
+}
+
+/** Store a frame of decoded audio in the ring.
+ * The audio mutex must be locked.
+ */
+
+static void audio_ring_put(producer_avformat self,
+                           mlt_position position,
+                           const void *buffer,
+                           mlt_audio_format format,
+                           int frequency,
+                           int channels,
+                           int samples,
+                           mlt_channel_layout layout)
+{
+    int size = mlt_audio_format_size(format, samples, channels);
+    audio_slot *slot;
+
+    if (!self->audio_ring.count || position < 0 || size <= 0)
+        return;
+    slot = &self->audio_ring.slots[position % self->audio_ring.count];
+    if (slot->size < size) {
+        mlt_pool_release(slot->buffer);
+        slot->buffer = mlt_pool_alloc(size);
+        slot->size = size;
+    }
+    memcpy(slot->buffer, buffer, size);
+    slot->position = position;
+    slot->format = format;
+    slot->frequency = frequency;
+    slot->channels = channels;
+    slot->samples = samples;
+    slot->layout = layout;
+}
+
+/** Copy a frame of decoded audio out of the ring into the frame.
+ * The audio mutex must be locked.
+ * \return true if the ring has the position
+ */
+
+static int audio_ring_get(producer_avformat self,
+                          mlt_frame frame,
+                          mlt_position position,
+                          void **buffer,
+                          mlt_audio_format *format,
+                          int *frequency,
+                          int *channels,
+                          int *samples)
+{
+    audio_slot *slot = audio_ring_slot(self, position);
+    int size;
+
+    if (!slot)
+        return 0;
+    size = mlt_audio_format_size(slot->format, slot->samples, slot->channels);
+    *buffer = mlt_pool_alloc(size);
+    memcpy(*buffer, slot->buffer, size);
+    *format = slot->format;
+    *frequency = slot->frequency;
+    *channels = slot->channels;
+    *samples = slot->samples;
+    mlt_frame_set_audio(frame, *buffer, *format, size, mlt_pool_release);
+    mlt_properties_set(MLT_FRAME_PROPERTIES(frame),
+                       "channel_layout",
+                       mlt_audio_channel_layout_name(slot->layout));
+    mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "audio_samples", *samples);
+    return 1;
+}
+
+/** Move the playhead of the ring to a request of the consumer and wake the prefetch thread.
+ * The audio mutex must be locked.
+ */
+
+static void audio_ring_follow(
+    producer_avformat self, mlt_frame frame, mlt_position position, int frequency, int channels)
+{
+    double fps = mlt_producer_get_fps(self->parent);
+
+    if (mlt_properties_get(MLT_FRAME_PROPERTIES(frame), "producer_consumer_fps"))
+        fps = mlt_properties_get_double(MLT_FRAME_PROPERTIES(frame), "producer_consumer_fps");
+
+    // The number of samples in each frame depends on the request
+    if (fps != self->audio_ring.fps || frequency != self->audio_ring.frequency
+        || channels != self->audio_ring.channels) {
+        audio_ring_clear(self);
+        self->audio_ring.fps = fps;
+        self->audio_ring.frequency = frequency;
+        self->audio_ring.channels = channels;
+    }
+    self->audio_ring.sequential = position == self->audio_ring.playhead + 1;
+    self->audio_ring.playhead = position;
+    pthread_cond_signal(&self->audio_ring.cond);
+}
+
+/** Get the first position after the playhead that the ring is missing.
+ * The audio mutex must be locked.
+ * \return the position or POSITION_INVALID if there is nothing to prefetch
+ */
+
+static mlt_position audio_ring_next(producer_avformat self)
+{
+    mlt_position length = mlt_producer_get_length(self->parent);
+    mlt_position position;
+
+    if (!self->audio_ring.sequential || self->audio_ring.stop)
+        return POSITION_INVALID;
+    for (position = self->audio_ring.playhead + 1;
+         position <= self->audio_ring.playhead + self->audio_ring.ahead && position < length;
+         position++)
+        if (!audio_ring_slot(self, position))
+            return position;
+    return POSITION_INVALID;
+}
+
 /** Get the audio from a frame.
 */
 static int producer_get_audio(mlt_frame frame,
@@ -3236,10 +3660,41 @@ static int producer_get_audio(mlt_frame frame,
     // Obtain the frame number of this frame
     mlt_position position = mlt_frame_original_position(frame);
 
-    int paused = position + 1 == self->audio_expected
-                 && mlt_properties_get_int(MLT_PRODUCER_PROPERTIES(self->parent), "mute_on_pause");
-
-    if (!paused) {
+    int mute_on_pause = mlt_properties_get_int(MLT_PRODUCER_PROPERTIES(self->parent),
+                                               "mute_on_pause");
+    int paused = position + 1 == self->audio_expected && mute_on_pause;
+    int prefetch = mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame), "avformat.prefetch");
+    int from_ring = 0;
+
+    if (!self->audio_ring.slots && !prefetch)
+        audio_ring_init(self, frame);
+
+    if (self->audio_ring.slots) {
+        // The decoder runs ahead of the consumer, so audio_expected is not its playhead
+        if (prefetch) {
+            // The consumer may have decoded this position in the meantime
+            if (audio_ring_slot(self, position)) {
+                pthread_mutex_unlock(&self->audio_mutex);
+                return 0;
+            }
+            paused = 0;
+        } else {
+            paused = position == self->audio_ring.playhead && mute_on_pause;
+            audio_ring_follow(self, frame, position, *frequency, *channels);
+            if (paused)
+                goto exit_get_audio;
+            from_ring = audio_ring_get(self,
+                                       frame,
+                                       position,
+                                       buffer,
+                                       format,
+                                       frequency,
+                                       channels,
+                                       samples);
+            if (from_ring)
+                goto done_get_audio;
+        }
+    } else if (!paused) {
         // Check the audio cache if not paused
         if (!self->audio_cache) {
             init_cache(MLT_PRODUCER_PROPERTIES(self->parent), &self->audio_cache);
@@ -3494,6 +3949,7 @@ static int producer_get_audio(mlt_frame frame,
         if (self->audio_cache) {
             mlt_cache_put_frame_audio(self->audio_cache, frame);
         }
+        audio_ring_put(self, position, *buffer, *format, *frequency, *channels, *samples, layout);
 
     } else {
     exit_get_audio:
@@ -3507,7 +3963,7 @@ static int producer_get_audio(mlt_frame frame,
 done_get_audio:
 
     // Regardless of speed (other than paused), we expect to get the next frame
-    if (!paused)
+    if (!paused && !from_ring)
         self->audio_expected = position + 1;
 
     pthread_mutex_unlock(&self->audio_mutex);
@@ -3515,6 +3971,52 @@ done_get_audio:
     return 0;
 }
 
+/** Decode audio ahead of the playhead of the consumer into the ring.
+*/
+
+static void *audio_ring_thread(void *arg)
+{
+    producer_avformat self = arg;
+
+    pthread_mutex_lock(&self->audio_mutex);
+    while (!self->audio_ring.stop) {
+        mlt_position position = audio_ring_next(self);
+        if (position == POSITION_INVALID) {
+            pthread_cond_wait(&self->audio_ring.cond, &self->audio_mutex);
+            continue;
+        }
+        double fps = self->audio_ring.fps;
+        int frequency = self->audio_ring.frequency;
+        int channels = self->audio_ring.channels;
+        pthread_mutex_unlock(&self->audio_mutex);
+
+        // Decode through producer_get_audio as for a frame of the consumer
+        mlt_frame frame = mlt_frame_init(MLT_PRODUCER_SERVICE(self->parent));
+        if (frame) {
+            mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+            mlt_audio_format format = mlt_audio_none;
+            int samples = mlt_audio_calculate_frame_samples(fps, frequency, position);
+            void *buffer = NULL;
+
+            mlt_properties_set_position(properties, "original_position", position);
+            mlt_properties_set_double(properties, "producer_consumer_fps", fps);
+            mlt_properties_set_int(properties, "avformat.prefetch", 1);
+            mlt_frame_push_audio(frame, self);
+            mlt_frame_push_audio(frame, producer_get_audio);
+            mlt_frame_get_audio(frame, &buffer, &format, &frequency, &channels, &samples);
+            mlt_frame_close(frame);
+        }
+
+        pthread_mutex_lock(&self->audio_mutex);
+        // Wait for the playhead to move rather than retry a position that yields nothing
+        if (!frame || !audio_ring_slot(self, position))
+            self->audio_ring.sequential = 0;
+    }
+    pthread_mutex_unlock(&self->audio_mutex);
+
+    return NULL;
+}
+
 /** Initialize the audio codec context.
 */
 
@@ -3687,6 +4189,9 @@ static void producer_set_up_audio(producer_avformat self, mlt_frame frame)
     // Update the audio properties if the index changed
     if (context && self->audio_index > -1 && index != self->audio_index) {
         self->audio_index = index;
+        pthread_mutex_lock(&self->audio_mutex);
+        audio_ring_clear(self);
+        pthread_mutex_unlock(&self->audio_mutex);
         pthread_mutex_lock(&self->open_mutex);
         unsigned i = 0;
         int index_max = FFMIN(MAX_AUDIO_STREAMS, context->nb_streams);
@@ -3859,6 +4364,9 @@ static void producer_avformat_close(producer_avformat self)
         mlt_events_disconnect(MLT_PRODUCER_PROPERTIES(self->parent), self);
     pthread_mutex_unlock(&self->close_mutex);
 
+    // Stop decoding ahead before the contexts go away
+    audio_ring_close(self);
+
     // Cleanup av contexts
     av_packet_unref(&self->pkt);
     av_frame_free(&self->video_frame);
@@ -3901,6 +4409,7 @@ static void producer_avformat_close(producer_avformat self)
     // Cleanup caches.
     mlt_cache_close(self->image_cache);
     mlt_cache_close(self->audio_cache);
+    mlt_properties_close(self->probe_cache);
     if (self->last_good_frame)
         mlt_frame_close(self->last_good_frame);
 
@@ -3943,6 +4452,7 @@ static void producer_close(mlt_producer parent)
                                                       "producer_avformat");
     producer_avformat self = mlt_cache_item_data(cache_item, NULL);
     if (self) {
+        audio_ring_close(self);
         pthread_mutex_lock(&self->close_mutex);
         self->parent = NULL;
         parent->close = NULL;
@@ -0,0 +1,162 @@
+/*
+ * composite_line_yuv_sse2.c
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "transition_composite.h"
+
+#include <emmintrin.h>
+#include <inttypes.h>
+
+/** Multiply 32-bit lanes keeping the low 32 bits (SSE4.1 pmulld).
+*/
+
+static inline __m128i mullo_epi32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/** Compute smoothstep(luma, luma + softness, step) for 4 pixels.
+ *
+ * The division is done in double precision, which is exact for these ranges.
+ */
+
+static inline __m128i smoothstep4(__m128i luma, __m128i step, __m128i softness, __m128d divisor)
+{
+    __m128i below = _mm_cmpgt_epi32(luma, step);
+    __m128i inside = _mm_cmpgt_epi32(_mm_add_epi32(luma, softness), step);
+    __m128i x = _mm_sub_epi32(step, luma);
+    __m128d lo = _mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(x), _mm_set1_pd(65536.0)), divisor);
+    __m128d hi = _mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(x, 8)),
+                                       _mm_set1_pd(65536.0)),
+                            divisor);
+    __m128i a = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+    __m128i r = _mm_srli_epi32(mullo_epi32(a, a), 16);
+    r = _mm_srli_epi32(mullo_epi32(r, _mm_sub_epi32(_mm_set1_epi32(3 << 16), _mm_add_epi32(a, a))),
+                       16);
+
+    // below the edge -> 0, at or above the upper edge -> 0x10000
+    r = _mm_or_si128(_mm_and_si128(inside, r), _mm_andnot_si128(inside, _mm_set1_epi32(0x10000)));
+    return _mm_andnot_si128(below, r);
+}
+
+/** Blend 2 pixels (4 bytes) of src over dest with a mix for each pixel.
+ *
+ * This is sample_mix() rewritten as dest + ((src - dest) * mix >> 16).
+ */
+
+static inline __m128i sample_mix4(__m128i dest, __m128i src, __m128i mix)
+{
+    __m128i diff = _mm_sub_epi32(src, dest);
+    return _mm_add_epi32(dest, _mm_srai_epi32(mullo_epi32(diff, mix), 16));
+}
+
+/** Composite 8 pixels at a time of a line and return the number of pixels done.
+ *
+ * This produces exactly the same result as the C versions in transition_composite.c
+ * including the luma wipe and the updates to alpha_a.
+ */
+
+int composite_line_yuv_sse2(uint8_t *dest,
+                            uint8_t *src,
+                            int width,
+                            uint8_t *alpha_b,
+                            uint8_t *alpha_a,
+                            int weight,
+                            uint16_t *luma,
+                            int soft,
+                            uint32_t step,
+                            enum composite_op op)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi8((char) 0xff);
+    const __m128i low_byte = _mm_set1_epi32(0xff);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i v_weight = _mm_set1_epi32(weight);
+    const __m128i v_step = _mm_set1_epi32(step);
+    const __m128i v_soft = _mm_set1_epi32(soft);
+    const __m128d divisor = _mm_set1_pd(soft);
+    int j;
+
+    for (j = 0; j + 8 <= width; j += 8) {
+        __m128i a_b = alpha_b ? _mm_loadl_epi64((const __m128i *) (alpha_b + j)) : opaque;
+        __m128i a_a = alpha_a ? _mm_loadl_epi64((const __m128i *) (alpha_a + j)) : opaque;
+        __m128i alpha;
+
+        switch (op) {
+        case composite_op_or:
+            alpha = _mm_or_si128(a_b, a_a);
+            break;
+        case composite_op_and:
+            alpha = _mm_and_si128(a_b, a_a);
+            break;
+        case composite_op_xor:
+            alpha = _mm_xor_si128(a_b, a_a);
+            break;
+        default:
+            alpha = a_b;
+            break;
+        }
+
+        // mix = (luma ? smoothstep : weight) * (alpha + 1) >> 8
+        alpha = _mm_unpacklo_epi8(alpha, zero);
+        __m128i alpha_lo = _mm_add_epi32(_mm_unpacklo_epi16(alpha, zero), one);
+        __m128i alpha_hi = _mm_add_epi32(_mm_unpackhi_epi16(alpha, zero), one);
+        __m128i mix_lo = v_weight, mix_hi = v_weight;
+        if (luma) {
+            __m128i l = _mm_loadu_si128((const __m128i *) (luma + j));
+            mix_lo = smoothstep4(_mm_unpacklo_epi16(l, zero), v_step, v_soft, divisor);
+            mix_hi = smoothstep4(_mm_unpackhi_epi16(l, zero), v_step, v_soft, divisor);
+        }
+        mix_lo = _mm_srli_epi32(mullo_epi32(mix_lo, alpha_lo), 8);
+        mix_hi = _mm_srli_epi32(mullo_epi32(mix_hi, alpha_hi), 8);
+
+        // Each pixel has 2 samples that use the same mix
+        __m128i s = _mm_loadu_si128((const __m128i *) (src + j * 2));
+        __m128i d = _mm_loadu_si128((const __m128i *) (dest + j * 2));
+        __m128i s_lo = _mm_unpacklo_epi8(s, zero), s_hi = _mm_unpackhi_epi8(s, zero);
+        __m128i d_lo = _mm_unpacklo_epi8(d, zero), d_hi = _mm_unpackhi_epi8(d, zero);
+        __m128i r0 = sample_mix4(_mm_unpacklo_epi16(d_lo, zero),
+                                 _mm_unpacklo_epi16(s_lo, zero),
+                                 _mm_unpacklo_epi32(mix_lo, mix_lo));
+        __m128i r1 = sample_mix4(_mm_unpackhi_epi16(d_lo, zero),
+                                 _mm_unpackhi_epi16(s_lo, zero),
+                                 _mm_unpackhi_epi32(mix_lo, mix_lo));
+        __m128i r2 = sample_mix4(_mm_unpacklo_epi16(d_hi, zero),
+                                 _mm_unpacklo_epi16(s_hi, zero),
+                                 _mm_unpacklo_epi32(mix_hi, mix_hi));
+        __m128i r3 = sample_mix4(_mm_unpackhi_epi16(d_hi, zero),
+                                 _mm_unpackhi_epi16(s_hi, zero),
+                                 _mm_unpackhi_epi32(mix_hi, mix_hi));
+        _mm_storeu_si128((__m128i *) (dest + j * 2),
+                         _mm_packus_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, r3)));
+
+        if (alpha_a) {
+            // The alpha is the low byte of mix >> 8 as in the C versions
+            __m128i m = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(mix_lo, 8), low_byte),
+                                        _mm_and_si128(_mm_srli_epi32(mix_hi, 8), low_byte));
+            m = _mm_packus_epi16(m, zero);
+            if (op == composite_op_over)
+                m = _mm_or_si128(m, a_a);
+            _mm_storel_epi64((__m128i *) (alpha_a + j), m);
+        }
+    }
+    return j;
+}
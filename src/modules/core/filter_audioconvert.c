@@ -42,457 +42,13 @@ static int convert_audio(mlt_frame frame,
                       mlt_audio_format_name(requested_format),
                       channels,
                       samples);
-        switch (*format) {
-        case mlt_audio_s16:
-            switch (requested_format) {
-            case mlt_audio_s32: {
-                int32_t *buffer = mlt_pool_alloc(size);
-                int32_t *p = buffer;
-                int c;
-                for (c = 0; c < channels; c++) {
-                    int16_t *q = (int16_t *) *audio + c;
-                    int i = samples + 1;
-                    while (--i) {
-                        *p++ = (int32_t) *q << 16;
-                        q += channels;
-                    }
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_float: {
-                float *buffer = mlt_pool_alloc(size);
-                float *p = buffer;
-                int c;
-                for (c = 0; c < channels; c++) {
-                    int16_t *q = (int16_t *) *audio + c;
-                    int i = samples + 1;
-                    while (--i) {
-                        *p++ = (float) (*q) / 32768.0;
-                        q += channels;
-                    }
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_s32le: {
-                int32_t *buffer = mlt_pool_alloc(size);
-                int32_t *p = buffer;
-                int16_t *q = (int16_t *) *audio;
-                int i = samples * channels + 1;
-                while (--i)
-                    *p++ = (int32_t) *q++ << 16;
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_f32le: {
-                float *buffer = mlt_pool_alloc(size);
-                float *p = buffer;
-                int16_t *q = (int16_t *) *audio;
-                int i = samples * channels + 1;
-                while (--i) {
-                    float f = (float) (*q++) / 32768.0;
-                    *p++ = CLAMP(f, -1.0f, 1.0f);
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_u8: {
-                uint8_t *buffer = mlt_pool_alloc(size);
-                uint8_t *p = buffer;
-                int16_t *q = (int16_t *) *audio;
-                int i = samples * channels + 1;
-                while (--i)
-                    *p++ = (*q++ >> 8) + 128;
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            default:
-                break;
-            }
-            break;
-        case mlt_audio_s32:
-            switch (requested_format) {
-            case mlt_audio_s16: {
-                int16_t *buffer = mlt_pool_alloc(size);
-                int16_t *p = buffer;
-                int32_t *q = (int32_t *) *audio;
-                int s, c;
-                for (s = 0; s < samples; s++)
-                    for (c = 0; c < channels; c++)
-                        *p++ = *(q + c * samples + s) >> 16;
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_float: {
-                float *buffer = mlt_pool_alloc(size);
-                float *p = buffer;
-                int32_t *q = (int32_t *) *audio;
-                int i = samples * channels + 1;
-                while (--i)
-                    *p++ = (float) (*q++) / 2147483648.0;
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_s32le: {
-                int32_t *buffer = mlt_pool_alloc(size);
-                int32_t *p = buffer;
-                int32_t *q = (int32_t *) *audio;
-                int s, c;
-                for (s = 0; s < samples; s++)
-                    for (c = 0; c < channels; c++)
-                        *p++ = *(q + c * samples + s);
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_f32le: {
-                float *buffer = mlt_pool_alloc(size);
-                float *p = buffer;
-                int32_t *q = (int32_t *) *audio;
-                int s, c;
-                for (s = 0; s < samples; s++)
-                    for (c = 0; c < channels; c++) {
-                        float f = (float) (*(q + c * samples + s)) / 2147483648.0;
-                        *p++ = CLAMP(f, -1.0f, 1.0f);
-                    }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_u8: {
-                uint8_t *buffer = mlt_pool_alloc(size);
-                uint8_t *p = buffer;
-                int32_t *q = (int32_t *) *audio;
-                int s, c;
-                for (s = 0; s < samples; s++)
-                    for (c = 0; c < channels; c++)
-                        *p++ = (q[c * samples + s] >> 24) + 128;
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            default:
-                break;
-            }
-            break;
-        case mlt_audio_float:
-            switch (requested_format) {
-            case mlt_audio_s16: {
-                int16_t *buffer = mlt_pool_alloc(size);
-                int16_t *p = buffer;
-                float *q = (float *) *audio;
-                int s, c;
-                for (s = 0; s < samples; s++)
-                    for (c = 0; c < channels; c++) {
-                        float f = *(q + c * samples + s);
-                        f = CLAMP(f, -1.0f, 1.0f);
-                        *p++ = 32767 * f;
-                    }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_s32: {
-                int32_t *buffer = mlt_pool_alloc(size);
-                int32_t *p = buffer;
-                float *q = (float *) *audio;
-                int i = samples * channels + 1;
-                while (--i) {
-                    float f = *q++;
-                    f = CLAMP(f, -1.0f, 1.0f);
-                    int64_t pcm = (f > 0.0f ? 2147483647LL : 2147483648LL) * f;
-                    *p++ = CLAMP(pcm, -2147483648LL, 2147483647LL);
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_s32le: {
-                int32_t *buffer = mlt_pool_alloc(size);
-                int32_t *p = buffer;
-                float *q = (float *) *audio;
-                int s, c;
-                for (s = 0; s < samples; s++)
-                    for (c = 0; c < channels; c++) {
-                        float f = *(q + c * samples + s);
-                        f = CLAMP(f, -1.0f, 1.0f);
-                        int64_t pcm = (f > 0.0f ? 2147483647LL : 2147483648LL) * f;
-                        *p++ = CLAMP(pcm, -2147483648LL, 2147483647LL);
-                    }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_f32le: {
-                float *buffer = mlt_pool_alloc(size);
-                float *p = buffer;
-                float *q = (float *) *audio;
-                int s, c;
-                for (s = 0; s < samples; s++)
-                    for (c = 0; c < channels; c++)
-                        *p++ = *(q + c * samples + s);
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_u8: {
-                uint8_t *buffer = mlt_pool_alloc(size);
-                uint8_t *p = buffer;
-                float *q = (float *) *audio;
-                int s, c;
-                for (s = 0; s < samples; s++)
-                    for (c = 0; c < channels; c++) {
-                        float f = *(q + c * samples + s);
-                        f = CLAMP(f, -1.0f, 1.0f);
-                        *p++ = (127 * f) + 128;
-                    }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            default:
-                break;
-            }
-            break;
-        case mlt_audio_s32le:
-            switch (requested_format) {
-            case mlt_audio_s16: {
-                int16_t *buffer = mlt_pool_alloc(size);
-                int16_t *p = buffer;
-                int32_t *q = (int32_t *) *audio;
-                int i = samples * channels + 1;
-                while (--i)
-                    *p++ = *q++ >> 16;
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_s32: {
-                int32_t *buffer = mlt_pool_alloc(size);
-                int32_t *p = buffer;
-                int c;
-                for (c = 0; c < channels; c++) {
-                    int32_t *q = (int32_t *) *audio + c;
-                    int i = samples + 1;
-                    while (--i) {
-                        *p++ = *q;
-                        q += channels;
-                    }
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_float: {
-                float *buffer = mlt_pool_alloc(size);
-                float *p = buffer;
-                int c;
-                for (c = 0; c < channels; c++) {
-                    int32_t *q = (int32_t *) *audio + c;
-                    int i = samples + 1;
-                    while (--i) {
-                        *p++ = (float) (*q) / 2147483648.0;
-                        q += channels;
-                    }
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_f32le: {
-                float *buffer = mlt_pool_alloc(size);
-                float *p = buffer;
-                int32_t *q = (int32_t *) *audio;
-                int i = samples * channels + 1;
-                while (--i)
-                    *p++ = (float) (*q++) / 2147483648.0;
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_u8: {
-                uint8_t *buffer = mlt_pool_alloc(size);
-                uint8_t *p = buffer;
-                int32_t *q = (int32_t *) *audio;
-                int i = samples * channels + 1;
-                while (--i)
-                    *p++ = (*q++ >> 24) + 128;
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            default:
-                break;
-            }
-            break;
-        case mlt_audio_f32le:
-            switch (requested_format) {
-            case mlt_audio_s16: {
-                int16_t *buffer = mlt_pool_alloc(size);
-                int16_t *p = buffer;
-                float *q = (float *) *audio;
-                int i = samples * channels + 1;
-                while (--i) {
-                    float f = *q++;
-                    f = CLAMP(f, -1.0f, 1.0f);
-                    *p++ = 32767 * f;
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_float: {
-                float *buffer = mlt_pool_alloc(size);
-                float *p = buffer;
-                int c;
-                for (c = 0; c < channels; c++) {
-                    float *q = (float *) *audio + c;
-                    int i = samples + 1;
-                    while (--i) {
-                        *p++ = *q;
-                        q += channels;
-                    }
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_s32: {
-                int32_t *buffer = mlt_pool_alloc(size);
-                int32_t *p = buffer;
-                int c;
-                for (c = 0; c < channels; c++) {
-                    float *q = (float *) *audio + c;
-                    int i = samples + 1;
-                    while (--i) {
-                        float f = *q;
-                        f = CLAMP(f, -1.0f, 1.0f);
-                        int64_t pcm = (f > 0.0f ? 2147483647LL : 2147483648LL) * f;
-                        *p++ = CLAMP(pcm, -2147483648LL, 2147483647LL);
-                        q += channels;
-                    }
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_s32le: {
-                int32_t *buffer = mlt_pool_alloc(size);
-                int32_t *p = buffer;
-                float *q = (float *) *audio;
-                int i = samples * channels + 1;
-                while (--i) {
-                    float f = *q++;
-                    f = CLAMP(f, -1.0f, 1.0f);
-                    int64_t pcm = (f > 0.0f ? 2147483647LL : 2147483648LL) * f;
-                    *p++ = CLAMP(pcm, -2147483648LL, 2147483647LL);
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_u8: {
-                uint8_t *buffer = mlt_pool_alloc(size);
-                uint8_t *p = buffer;
-                float *q = (float *) *audio;
-                int i = samples * channels + 1;
-                while (--i) {
-                    float f = *q++;
-                    f = CLAMP(f, -1.0f, 1.0f);
-                    *p++ = (127 * f) + 128;
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            default:
-                break;
-            }
-            break;
-        case mlt_audio_u8:
-            switch (requested_format) {
-            case mlt_audio_s32: {
-                int32_t *buffer = mlt_pool_alloc(size);
-                int32_t *p = buffer;
-                int c;
-                for (c = 0; c < channels; c++) {
-                    uint8_t *q = (uint8_t *) *audio + c;
-                    int i = samples + 1;
-                    while (--i) {
-                        *p++ = ((int32_t) *q - 128) << 24;
-                        q += channels;
-                    }
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_float: {
-                float *buffer = mlt_pool_alloc(size);
-                float *p = buffer;
-                int c;
-                for (c = 0; c < channels; c++) {
-                    uint8_t *q = (uint8_t *) *audio + c;
-                    int i = samples + 1;
-                    while (--i) {
-                        *p++ = ((float) *q - 128) / 256.0f;
-                        q += channels;
-                    }
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_s16: {
-                int16_t *buffer = mlt_pool_alloc(size);
-                int16_t *p = buffer;
-                uint8_t *q = (uint8_t *) *audio;
-                int i = samples * channels + 1;
-                while (--i)
-                    *p++ = ((int16_t) *q++ - 128) << 8;
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_s32le: {
-                int32_t *buffer = mlt_pool_alloc(size);
-                int32_t *p = buffer;
-                uint8_t *q = (uint8_t *) *audio;
-                int i = samples * channels + 1;
-                while (--i)
-                    *p++ = ((int32_t) *q++ - 128) << 24;
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            case mlt_audio_f32le: {
-                float *buffer = mlt_pool_alloc(size);
-                float *p = buffer;
-                uint8_t *q = (uint8_t *) *audio;
-                int i = samples * channels + 1;
-                while (--i) {
-                    float f = ((float) *q++ - 128) / 256.0f;
-                    *p++ = CLAMP(f, -1.0f, 1.0f);
-                }
-                *audio = buffer;
-                error = 0;
-                break;
-            }
-            default:
-                break;
-            }
-            break;
-        default:
-            break;
-        }
+        void *buffer = mlt_pool_alloc(size);
+        error = mlt_audio_convert_samples(
+            buffer, requested_format, *audio, *format, samples, channels);
+        if (error)
+            mlt_pool_release(buffer);
+        else
+            *audio = buffer;
     }
     if (!error) {
         mlt_frame_set_audio(frame, *audio, requested_format, size, mlt_pool_release);
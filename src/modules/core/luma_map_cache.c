@@ -0,0 +1,221 @@
+/*
+ * luma_map_cache.c -- a process-wide cache of luma maps shared by transitions
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "luma_map_cache.h"
+
+#include <framework/mlt_log.h>
+#include <framework/mlt_luma_map.h>
+#include <framework/mlt_pool.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Every transition of a playlist or project that uses the same wipe gets the
+ * same map instead of loading, rendering and scaling its own copy. Entries are
+ * keyed by the file name, the size requested, inversion, and the profile size
+ * used to render a map whose file does not exist. Entries are freed when the
+ * last reference is released.
+ */
+
+typedef struct entry_s
+{
+    struct luma_map_cache_item_s item; // must be first
+    char *key;
+    int refs;
+    int loaded;
+    pthread_mutex_t mutex;
+    luma_map_cache_item source; // the unscaled map while this one is in use
+    struct entry_s *next;
+} * entry;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static entry cache_entries = NULL;
+
+/** Scale 16bit greyscale luma map using nearest neighbor.
+*/
+
+void luma_map_scale(uint16_t *dest_buf,
+                    int dest_width,
+                    int dest_height,
+                    const uint16_t *src_buf,
+                    int src_width,
+                    int src_height,
+                    int invert)
+{
+    register int i, j;
+    register int x_step = (src_width << 16) / dest_width;
+    register int y_step = (src_height << 16) / dest_height;
+    register int x, y = 0;
+
+    for (i = 0; i < dest_height; i++) {
+        const uint16_t *src = src_buf + (y >> 16) * src_width;
+        x = 0;
+
+        for (j = 0; j < dest_width; j++) {
+            *dest_buf++ = src[x >> 16] ^ invert;
+            x += x_step;
+        }
+        y += y_step;
+    }
+}
+
+static void load_entry(entry self,
+                       mlt_profile profile,
+                       const char *resource,
+                       const char *orig_resource,
+                       int width,
+                       int height,
+                       int invert)
+{
+    luma_map_cache_item item = &self->item;
+
+    if (width > 0 && height > 0) {
+        // Scale (and invert) a shared copy of the original map
+        self->source = luma_map_cache_get(profile, resource, orig_resource, 0, 0, 0);
+        if (self->source) {
+            item->bitmap = mlt_pool_alloc(width * height * sizeof(uint16_t));
+            if (item->bitmap) {
+                luma_map_scale(item->bitmap,
+                               width,
+                               height,
+                               self->source->bitmap,
+                               self->source->width,
+                               self->source->height,
+                               invert * ((1 << 16) - 1));
+                item->width = width;
+                item->height = height;
+            }
+        }
+    } else if (mlt_luma_map_from_pgm(resource, &item->bitmap, &item->width, &item->height)) {
+        // Failed to read file; generate it.
+        mlt_luma_map luma = mlt_luma_map_new(orig_resource);
+        if (profile) {
+            luma->w = profile->width;
+            luma->h = profile->height;
+        }
+        item->bitmap = mlt_luma_map_render(luma);
+        item->width = luma->w;
+        item->height = luma->h;
+        free(luma);
+    }
+    if (!item->bitmap || item->width <= 0 || item->height <= 0) {
+        mlt_log_warning(NULL, "[luma_map_cache] failed to load %s\n", resource);
+        mlt_pool_release(item->bitmap);
+        item->bitmap = NULL;
+    }
+}
+
+/** Get a shared luma map, loading or rendering it on first use.
+ *
+ * \param profile the profile whose size is used to generate a missing map
+ * \param resource the file name of a PGM luma map
+ * \param orig_resource the name used to generate the map if the file does not exist
+ * \param width the width to scale to or 0 for the size of the file
+ * \param height the height to scale to or 0 for the size of the file
+ * \param invert whether to invert the scaled map
+ * \return a reference to release with luma_map_cache_release or NULL on error
+ */
+
+luma_map_cache_item luma_map_cache_get(mlt_profile profile,
+                                       const char *resource,
+                                       const char *orig_resource,
+                                       int width,
+                                       int height,
+                                       int invert)
+{
+    entry self;
+    char *key;
+    size_t size = strlen(resource) + strlen(orig_resource) + 64;
+
+    if (!(key = malloc(size)))
+        return NULL;
+    snprintf(key,
+             size,
+             "%s\n%s\n%dx%d %dx%d %d",
+             resource,
+             orig_resource,
+             profile ? profile->width : 0,
+             profile ? profile->height : 0,
+             width,
+             height,
+             invert != 0);
+
+    pthread_mutex_lock(&cache_mutex);
+    for (self = cache_entries; self && strcmp(self->key, key); self = self->next)
+        ;
+    if (self) {
+        free(key);
+    } else if ((self = calloc(1, sizeof(*self)))) {
+        self->key = key;
+        pthread_mutex_init(&self->mutex, NULL);
+        self->next = cache_entries;
+        cache_entries = self;
+    } else {
+        free(key);
+        pthread_mutex_unlock(&cache_mutex);
+        return NULL;
+    }
+    self->refs++;
+    pthread_mutex_unlock(&cache_mutex);
+
+    // Load outside of the cache lock so that other maps are not held up
+    pthread_mutex_lock(&self->mutex);
+    if (!self->loaded) {
+        load_entry(self, profile, resource, orig_resource, width, height, invert);
+        self->loaded = 1;
+    }
+    pthread_mutex_unlock(&self->mutex);
+
+    if (!self->item.bitmap) {
+        luma_map_cache_release(&self->item);
+        return NULL;
+    }
+    return &self->item;
+}
+
+/** Release a reference to a shared luma map.
+ *
+ * This is usable as a mlt_destructor and accepts NULL.
+ */
+
+void luma_map_cache_release(luma_map_cache_item item)
+{
+    entry self = (entry) item;
+    entry *prev;
+
+    if (!self)
+        return;
+    pthread_mutex_lock(&cache_mutex);
+    if (--self->refs > 0) {
+        pthread_mutex_unlock(&cache_mutex);
+        return;
+    }
+    for (prev = &cache_entries; *prev != self; prev = &(*prev)->next)
+        ;
+    *prev = self->next;
+    pthread_mutex_unlock(&cache_mutex);
+
+    luma_map_cache_release(self->source);
+    mlt_pool_release(self->item.bitmap);
+    pthread_mutex_destroy(&self->mutex);
+    free(self->key);
+    free(self);
+}
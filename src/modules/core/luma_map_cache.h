@@ -0,0 +1,52 @@
+/*
+ * luma_map_cache.h -- a process-wide cache of luma maps shared by transitions
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef LUMA_MAP_CACHE_H
+#define LUMA_MAP_CACHE_H
+
+#include <framework/mlt_profile.h>
+
+#include <stdint.h>
+
+/** A reference to a shared, read-only luma map.
+*/
+
+typedef struct luma_map_cache_item_s
+{
+    uint16_t *bitmap;
+    int width;
+    int height;
+} * luma_map_cache_item;
+
+luma_map_cache_item luma_map_cache_get(mlt_profile profile,
+                                       const char *resource,
+                                       const char *orig_resource,
+                                       int width,
+                                       int height,
+                                       int invert);
+void luma_map_cache_release(luma_map_cache_item item);
+void luma_map_scale(uint16_t *dest_buf,
+                    int dest_width,
+                    int dest_height,
+                    const uint16_t *src_buf,
+                    int src_width,
+                    int src_height,
+                    int invert);
+
+#endif // LUMA_MAP_CACHE_H
@@ -17,6 +17,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include "luma_map_cache.h"
 #include "transition_composite.h"
 #include <framework/mlt.h>
 #include <framework/mlt_luma_map.h>
@@ -139,41 +140,79 @@ static inline uint8_t sample_mix(uint8_t dest, uint8_t src, int mix)
 void composite_line_yuv_sse2_simple(
     uint8_t *dest, uint8_t *src, int width, uint8_t *alpha_b, uint8_t *alpha_a, int weight);
 #endif
+#ifdef USE_SSE2
+int composite_line_yuv_sse2(uint8_t *dest,
+                            uint8_t *src,
+                            int width,
+                            uint8_t *alpha_b,
+                            uint8_t *alpha_a,
+                            int weight,
+                            uint16_t *luma,
+                            int soft,
+                            uint32_t step,
+                            enum composite_op op);
+#endif
 
-void composite_line_yuv(uint8_t *dest,
-                        uint8_t *src,
-                        int width,
-                        uint8_t *alpha_b,
-                        uint8_t *alpha_a,
-                        int weight,
-                        uint16_t *luma,
-                        int soft,
-                        uint32_t step)
+static inline void composite_line_yuv_op(uint8_t *dest,
+                                         uint8_t *src,
+                                         int width,
+                                         uint8_t *alpha_b,
+                                         uint8_t *alpha_a,
+                                         int weight,
+                                         uint16_t *luma,
+                                         int soft,
+                                         uint32_t step,
+                                         enum composite_op op,
+                                         int simd)
 {
     register int j = 0;
     register int mix;
+    int alpha;
 
 #if defined(USE_SSE) && defined(ARCH_X86_64)
-    if (!luma && width > 7) {
+    if (simd && op == composite_op_over && !luma && width > 7) {
         composite_line_yuv_sse2_simple(dest, src, width, alpha_b, alpha_a, weight);
         j = width - width % 8;
-        dest += j * 2;
-        src += j * 2;
-        if (alpha_a)
-            alpha_a += j;
-        if (alpha_b)
-            alpha_b += j;
     }
 #endif
+#ifdef USE_SSE2
+    if (simd && j == 0 && width > 7)
+        j = composite_line_yuv_sse2(dest,
+                                    src,
+                                    width,
+                                    alpha_b,
+                                    alpha_a,
+                                    weight,
+                                    luma,
+                                    soft,
+                                    step,
+                                    op);
+#endif
+    dest += j * 2;
+    src += j * 2;
+    if (alpha_a)
+        alpha_a += j;
+    if (alpha_b)
+        alpha_b += j;
 
     for (; j < width; j++) {
-        mix = calculate_mix(luma, j, soft, weight, alpha_b ? *alpha_b : 255, step);
+        alpha = alpha_b ? *alpha_b : 255;
+        if (op == composite_op_or)
+            alpha |= alpha_a ? *alpha_a : 255;
+        else if (op == composite_op_and)
+            alpha &= alpha_a ? *alpha_a : 255;
+        else if (op == composite_op_xor)
+            alpha ^= alpha_a ? *alpha_a : 255;
+        mix = calculate_mix(luma, j, soft, weight, alpha, step);
         *dest = sample_mix(*dest, *src++, mix);
         dest++;
         *dest = sample_mix(*dest, *src++, mix);
         dest++;
         if (alpha_a) {
-            *alpha_a = (mix >> 8) | *alpha_a;
+            if (op == composite_op_over)
+                *alpha_a = (mix >> 8) | *alpha_a;
+            else
+                *alpha_a = mix >> 8;
             alpha_a++;
         }
         if (alpha_b)
@@ -181,6 +220,29 @@ void composite_line_yuv(uint8_t *dest,
     }
 }
 
+void composite_line_yuv(uint8_t *dest,
+                        uint8_t *src,
+                        int width,
+                        uint8_t *alpha_b,
+                        uint8_t *alpha_a,
+                        int weight,
+                        uint16_t *luma,
+                        int soft,
+                        uint32_t step)
+{
+    composite_line_yuv_op(dest,
+                          src,
+                          width,
+                          alpha_b,
+                          alpha_a,
+                          weight,
+                          luma,
+                          soft,
+                          step,
+                          composite_op_over,
+                          1);
+}
+
 static void composite_line_yuv_or(uint8_t *dest,
                                   uint8_t *src,
                                   int width,
@@ -191,25 +253,17 @@ static void composite_line_yuv_or(uint8_t *dest,
                                   int soft,
                                   uint32_t step)
 {
-    register int j;
-    register int mix;
-
-    for (j = 0; j < width; j++) {
-        mix = calculate_mix(luma,
-                            j,
-                            soft,
-                            weight,
-                            (alpha_b ? *alpha_b : 255) | (alpha_a ? *alpha_a : 255),
-                            step);
-        *dest = sample_mix(*dest, *src++, mix);
-        dest++;
-        *dest = sample_mix(*dest, *src++, mix);
-        dest++;
-        if (alpha_a)
-            *alpha_a++ = mix >> 8;
-        if (alpha_b)
-            alpha_b++;
-    }
+    composite_line_yuv_op(dest,
+                          src,
+                          width,
+                          alpha_b,
+                          alpha_a,
+                          weight,
+                          luma,
+                          soft,
+                          step,
+                          composite_op_or,
+                          1);
 }
 
 static void composite_line_yuv_and(uint8_t *dest,
@@ -222,25 +276,17 @@ static void composite_line_yuv_and(uint8_t *dest,
                                    int soft,
                                    uint32_t step)
 {
-    register int j;
-    register int mix;
-
-    for (j = 0; j < width; j++) {
-        mix = calculate_mix(luma,
-                            j,
-                            soft,
-                            weight,
-                            (alpha_b ? *alpha_b : 255) & (alpha_a ? *alpha_a : 255),
-                            step);
-        *dest = sample_mix(*dest, *src++, mix);
-        dest++;
-        *dest = sample_mix(*dest, *src++, mix);
-        dest++;
-        if (alpha_a)
-            *alpha_a++ = mix >> 8;
-        if (alpha_b)
-            alpha_b++;
-    }
+    composite_line_yuv_op(dest,
+                          src,
+                          width,
+                          alpha_b,
+                          alpha_a,
+                          weight,
+                          luma,
+                          soft,
+                          step,
+                          composite_op_and,
+                          1);
 }
 
 static void composite_line_yuv_xor(uint8_t *dest,
@@ -253,25 +299,112 @@ static void composite_line_yuv_xor(uint8_t *dest,
                                    int soft,
                                    uint32_t step)
 {
-    register int j;
-    register int mix;
+    composite_line_yuv_op(dest,
+                          src,
+                          width,
+                          alpha_b,
+                          alpha_a,
+                          weight,
+                          luma,
+                          soft,
+                          step,
+                          composite_op_xor,
+                          1);
+}
 
-    for (j = 0; j < width; j++) {
-        mix = calculate_mix(luma,
-                            j,
-                            soft,
-                            weight,
-                            (alpha_b ? *alpha_b : 255) ^ (alpha_a ? *alpha_a : 255),
-                            step);
-        *dest = sample_mix(*dest, *src++, mix);
-        dest++;
-        *dest = sample_mix(*dest, *src++, mix);
-        dest++;
-        if (alpha_a)
-            *alpha_a++ = mix >> 8;
-        if (alpha_b)
-            alpha_b++;
-    }
+/** The same without the SIMD code, for comparing the results.
+*/
+
+static void composite_line_yuv_c(uint8_t *dest,
+                                 uint8_t *src,
+                                 int width,
+                                 uint8_t *alpha_b,
+                                 uint8_t *alpha_a,
+                                 int weight,
+                                 uint16_t *luma,
+                                 int soft,
+                                 uint32_t step)
+{
+    composite_line_yuv_op(dest,
+                          src,
+                          width,
+                          alpha_b,
+                          alpha_a,
+                          weight,
+                          luma,
+                          soft,
+                          step,
+                          composite_op_over,
+                          0);
+}
+
+static void composite_line_yuv_or_c(uint8_t *dest,
+                                    uint8_t *src,
+                                    int width,
+                                    uint8_t *alpha_b,
+                                    uint8_t *alpha_a,
+                                    int weight,
+                                    uint16_t *luma,
+                                    int soft,
+                                    uint32_t step)
+{
+    composite_line_yuv_op(dest,
+                          src,
+                          width,
+                          alpha_b,
+                          alpha_a,
+                          weight,
+                          luma,
+                          soft,
+                          step,
+                          composite_op_or,
+                          0);
+}
+
+static void composite_line_yuv_and_c(uint8_t *dest,
+                                     uint8_t *src,
+                                     int width,
+                                     uint8_t *alpha_b,
+                                     uint8_t *alpha_a,
+                                     int weight,
+                                     uint16_t *luma,
+                                     int soft,
+                                     uint32_t step)
+{
+    composite_line_yuv_op(dest,
+                          src,
+                          width,
+                          alpha_b,
+                          alpha_a,
+                          weight,
+                          luma,
+                          soft,
+                          step,
+                          composite_op_and,
+                          0);
+}
+
+static void composite_line_yuv_xor_c(uint8_t *dest,
+                                     uint8_t *src,
+                                     int width,
+                                     uint8_t *alpha_b,
+                                     uint8_t *alpha_a,
+                                     int weight,
+                                     uint16_t *luma,
+                                     int soft,
+                                     uint32_t step)
+{
+    composite_line_yuv_op(dest,
+                          src,
+                          width,
+                          alpha_b,
+                          alpha_a,
+                          weight,
+                          luma,
+                          soft,
+                          step,
+                          composite_op_xor,
+                          0);
 }
 
 struct sliced_composite_desc
@@ -299,17 +432,27 @@ static int sliced_composite_proc(int id, int idx, int jobs, void *cookie)
     struct sliced_composite_desc ctx = *((struct sliced_composite_desc *) cookie);
     int i, ho, hs = mlt_slices_size_slice(jobs, idx, ctx.height_src, &ho);
 
-    for (i = 0; i < ctx.height_src; i += ctx.step) {
-        if (i >= ho && i < (ho + hs))
-            ctx.line_fn(ctx.p_dest,
-                        ctx.p_src,
-                        ctx.width_src,
-                        ctx.alpha_b,
-                        ctx.alpha_a,
-                        ctx.weight,
-                        ctx.p_luma,
-                        ctx.i_softness,
-                        ctx.luma_step);
+    // Start at the first line of this slice instead of walking every line before it
+    int lines = (ho + ctx.step - 1) / ctx.step;
+    ctx.p_src += lines * ctx.stride_src;
+    ctx.p_dest += lines * ctx.stride_dest;
+    if (ctx.alpha_b)
+        ctx.alpha_b += lines * ctx.alpha_b_stride;
+    if (ctx.alpha_a)
+        ctx.alpha_a += lines * ctx.alpha_a_stride;
+    if (ctx.p_luma)
+        ctx.p_luma += lines * ctx.alpha_b_stride;
+
+    for (i = lines * ctx.step; i < ho + hs && i < ctx.height_src; i += ctx.step) {
+        ctx.line_fn(ctx.p_dest,
+                    ctx.p_src,
+                    ctx.width_src,
+                    ctx.alpha_b,
+                    ctx.alpha_a,
+                    ctx.weight,
+                    ctx.p_luma,
+                    ctx.i_softness,
+                    ctx.luma_step);
 
         ctx.p_src += ctx.stride_src;
         ctx.p_dest += ctx.stride_dest;
@@ -491,34 +634,6 @@ static int composite_yuv(uint8_t *p_dest,
     return ret;
 }
 
-/** Scale 16bit greyscale luma map using nearest neighbor.
-*/
-
-static inline void scale_luma(uint16_t *dest_buf,
-                              int dest_width,
-                              int dest_height,
-                              const uint16_t *src_buf,
-                              int src_width,
-                              int src_height,
-                              int invert)
-{
-    register int i, j;
-    register int x_step = (src_width << 16) / dest_width;
-    register int y_step = (src_height << 16) / dest_height;
-    register int x, y = 0;
-
-    for (i = 0; i < dest_height; i++) {
-        const uint16_t *src = src_buf + (y >> 16) * src_width;
-        x = 0;
-
-        for (j = 0; j < dest_width; j++) {
-            *dest_buf++ = src[x >> 16] ^ invert;
-            x += x_step;
-        }
-        y += y_step;
-    }
-}
-
 static uint16_t *get_luma(mlt_transition self, mlt_properties properties, int width, int height)
 {
     // The cached luma map information
@@ -569,38 +684,84 @@ static uint16_t *get_luma(mlt_transition self, mlt_properties properties, int wi
         if (old_luma && old_luma[0]) {
             mlt_properties_set_data(properties, "_luma.orig_bitmap", NULL, 0, NULL, NULL);
             mlt_properties_set_data(properties, "_luma.bitmap", NULL, 0, NULL, NULL);
+            mlt_properties_clear(properties, "_luma.map");
             luma_bitmap = NULL;
             mlt_properties_set(properties, "_luma", NULL);
         }
     }
 
-    if (resource && resource[0]
+    char *extension = resource ? strrchr(resource, '.') : NULL;
+    if (resource && resource[0] && extension && !strcmp(extension, ".pgm")
         && (luma_bitmap == NULL || luma_width != width || luma_height != height)) {
+        // PGM and generated maps are shared with other transitions
+        luma_map_cache_item map
+            = luma_map_cache_get(profile, resource, orig_resource, width, height, invert);
+        luma_bitmap = map ? map->bitmap : NULL;
+        if (map && map == mlt_properties_get_data(properties, "_luma.map", NULL))
+            luma_map_cache_release(map);
+        else
+            mlt_properties_set_data(properties,
+                                    "_luma.map",
+                                    map,
+                                    0,
+                                    (mlt_destructor) luma_map_cache_release,
+                                    NULL);
+        mlt_properties_set_data(properties, "_luma.bitmap", luma_bitmap, 0, NULL, NULL);
+        mlt_properties_set_int(properties, "_luma.width", width);
+        mlt_properties_set_int(properties, "_luma.height", height);
+        mlt_properties_set(properties, "_luma", resource);
+        mlt_properties_set_int(properties, "_luma_invert", invert);
+    } else if (resource && resource[0]
+               && (luma_bitmap == NULL || luma_width != width || luma_height != height)) {
         uint16_t *orig_bitmap = mlt_properties_get_data(properties, "_luma.orig_bitmap", NULL);
         luma_width = mlt_properties_get_int(properties, "_luma.orig_width");
         luma_height = mlt_properties_get_int(properties, "_luma.orig_height");
 
         // Load the original luma once
         if (orig_bitmap == NULL) {
-            char *extension = strrchr(resource, '.');
-
-            // See if it is a PGM
-            int lumaLoaded = 0;
-            if (extension != NULL && strcmp(extension, ".pgm") == 0) {
-                // Load from PGM
-                if (mlt_luma_map_from_pgm(resource, &orig_bitmap, &luma_width, &luma_height)) {
-                    // Failed to read file; generate it.
-                    mlt_luma_map luma = mlt_luma_map_new(orig_resource);
-                    if (profile) {
-                        luma->w = profile->width;
-                        luma->h = profile->height;
-                    }
-                    luma_bitmap = mlt_luma_map_render(luma);
-                    luma_width = luma->w;
-                    luma_height = luma->h;
-                    free(luma);
-                }
-                if (luma_width > 0 && luma_height > 0) {
+            // Get the factory producer service
+            char *factory = mlt_properties_get(properties, "factory");
+
+            // Create the producer
+            mlt_producer producer = mlt_factory_producer(profile, factory, resource);
+
+            // If we have one
+            if (producer != NULL) {
+                // Get the producer properties
+                mlt_properties producer_properties = MLT_PRODUCER_PROPERTIES(producer);
+
+                // Ensure that we loop
+                mlt_properties_set(producer_properties, "eof", "loop");
+
+                // Now pass all producer. properties on the transition down
+                mlt_properties_pass(producer_properties, properties, "luma.");
+
+                // We will get the alpha frame from the producer
+                mlt_frame luma_frame = NULL;
+
+                // Get the luma frame
+                if (mlt_service_get_frame(MLT_PRODUCER_SERVICE(producer), &luma_frame, 0) == 0) {
+                    uint8_t *luma_image;
+                    mlt_image_format luma_format = mlt_image_yuv422;
+
+                    // Get image from the luma producer
+                    mlt_properties_set(MLT_FRAME_PROPERTIES(luma_frame),
+                                       "consumer.rescale",
+                                       "none");
+                    mlt_frame_get_image(luma_frame,
+                                        &luma_image,
+                                        &luma_format,
+                                        &luma_width,
+                                        &luma_height,
+                                        0);
+
+                    // Generate the luma map
+                    if (luma_image != NULL && luma_format == mlt_image_yuv422)
+                        mlt_luma_map_from_yuv422(luma_image,
+                                                 &orig_bitmap,
+                                                 luma_width,
+                                                 luma_height);
+
                     // Remember the original size for subsequent scaling
                     mlt_properties_set_data(properties,
                                             "_luma.orig_bitmap",
@@ -610,85 +771,28 @@ static uint16_t *get_luma(mlt_transition self, mlt_properties properties, int wi
                                             NULL);
                     mlt_properties_set_int(properties, "_luma.orig_width", luma_width);
                     mlt_properties_set_int(properties, "_luma.orig_height", luma_height);
-                    lumaLoaded = 1;
-                }
-            }
-            if (!lumaLoaded) {
-                // Get the factory producer service
-                char *factory = mlt_properties_get(properties, "factory");
-
-                // Create the producer
-                mlt_producer producer = mlt_factory_producer(profile, factory, resource);
-
-                // If we have one
-                if (producer != NULL) {
-                    // Get the producer properties
-                    mlt_properties producer_properties = MLT_PRODUCER_PROPERTIES(producer);
-
-                    // Ensure that we loop
-                    mlt_properties_set(producer_properties, "eof", "loop");
-
-                    // Now pass all producer. properties on the transition down
-                    mlt_properties_pass(producer_properties, properties, "luma.");
-
-                    // We will get the alpha frame from the producer
-                    mlt_frame luma_frame = NULL;
-
-                    // Get the luma frame
-                    if (mlt_service_get_frame(MLT_PRODUCER_SERVICE(producer), &luma_frame, 0) == 0) {
-                        uint8_t *luma_image;
-                        mlt_image_format luma_format = mlt_image_yuv422;
-
-                        // Get image from the luma producer
-                        mlt_properties_set(MLT_FRAME_PROPERTIES(luma_frame),
-                                           "consumer.rescale",
-                                           "none");
-                        mlt_frame_get_image(luma_frame,
-                                            &luma_image,
-                                            &luma_format,
-                                            &luma_width,
-                                            &luma_height,
-                                            0);
-
-                        // Generate the luma map
-                        if (luma_image != NULL && luma_format == mlt_image_yuv422)
-                            mlt_luma_map_from_yuv422(luma_image,
-                                                     &orig_bitmap,
-                                                     luma_width,
-                                                     luma_height);
-
-                        // Remember the original size for subsequent scaling
-                        mlt_properties_set_data(properties,
-                                                "_luma.orig_bitmap",
-                                                orig_bitmap,
-                                                luma_width * luma_height * 2,
-                                                mlt_pool_release,
-                                                NULL);
-                        mlt_properties_set_int(properties, "_luma.orig_width", luma_width);
-                        mlt_properties_set_int(properties, "_luma.orig_height", luma_height);
-
-                        // Cleanup the luma frame
-                        mlt_frame_close(luma_frame);
-                    }
-
-                    // Cleanup the luma producer
-                    mlt_producer_close(producer);
-                } else {
-                    luma_width = 0;
-                    luma_height = 0;
+
+                    // Cleanup the luma frame
+                    mlt_frame_close(luma_frame);
                 }
+
+                // Cleanup the luma producer
+                mlt_producer_close(producer);
+            } else {
+                luma_width = 0;
+                luma_height = 0;
             }
         }
         if (orig_bitmap && luma_width > 0 && luma_height > 0) {
             // Scale luma map
             luma_bitmap = mlt_pool_alloc(width * height * sizeof(uint16_t));
-            scale_luma(luma_bitmap,
-                       width,
-                       height,
-                       orig_bitmap,
-                       luma_width,
-                       luma_height,
-                       invert * ((1 << 16) - 1));
+            luma_map_scale(luma_bitmap,
+                           width,
+                           height,
+                           orig_bitmap,
+                           luma_width,
+                           luma_height,
+                           invert * ((1 << 16) - 1));
 
             // Remember the scaled luma size to prevent unnecessary scaling
             mlt_properties_set_int(properties, "_luma.width", width);
@@ -701,6 +805,7 @@ static uint16_t *get_luma(mlt_transition self, mlt_properties properties, int wi
                                     NULL);
             mlt_properties_set(properties, "_luma", resource);
             mlt_properties_set_int(properties, "_luma_invert", invert);
+            mlt_properties_clear(properties, "_luma.map");
         }
     }
     return luma_bitmap;
@@ -1082,16 +1187,17 @@ static int transition_get_image(mlt_frame a_frame,
 
             alpha_b = alpha_b == NULL ? mlt_frame_get_alpha(b_frame) : alpha_b;
 
-            composite_line_fn line_fn = composite_line_yuv;
+            int simd = mlt_properties_get_int(properties, "simd");
+            composite_line_fn line_fn = simd ? composite_line_yuv : composite_line_yuv_c;
 
             // Replacement and override
             if (operator!= NULL) {
                 if (!strcmp(operator, "or"))
-                    line_fn = composite_line_yuv_or;
+                    line_fn = simd ? composite_line_yuv_or : composite_line_yuv_or_c;
                 if (!strcmp(operator, "and"))
-                    line_fn = composite_line_yuv_and;
+                    line_fn = simd ? composite_line_yuv_and : composite_line_yuv_and_c;
                 if (!strcmp(operator, "xor"))
-                    line_fn = composite_line_yuv_xor;
+                    line_fn = simd ? composite_line_yuv_xor : composite_line_yuv_xor_c;
             }
 
             // Allow the user to completely obliterate the alpha channels from both frames
@@ -1223,6 +1329,9 @@ mlt_transition transition_composite_init(mlt_profile profile,
         // Default to progressive rendering
         mlt_properties_set_int(properties, "progressive", 1);
 
+        // Use the SIMD code when built with it
+        mlt_properties_set_int(properties, "simd", 1);
+
         // Inform apps and framework that this is a video only transition
         mlt_properties_set_int(properties, "_transition_type", 1);
     }
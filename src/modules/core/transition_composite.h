@@ -27,6 +27,16 @@ extern mlt_transition transition_composite_init(mlt_profile profile,
                                                 const char *id,
                                                 char *arg);
 
+/** The ways to combine the alpha channels of the a and b frames.
+*/
+
+enum composite_op {
+    composite_op_over, ///< alpha_b is used and alpha_a accumulates the mix
+    composite_op_or,
+    composite_op_and,
+    composite_op_xor
+};
+
 extern void composite_line_yuv(uint8_t *dest,
                                uint8_t *src,
                                int width,
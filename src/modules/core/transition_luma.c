@@ -23,6 +23,7 @@
 #include <framework/mlt.h>
 #include <framework/mlt_luma_map.h>
 
+#include "luma_map_cache.h"
 #include "transition_composite.h"
 #include <ctype.h>
 #include <limits.h>
@@ -441,20 +442,12 @@ static int transition_get_image(mlt_frame a_frame,
 
         // See if it is a PGM
         if (extension != NULL && strcmp(extension, ".pgm") == 0) {
-            // Load from PGM
-            luma_bitmap = NULL;
-            if (mlt_luma_map_from_pgm(resource, &luma_bitmap, &luma_width, &luma_height)) {
-                // Failed to read file; generate it.
-                mlt_luma_map luma = mlt_luma_map_new(orig_resource);
-                if (profile) {
-                    luma->w = profile->width;
-                    luma->h = profile->height;
-                }
-                luma_bitmap = mlt_luma_map_render(luma);
-                luma_width = luma->w;
-                luma_height = luma->h;
-                free(luma);
-            }
+            // Get the map loaded from PGM or generated, shared with other transitions
+            luma_map_cache_item map
+                = luma_map_cache_get(profile, resource, orig_resource, 0, 0, 0);
+            luma_bitmap = map ? map->bitmap : NULL;
+            luma_width = map ? map->width : 0;
+            luma_height = map ? map->height : 0;
 
             // Set the transition properties
             mlt_properties_set_int(properties, "width", luma_width);
@@ -464,15 +457,31 @@ static int transition_get_image(mlt_frame a_frame,
                                     "bitmap",
                                     luma_bitmap,
                                     luma_width * luma_height * 2,
-                                    mlt_pool_release,
+                                    NULL,
                                     NULL);
+            if (map && map == mlt_properties_get_data(properties, "_map", NULL))
+                luma_map_cache_release(map);
+            else
+                mlt_properties_set_data(properties,
+                                        "_map",
+                                        map,
+                                        0,
+                                        (mlt_destructor) luma_map_cache_release,
+                                        NULL);
             mlt_properties_clear(properties, "producer");
         } else if (!*resource) {
             luma_bitmap = NULL;
             mlt_properties_set(properties, "_resource", NULL);
             mlt_properties_set_data(properties, "bitmap", luma_bitmap, 0, mlt_pool_release, NULL);
+            mlt_properties_clear(properties, "_map");
             mlt_properties_clear(properties, "producer");
         } else {
+            // Stop using a shared map
+            if (mlt_properties_get_data(properties, "_map", NULL)) {
+                luma_bitmap = NULL;
+                mlt_properties_set_data(properties, "bitmap", NULL, 0, NULL, NULL);
+                mlt_properties_clear(properties, "_map");
+            }
             if (!producer || !current_resource || strcmp(resource, current_resource)) {
                 // Get the factory producer service
                 char *factory = mlt_properties_get(properties, "factory");
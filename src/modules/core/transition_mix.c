@@ -42,59 +42,6 @@ typedef struct transition_mix_s
     mlt_position previous_frame_b;
 } * transition_mix;
 
-static void mix_audio(double weight_start,
-                      double weight_end,
-                      float *buffer_a,
-                      float *buffer_b,
-                      int channels_a,
-                      int channels_b,
-                      int channels_out,
-                      int samples)
-{
-    int i, j;
-    double a, b, v;
-
-    // Compute a smooth ramp over start to end
-    double mix = weight_start;
-    double mix_step = (weight_end - weight_start) / samples;
-
-    for (i = 0; i < samples; i++) {
-        for (j = 0; j < channels_out; j++) {
-            a = (double) buffer_a[i * channels_a + j];
-            b = (double) buffer_b[i * channels_b + j];
-            v = mix * b + (1.0 - mix) * a;
-            buffer_a[i * channels_a + j] = v;
-        }
-        mix += mix_step;
-    }
-}
-
-static void sum_audio(double weight_start,
-                      double weight_end,
-                      float *buffer_a,
-                      float *buffer_b,
-                      int channels_a,
-                      int channels_b,
-                      int channels_out,
-                      int samples)
-{
-    int i, j;
-    double a, b;
-
-    // Compute a smooth ramp over start to end
-    double mix = weight_start;
-    double mix_step = (weight_end - weight_start) / samples;
-
-    for (i = 0; i < samples; i++) {
-        for (j = 0; j < channels_out; j++) {
-            a = (double) buffer_a[i * channels_a + j];
-            b = (double) buffer_b[i * channels_b + j];
-            buffer_a[i * channels_a + j] = mix * b + a;
-        }
-        mix += mix_step;
-    }
-}
-
 // This filter uses an inline low pass filter to allow mixing without volume hacking.
 static void combine_audio(double weight,
                           float *buffer_a,
@@ -189,9 +136,9 @@ static int transition_get_audio(mlt_frame frame_a,
     *samples = MIN(samples_a, samples_b);
     *channels = MIN(MIN(channels_b, channels_a), MAX_CHANNELS);
     *frequency = frequency_a;
-    // Note this direct call to sum_audio() skips ramping and the alternative
+    // Note this direct call to mlt_audio_sum_float() skips ramping and the alternative
     // mixing methods.
-    sum_audio(1, 1, buffer_a, buffer_b, channels_a, channels_b, *channels, *samples);
+    mlt_audio_sum_float(buffer_a, buffer_b, channels_a, channels_b, *channels, *samples, 1, 1);
     *buffer = buffer_a;
 
     return error;
@@ -264,7 +211,8 @@ static int transition_get_audio(mlt_frame frame_a,
             mix_start = 1.0 - mix_start;
             mix_end = 1.0 - mix_end;
         }
-        sum_audio(mix_start, mix_end, buffer_a, buffer_b, channels_a, channels_b, *channels, *samples);
+        mlt_audio_sum_float(
+            buffer_a, buffer_b, channels_a, channels_b, *channels, *samples, mix_start, mix_end);
     } else if (mlt_properties_get_int(MLT_TRANSITION_PROPERTIES(transition), "combine")) {
         double weight = 1.0;
         if (mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame_a), "meta.mixdown"))
@@ -280,7 +228,8 @@ static int transition_get_audio(mlt_frame frame_a,
             mix_start = 1.0 - mix_start;
             mix_end = 1.0 - mix_end;
         }
-        mix_audio(mix_start, mix_end, buffer_a, buffer_b, channels_a, channels_b, *channels, *samples);
+        mlt_audio_mix_float(
+            buffer_a, buffer_b, channels_a, channels_b, *channels, *samples, mix_start, mix_end);
     }
 
     // Copy the audio from the dest buffer into the frame.
@@ -19,24 +19,172 @@
  */
 #include "frei0r_helper.h"
 #include <frei0r.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
-#ifdef _WIN32
-#include <windows.h>
+#ifdef USE_SSE2
+#include <emmintrin.h>
 #endif
 
 const char *CAIROBLEND_MODE_PROPERTY = "frei0r.cairoblend.mode";
 
+// The most instances of a plugin that a service keeps at once
+#define MAX_INSTANCES (16)
+
+// Idle instances that have not been used for this many updates are destroyed
+#define IDLE_UPDATES (100)
+
+typedef struct
+{
+    f0r_instance_t instance;
+    int width;
+    int height;
+    int busy;
+    unsigned int last_update;
+} instance_slot;
+
+/** A bounded set of plugin instances that the threads check out for each update.
+ */
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    void (*f0r_destruct)(f0r_instance_t instance);
+    unsigned int updates;
+    instance_slot slots[MAX_INSTANCES];
+} instance_pool;
+
+static void instance_pool_close(instance_pool *pool)
+{
+    int i;
+    for (i = 0; i < MAX_INSTANCES; i++) {
+        if (pool->slots[i].instance)
+            pool->f0r_destruct(pool->slots[i].instance);
+    }
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+static instance_pool *instance_pool_get(mlt_properties prop)
+{
+    instance_pool *pool = mlt_properties_get_data(prop, "_instance_pool", NULL);
+    if (!pool) {
+        pool = calloc(1, sizeof(*pool));
+        pthread_mutex_init(&pool->mutex, NULL);
+        pthread_cond_init(&pool->cond, NULL);
+        pool->f0r_destruct = mlt_properties_get_data(prop, "f0r_destruct", NULL);
+        mlt_properties_set_data(prop,
+                                "_instance_pool",
+                                pool,
+                                0,
+                                (mlt_destructor) instance_pool_close,
+                                NULL);
+    }
+    return pool;
+}
+
+/** Take an instance of the given size out of the pool.
+ *
+ * An idle instance of the right size is preferred, then an idle instance of
+ * another size, which is rebuilt, and then an empty slot. When every slot is
+ * busy this waits for an instance to be returned.
+ */
+
+static instance_slot *instance_pool_checkout(instance_pool *pool,
+                                             f0r_instance_t (*f0r_construct)(unsigned int,
+                                                                             unsigned int),
+                                             int width,
+                                             int height)
+{
+    instance_slot *slot = NULL;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!slot) {
+        instance_slot *empty = NULL;
+        instance_slot *other = NULL;
+        int i;
+        for (i = 0; i < MAX_INSTANCES; i++) {
+            instance_slot *candidate = &pool->slots[i];
+            if (candidate->busy)
+                continue;
+            if (!candidate->instance) {
+                if (!empty)
+                    empty = candidate;
+            } else if (candidate->width == width && candidate->height == height) {
+                slot = candidate;
+                break;
+            } else if (!other || candidate->last_update < other->last_update) {
+                other = candidate;
+            }
+        }
+        if (!slot) {
+            slot = other ? other : empty;
+            if (slot) {
+                if (slot->instance)
+                    pool->f0r_destruct(slot->instance);
+                slot->instance = f0r_construct(width, height);
+                slot->width = width;
+                slot->height = height;
+            } else {
+                pthread_cond_wait(&pool->cond, &pool->mutex);
+            }
+        }
+    }
+    slot->busy = 1;
+    slot->last_update = ++pool->updates;
+    pthread_mutex_unlock(&pool->mutex);
+    return slot;
+}
+
+/** Return an instance to the pool and destroy the instances that have been idle for long.
+ */
+
+static void instance_pool_checkin(instance_pool *pool, instance_slot *slot)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+    slot->busy = 0;
+    for (i = 0; i < MAX_INSTANCES; i++) {
+        instance_slot *idle = &pool->slots[i];
+        if (!idle->busy && idle->instance && pool->updates - idle->last_update > IDLE_UPDATES) {
+            pool->f0r_destruct(idle->instance);
+            idle->instance = NULL;
+        }
+    }
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
 static void rgba_bgra(uint8_t *src, uint8_t *dst, int width, int height)
 {
-    int n = width * height + 1;
-
-    while (--n) {
-        *dst++ = src[2];
-        *dst++ = src[1];
-        *dst++ = src[0];
-        *dst++ = src[3];
-        src += 4;
+    const uint32_t *in = (const uint32_t *) src;
+    uint32_t *out = (uint32_t *) dst;
+    int n = width * height;
+    int i = 0;
+
+#ifdef USE_SSE2
+    const __m128i ga_mask = _mm_set1_epi32(0xff00ff00);
+    const __m128i rb_mask = _mm_set1_epi32(0x00ff00ff);
+    for (; i + 4 <= n; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (in + i));
+        __m128i rb = _mm_and_si128(pixels, rb_mask);
+        rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+        _mm_storeu_si128((__m128i *) (out + i),
+                         _mm_or_si128(_mm_and_si128(pixels, ga_mask), rb));
+    }
+#endif
+    // Swap the first and third bytes of the remaining pixels
+    for (; i < n; i++) {
+        uint8_t *pixel = (uint8_t *) (in + i);
+        uint8_t *swapped = (uint8_t *) (out + i);
+        uint8_t first = pixel[0];
+        swapped[0] = pixel[2];
+        swapped[1] = pixel[1];
+        swapped[2] = first;
+        swapped[3] = pixel[3];
     }
 }
 
@@ -139,42 +287,21 @@ int process_frei0r_item(mlt_service service,
     }
     int slice_height = *height / slice_count;
 
-    // Use width and height in the frei0r instance key
-    char ctorname[1024] = "";
-    if (not_thread_safe)
-        sprintf(ctorname, "_ctor-");
-    else
-#ifdef _WIN32
-        sprintf(ctorname, "_ctor-%lu", GetCurrentThreadId());
-#else
-        sprintf(ctorname, "_ctor-%p", (void *) pthread_self());
-#endif
-
     mlt_service_lock(service);
+    instance_pool *pool = instance_pool_get(prop);
 
-    mlt_properties ctor = mlt_properties_get_data(prop, ctorname, NULL);
-    if (!ctor || mlt_properties_get_int(ctor, "width") != *width
-        || mlt_properties_get_int(ctor, "height") != slice_height) {
-        mlt_properties_clear(prop, ctorname);
-        ctor = mlt_properties_new();
-        f0r_instance_t new_inst = f0r_construct(*width, slice_height);
-        mlt_properties_set_int(ctor, "width", *width);
-        mlt_properties_set_int(ctor, "height", slice_height);
-        mlt_properties_set_data(ctor,
-                                "inst",
-                                new_inst,
-                                0,
-                                mlt_properties_get_data(prop, "f0r_destruct", NULL),
-                                NULL);
-        mlt_properties_set_data(prop, ctorname, ctor, 0, (mlt_destructor) mlt_properties_close, NULL);
-    }
-    f0r_instance_t inst = mlt_properties_get_data(ctor, "inst", NULL);
-    if (!inst) {
+    // Not thread safe plugins keep the service locked until the update is done
+    if (!not_thread_safe)
         mlt_service_unlock(service);
+
+    instance_slot *slot = instance_pool_checkout(pool, f0r_construct, *width, slice_height);
+    f0r_instance_t inst = slot->instance;
+    if (!inst) {
+        instance_pool_checkin(pool, slot);
+        if (not_thread_safe)
+            mlt_service_unlock(service);
         return -1;
     }
-    if (!not_thread_safe && slice_count == 1)
-        mlt_service_unlock(service);
 
     f0r_plugin_info_t info;
     memset(&info, 0, sizeof(info));
@@ -318,7 +445,8 @@ int process_frei0r_item(mlt_service service,
             f0r_update2(inst, time, source[0], source[1], NULL, dest);
         }
     }
-    if (not_thread_safe || slice_count != 1)
+    instance_pool_checkin(pool, slot);
+    if (not_thread_safe)
         mlt_service_unlock(service);
     if (info.color_model == F0R_COLOR_MODEL_BGRA8888) {
         rgba_bgra((uint8_t *) dest, (uint8_t *) result, *width, *height);
@@ -334,16 +462,13 @@ int process_frei0r_item(mlt_service service,
 void destruct(mlt_properties prop)
 {
     void (*f0r_deinit)(void) = mlt_properties_get_data(prop, "f0r_deinit", NULL);
-    int i = 0;
+
+    // Destroy the instances before the plugin is deinitialized
+    mlt_properties_clear(prop, "_instance_pool");
 
     if (f0r_deinit)
         f0r_deinit();
 
-    for (i = 0; i < mlt_properties_count(prop); i++) {
-        if (strstr(mlt_properties_get_name(prop, i), "_ctor-")) {
-            mlt_properties_clear(prop, mlt_properties_get_name(prop, i));
-        }
-    }
     void (*dlclose)(void *) = mlt_properties_get_data(prop, "_dlclose", NULL);
     void *handle = mlt_properties_get_data(prop, "_dlclose_handle", NULL);
 
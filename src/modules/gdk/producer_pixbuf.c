@@ -42,6 +42,27 @@
 // this protects concurrent access to gdk_pixbuf
 static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+#define PYRAMID_COUNT (16)
+#define PYRAMID_LEVELS (8)
+#define PYRAMID_CACHE_SIZE (256 * 1024 * 1024)
+
+/** Halved copies of a source image, shared by all of the producers (protected by g_mutex).
+ */
+
+typedef struct
+{
+    char *key;
+    int width;
+    int height;
+    GdkPixbuf *levels[PYRAMID_LEVELS]; // level i is the source scaled down by 2^(i + 1)
+    int64_t bytes;
+    int64_t last_used;
+} pyramid_s;
+
+static pyramid_s g_pyramids[PYRAMID_COUNT];
+static int64_t g_pyramids_bytes = 0;
+static int64_t g_pyramids_clock = 0;
+
 typedef struct producer_pixbuf_s *producer_pixbuf;
 
 struct producer_pixbuf_s
@@ -549,6 +570,113 @@ static int refresh_pixbuf(producer_pixbuf self, mlt_frame frame)
     return current_idx;
 }
 
+static void pyramid_clear(pyramid_s *pyramid)
+{
+    int i;
+    for (i = 0; i < PYRAMID_LEVELS; i++) {
+        if (pyramid->levels[i])
+            g_object_unref(pyramid->levels[i]);
+    }
+    free(pyramid->key);
+    g_pyramids_bytes -= pyramid->bytes;
+    memset(pyramid, 0, sizeof(*pyramid));
+}
+
+/** Find or create the pyramid of a source image. Must be called with g_mutex held.
+ */
+
+static pyramid_s *pyramid_get(const char *key, GdkPixbuf *source)
+{
+    int width = gdk_pixbuf_get_width(source);
+    int height = gdk_pixbuf_get_height(source);
+    pyramid_s *result = NULL;
+    int i;
+
+    for (i = 0; i < PYRAMID_COUNT && !result; i++) {
+        pyramid_s *pyramid = &g_pyramids[i];
+        if (pyramid->key && !strcmp(pyramid->key, key)) {
+            if (pyramid->width != width || pyramid->height != height)
+                pyramid_clear(pyramid);
+            else
+                result = pyramid;
+        }
+    }
+    if (!result) {
+        // Reuse a free slot or the least recently used one
+        result = &g_pyramids[0];
+        for (i = 1; i < PYRAMID_COUNT && result->key; i++) {
+            if (!g_pyramids[i].key || g_pyramids[i].last_used < result->last_used)
+                result = &g_pyramids[i];
+        }
+        pyramid_clear(result);
+        result->key = strdup(key);
+        result->width = width;
+        result->height = height;
+    }
+    result->last_used = ++g_pyramids_clock;
+    return result;
+}
+
+/** Release the least recently used pyramids until the cache fits its size.
+ */
+
+static void pyramid_trim(pyramid_s *keep)
+{
+    while (g_pyramids_bytes > PYRAMID_CACHE_SIZE) {
+        pyramid_s *oldest = NULL;
+        int i;
+        for (i = 0; i < PYRAMID_COUNT; i++) {
+            pyramid_s *pyramid = &g_pyramids[i];
+            if (pyramid->key && pyramid != keep
+                && (!oldest || pyramid->last_used < oldest->last_used))
+                oldest = pyramid;
+        }
+        if (!oldest)
+            break;
+        pyramid_clear(oldest);
+    }
+}
+
+/** Scale a pixbuf starting from the smallest level of its pyramid that is still
+ * at least as large as the requested size. Must be called with g_mutex held.
+ *
+ * The levels are halved with bilinear filtering, which averages 2x2 blocks like
+ * tiles does. Hyper keeps scaling the source image to get its own filter.
+ */
+
+static GdkPixbuf *scale_pixbuf(const char *key, GdkPixbuf *source, int width, int height, int interp)
+{
+    GdkPixbuf *level = source;
+    int i;
+
+    if (key && (interp == GDK_INTERP_BILINEAR || interp == GDK_INTERP_TILES)
+        && width * 2 <= gdk_pixbuf_get_width(source)
+        && height * 2 <= gdk_pixbuf_get_height(source)) {
+        pyramid_s *pyramid = pyramid_get(key, source);
+        for (i = 0; i < PYRAMID_LEVELS; i++) {
+            int level_width = gdk_pixbuf_get_width(level) / 2;
+            int level_height = gdk_pixbuf_get_height(level) / 2;
+            if (level_width < width || level_height < height)
+                break;
+            if (!pyramid->levels[i]) {
+                pyramid->levels[i] = gdk_pixbuf_scale_simple(level,
+                                                             level_width,
+                                                             level_height,
+                                                             GDK_INTERP_BILINEAR);
+                if (!pyramid->levels[i])
+                    break;
+                int64_t bytes = (int64_t) gdk_pixbuf_get_rowstride(pyramid->levels[i])
+                                * level_height;
+                pyramid->bytes += bytes;
+                g_pyramids_bytes += bytes;
+            }
+            level = pyramid->levels[i];
+        }
+        pyramid_trim(pyramid);
+    }
+    return gdk_pixbuf_scale_simple(level, width, height, interp);
+}
+
 static void refresh_image(
     producer_pixbuf self, mlt_frame frame, mlt_image_format format, int width, int height)
 {
@@ -590,9 +718,21 @@ static void refresh_image(
             interp = GDK_INTERP_HYPER;
         free(interps);
 
+        // Identify the source image to share its pyramid with other producers
+        char *key = NULL;
+        const char *filename = mlt_properties_get_value(self->filenames, current_idx);
+        struct stat file_info;
+        if (filename && !stat(filename, &file_info))
+            key = g_strdup_printf("%s:%ld:%d",
+                                  filename,
+                                  (long) file_info.st_mtime,
+                                  mlt_properties_get_int(MLT_PRODUCER_PROPERTIES(producer),
+                                                         "disable_exif"));
+
         // Note - the original pixbuf is already safe and ready for destruction
         pthread_mutex_lock(&g_mutex);
-        GdkPixbuf *pixbuf = gdk_pixbuf_scale_simple(self->pixbuf, width, height, interp);
+        GdkPixbuf *pixbuf = scale_pixbuf(key, self->pixbuf, width, height, interp);
+        g_free(key);
 
         // Store width and height
         self->width = width;
@@ -22,6 +22,8 @@
 #include <limits>
 #include <opencv2/core/version.hpp>
 #include <opencv2/tracking.hpp>
+#include <pthread.h>
+#include <vector>
 
 #define CV_VERSION_INT (CV_VERSION_MAJOR << 16 | CV_VERSION_MINOR << 8 | CV_VERSION_REVISION)
 
@@ -55,15 +57,50 @@ typedef struct
     mlt_position producer_in;
     mlt_position producer_length;
     bool legacyTracking;
+    std::vector<mlt_rect> *rects; // "results" by position, expanded once for direct lookups
+    bool rects_dirty;
+    struct tracker_job *job;
+    bool job_cancel;
+    bool job_failed;
 } private_data;
 
+/** Tracks the clip with a copy of its producer on a thread ahead of the playhead.
+ * The rects are in profile coordinates, indexed by filter position.
+ */
+
+struct tracker_job
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    mlt_filter filter;
+    mlt_profile profile;
+    mlt_producer producer;
+    mlt_position offset; // the producer position of the first frame of the filter
+    mlt_position first;  // the first valid rect, before from when kept from previous results
+    mlt_position from;
+    mlt_position end; // the rects are valid up to there
+    mlt_position length;
+    mlt_rect rect;
+    bool stop;
+    bool finished;
+    std::vector<mlt_rect> rects;
+};
+
 static void property_changed(mlt_service owner, mlt_filter filter, mlt_event_data event_data)
 {
     private_data *pdata = (private_data *) filter->child;
     mlt_properties filter_properties = MLT_FILTER_PROPERTIES(filter);
     const char *name = mlt_event_data_to_string(event_data);
 
+    if (name
+        && (!strcmp(name, "rect") || !strcmp(name, "algo") || !strcmp(name, "_reset")
+            || !strcmp(name, "analyze_ahead"))) {
+        // Let the image thread stop the tracking job
+        pdata->job_cancel = true;
+    }
     if (name && !strcmp(name, "results")) {
+        pdata->rects_dirty = true;
         mlt_properties_anim_get_int(filter_properties, "results", 0, -1);
         mlt_animation anim = mlt_properties_get_animation(filter_properties, "results");
         if (anim && mlt_animation_key_count(anim) > 0) {
@@ -104,11 +141,32 @@ static void property_changed(mlt_service owner, mlt_filter filter, mlt_event_dat
     }
 }
 
-static void apply(
-    mlt_filter filter, private_data *data, int width, int height, int position, int length)
+/** Get the result rect of a position in profile coordinates.
+ *
+ * The results are expanded to a rect per frame whenever they change so that playback and
+ * seeking do not need to interpolate the keyframes.
+ */
+
+static mlt_rect get_result(mlt_filter filter, private_data *data, int position, int length)
 {
     mlt_properties properties = MLT_FILTER_PROPERTIES(filter);
-    mlt_rect rect = mlt_properties_anim_get_rect(properties, "results", position, -1);
+
+    if (!data->rects)
+        data->rects = new std::vector<mlt_rect>;
+    if (data->rects_dirty || (int) data->rects->size() != MAX(length, 0)) {
+        data->rects->resize(MAX(length, 0));
+        for (int i = 0; i < length; i++)
+            (*data->rects)[i] = mlt_properties_anim_get_rect(properties, "results", i, -1);
+        data->rects_dirty = false;
+    }
+    if (position >= 0 && position < length)
+        return (*data->rects)[position];
+    return mlt_properties_anim_get_rect(properties, "results", position, -1);
+}
+
+static void set_bounding_box(
+    mlt_filter filter, private_data *data, int width, int height, mlt_rect rect)
+{
     mlt_profile profile = mlt_service_profile(MLT_FILTER_SERVICE(filter));
     // Calculate the region now
     double scale_width = mlt_profile_scale_width(profile, width);
@@ -123,217 +181,270 @@ static void apply(
     data->boundingBox.height = rect.h;
 }
 
-static void analyze(mlt_filter filter,
-                    cv::Mat cvFrame,
-                    private_data *data,
-                    int width,
-                    int height,
-                    int position,
-                    int length)
+static void apply(
+    mlt_filter filter, private_data *data, int width, int height, int position, int length)
 {
-    mlt_properties filter_properties = MLT_FILTER_PROPERTIES(filter);
-    if (data->analyse_width == -1) {
-        // Store analyze width/height
-        data->analyse_width = width;
-        data->analyse_height = height;
-    } else if (data->analyse_width != width || data->analyse_height != height) {
-        // Frame size changed, reset all stored data
-        data->initialized = false;
-        data->analyse_width = width;
-        data->analyse_height = height;
+    set_bounding_box(filter, data, width, height, get_result(filter, data, position, length));
+}
+
+static void clamp_bounding_box(private_data *data, int width, int height)
+{
+    if (data->boundingBox.x > width) {
+        data->boundingBox.x = width - 10;
+    } else {
+        data->boundingBox.x = MAX(0., data->boundingBox.x);
     }
-    // Create tracker and initialize it
-    if (!data->initialized) {
-        // Build tracker
-        data->tracker.reset();
+    if (data->boundingBox.y > height) {
+        data->boundingBox.y = height - 10;
+    } else {
+        data->boundingBox.y = MAX(0., data->boundingBox.y);
+    }
+    if (data->boundingBox.x + data->boundingBox.width > width) {
+        data->boundingBox.width = width - data->boundingBox.x;
+    }
+    if (data->boundingBox.y + data->boundingBox.height > height) {
+        data->boundingBox.height = height - data->boundingBox.y;
+    }
+}
+
+/** Create the tracker and initialize it with a rect given in profile coordinates.
+ * \return true if the tracker could be created
+ */
+
+static bool init_tracker(
+    mlt_filter filter, cv::Mat cvFrame, private_data *data, int width, int height, mlt_rect rect)
+{
+    mlt_properties filter_properties = MLT_FILTER_PROPERTIES(filter);
+
+    // Build tracker
+    data->tracker.reset();
 #if CV_VERSION_INT > 0x040502
-        data->legacyTracker.reset();
+    data->legacyTracker.reset();
 #endif
-        data->legacyTracking = false;
-        data->algo = mlt_properties_get(filter_properties, "algo");
+    data->legacyTracking = false;
+    data->algo = mlt_properties_get(filter_properties, "algo");
 #if CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 3)
-        if (!data->algo || *data->algo == '\0' || !strcmp(data->algo, "KCF")) {
-            data->tracker = cv::TrackerKCF::create();
-        } else if (!strcmp(data->algo, "MIL")) {
-            data->tracker = cv::TrackerMIL::create();
-        }
+    if (!data->algo || *data->algo == '\0' || !strcmp(data->algo, "KCF")) {
+        data->tracker = cv::TrackerKCF::create();
+    } else if (!strcmp(data->algo, "MIL")) {
+        data->tracker = cv::TrackerMIL::create();
+    }
 #if CV_VERSION_INT > 0x040502
-        else if (!strcmp(data->algo, "DaSIAM")) {
-            if (mlt_properties_exists(filter_properties, "modelsfolder")) {
-                char *modelsdir = mlt_properties_get(filter_properties, "modelsfolder");
-                cv::TrackerDaSiamRPN::Params parameters;
-                char *model1 = (char *) calloc(1, 1000);
-                char *model2 = (char *) calloc(1, 1000);
-                char *model3 = (char *) calloc(1, 1000);
-                strcat(model1, modelsdir);
-                strcat(model2, modelsdir);
-                strcat(model3, modelsdir);
-                strcat(model1, "/dasiamrpn_model.onnx");
-                strcat(model2, "/dasiamrpn_kernel_cls1.onnx");
-                strcat(model3, "/dasiamrpn_kernel_r1.onnx");
-                // Models can be downloaded from:
-                // - network:     https://www.dropbox.com/s/rr1lk9355vzolqv/dasiamrpn_model.onnx?dl=0
-                // - kernel_r1:   https://www.dropbox.com/s/999cqx5zrfi7w4p/dasiamrpn_kernel_r1.onnx?dl=0
-                // - kernel_cls1: https://www.dropbox.com/s/qvmtszx5h339a0w/dasiamrpn_kernel_cls1.onnx?dl=0
-                struct stat file_info;
-                if (mlt_stat(model1, &file_info) == 0 && mlt_stat(model2, &file_info) == 0
-                    && mlt_stat(model3, &file_info) == 0) {
-                    // Models found, process
-                    parameters.model = model1;
-                    parameters.kernel_cls1 = model2;
-                    parameters.kernel_r1 = model3;
-                    data->tracker = cv::TrackerDaSiamRPN::create(parameters);
-                } else {
-                    mlt_log_error(
-                        MLT_FILTER_SERVICE(filter),
-                        "DaSIAM models not found, please provide a modelsfolder parameter\n");
-                }
-                free(model1);
-                free(model2);
-                free(model3);
+    else if (!strcmp(data->algo, "DaSIAM")) {
+        if (mlt_properties_exists(filter_properties, "modelsfolder")) {
+            char *modelsdir = mlt_properties_get(filter_properties, "modelsfolder");
+            cv::TrackerDaSiamRPN::Params parameters;
+            char *model1 = (char *) calloc(1, 1000);
+            char *model2 = (char *) calloc(1, 1000);
+            char *model3 = (char *) calloc(1, 1000);
+            strcat(model1, modelsdir);
+            strcat(model2, modelsdir);
+            strcat(model3, modelsdir);
+            strcat(model1, "/dasiamrpn_model.onnx");
+            strcat(model2, "/dasiamrpn_kernel_cls1.onnx");
+            strcat(model3, "/dasiamrpn_kernel_r1.onnx");
+            // Models can be downloaded from:
+            // - network:     https://www.dropbox.com/s/rr1lk9355vzolqv/dasiamrpn_model.onnx?dl=0
+            // - kernel_r1:   https://www.dropbox.com/s/999cqx5zrfi7w4p/dasiamrpn_kernel_r1.onnx?dl=0
+            // - kernel_cls1: https://www.dropbox.com/s/qvmtszx5h339a0w/dasiamrpn_kernel_cls1.onnx?dl=0
+            struct stat file_info;
+            if (mlt_stat(model1, &file_info) == 0 && mlt_stat(model2, &file_info) == 0
+                && mlt_stat(model3, &file_info) == 0) {
+                // Models found, process
+                parameters.model = model1;
+                parameters.kernel_cls1 = model2;
+                parameters.kernel_r1 = model3;
+                data->tracker = cv::TrackerDaSiamRPN::create(parameters);
+            } else {
+                mlt_log_error(
+                    MLT_FILTER_SERVICE(filter),
+                    "DaSIAM models not found, please provide a modelsfolder parameter\n");
             }
+            free(model1);
+            free(model2);
+            free(model3);
+        }
 #if CV_VERSION_INT > 0x040600
-        } else if (!strcmp(data->algo, "Nano")) {
-            if (mlt_properties_exists(filter_properties, "modelsfolder")) {
-                char *modelsdir = mlt_properties_get(filter_properties, "modelsfolder");
-                cv::TrackerNano::Params parameters;
-                char *model1 = (char *) calloc(1, 1000);
-                char *model2 = (char *) calloc(1, 1000);
-                strcat(model1, modelsdir);
-                strcat(model2, modelsdir);
-                strcat(model1, "/nanotrack_backbone_sim.onnx");
-                strcat(model2, "/nanotrack_head_sim.onnx");
-                // Models can be downloaded from:
-                // https://github.com/HonglinChu/SiamTrackers/tree/master/NanoTrack/models/nanotrackv2
-                struct stat file_info;
-                if (mlt_stat(model1, &file_info) == 0 && mlt_stat(model2, &file_info) == 0) {
-                    // Models found, process
-                    parameters.backbone = model1;
-                    parameters.neckhead = model2;
-                    data->tracker = cv::TrackerNano::create(parameters);
-                } else {
-                    mlt_log_error(
-                        MLT_FILTER_SERVICE(filter),
-                        "Nano models not found, please provide a modelsfolder parameter\n");
-                }
-                free(model1);
-                free(model2);
+    } else if (!strcmp(data->algo, "Nano")) {
+        if (mlt_properties_exists(filter_properties, "modelsfolder")) {
+            char *modelsdir = mlt_properties_get(filter_properties, "modelsfolder");
+            cv::TrackerNano::Params parameters;
+            char *model1 = (char *) calloc(1, 1000);
+            char *model2 = (char *) calloc(1, 1000);
+            strcat(model1, modelsdir);
+            strcat(model2, modelsdir);
+            strcat(model1, "/nanotrack_backbone_sim.onnx");
+            strcat(model2, "/nanotrack_head_sim.onnx");
+            // Models can be downloaded from:
+            // https://github.com/HonglinChu/SiamTrackers/tree/master/NanoTrack/models/nanotrackv2
+            struct stat file_info;
+            if (mlt_stat(model1, &file_info) == 0 && mlt_stat(model2, &file_info) == 0) {
+                // Models found, process
+                parameters.backbone = model1;
+                parameters.neckhead = model2;
+                data->tracker = cv::TrackerNano::create(parameters);
+            } else {
+                mlt_log_error(
+                    MLT_FILTER_SERVICE(filter),
+                    "Nano models not found, please provide a modelsfolder parameter\n");
             }
-#endif
-        } else if (!strcmp(data->algo, "MOSSE")) {
-            data->legacyTracking = true;
-            data->legacyTracker = cv::legacy::tracking::TrackerMOSSE::create();
-        } else if (!strcmp(data->algo, "MEDIANFLOW")) {
-            data->legacyTracking = true;
-            data->legacyTracker = cv::legacy::tracking::TrackerMedianFlow::create();
-        } else if (!strcmp(data->algo, "CSRT")) {
-            data->legacyTracking = true;
-            data->legacyTracker = cv::legacy::tracking::TrackerCSRT::create();
+            free(model1);
+            free(model2);
         }
+#endif
+    } else if (!strcmp(data->algo, "MOSSE")) {
+        data->legacyTracking = true;
+        data->legacyTracker = cv::legacy::tracking::TrackerMOSSE::create();
+    } else if (!strcmp(data->algo, "MEDIANFLOW")) {
+        data->legacyTracking = true;
+        data->legacyTracker = cv::legacy::tracking::TrackerMedianFlow::create();
+    } else if (!strcmp(data->algo, "CSRT")) {
+        data->legacyTracking = true;
+        data->legacyTracker = cv::legacy::tracking::TrackerCSRT::create();
+    }
 #endif
 #if CV_VERSION_INT >= 0x030402 && CV_VERSION_INT < 0x040500
-        else if (!strcmp(data->algo, "CSRT")) {
-            data->tracker = cv::TrackerCSRT::create();
-        } else if (!strcmp(data->algo, "MOSSE")) {
-            data->tracker = cv::TrackerMOSSE::create();
-        }
+    else if (!strcmp(data->algo, "CSRT")) {
+        data->tracker = cv::TrackerCSRT::create();
+    } else if (!strcmp(data->algo, "MOSSE")) {
+        data->tracker = cv::TrackerMOSSE::create();
+    }
 #endif
 #if CV_VERSION_INT >= 0x030402 && CV_VERSION_INT < 0x040500
-        else if (!strcmp(data->algo, "TLD")) {
-            data->tracker = cv::TrackerTLD::create();
-        } else {
-            data->tracker = cv::TrackerBoosting::create();
-        }
+    else if (!strcmp(data->algo, "TLD")) {
+        data->tracker = cv::TrackerTLD::create();
+    } else {
+        data->tracker = cv::TrackerBoosting::create();
+    }
 #endif // CV_VERSION_INT >= 0x030402 && CV_VERSION_INT < 0x040500
 #else
-        if (data->algo == NULL || !strcmp(data->algo, "")) {
-            data->tracker = cv::Tracker::create("KCF");
-        } else {
-            data->tracker = cv::Tracker::create(data->algo);
-        }
+    if (data->algo == NULL || !strcmp(data->algo, "")) {
+        data->tracker = cv::Tracker::create("KCF");
+    } else {
+        data->tracker = cv::Tracker::create(data->algo);
+    }
 #endif
 
-        // Discard previous results
+    // Discard previous results
 #if CV_VERSION_INT > 0x040502
-        if (data->tracker == NULL && data->legacyTracker == NULL) {
+    if (data->tracker == NULL && data->legacyTracker == NULL) {
 #else
-        if (data->tracker == NULL) {
+    if (data->tracker == NULL) {
 #endif
-            mlt_log_error(MLT_FILTER_SERVICE(filter), "Tracker initialized FAILED\n");
+        mlt_log_error(MLT_FILTER_SERVICE(filter), "Tracker initialized FAILED\n");
+    } else {
+        data->startRect = rect;
+        mlt_profile profile = mlt_service_profile(MLT_FILTER_SERVICE(filter));
+        double scale_width = mlt_profile_scale_width(profile, width);
+        double scale_height = mlt_profile_scale_height(profile, height);
+        data->startRect.x *= scale_width;
+        data->startRect.w *= scale_width;
+        data->startRect.y *= scale_height;
+        data->startRect.h *= scale_height;
+
+        // Ensure startRect is within frame boundaries
+        if (data->startRect.x > width) {
+            data->startRect.x = width - 10;
         } else {
-            data->startRect = mlt_properties_get_rect(filter_properties, "rect");
-            mlt_profile profile = mlt_service_profile(MLT_FILTER_SERVICE(filter));
-            double scale_width = mlt_profile_scale_width(profile, width);
-            double scale_height = mlt_profile_scale_height(profile, height);
-            data->startRect.x *= scale_width;
-            data->startRect.w *= scale_width;
-            data->startRect.y *= scale_height;
-            data->startRect.h *= scale_height;
-
-            // Ensure startRect is within frame boundaries
-            if (data->startRect.x > width) {
-                data->startRect.x = width - 10;
-            } else {
-                data->startRect.x = MAX(0., data->startRect.x);
-            }
-            if (data->startRect.y > height) {
-                data->startRect.y = height - 10;
-            } else {
-                data->startRect.y = MAX(0., data->startRect.y);
-            }
-            if (data->startRect.x + data->startRect.w > width) {
-                data->startRect.w = width - data->startRect.x;
-            }
-            if (data->startRect.y + data->startRect.h > height) {
-                data->startRect.h = height - data->startRect.y;
-            }
+            data->startRect.x = MAX(0., data->startRect.x);
+        }
+        if (data->startRect.y > height) {
+            data->startRect.y = height - 10;
+        } else {
+            data->startRect.y = MAX(0., data->startRect.y);
+        }
+        if (data->startRect.x + data->startRect.w > width) {
+            data->startRect.w = width - data->startRect.x;
+        }
+        if (data->startRect.y + data->startRect.h > height) {
+            data->startRect.h = height - data->startRect.y;
+        }
 
-            data->boundingBox.x = data->startRect.x;
-            data->boundingBox.y = data->startRect.y;
-            data->boundingBox.width = data->startRect.w;
-            data->boundingBox.height = data->startRect.h;
-            if (data->boundingBox.width < 1) {
-                data->boundingBox.width = 50;
-            }
-            if (data->boundingBox.height < 1) {
-                data->boundingBox.height = 50;
-            }
+        data->boundingBox.x = data->startRect.x;
+        data->boundingBox.y = data->startRect.y;
+        data->boundingBox.width = data->startRect.w;
+        data->boundingBox.height = data->startRect.h;
+        if (data->boundingBox.width < 1) {
+            data->boundingBox.width = 50;
+        }
+        if (data->boundingBox.height < 1) {
+            data->boundingBox.height = 50;
+        }
 #if CV_VERSION_INT >= 0x030402 && CV_VERSION_INT < 0x040500
-            if (data->tracker->init(cvFrame, data->boundingBox)) {
+        if (data->tracker->init(cvFrame, data->boundingBox)) {
 #else
-            {
-                try {
-                    if (data->legacyTracking) {
+        {
+            try {
+                if (data->legacyTracking) {
 #if CV_VERSION_INT > 0x040502
-                        data->legacyTracker->init(cvFrame, data->boundingBox);
+                    data->legacyTracker->init(cvFrame, data->boundingBox);
 #endif
-                    } else {
-                        data->tracker->init(cvFrame, data->boundingBox);
-                    }
+                } else {
+                    data->tracker->init(cvFrame, data->boundingBox);
+                }
 #endif
-                    data->initialized = true;
-                    data->analyze = true;
-                    data->last_position = position - 1;
-                } catch (cv::Exception &e) {
-                    mlt_log_warning(MLT_FILTER_SERVICE(filter),
+                data->initialized = true;
+            } catch (cv::Exception &e) {
+                mlt_log_warning(MLT_FILTER_SERVICE(filter),
                                 "failed to initialize tracker: %s\n",
                                 e.what());
-                }
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+static void update_tracker(cv::Mat cvFrame, private_data *data)
+{
+    if (data->legacyTracking) {
+#if CV_VERSION_INT > 0x040502
+        cv::Rect2d rect(data->boundingBox);
+        data->legacyTracker->update(cvFrame, rect);
+        data->boundingBox = cv::Rect(rect);
+#endif
+    } else {
+        data->tracker->update(cvFrame, data->boundingBox);
+    }
+}
+
+static void analyze(mlt_filter filter,
+                    cv::Mat cvFrame,
+                    private_data *data,
+                    int width,
+                    int height,
+                    int position,
+                    int length)
+{
+    mlt_properties filter_properties = MLT_FILTER_PROPERTIES(filter);
+    if (data->analyse_width == -1) {
+        // Store analyze width/height
+        data->analyse_width = width;
+        data->analyse_height = height;
+    } else if (data->analyse_width != width || data->analyse_height != height) {
+        // Frame size changed, reset all stored data
+        data->initialized = false;
+        data->analyse_width = width;
+        data->analyse_height = height;
+    }
+    // Create tracker and initialize it
+    if (!data->initialized) {
+        if (init_tracker(filter,
+                         cvFrame,
+                         data,
+                         width,
+                         height,
+                         mlt_properties_get_rect(filter_properties, "rect"))) {
+            if (data->initialized) {
+                data->analyze = true;
+                data->last_position = position - 1;
             }
             // init anim property
             mlt_properties_anim_get_int(filter_properties, "_results", 0, -1);
             mlt_properties_get_animation(filter_properties, "_results");
         }
     } else {
-        if (data->legacyTracking) {
-#if CV_VERSION_INT > 0x040502
-            cv::Rect2d rect(data->boundingBox);
-            data->legacyTracker->update(cvFrame, rect);
-            data->boundingBox = cv::Rect(rect);
-#endif
-        } else {
-            data->tracker->update(cvFrame, data->boundingBox);
-        }
+        update_tracker(cvFrame, data);
     }
     if (data->analyze && position != data->last_position + 1) {
         // We are in real time, do not try to store data
@@ -379,6 +490,238 @@ static void analyze(mlt_filter filter,
     data->last_position = position;
 }
 
+/** Track the clip from the first position of the job until its end or until stopped.
+ */
+
+static void *track_thread(void *arg)
+{
+    tracker_job *job = (tracker_job *) arg;
+    private_data tracker{};
+
+    for (mlt_position position = job->from; position < job->length; position++) {
+        mlt_frame frame = NULL;
+        uint8_t *image = NULL;
+        mlt_image_format format = mlt_image_rgb;
+        int width = job->profile->width;
+        int height = job->profile->height;
+
+        pthread_mutex_lock(&job->mutex);
+        bool stop = job->stop;
+        pthread_mutex_unlock(&job->mutex);
+        if (stop)
+            break;
+
+        mlt_producer_seek(job->producer, job->offset + position);
+        if (mlt_service_get_frame(MLT_PRODUCER_SERVICE(job->producer), &frame, 0) || !frame)
+            break;
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "consumer.progressive", 1);
+        if (mlt_frame_get_image(frame, &image, &format, &width, &height, 0) || !image) {
+            mlt_frame_close(frame);
+            break;
+        }
+        cv::Mat cvFrame(height, width, CV_8UC3, image);
+        if (!tracker.initialized)
+            init_tracker(job->filter, cvFrame, &tracker, width, height, job->rect);
+        else
+            update_tracker(cvFrame, &tracker);
+        mlt_frame_close(frame);
+        if (!tracker.initialized)
+            break;
+        clamp_bounding_box(&tracker, width, height);
+
+        // Store the rect in profile coordinates
+        mlt_rect rect;
+        rect.x = tracker.boundingBox.x * job->profile->width / width;
+        rect.y = tracker.boundingBox.y * job->profile->height / height;
+        rect.w = tracker.boundingBox.width * job->profile->width / width;
+        rect.h = tracker.boundingBox.height * job->profile->height / height;
+        rect.o = 0;
+        pthread_mutex_lock(&job->mutex);
+        job->rects[position] = rect;
+        job->end = position + 1;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->mutex);
+    }
+
+    pthread_mutex_lock(&job->mutex);
+    job->finished = true;
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->mutex);
+    return NULL;
+}
+
+/** Start tracking on a copy of the producer from a position and a rect in profile coordinates.
+ *
+ * When keeping the results, the rects before the position are taken from them so that only
+ * the frames from the position on are tracked again.
+ */
+
+static tracker_job *start_job(mlt_filter filter,
+                              mlt_frame frame,
+                              private_data *data,
+                              mlt_position from,
+                              mlt_rect rect,
+                              bool keep)
+{
+    mlt_producer producer = mlt_frame_get_original_producer(frame);
+    mlt_profile profile = mlt_service_profile(MLT_FILTER_SERVICE(filter));
+    int length = data->producer_in + data->producer_length;
+
+    if (!producer || !profile || from < 0 || from >= data->producer_length)
+        return NULL;
+
+    tracker_job *job = new tracker_job();
+    job->profile = mlt_profile_clone(profile);
+    job->producer = mlt_producer_clone_before(producer, job->profile, filter);
+    if (!job->producer) {
+        mlt_log_info(MLT_FILTER_SERVICE(filter), "Can not track ahead, tracking during playback\n");
+        mlt_profile_close(job->profile);
+        delete job;
+        data->job_failed = true;
+        return NULL;
+    }
+    job->filter = filter;
+    job->offset = mlt_frame_original_position(frame) - mlt_filter_get_position(filter, frame);
+    job->first = keep ? 0 : from;
+    job->from = from;
+    job->end = from;
+    job->length = data->producer_length;
+    job->rect = rect;
+    job->rects.resize(job->length);
+    for (mlt_position i = job->first; i < from; i++)
+        job->rects[i] = get_result(filter, data, i, length);
+    pthread_mutex_init(&job->mutex, NULL);
+    pthread_cond_init(&job->cond, NULL);
+    pthread_create(&job->thread, NULL, track_thread, job);
+    return job;
+}
+
+static void stop_job(private_data *data)
+{
+    tracker_job *job = data->job;
+
+    if (!job)
+        return;
+    pthread_mutex_lock(&job->mutex);
+    job->stop = true;
+    pthread_mutex_unlock(&job->mutex);
+    pthread_join(job->thread, NULL);
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->mutex);
+    mlt_producer_close(job->producer);
+    mlt_profile_close(job->profile);
+    delete job;
+    data->job = NULL;
+}
+
+/** Replace the results from the first position of a finished job.
+ */
+
+static void publish_results(mlt_filter filter, private_data *data, tracker_job *job)
+{
+    mlt_properties properties = MLT_FILTER_PROPERTIES(filter);
+    int length = data->producer_in + data->producer_length;
+    int steps = mlt_properties_get_int(properties, "steps");
+
+    // Keep the keyframes before the tracked range
+    if (job->first < job->from) {
+        mlt_properties_set(properties, "_results", mlt_properties_get(properties, "results"));
+        mlt_properties_anim_get_int(properties, "_results", 0, length);
+        mlt_animation anim = mlt_properties_get_animation(properties, "_results");
+        struct mlt_animation_item_s item;
+        item.property = NULL;
+        for (int i = mlt_animation_key_count(anim) - 1; i >= 0; i--) {
+            if (!mlt_animation_key_get(anim, &item, i)
+                && item.frame >= job->from + data->producer_in)
+                mlt_animation_remove(anim, item.frame);
+        }
+    } else {
+        mlt_properties_set(properties, "_results", NULL);
+    }
+    for (mlt_position position = job->from; position < job->length; position++) {
+        if (steps <= 1 || position == job->from || position == job->length - 1
+            || position % steps == 0)
+            mlt_properties_anim_set_rect(properties,
+                                         "_results",
+                                         job->rects[position],
+                                         position + data->producer_in,
+                                         length,
+                                         mlt_keyframe_smooth);
+    }
+    char *results = mlt_animation_serialize(mlt_properties_get_animation(properties, "_results"));
+    mlt_properties_set(properties, "results", results);
+    free(results);
+    // Discard temporary data
+    mlt_properties_set(properties, "_results", NULL);
+}
+
+/** Get the bounding box from the tracking job, starting or restarting it as requested.
+ * \return true if the job provides the bounding box of this frame
+ */
+
+static bool track_ahead(mlt_filter filter,
+                        mlt_frame frame,
+                        private_data *data,
+                        mlt_position position,
+                        int width,
+                        int height)
+{
+    mlt_properties properties = MLT_FILTER_PROPERTIES(filter);
+    int length = data->producer_in + data->producer_length;
+    mlt_rect start_rect = mlt_properties_get_rect(properties, "rect");
+
+    if (data->job_cancel) {
+        stop_job(data);
+        data->job_cancel = false;
+        data->job_failed = false;
+    }
+    if (!mlt_properties_get_int(properties, "analyze_ahead"))
+        return false;
+    if (mlt_properties_get(properties, "reanalyze")) {
+        mlt_position from = mlt_properties_get_position(properties, "reanalyze");
+        mlt_properties_set(properties, "reanalyze", NULL);
+        stop_job(data);
+        data->job_failed = false;
+        // Keep the results before the edited position and track again from its rect
+        if (data->playback)
+            data->job = start_job(
+                filter, frame, data, from, get_result(filter, data, from, length), true);
+        else
+            data->job = start_job(filter, frame, data, from, start_rect, false);
+    }
+    if (!data->job && !data->playback && !data->job_failed)
+        data->job = start_job(filter, frame, data, position, start_rect, false);
+
+    tracker_job *job = data->job;
+    if (!job)
+        return false;
+
+    // Wait for the thread if the playhead caught up with it
+    pthread_mutex_lock(&job->mutex);
+    while (!job->finished && position >= job->from && position >= job->end)
+        pthread_cond_wait(&job->cond, &job->mutex);
+    bool found = position >= job->first && position < job->end;
+    mlt_rect rect = found ? job->rects[position] : mlt_rect();
+    bool finished = job->finished;
+    pthread_mutex_unlock(&job->mutex);
+
+    if (found)
+        set_bounding_box(filter, data, width, height, rect);
+    else
+        // Before the tracked range, such as when reanalyzing from a later position
+        apply(filter, data, width, height, position, length);
+    if (finished) {
+        if (job->end == job->length) {
+            publish_results(filter, data, job);
+        } else {
+            mlt_log_error(MLT_FILTER_SERVICE(filter), "Tracking failed at frame %d\n", job->end);
+            data->job_failed = true;
+        }
+        stop_job(data);
+    }
+    return true;
+}
+
 /** Get the image.
 */
 static int filter_get_image(mlt_frame frame,
@@ -428,7 +771,9 @@ static int filter_get_image(mlt_frame frame,
             data->playback = true;
         }
     }
-    if (data->playback) {
+    if (track_ahead(filter, frame, data, position, *width, *height)) {
+        // The tracking thread provided the bounding box
+    } else if (data->playback) {
         // Clip already analysed, don't re-process
         apply(filter, data, *width, *height, position, data->producer_in + data->producer_length);
     } else {
@@ -441,22 +786,14 @@ static int filter_get_image(mlt_frame frame,
                 data->producer_in + data->producer_length);
     }
     // ensure bounding box is within the frame boundaries or OpenCV will crash
-    if (data->boundingBox.x > *width) {
-        data->boundingBox.x = *width - 10;
-    } else {
-        data->boundingBox.x = MAX(0., data->boundingBox.x);
-    }
-    if (data->boundingBox.y > *height) {
-        data->boundingBox.y = *height - 10;
-    } else {
-        data->boundingBox.y = MAX(0., data->boundingBox.y);
-    }
-    if (data->boundingBox.x + data->boundingBox.width > *width) {
-        data->boundingBox.width = *width - data->boundingBox.x;
-    }
-    if (data->boundingBox.y + data->boundingBox.height > *height) {
-        data->boundingBox.height = *height - data->boundingBox.y;
-    }
+    clamp_bounding_box(data, *width, *height);
+    mlt_rect rect;
+    rect.x = data->boundingBox.x;
+    rect.y = data->boundingBox.y;
+    rect.w = data->boundingBox.width;
+    rect.h = data->boundingBox.height;
+    rect.o = 1;
+    mlt_properties_set_rect(MLT_FRAME_PROPERTIES(frame), "opencv.tracker.rect", rect);
 
     if (blur > 0) {
         switch (mlt_properties_get_int(filter_properties, "blur_type")) {
@@ -567,6 +904,8 @@ static mlt_frame filter_process(mlt_filter filter, mlt_frame frame)
 static void filter_close(mlt_filter filter)
 {
     private_data *data = (private_data *) filter->child;
+    stop_job(data);
+    delete data->rects;
     free(data);
     filter->child = NULL;
     filter->close = NULL;
@@ -601,6 +940,7 @@ mlt_filter filter_tracker_init(mlt_profile profile, mlt_service_type type, const
         data->analyse_height = -1;
         data->producer_in = 0;
         data->producer_length = 0;
+        data->rects_dirty = true;
         filter->child = data;
 
         // Create a unique ID for storing data on the frame
@@ -265,12 +265,75 @@ static void paint_waveform(
     }
 }
 
+/** Draw the waveform of a channel from a peak index, one line per x position.
+*/
+
+static void paint_peaks(QPainter &p,
+                        QRectF &rect,
+                        mlt_peaks peaks,
+                        int channel,
+                        int64_t start,
+                        int64_t end,
+                        int fill)
+{
+    int width = rect.width();
+    if (width <= 0)
+        return;
+    QVector<mlt_peak> values(width);
+    if (mlt_peaks_get(peaks, channel, start, end, values.data(), width))
+        return;
+
+    qreal half_height = rect.height() / 2.0;
+    qreal center_y = rect.y() + half_height;
+    for (int x = 0; x < width; x++) {
+        qreal max = values[x].max;
+        qreal min = values[x].min;
+
+        if (fill) {
+            // Draw the line all the way to 0 to "fill" it in.
+            if (max > 0 && min > 0) {
+                min = 0;
+            } else if (min < 0 && max < 0) {
+                max = 0;
+            }
+        }
+
+        QPoint high(x + rect.x(), max * half_height + center_y);
+        QPoint low(x + rect.x(), min * half_height + center_y);
+        if (high.y() == low.y()) {
+            p.drawPoint(high);
+        } else {
+            p.drawLine(low, high);
+        }
+    }
+}
+
+/** Get the range of samples of the window that ends with a frame in a peak index.
+*/
+
+static void get_peaks_range(
+    mlt_filter filter, mlt_frame frame, mlt_peaks peaks, int64_t *start, int64_t *end)
+{
+    mlt_profile profile = mlt_service_profile(MLT_FILTER_SERVICE(filter));
+    double fps = mlt_profile_fps(profile);
+    int frequency = mlt_peaks_frequency(peaks);
+    mlt_position position = mlt_frame_original_position(frame);
+    int frame_samples = mlt_audio_calculate_frame_samples(fps, frequency, position);
+    int64_t window_samples = (int64_t) mlt_properties_get_int(MLT_FILTER_PROPERTIES(filter),
+                                                              "window")
+                             * frequency / 1000;
+
+    *end = mlt_audio_calculate_samples_to_position(fps, frequency, position) + frame_samples;
+    *start = *end - (window_samples > frame_samples ? window_samples : frame_samples);
+}
+
 static void draw_waveforms(mlt_filter filter,
                            mlt_frame frame,
                            QImage *qimg,
                            int16_t *audio,
                            int channels,
                            int samples,
+                           mlt_peaks peaks,
                            int width,
                            int height)
 {
@@ -301,6 +364,33 @@ static void draw_waveforms(mlt_filter filter,
 
     setup_graph_painter(p, r, filter_properties, position, length);
 
+    if (peaks) {
+        // Draw from the peak index of the producer instead of the audio of the frame
+        int64_t start, end;
+        get_peaks_range(filter, frame, peaks, &start, &end);
+        channels = mlt_peaks_channels(peaks);
+        if (show_channel == 0) {
+            QRectF c_rect = r;
+            qreal c_height = r.height() / channels;
+            for (int c = 0; c < channels; c++) {
+                c_rect.setY(r.y() + c_height * c);
+                c_rect.setHeight(c_height);
+                setup_graph_pen(p, c_rect, filter_properties, scale, position, length);
+                paint_peaks(p, c_rect, peaks, c, start, end, fill);
+            }
+        } else {
+            if (show_channel > channels) {
+                // Sanity
+                show_channel = 1;
+            }
+            // The peaks of all channels together stand in for their average
+            setup_graph_pen(p, r, filter_properties, scale, position, length);
+            paint_peaks(p, r, peaks, show_channel < 0 ? -1 : show_channel - 1, start, end, fill);
+        }
+        p.end();
+        return;
+    }
+
     if (show_channel == -1) // Combine all channels
     {
         if (channels > 1) {
@@ -355,8 +445,9 @@ static int filter_get_image(mlt_frame frame,
     save_buffer *audio = (save_buffer *) mlt_properties_get_data(frame_properties,
                                                                  pdata->buffer_prop_name,
                                                                  NULL);
+    mlt_peaks peaks = mlt_peaks_for_producer(mlt_frame_get_original_producer(frame));
 
-    if (audio) {
+    if (audio || peaks) {
         // Get the current image
         *image_format = mlt_image_rgba;
         error = mlt_frame_get_image(frame, image, image_format, width, height, writable);
@@ -368,9 +459,10 @@ static int filter_get_image(mlt_frame frame,
             draw_waveforms(filter,
                            frame,
                            &qimg,
-                           audio->buffer,
-                           audio->channels,
-                           audio->samples,
+                           audio ? audio->buffer : NULL,
+                           audio ? audio->channels : 0,
+                           audio ? audio->samples : 0,
+                           peaks,
                            *width,
                            *height);
             convert_qimage_to_mlt_rgba(&qimg, *image, *width, *height);
@@ -364,6 +364,7 @@ static void producer_close(mlt_producer parent)
 {
     producer_qimage self = parent->child;
     parent->close = NULL;
+    close_qimage(self);
     mlt_service_cache_purge(MLT_PRODUCER_SERVICE(parent));
     mlt_producer_close(parent);
     mlt_properties_close(self->filenames);
@@ -24,14 +24,21 @@
 #include <kcomponentdata.h>
 #endif
 
+#include <QCache>
+#include <QDateTime>
 #include <QDir>
 #include <QFileInfo>
+#include <QHash>
 #include <QImage>
 #include <QImageReader>
 #include <QMovie>
 #include <QMutex>
+#include <QRunnable>
 #include <QSysInfo>
 #include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
 #include <QtEndian>
 
 #ifdef USE_EXIF
@@ -44,6 +51,271 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+/// Reads one image of a file or a sequence, returns a null image on error
+static QImage *read_image(mlt_service service,
+                          const QString &filename,
+                          int image_idx,
+                          int disable_exif)
+{
+    QImageReader reader;
+    QImage *qimage;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+    // Use Qt's orientation detection
+    reader.setAutoTransform(!disable_exif);
+#endif
+
+    // First try to detect the file type based on the content
+    // in case the file extension is incorrect.
+    reader.setDecideFormatFromContent(true);
+    reader.setFileName(filename);
+    if (reader.imageCount() > 1) {
+        QMovie movie(filename);
+        movie.setCacheMode(QMovie::CacheAll);
+        movie.jumpToFrame(image_idx);
+        qimage = new QImage(movie.currentImage());
+    } else {
+        qimage = new QImage(reader.read());
+    }
+    if (qimage->isNull()) {
+        mlt_log_info(service,
+                     "QImage retry: %d - %s\n",
+                     reader.error(),
+                     reader.errorString().toLatin1().data());
+        delete qimage;
+        // If detection fails, try a more comprehensive detection including file extension
+        reader.setDecideFormatFromContent(false);
+        reader.setFileName(filename);
+        qimage = new QImage(reader.read());
+        if (qimage->isNull()) {
+            mlt_log_info(service,
+                         "QImage fail: %d - %s\n",
+                         reader.error(),
+                         reader.errorString().toLatin1().data());
+        }
+    }
+    return qimage;
+}
+
+/// Scales an image from the smallest level of its pyramid that is not smaller than the size
+static QImage scale_image(const QString &key, const QImage &source, int width, int height)
+{
+    // Halved copies of the source images shared by all of the producers, cost in KiB
+    static QMutex mutex;
+    static QCache<QString, QList<QImage>> pyramids(256 * 1024);
+
+    if (key.isEmpty() || width * 2 > source.width() || height * 2 > source.height())
+        return source.scaled(QSize(width, height), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    QList<QImage> levels;
+    {
+        QMutexLocker locker(&mutex);
+        QList<QImage> *cached = pyramids.object(key);
+        if (cached && !cached->isEmpty() && cached->first().width() == source.width() / 2
+            && cached->first().height() == source.height() / 2)
+            levels = *cached;
+    }
+
+    // Use the existing levels and only compute the missing ones
+    QImage level = source;
+    int count = levels.size();
+    for (int i = 0;; i++) {
+        QSize size(level.width() / 2, level.height() / 2);
+        if (size.width() < width || size.height() < height)
+            break;
+        if (i == levels.size())
+            levels << level.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        level = levels[i];
+    }
+    if (levels.size() > count) {
+        qint64 cost = 0;
+        for (const QImage &image : levels)
+            cost += qint64(image.bytesPerLine()) * image.height() / 1024;
+        QMutexLocker locker(&mutex);
+        pyramids.insert(key, new QList<QImage>(levels), cost);
+    }
+    return level.scaled(QSize(width, height), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+/// Decodes the images that follow the current one of a sequence on a thread pool
+class ImagePrefetcher
+{
+public:
+    explicit ImagePrefetcher(mlt_service service)
+        : m_service(service)
+    {}
+
+    ~ImagePrefetcher()
+    {
+        cancel();
+        m_pool.waitForDone();
+    }
+
+    /// Returns the prefetched image for an index, waiting if it is being decoded, or NULL
+    QImage *take(int index, int disable_exif)
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_images.find(index);
+        while (it != m_images.end() && it->started && !it->image) {
+            m_ready.wait(&m_mutex);
+            it = m_images.find(index);
+        }
+        if (it == m_images.end())
+            return nullptr;
+        // A queued image is decoded by the caller rather than waiting for the pool
+        QImage *image = it->disable_exif == disable_exif ? it->image : nullptr;
+        if (!image)
+            delete it->image;
+        m_images.erase(it);
+        return image;
+    }
+
+    /// Keeps the next images in the direction of playback decoded or being decoded
+    void schedule(producer_qimage self,
+                  int index,
+                  double speed,
+                  int depth,
+                  qint64 budget,
+                  int disable_exif)
+    {
+        int count = mlt_properties_count(self->filenames);
+        QMutexLocker locker(&m_mutex);
+
+        // Follow the step between consecutive requests, which gives the direction and speed
+        int step = index - m_last_index;
+        m_last_index = index;
+        if (step == 0)
+            return;
+        if (std::abs(step) <= max_step && speed != 0.0 && (step > 0) != (speed > 0.0)) {
+            // Frames rendered in parallel may arrive slightly out of order
+            return;
+        }
+        if (std::abs(step) > max_step) {
+            // A seek, start again in the direction of the producer
+            if (speed == 0.0) {
+                locker.unlock();
+                cancel();
+                return;
+            }
+            step = speed < 0.0 ? -1 : 1;
+        }
+
+        // Do not hold more decoded images than the budget allows
+        if (m_image_bytes > 0)
+            depth = qMin<qint64>(depth, budget / m_image_bytes);
+        depth = qMin(depth, count - 1);
+        QList<int> wanted;
+        for (int k = 1; k <= depth; k++)
+            wanted << ((index + k * step) % count + count) % count;
+
+        // Drop what is not ahead anymore, for example after a seek
+        for (auto it = m_images.begin(); it != m_images.end();) {
+            if (!wanted.contains(it.key()) || it->disable_exif != disable_exif) {
+                delete it->image;
+                it = m_images.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (int i : wanted) {
+            if (m_images.contains(i))
+                continue;
+            Entry &entry = m_images[i];
+            entry.serial = ++m_serial;
+            entry.disable_exif = disable_exif;
+            QString filename = QString::fromUtf8(mlt_properties_get_value(self->filenames, i));
+            m_pool.start(new Task(this, i, entry.serial, filename, disable_exif));
+        }
+    }
+
+    /// Forgets all of the prefetched images
+    void cancel()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_pool.clear();
+        for (auto &entry : m_images)
+            delete entry.image;
+        m_images.clear();
+        m_ready.wakeAll();
+    }
+
+private:
+    struct Entry
+    {
+        QImage *image = nullptr;
+        quint64 serial = 0;
+        int disable_exif = 0;
+        bool started = false;
+    };
+
+    class Task : public QRunnable
+    {
+    public:
+        Task(ImagePrefetcher *prefetcher,
+             int index,
+             quint64 serial,
+             const QString &filename,
+             int disable_exif)
+            : m_prefetcher(prefetcher)
+            , m_index(index)
+            , m_serial(serial)
+            , m_filename(filename)
+            , m_disable_exif(disable_exif)
+        {}
+
+        void run() override
+        {
+            if (m_prefetcher->start(m_index, m_serial)) {
+                QImage *image
+                    = read_image(m_prefetcher->m_service, m_filename, m_index, m_disable_exif);
+                m_prefetcher->finish(m_index, m_serial, image);
+            }
+        }
+
+    private:
+        ImagePrefetcher *m_prefetcher;
+        int m_index;
+        quint64 m_serial;
+        QString m_filename;
+        int m_disable_exif;
+    };
+
+    bool start(int index, quint64 serial)
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_images.find(index);
+        if (it == m_images.end() || it->serial != serial)
+            return false;
+        it->started = true;
+        return true;
+    }
+
+    void finish(int index, quint64 serial, QImage *image)
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_images.find(index);
+        if (it == m_images.end() || it->serial != serial) {
+            delete image;
+            return;
+        }
+        it->image = image;
+        if (!image->isNull())
+            m_image_bytes = qint64(image->bytesPerLine()) * image->height();
+        m_ready.wakeAll();
+    }
+
+    static const int max_step = 8;
+
+    mlt_service m_service;
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QWaitCondition m_ready;
+    QHash<int, Entry> m_images;
+    quint64 m_serial = 0;
+    qint64 m_image_bytes = 0;
+    int m_last_index = -1;
+};
+
 extern "C" {
 
 #include <framework/mlt_cache.h>
@@ -144,6 +416,35 @@ static QImage *reorient_with_exif(producer_qimage self, int image_idx, QImage *q
 }
 #endif
 
+static void prefetch_images(producer_qimage self, int image_idx, int disable_exif)
+{
+    mlt_producer producer = &self->parent;
+    mlt_properties producer_props = MLT_PRODUCER_PROPERTIES(producer);
+    ImagePrefetcher *prefetcher = static_cast<ImagePrefetcher *>(self->prefetch);
+    int depth = mlt_properties_get(producer_props, "prefetch")
+                    ? mlt_properties_get_int(producer_props, "prefetch")
+                    : QThread::idealThreadCount();
+    qint64 budget = mlt_properties_get(producer_props, "prefetch_budget")
+                        ? mlt_properties_get_int64(producer_props, "prefetch_budget")
+                        : 256;
+
+    if (depth <= 0 || budget <= 0) {
+        if (prefetcher)
+            prefetcher->cancel();
+        return;
+    }
+    if (!prefetcher) {
+        prefetcher = new ImagePrefetcher(MLT_PRODUCER_SERVICE(producer));
+        self->prefetch = prefetcher;
+    }
+    prefetcher->schedule(self,
+                         image_idx,
+                         mlt_producer_get_speed(producer),
+                         depth,
+                         budget * 1024 * 1024,
+                         disable_exif);
+}
+
 int refresh_qimage(producer_qimage self, mlt_frame frame, int enable_caching)
 {
     // Obtain properties of frame and producer
@@ -153,6 +454,8 @@ int refresh_qimage(producer_qimage self, mlt_frame frame, int enable_caching)
 
     // Check if user wants us to reload the image
     if (mlt_properties_get_int(producer_props, "force_reload")) {
+        if (self->prefetch)
+            static_cast<ImagePrefetcher *>(self->prefetch)->cancel();
         self->qimage = NULL;
         self->current_image = NULL;
         mlt_properties_set_int(producer_props, "force_reload", 0);
@@ -173,46 +476,17 @@ int refresh_qimage(producer_qimage self, mlt_frame frame, int enable_caching)
     }
     if (!self->qimage || mlt_properties_get_int(producer_props, "_disable_exif") != disable_exif) {
         self->current_image = NULL;
-        QImageReader reader;
-        QImage *qimage;
-
-#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
-        // Use Qt's orientation detection
-        reader.setAutoTransform(!disable_exif);
-#endif
-        QString filename = QString::fromUtf8(mlt_properties_get_value(self->filenames, image_idx));
-        if (filename.isEmpty()) {
-            filename = QString::fromUtf8(mlt_properties_get(producer_props, "resource"));
-        }
-
-        // First try to detect the file type based on the content
-        // in case the file extension is incorrect.
-        reader.setDecideFormatFromContent(true);
-        reader.setFileName(filename);
-        if (reader.imageCount() > 1) {
-            QMovie movie(filename);
-            movie.setCacheMode(QMovie::CacheAll);
-            movie.jumpToFrame(image_idx);
-            qimage = new QImage(movie.currentImage());
-        } else {
-            qimage = new QImage(reader.read());
-        }
-        if (qimage->isNull()) {
-            mlt_log_info(MLT_PRODUCER_SERVICE(&self->parent),
-                         "QImage retry: %d - %s\n",
-                         reader.error(),
-                         reader.errorString().toLatin1().data());
-            delete qimage;
-            // If detection fails, try a more comprehensive detection including file extension
-            reader.setDecideFormatFromContent(false);
-            reader.setFileName(filename);
-            qimage = new QImage(reader.read());
-            if (qimage->isNull()) {
-                mlt_log_info(MLT_PRODUCER_SERVICE(&self->parent),
-                             "QImage fail: %d - %s\n",
-                             reader.error(),
-                             reader.errorString().toLatin1().data());
+        QImage *qimage = nullptr;
+        ImagePrefetcher *prefetcher = static_cast<ImagePrefetcher *>(self->prefetch);
+        if (prefetcher)
+            qimage = prefetcher->take(image_idx, disable_exif);
+        if (!qimage) {
+            QString filename = QString::fromUtf8(
+                mlt_properties_get_value(self->filenames, image_idx));
+            if (filename.isEmpty()) {
+                filename = QString::fromUtf8(mlt_properties_get(producer_props, "resource"));
             }
+            qimage = read_image(MLT_PRODUCER_SERVICE(producer), filename, image_idx, disable_exif);
         }
         self->qimage = qimage;
 
@@ -263,6 +537,10 @@ int refresh_qimage(producer_qimage self, mlt_frame frame, int enable_caching)
         }
     }
 
+    // Decode the following images of a sequence in the background
+    if (!enable_caching && mlt_properties_count(self->filenames) > 1)
+        prefetch_images(self, image_idx, disable_exif);
+
     // Set width/height of frame
     mlt_properties_set_int(properties, "width", self->current_width);
     mlt_properties_set_int(properties, "height", self->current_height);
@@ -270,6 +548,12 @@ int refresh_qimage(producer_qimage self, mlt_frame frame, int enable_caching)
     return image_idx;
 }
 
+void close_qimage(producer_qimage self)
+{
+    delete static_cast<ImagePrefetcher *>(self->prefetch);
+    self->prefetch = NULL;
+}
+
 void refresh_image(producer_qimage self,
                    mlt_frame frame,
                    mlt_image_format format,
@@ -280,6 +564,7 @@ void refresh_image(producer_qimage self,
     // Obtain properties of frame and producer
     mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
     mlt_producer producer = &self->parent;
+    mlt_properties producer_props = MLT_PRODUCER_PROPERTIES(producer);
 
     // Get index and qimage
     int image_idx = refresh_qimage(self, frame, enable_caching);
@@ -313,10 +598,25 @@ void refresh_image(producer_qimage self,
             self->qimage_cache = mlt_service_cache_get(MLT_PRODUCER_SERVICE(producer),
                                                        "qimage.qimage");
         }
-        QImage scaled = interp ? qimage->scaled(QSize(width, height),
-                                                Qt::IgnoreAspectRatio,
-                                                Qt::SmoothTransformation)
-                               : qimage->scaled(QSize(width, height));
+        QImage scaled;
+        if (interp) {
+            // Identify the source image to share its pyramid with other producers
+            QString key;
+            QString filename = QString::fromUtf8(
+                mlt_properties_get_value(self->filenames, self->qimage_idx));
+            if (filename.isEmpty())
+                filename = QString::fromUtf8(mlt_properties_get(producer_props, "resource"));
+            QFileInfo info(filename);
+            if (info.exists())
+                key = QStringLiteral("%1:%2:%3:%4")
+                          .arg(info.absoluteFilePath())
+                          .arg(info.lastModified().toMSecsSinceEpoch())
+                          .arg(self->qimage_idx)
+                          .arg(mlt_properties_get_int(producer_props, "disable_exif"));
+            scaled = scale_image(key, *qimage, width, height);
+        } else {
+            scaled = qimage->scaled(QSize(width, height));
+        }
 
         // Store width and height
         self->current_width = width;
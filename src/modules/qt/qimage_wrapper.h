@@ -44,6 +44,7 @@ struct producer_qimage_s
     mlt_cache_item alpha_cache;
     mlt_cache_item qimage_cache;
     void *qimage;
+    void *prefetch;
     mlt_image_format format;
 };
 
@@ -52,6 +53,7 @@ typedef struct producer_qimage_s *producer_qimage;
 extern int refresh_qimage(producer_qimage self, mlt_frame frame, int enable_caching);
 extern void refresh_image(
     producer_qimage, mlt_frame, mlt_image_format, int width, int height, int enable_caching);
+extern void close_qimage(producer_qimage self);
 extern void make_tempfile(producer_qimage, const char *xml);
 extern int init_qimage(mlt_producer producer, const char *filename);
 extern int load_sequence_sprintf(producer_qimage self,
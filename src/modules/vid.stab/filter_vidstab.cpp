@@ -27,7 +27,9 @@ extern "C" {
 }
 
 #include <assert.h>
+#include <pthread.h>
 #include <sstream>
+#include <stdio.h>
 #include <string.h>
 
 typedef struct
@@ -45,10 +47,14 @@ typedef struct
     VSPixelFormat format;
 } vs_apply;
 
+struct vs_job;
+
 typedef struct
 {
     vs_analyze *analyze_data;
     vs_apply *apply_data;
+    struct vs_job *job;
+    int job_failed; // analyze in one pass during playback instead
 } vs_data;
 
 static void get_transform_config(VSTransformConfig *conf, mlt_filter filter, mlt_frame frame)
@@ -186,6 +192,20 @@ void destroy_analyze_data(vs_analyze *analyze_data)
     }
 }
 
+static void get_motion_config(VSMotionDetectConfig *conf, mlt_filter filter)
+{
+    mlt_properties properties = MLT_FILTER_PROPERTIES(filter);
+    const char *filterName = mlt_properties_get(properties, "mlt_service");
+
+    *conf = vsMotionDetectGetDefaultConfig(filterName);
+    conf->shakiness = mlt_properties_get_int(properties, "shakiness");
+    conf->accuracy = mlt_properties_get_int(properties, "accuracy");
+    conf->stepSize = mlt_properties_get_int(properties, "stepsize");
+    conf->contrastThreshold = mlt_properties_get_double(properties, "mincontrast");
+    conf->show = mlt_properties_get_int(properties, "show");
+    conf->virtualTripod = mlt_properties_get_int(properties, "tripod");
+}
+
 static void init_analyze_data(
     mlt_filter filter, mlt_frame frame, VSPixelFormat vs_format, int width, int height)
 {
@@ -195,14 +215,8 @@ static void init_analyze_data(
     memset(analyze_data, 0, sizeof(vs_analyze));
 
     // Initialize a VSMotionDetectConfig
-    const char *filterName = mlt_properties_get(properties, "mlt_service");
-    VSMotionDetectConfig conf = vsMotionDetectGetDefaultConfig(filterName);
-    conf.shakiness = mlt_properties_get_int(properties, "shakiness");
-    conf.accuracy = mlt_properties_get_int(properties, "accuracy");
-    conf.stepSize = mlt_properties_get_int(properties, "stepsize");
-    conf.contrastThreshold = mlt_properties_get_double(properties, "mincontrast");
-    conf.show = mlt_properties_get_int(properties, "show");
-    conf.virtualTripod = mlt_properties_get_int(properties, "tripod");
+    VSMotionDetectConfig conf;
+    get_motion_config(&conf, filter);
 
     // Initialize a VSFrameInfo
     VSFrameInfo fi;
@@ -265,6 +279,328 @@ static int apply_results(mlt_filter filter,
     return error;
 }
 
+typedef struct vs_chunk vs_chunk;
+
+/** Analyzes the clip with copies of its producer, one chunk of the clip per thread, while
+ * the frames of the filter pass through.
+ */
+
+typedef struct vs_job
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    mlt_filter filter;
+    vs_chunk *chunks;
+    int count;
+    mlt_position length;
+    char *filename;
+    int done;    // frames analyzed
+    int running; // chunks not finished yet
+    int stop;
+    int finished;
+    int error;
+} vs_job;
+
+struct vs_chunk
+{
+    vs_job *job;
+    pthread_t thread;
+    mlt_profile profile;
+    mlt_producer producer;
+    VSMotionDetectConfig conf;
+    mlt_image_format format;
+    char *rescale;
+    char *filename;
+    mlt_position offset; // the producer position of the first frame of the filter
+    mlt_position start;
+    mlt_position end;
+    int error;
+};
+
+/** Detect the motions of a chunk of the clip and write them to the file of the chunk.
+ */
+
+static void *analyze_chunk(void *arg)
+{
+    vs_chunk *chunk = (vs_chunk *) arg;
+    vs_job *job = chunk->job;
+    VSMotionDetect md;
+    int initialized = 0;
+    FILE *results = mlt_fopen(chunk->filename, "w");
+
+    // Start one frame early to have the previous frame of the first motion
+    mlt_position pos = chunk->start > 0 ? chunk->start - 1 : 0;
+    chunk->error = results == NULL;
+    for (; pos < chunk->end && !chunk->error; pos++) {
+        pthread_mutex_lock(&job->mutex);
+        int stop = job->stop;
+        pthread_mutex_unlock(&job->mutex);
+        if (stop)
+            break;
+
+        mlt_frame frame = NULL;
+        uint8_t *image = NULL;
+        uint8_t *vs_image = NULL;
+        mlt_image_format format = chunk->format;
+        int width = chunk->profile->width;
+        int height = chunk->profile->height;
+
+        mlt_producer_seek(chunk->producer, chunk->offset + pos);
+        if (mlt_service_get_frame(MLT_PRODUCER_SERVICE(chunk->producer), &frame, 0) || !frame) {
+            chunk->error = 1;
+            break;
+        }
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "consumer.progressive", 1);
+        mlt_properties_set(MLT_FRAME_PROPERTIES(frame), "consumer.rescale", chunk->rescale);
+
+        if (!mlt_frame_get_image(frame, &image, &format, &width, &height, 1)) {
+            VSPixelFormat vs_format = mltimage_to_vsimage(format, width, height, image, &vs_image);
+            if (vs_image && !initialized) {
+                VSFrameInfo fi;
+                vsFrameInfoInit(&fi, width, height, vs_format);
+                vsMotionDetectInit(&md, &chunk->conf, &fi);
+#ifdef ASCII_SERIALIZATION_MODE
+                md.serializationMode = ASCII_SERIALIZATION_MODE;
+#endif
+                initialized = 1;
+                if (chunk->start == 0 && vsPrepareFile(&md, results) != VS_OK)
+                    chunk->error = 1;
+            }
+            if (vs_image && !chunk->error) {
+                LocalMotions localmotions;
+                VSFrame vsFrame;
+                vsFrameFillFromBuffer(&vsFrame, vs_image, &md.fi);
+                if (vsMotionDetection(&md, &localmotions, &vsFrame) == VS_OK) {
+                    if (pos >= chunk->start) {
+                        // Number the motions by their position in the whole clip
+                        int frame_num = md.frameNum;
+                        md.frameNum = pos + 1;
+                        vsWriteToFile(&md, results, &localmotions);
+                        md.frameNum = frame_num;
+                    }
+                    vs_vector_del(&localmotions);
+                } else {
+                    chunk->error = 1;
+                }
+            }
+            if (vs_image)
+                free_vsimage(vs_image, vs_format);
+        }
+        if (!vs_image)
+            chunk->error = 1;
+        mlt_frame_close(frame);
+
+        if (pos >= chunk->start) {
+            pthread_mutex_lock(&job->mutex);
+            job->done++;
+            pthread_cond_signal(&job->cond);
+            pthread_mutex_unlock(&job->mutex);
+        }
+    }
+
+    if (initialized)
+        vsMotionDetectionCleanup(&md);
+    if (results)
+        fclose(results);
+    pthread_mutex_lock(&job->mutex);
+    job->running--;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->mutex);
+    return NULL;
+}
+
+static int append_file(FILE *dest, const char *filename)
+{
+    FILE *src = mlt_fopen(filename, "r");
+    char buffer[65536];
+    size_t size;
+    int error = src == NULL;
+
+    while (src && (size = fread(buffer, 1, sizeof(buffer), src)) > 0)
+        error |= fwrite(buffer, 1, size, dest) != size;
+    if (src)
+        fclose(src);
+    return error;
+}
+
+/** Run the chunks of a job and join their motions in the results file.
+ *
+ * The "vidstab-progress" event reports the percentage of frames analyzed.
+ */
+
+static void *run_job(void *arg)
+{
+    vs_job *job = (vs_job *) arg;
+    mlt_properties properties = MLT_FILTER_PROPERTIES(job->filter);
+    int error = 0;
+    int i;
+
+    for (i = 0; i < job->count; i++)
+        pthread_create(&job->chunks[i].thread, NULL, analyze_chunk, &job->chunks[i]);
+
+    // Report the progress from this thread while the chunks run
+    int percent = -1;
+    pthread_mutex_lock(&job->mutex);
+    while (job->running > 0) {
+        pthread_cond_wait(&job->cond, &job->mutex);
+        if (job->done * 100 / job->length != percent && !job->stop) {
+            percent = job->done * 100 / job->length;
+            pthread_mutex_unlock(&job->mutex);
+            mlt_events_fire(properties, "vidstab-progress", mlt_event_data_from_int(percent));
+            pthread_mutex_lock(&job->mutex);
+        }
+    }
+    error = job->stop;
+    pthread_mutex_unlock(&job->mutex);
+    for (i = 0; i < job->count; i++) {
+        pthread_join(job->chunks[i].thread, NULL);
+        error |= job->chunks[i].error;
+    }
+
+    // Join the motions of the chunks in order
+    if (!error) {
+        FILE *results = mlt_fopen(job->filename, "a");
+        error = results == NULL;
+        for (i = 1; i < job->count && !error; i++)
+            error = append_file(results, job->chunks[i].filename);
+        if (results)
+            fclose(results);
+    }
+
+    pthread_mutex_lock(&job->mutex);
+    job->error = error;
+    job->finished = 1;
+    pthread_mutex_unlock(&job->mutex);
+    return NULL;
+}
+
+static void close_job(vs_job *job)
+{
+    int i;
+
+    for (i = 0; i < job->count; i++) {
+        vs_chunk *chunk = &job->chunks[i];
+        mlt_producer_close(chunk->producer);
+        mlt_profile_close(chunk->profile);
+        if (i > 0 && chunk->filename)
+            remove(chunk->filename);
+        free(chunk->filename);
+        free(chunk->rescale);
+    }
+    free(job->chunks);
+    free(job->filename);
+    free(job);
+}
+
+/** Start analyzing the whole clip in parallel on threads of its own.
+ *
+ * \return the job or NULL if the clip can not be analyzed this way and needs a serial pass
+ */
+
+static vs_job *start_job(mlt_filter filter, mlt_frame frame, VSPixelFormat vs_format, int jobs)
+{
+    mlt_properties properties = MLT_FILTER_PROPERTIES(filter);
+    mlt_producer producer = mlt_frame_get_original_producer(frame);
+    mlt_profile profile = mlt_service_profile(MLT_FILTER_SERVICE(filter));
+    mlt_position length = mlt_filter_get_length2(filter, frame);
+    const char *filename = mlt_properties_get(properties, "filename");
+    VSMotionDetectConfig conf;
+    int error = 0;
+    int i;
+
+    // The virtual tripod and the visualization need a single serial pass
+    get_motion_config(&conf, filter);
+    if (!producer || !profile || !filename || conf.virtualTripod || conf.show)
+        return NULL;
+    if (jobs > length / 2)
+        jobs = length / 2;
+    if (jobs < 2)
+        return NULL;
+
+    vs_job *job = (vs_job *) calloc(1, sizeof(vs_job));
+    job->filter = filter;
+    job->chunks = (vs_chunk *) calloc(jobs, sizeof(vs_chunk));
+    job->count = jobs;
+    job->length = length;
+    job->filename = strdup(filename);
+    job->running = jobs;
+    mlt_position size = (length + jobs - 1) / jobs;
+    mlt_position offset = mlt_frame_original_position(frame) - mlt_filter_get_position(filter, frame);
+    const char *rescale = mlt_properties_get(MLT_FRAME_PROPERTIES(frame), "consumer.rescale");
+    for (i = 0; i < jobs && !error; i++) {
+        vs_chunk *chunk = &job->chunks[i];
+        chunk->job = job;
+        chunk->profile = mlt_profile_clone(profile);
+        chunk->producer = mlt_producer_clone_before(producer, chunk->profile, filter);
+        chunk->conf = conf;
+        chunk->format = vs_format == PF_YUV420P ? mlt_image_yuv420p : mlt_image_yuv422;
+        chunk->rescale = strdup(rescale ? rescale : "bilinear");
+        chunk->offset = offset;
+        chunk->start = i * size;
+        chunk->end = MIN(chunk->start + size, length);
+        if (i == 0) {
+            chunk->filename = strdup(filename);
+        } else {
+            chunk->filename = (char *) malloc(strlen(filename) + 20);
+            sprintf(chunk->filename, "%s.chunk%d", filename, i);
+        }
+        error = !chunk->producer;
+    }
+    if (error) {
+        mlt_log_info(MLT_FILTER_SERVICE(filter), "Can not analyze in parallel, using one pass\n");
+        close_job(job);
+        return NULL;
+    }
+    mlt_log_info(MLT_FILTER_SERVICE(filter), "Analyzing %d frames in %d jobs\n", length, jobs);
+    pthread_mutex_init(&job->mutex, NULL);
+    pthread_cond_init(&job->cond, NULL);
+    pthread_create(&job->thread, NULL, run_job, job);
+    return job;
+}
+
+static void stop_job(vs_data *data)
+{
+    vs_job *job = data->job;
+
+    if (!job)
+        return;
+    pthread_mutex_lock(&job->mutex);
+    job->stop = 1;
+    pthread_mutex_unlock(&job->mutex);
+    pthread_join(job->thread, NULL);
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->mutex);
+    close_job(job);
+    data->job = NULL;
+}
+
+/** Publish the results of the parallel analysis once it finished.
+ */
+
+static void check_job(mlt_filter filter, vs_data *data)
+{
+    vs_job *job = data->job;
+
+    pthread_mutex_lock(&job->mutex);
+    int finished = job->finished;
+    int error = job->error;
+    pthread_mutex_unlock(&job->mutex);
+    if (!finished)
+        return;
+
+    stop_job(data);
+    if (error) {
+        mlt_log_error(MLT_FILTER_SERVICE(filter), "Motion detection failed\n");
+        data->job_failed = 1;
+    } else {
+        mlt_log_info(MLT_FILTER_SERVICE(filter), "Analysis complete\n");
+        mlt_properties_set(MLT_FILTER_PROPERTIES(filter),
+                           "results",
+                           mlt_properties_get(MLT_FILTER_PROPERTIES(filter), "filename"));
+    }
+}
+
 static void analyze_image(mlt_filter filter,
                           mlt_frame frame,
                           uint8_t *vs_image,
@@ -286,6 +622,19 @@ static void analyze_image(mlt_filter filter,
         data->analyze_data = NULL;
     }
 
+    int jobs = mlt_properties_get_int(properties, "analyze_jobs");
+    if (!data->analyze_data && !data->job_failed && jobs > 1) {
+        // Analyze the whole clip in parallel when asked and pass the frames through meanwhile
+        if (!data->job) {
+            data->job = start_job(filter, frame, vs_format, jobs);
+            data->job_failed = !data->job;
+        }
+        if (data->job) {
+            check_job(filter, data);
+            return;
+        }
+    }
+
     if (!data->analyze_data && pos == 0) {
         // Analysis must start on the first frame
         init_analyze_data(filter, frame, vs_format, width, height);
@@ -385,6 +734,7 @@ static void filter_close(mlt_filter filter)
 {
     vs_data *data = (vs_data *) filter->child;
     if (data) {
+        stop_job(data);
         if (data->analyze_data)
             destroy_analyze_data(data->analyze_data);
         if (data->apply_data)
@@ -437,6 +787,7 @@ mlt_filter filter_vidstab_init(mlt_profile profile, mlt_service_type type, const
         mlt_properties_set(properties, "reload", "0");
 
         mlt_properties_set(properties, "vid.stab.version", LIBVIDSTAB_VERSION);
+        mlt_events_register(properties, "vidstab-progress");
 
         init_vslog();
     } else {
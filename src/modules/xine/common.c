@@ -21,6 +21,27 @@
 #include "deinterlace.h"
 #include "yadif.h"
 
+#include <framework/mlt_pool.h>
+#include <framework/mlt_slices.h>
+
+#include <string.h>
+
+// The number of rows that a slice converts to planes at a time
+#define YADIF_CHUNK_ROWS (16)
+
+#define YADIF_MODE_TEMPORAL_SPATIAL (0)
+#define YADIF_MODE_TEMPORAL (2)
+
+typedef struct
+{
+    mlt_image dst;
+    mlt_image src;
+    mlt_image prev;
+    mlt_image next;
+    int mode;
+    int tff;
+} yadif_slice_desc;
+
 static yadif_filter *init_yadif(int width, int height)
 {
     yadif_filter *yadif = mlt_pool_alloc(sizeof(*yadif));
@@ -69,23 +90,207 @@ static void close_yadif(yadif_filter *yadif)
     mlt_pool_release(yadif->udest);
     mlt_pool_release(yadif->vdest);
     mlt_pool_release(yadif);
+}
 
-#if defined(__GNUC__) && !defined(PIC)
-    // Set SSSE3 bit to cpu
-    asm("mov $1, %%eax \n\t"
-        "push %%ebx \n\t"
-        "cpuid \n\t"
-        "pop %%ebx \n\t"
-        "mov %%ecx, %%edx \n\t"
-        "shr $9, %%edx \n\t"
-        "and $1, %%edx \n\t"
-        "shl $9, %%edx \n\t"
-        "and $511, %%ebx \n\t"
-        "or %%edx, %%ebx \n\t"
-        : "=b"(yadif->cpu)
-        : "p"(yadif->cpu)
-        : "%eax", "%ecx", "%edx");
-#endif
+/** Deinterlace a slice of packed YUV 4:2:2 rows.
+ *
+ * The rows are converted to planes a chunk at a time, with the two rows on
+ * either side that yadif reads, so that the planes stay in the cache.
+ */
+
+static int yadif_yuv422_slice(int id, int idx, int jobs, void *cookie)
+{
+    yadif_slice_desc *desc = (yadif_slice_desc *) cookie;
+    int width = desc->src->width;
+    int height = desc->src->height;
+    int pitch = desc->src->strides[0];
+    int start = 0;
+    int end = start + mlt_slices_size_slice(jobs, idx, height, &start);
+    const int parity = 0;
+    yadif_filter *yadif = init_yadif(width, YADIF_CHUNK_ROWS + 4);
+    int y0;
+
+    for (y0 = start; y0 < end; y0 += YADIF_CHUNK_ROWS) {
+        int y1 = MIN(y0 + YADIF_CHUNK_ROWS, end);
+        int row0 = MAX(0, y0 - 2);
+        int rows = MIN(height, y1 + 2) - row0;
+
+        // Convert packed to planar
+        YUY2ToPlanes(desc->src->planes[0] + row0 * pitch,
+                     pitch,
+                     width,
+                     rows,
+                     yadif->ysrc,
+                     yadif->ypitch,
+                     yadif->usrc,
+                     yadif->vsrc,
+                     yadif->uvpitch,
+                     yadif->cpu);
+        YUY2ToPlanes(desc->prev->planes[0] + row0 * pitch,
+                     pitch,
+                     width,
+                     rows,
+                     yadif->yprev,
+                     yadif->ypitch,
+                     yadif->uprev,
+                     yadif->vprev,
+                     yadif->uvpitch,
+                     yadif->cpu);
+        YUY2ToPlanes(desc->next->planes[0] + row0 * pitch,
+                     pitch,
+                     width,
+                     rows,
+                     yadif->ynext,
+                     yadif->ypitch,
+                     yadif->unext,
+                     yadif->vnext,
+                     yadif->uvpitch,
+                     yadif->cpu);
+
+        // Deinterlace each plane
+        filter_plane_rows(desc->mode,
+                          yadif->ydest,
+                          yadif->ypitch,
+                          yadif->yprev,
+                          yadif->ysrc,
+                          yadif->ynext,
+                          yadif->ypitch,
+                          width,
+                          height,
+                          parity,
+                          desc->tff,
+                          yadif->cpu,
+                          row0,
+                          y0,
+                          y1);
+        filter_plane_rows(desc->mode,
+                          yadif->udest,
+                          yadif->uvpitch,
+                          yadif->uprev,
+                          yadif->usrc,
+                          yadif->unext,
+                          yadif->uvpitch,
+                          width >> 1,
+                          height,
+                          parity,
+                          desc->tff,
+                          yadif->cpu,
+                          row0,
+                          y0,
+                          y1);
+        filter_plane_rows(desc->mode,
+                          yadif->vdest,
+                          yadif->uvpitch,
+                          yadif->vprev,
+                          yadif->vsrc,
+                          yadif->vnext,
+                          yadif->uvpitch,
+                          width >> 1,
+                          height,
+                          parity,
+                          desc->tff,
+                          yadif->cpu,
+                          row0,
+                          y0,
+                          y1);
+
+        // Convert planar to packed
+        YUY2FromPlanes(desc->dst->planes[0] + y0 * pitch,
+                       pitch,
+                       width,
+                       y1 - y0,
+                       yadif->ydest + (y0 - row0) * yadif->ypitch,
+                       yadif->ypitch,
+                       yadif->udest + (y0 - row0) * yadif->uvpitch,
+                       yadif->vdest + (y0 - row0) * yadif->uvpitch,
+                       yadif->uvpitch,
+                       yadif->cpu);
+    }
+
+    close_yadif(yadif);
+    return 0;
+}
+
+/** Deinterlace a slice of each plane of a 16-bit planar image.
+ */
+
+static int yadif_planar16_slice(int id, int idx, int jobs, void *cookie)
+{
+    yadif_slice_desc *desc = (yadif_slice_desc *) cookie;
+    const int parity = 0;
+    int plane;
+
+    for (plane = 0; plane < 3; plane++) {
+        int width = plane ? desc->src->width >> 1 : desc->src->width;
+        int height = plane && desc->src->format == mlt_image_yuv420p10 ? desc->src->height >> 1
+                                                                        : desc->src->height;
+        int stride = desc->src->strides[plane] / 2;
+        int start = 0;
+        int end = start + mlt_slices_size_slice(jobs, idx, height, &start);
+
+        filter_plane16_rows(desc->mode,
+                            (uint16_t *) desc->dst->planes[plane],
+                            desc->dst->strides[plane] / 2,
+                            (const uint16_t *) desc->prev->planes[plane],
+                            (const uint16_t *) desc->src->planes[plane],
+                            (const uint16_t *) desc->next->planes[plane],
+                            stride,
+                            width,
+                            height,
+                            parity,
+                            desc->tff,
+                            0,
+                            start,
+                            end);
+    }
+    return 0;
+}
+
+/** Deinterlace an image with yadif using the slice threads.
+ */
+
+static void yadif_image(mlt_image dst,
+                        mlt_image src,
+                        mlt_image prev,
+                        mlt_image next,
+                        int tff,
+                        mlt_deinterlacer method)
+{
+    yadif_slice_desc desc;
+    desc.dst = dst;
+    desc.src = src;
+    desc.prev = prev;
+    desc.next = next;
+    desc.mode = method == mlt_deinterlacer_yadif_nospatial ? YADIF_MODE_TEMPORAL
+                                                           : YADIF_MODE_TEMPORAL_SPATIAL;
+    desc.tff = tff;
+
+    // The planes may not have been set by whoever got the image data
+    mlt_image_format_planes(src->format, src->width, src->height, src->data, src->planes, src->strides);
+    mlt_image_format_planes(prev->format,
+                            prev->width,
+                            prev->height,
+                            prev->data,
+                            prev->planes,
+                            prev->strides);
+    mlt_image_format_planes(next->format,
+                            next->width,
+                            next->height,
+                            next->data,
+                            next->planes,
+                            next->strides);
+    mlt_image_format_planes(dst->format, dst->width, dst->height, dst->data, dst->planes, dst->strides);
+
+    if (src->format == mlt_image_yuv422)
+        mlt_slices_run_normal(0, yadif_yuv422_slice, &desc);
+    else
+        mlt_slices_run_normal(0, yadif_planar16_slice, &desc);
+}
+
+int deinterlace_yadif_supports_format(mlt_image_format format)
+{
+    return format == mlt_image_yuv422 || format == mlt_image_yuv422p16
+           || format == mlt_image_yuv420p10;
 }
 
 mlt_deinterlacer supported_method(mlt_deinterlacer method)
@@ -116,13 +321,19 @@ int deinterlace_image(
     }
 
     if (method >= mlt_deinterlacer_yadif_nospatial
-        && (!prev || !next || !prev->data || !next->data)) {
+        && (!prev || !next || !prev->data || !next->data || prev->format != src->format
+            || next->format != src->format)) {
         method = mlt_deinterlacer_linearblend;
     } else if ((method == mlt_deinterlacer_weave || method == mlt_deinterlacer_greedy)
                && (!next || !next->data)) {
         method = mlt_deinterlacer_linearblend;
     }
 
+    // Only yadif handles the formats other than packed YUV 4:2:2
+    if (src->format != mlt_image_yuv422 && method < mlt_deinterlacer_yadif_nospatial) {
+        return 1;
+    }
+
     if (method == mlt_deinterlacer_bob) {
         deinterlace_yuv(dst->data,
                         (uint8_t **) &src->data,
@@ -152,101 +363,7 @@ int deinterlace_image(
         src_array[1] = next->data;
         deinterlace_yuv(dst->data, src_array, src->width * 2, src->height, DEINTERLACE_GREEDY);
     } else if (method >= mlt_deinterlacer_yadif_nospatial) {
-        yadif_filter *yadif = init_yadif(src->width, src->height);
-        if (yadif) {
-            const int pitch = src->width << 1;
-            const int parity = 0;
-            const int YADIF_MODE_TEMPORAL_SPATIAL = 0;
-            const int YADIF_MODE_TEMPORAL = 2;
-            int mode = YADIF_MODE_TEMPORAL_SPATIAL;
-            if (method == mlt_deinterlacer_yadif_nospatial) {
-                mode = YADIF_MODE_TEMPORAL;
-            }
-
-            // Convert packed to planar
-            YUY2ToPlanes(src->data,
-                         pitch,
-                         src->width,
-                         src->height,
-                         yadif->ysrc,
-                         yadif->ypitch,
-                         yadif->usrc,
-                         yadif->vsrc,
-                         yadif->uvpitch,
-                         yadif->cpu);
-            YUY2ToPlanes(prev->data,
-                         pitch,
-                         src->width,
-                         src->height,
-                         yadif->yprev,
-                         yadif->ypitch,
-                         yadif->uprev,
-                         yadif->vprev,
-                         yadif->uvpitch,
-                         yadif->cpu);
-            YUY2ToPlanes(next->data,
-                         pitch,
-                         src->width,
-                         src->height,
-                         yadif->ynext,
-                         yadif->ypitch,
-                         yadif->unext,
-                         yadif->vnext,
-                         yadif->uvpitch,
-                         yadif->cpu);
-
-            // Deinterlace each plane
-            filter_plane(mode,
-                         yadif->ydest,
-                         yadif->ypitch,
-                         yadif->yprev,
-                         yadif->ysrc,
-                         yadif->ynext,
-                         yadif->ypitch,
-                         src->width,
-                         src->height,
-                         parity,
-                         tff,
-                         yadif->cpu);
-            filter_plane(mode,
-                         yadif->udest,
-                         yadif->uvpitch,
-                         yadif->uprev,
-                         yadif->usrc,
-                         yadif->unext,
-                         yadif->uvpitch,
-                         src->width >> 1,
-                         src->height,
-                         parity,
-                         tff,
-                         yadif->cpu);
-            filter_plane(mode,
-                         yadif->vdest,
-                         yadif->uvpitch,
-                         yadif->vprev,
-                         yadif->vsrc,
-                         yadif->vnext,
-                         yadif->uvpitch,
-                         src->width >> 1,
-                         src->height,
-                         parity,
-                         tff,
-                         yadif->cpu);
-
-            // Convert planar to packed
-            YUY2FromPlanes(dst->data,
-                           pitch,
-                           src->width,
-                           src->height,
-                           yadif->ydest,
-                           yadif->ypitch,
-                           yadif->udest,
-                           yadif->vdest,
-                           yadif->uvpitch,
-                           yadif->cpu);
-
-            close_yadif(yadif);
-        }
+        yadif_image(dst, src, prev, next, tff, method);
     } else {
         // If all else fails, default to linear blend
         deinterlace_yuv(dst->data,
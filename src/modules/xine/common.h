@@ -23,6 +23,7 @@
 #include <framework/mlt_image.h>
 
 mlt_deinterlacer supported_method(mlt_deinterlacer method);
+int deinterlace_yadif_supports_format(mlt_image_format format);
 int deinterlace_image(
     mlt_image dst, mlt_image src, mlt_image prev, mlt_image next, int tff, mlt_deinterlacer method);
 
@@ -17,8 +17,8 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include "common.h"
 #include "deinterlace.h"
-#include "yadif.h"
 #include <framework/mlt_events.h>
 #include <framework/mlt_filter.h>
 #include <framework/mlt_log.h>
@@ -32,73 +32,6 @@
 #define YADIF_MODE_TEMPORAL_SPATIAL (0)
 #define YADIF_MODE_TEMPORAL (2)
 
-static yadif_filter *init_yadif(int width, int height)
-{
-    yadif_filter *yadif = mlt_pool_alloc(sizeof(*yadif));
-
-    yadif->cpu = 0; // Pure C
-#ifdef USE_SSE
-    yadif->cpu |= AVS_CPU_INTEGER_SSE;
-#endif
-#ifdef USE_SSE2
-    yadif->cpu |= AVS_CPU_SSE2;
-#endif
-    // Create intermediate planar planes
-    yadif->yheight = height;
-    yadif->ywidth = width;
-    yadif->uvwidth = yadif->ywidth / 2;
-    yadif->ypitch = (yadif->ywidth + 15) / 16 * 16;
-    yadif->uvpitch = (yadif->uvwidth + 15) / 16 * 16;
-    yadif->ysrc = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->ypitch);
-    yadif->usrc = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->uvpitch);
-    yadif->vsrc = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->uvpitch);
-    yadif->yprev = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->ypitch);
-    yadif->uprev = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->uvpitch);
-    yadif->vprev = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->uvpitch);
-    yadif->ynext = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->ypitch);
-    yadif->unext = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->uvpitch);
-    yadif->vnext = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->uvpitch);
-    yadif->ydest = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->ypitch);
-    yadif->udest = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->uvpitch);
-    yadif->vdest = (unsigned char *) mlt_pool_alloc(yadif->yheight * yadif->uvpitch);
-
-    return yadif;
-}
-
-static void close_yadif(yadif_filter *yadif)
-{
-    mlt_pool_release(yadif->ysrc);
-    mlt_pool_release(yadif->usrc);
-    mlt_pool_release(yadif->vsrc);
-    mlt_pool_release(yadif->yprev);
-    mlt_pool_release(yadif->uprev);
-    mlt_pool_release(yadif->vprev);
-    mlt_pool_release(yadif->ynext);
-    mlt_pool_release(yadif->unext);
-    mlt_pool_release(yadif->vnext);
-    mlt_pool_release(yadif->ydest);
-    mlt_pool_release(yadif->udest);
-    mlt_pool_release(yadif->vdest);
-    mlt_pool_release(yadif);
-
-#if defined(__GNUC__) && !defined(PIC)
-    // Set SSSE3 bit to cpu
-    asm("mov $1, %%eax \n\t"
-        "push %%ebx \n\t"
-        "cpuid \n\t"
-        "pop %%ebx \n\t"
-        "mov %%ecx, %%edx \n\t"
-        "shr $9, %%edx \n\t"
-        "and $1, %%edx \n\t"
-        "shl $9, %%edx \n\t"
-        "and $511, %%ebx \n\t"
-        "or %%edx, %%ebx \n\t"
-        : "=b"(yadif->cpu)
-        : "p"(yadif->cpu)
-        : "%eax", "%ecx", "%edx");
-#endif
-}
-
 static int deinterlace_yadif(mlt_frame frame,
                              mlt_filter filter,
                              uint8_t **image,
@@ -127,6 +60,11 @@ static int deinterlace_yadif(mlt_frame frame,
     if (!previous_frame || !next_frame)
         return 1;
 
+    // Keep the bit depth of high bit depth requests
+    mlt_image_format yadif_format = mlt_image_yuv422;
+    if (deinterlace_yadif_supports_format(*format))
+        yadif_format = *format;
+
     mlt_service_lock(MLT_FILTER_SERVICE(filter));
 
     // Get the preceding frame's image
@@ -141,109 +79,45 @@ static int deinterlace_yadif(mlt_frame frame,
     // Check that we aren't already progressive
     if (!error && previous_image && !progressive) {
         // OK, now we know we have work to do and can request the image in our format
-        frame->convert_image(previous_frame, &previous_image, format, mlt_image_yuv422);
+        if (*format != yadif_format)
+            yadif_format = mlt_image_yuv422;
+        frame->convert_image(previous_frame, &previous_image, format, yadif_format);
 
         mlt_service_unlock(MLT_FILTER_SERVICE(filter));
 
         // Get the current frame's image
-        *format = mlt_image_yuv422;
-        error = mlt_frame_get_image(frame, image, format, width, height, 1);
+        *format = yadif_format;
+        error = mlt_frame_get_image(frame, image, format, width, height, 0);
 
-        if (!error && *image && *format == mlt_image_yuv422) {
-            // Get the following frame's image
+        if (!error && *image && *format == yadif_format) {
+            // Get the following frame's image, which may be shared with another frame
+            mlt_service_lock(MLT_FILTER_SERVICE(filter));
             error
                 = mlt_frame_get_image(next_frame, &next_image, format, &next_width, &next_height, 0);
-
-            if (!error && next_image && *format == mlt_image_yuv422) {
-                yadif_filter *yadif = init_yadif(*width, *height);
-                if (yadif) {
-                    const int order = mlt_properties_get_int(properties, "top_field_first");
-                    const int pitch = *width << 1;
-                    const int parity = 0;
-
-                    // Convert packed to planar
-                    YUY2ToPlanes(*image,
-                                 pitch,
-                                 *width,
-                                 *height,
-                                 yadif->ysrc,
-                                 yadif->ypitch,
-                                 yadif->usrc,
-                                 yadif->vsrc,
-                                 yadif->uvpitch,
-                                 yadif->cpu);
-                    YUY2ToPlanes(previous_image,
-                                 pitch,
-                                 *width,
-                                 *height,
-                                 yadif->yprev,
-                                 yadif->ypitch,
-                                 yadif->uprev,
-                                 yadif->vprev,
-                                 yadif->uvpitch,
-                                 yadif->cpu);
-                    YUY2ToPlanes(next_image,
-                                 pitch,
-                                 *width,
-                                 *height,
-                                 yadif->ynext,
-                                 yadif->ypitch,
-                                 yadif->unext,
-                                 yadif->vnext,
-                                 yadif->uvpitch,
-                                 yadif->cpu);
-
-                    // Deinterlace each plane
-                    filter_plane(mode,
-                                 yadif->ydest,
-                                 yadif->ypitch,
-                                 yadif->yprev,
-                                 yadif->ysrc,
-                                 yadif->ynext,
-                                 yadif->ypitch,
-                                 *width,
-                                 *height,
-                                 parity,
-                                 order,
-                                 yadif->cpu);
-                    filter_plane(mode,
-                                 yadif->udest,
-                                 yadif->uvpitch,
-                                 yadif->uprev,
-                                 yadif->usrc,
-                                 yadif->unext,
-                                 yadif->uvpitch,
-                                 *width >> 1,
-                                 *height,
-                                 parity,
-                                 order,
-                                 yadif->cpu);
-                    filter_plane(mode,
-                                 yadif->vdest,
-                                 yadif->uvpitch,
-                                 yadif->vprev,
-                                 yadif->vsrc,
-                                 yadif->vnext,
-                                 yadif->uvpitch,
-                                 *width >> 1,
-                                 *height,
-                                 parity,
-                                 order,
-                                 yadif->cpu);
-
-                    // Convert planar to packed
-                    YUY2FromPlanes(*image,
-                                   pitch,
-                                   *width,
-                                   *height,
-                                   yadif->ydest,
-                                   yadif->ypitch,
-                                   yadif->udest,
-                                   yadif->vdest,
-                                   yadif->uvpitch,
-                                   yadif->cpu);
-
-                    close_yadif(yadif);
+            mlt_service_unlock(MLT_FILTER_SERVICE(filter));
+
+            if (!error && next_image && *format == yadif_format) {
+                struct mlt_image_s srcimg, previmg, nextimg, dstimg;
+                const int order = mlt_properties_get_int(properties, "top_field_first");
+
+                mlt_image_set_values(&srcimg, *image, *format, *width, *height);
+                mlt_image_set_values(&previmg, previous_image, *format, *width, *height);
+                mlt_image_set_values(&nextimg, next_image, *format, *width, *height);
+                mlt_image_set_values(&dstimg, NULL, *format, *width, *height);
+                mlt_image_alloc_data(&dstimg);
+                error = deinterlace_image(&dstimg,
+                                          &srcimg,
+                                          &previmg,
+                                          &nextimg,
+                                          order,
+                                          mode == YADIF_MODE_TEMPORAL
+                                              ? mlt_deinterlacer_yadif_nospatial
+                                              : mlt_deinterlacer_yadif);
+                if (!error) {
+                    mlt_frame_set_image(frame, dstimg.data, 0, dstimg.release_data);
+                    *image = dstimg.data;
+                } else {
+                    mlt_image_close(&dstimg);
                 }
             }
         }
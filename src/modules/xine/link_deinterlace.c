@@ -72,6 +72,11 @@ static int link_get_image(mlt_frame frame,
         pdata->prev_next_required = 1;
     }
 
+    // Keep the bit depth of high bit depth requests when yadif can use it
+    mlt_image_format yadif_format = mlt_image_yuv422;
+    if (method >= mlt_deinterlacer_yadif_nospatial && deinterlace_yadif_supports_format(*format))
+        yadif_format = *format;
+
     if (srcimg.data) // Maybe already received during progressive check
     {
         if (srcimg.format != mlt_image_yuv422) {
@@ -85,7 +90,7 @@ static int link_get_image(mlt_frame frame,
             }
         }
     } else {
-        mlt_image_set_values(&srcimg, NULL, mlt_image_yuv422, *width, *height);
+        mlt_image_set_values(&srcimg, NULL, yadif_format, *width, *height);
         error = mlt_frame_get_image(frame,
                                     (uint8_t **) &srcimg.data,
                                     &srcimg.format,
@@ -96,6 +101,16 @@ static int link_get_image(mlt_frame frame,
             mlt_log_error(MLT_LINK_SERVICE(self), "Failed to get image\n");
             return error;
         }
+        if (srcimg.format != yadif_format && srcimg.format != mlt_image_yuv422) {
+            error = frame->convert_image(frame,
+                                         (uint8_t **) &srcimg.data,
+                                         &srcimg.format,
+                                         mlt_image_yuv422);
+            if (error) {
+                mlt_log_error(MLT_LINK_SERVICE(self), "Failed to convert image\n");
+                return error;
+            }
+        }
     }
 
     mlt_image_set_values(&dstimg, NULL, srcimg.format, srcimg.width, srcimg.height);
@@ -107,7 +122,7 @@ static int link_get_image(mlt_frame frame,
 
         mlt_frame prevframe = mlt_properties_get_data(unique_properties, "prev", NULL);
         if (prevframe) {
-            mlt_image_set_values(&previmg, NULL, mlt_image_yuv422, srcimg.width, srcimg.height);
+            mlt_image_set_values(&previmg, NULL, srcimg.format, srcimg.width, srcimg.height);
             error = mlt_frame_get_image(prevframe,
                                         (uint8_t **) &previmg.data,
                                         &previmg.format,
@@ -121,7 +136,7 @@ static int link_get_image(mlt_frame frame,
         }
         mlt_frame nextframe = mlt_properties_get_data(unique_properties, "next", NULL);
         if (nextframe) {
-            mlt_image_set_values(&nextimg, NULL, mlt_image_yuv422, srcimg.width, srcimg.height);
+            mlt_image_set_values(&nextimg, NULL, srcimg.format, srcimg.width, srcimg.height);
             error = mlt_frame_get_image(nextframe,
                                         (uint8_t **) &nextimg.data,
                                         &nextimg.format,
@@ -135,6 +150,24 @@ static int link_get_image(mlt_frame frame,
         }
     }
 
+    if (srcimg.format != mlt_image_yuv422
+        && (!previmg.data || !nextimg.data || previmg.format != srcimg.format
+            || nextimg.format != srcimg.format)) {
+        // The other methods need packed YUV 4:2:2
+        error = frame->convert_image(frame,
+                                     (uint8_t **) &srcimg.data,
+                                     &srcimg.format,
+                                     mlt_image_yuv422);
+        if (error) {
+            mlt_log_error(MLT_LINK_SERVICE(self), "Failed to convert image\n");
+            return error;
+        }
+        dstimg.format = srcimg.format;
+        mlt_image_alloc_data(&dstimg);
+        previmg.data = NULL;
+        nextimg.data = NULL;
+    }
+
     int tff = mlt_properties_get_int(MLT_FRAME_PROPERTIES(frame), "top_field_first");
     error = deinterlace_image(&dstimg, &srcimg, &previmg, &nextimg, tff, method);
     if (error) {
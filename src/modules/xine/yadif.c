@@ -25,6 +25,9 @@
 #include <stdlib.h>
 #include <memory.h>
 #include <stdint.h>
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
 
 #define MIN(a,b) ((a) > (b) ? (b) : (a))
 #define MAX(a,b) ((a) < (b) ? (b) : (a))
@@ -33,7 +36,7 @@
 #define MIN3(a,b,c) MIN(MIN(a,b),c)
 #define MAX3(a,b,c) MAX(MAX(a,b),c)
 
-static void (*filter_line)(int mode, uint8_t *dst, const uint8_t *prev, const uint8_t *cur, const uint8_t *next, int w, int refs, int parity);
+typedef void (*filter_line_func)(int mode, uint8_t *dst, const uint8_t *prev, const uint8_t *cur, const uint8_t *next, int w, int refs, int parity);
 
 #if defined(__GNUC__) && defined(USE_SSE)
 
@@ -347,6 +350,68 @@ static void filter_line_c(int mode, uint8_t *dst, const uint8_t *prev, const uin
     }
 }
 
+static void filter_line_c16(int mode, uint16_t *dst, const uint16_t *prev, const uint16_t *cur, const uint16_t *next, int w, int refs, int parity){
+    int x;
+    const uint16_t *prev2= parity ? prev : cur ;
+    const uint16_t *next2= parity ? cur  : next;
+    for(x=0; x<w; x++){
+        int c= cur[-refs];
+        int d= (prev2[0] + next2[0])>>1;
+        int e= cur[+refs];
+        int temporal_diff0= ABS(prev2[0] - next2[0]);
+        int temporal_diff1=( ABS(prev[-refs] - c) + ABS(prev[+refs] - e) )>>1;
+        int temporal_diff2=( ABS(next[-refs] - c) + ABS(next[+refs] - e) )>>1;
+        int diff= MAX3(temporal_diff0>>1, temporal_diff1, temporal_diff2);
+        int spatial_pred= (c+e)>>1;
+        int spatial_score= ABS(cur[-refs-1] - cur[+refs-1]) + ABS(c-e)
+                         + ABS(cur[-refs+1] - cur[+refs+1]) - 1;
+        int j;
+
+        // Same search as CHECK in filter_line_c: try the second slope only if the first one won
+        for(j=-1; j>=-2; j--){
+            int score= ABS(cur[-refs-1+ j] - cur[+refs-1- j])
+                     + ABS(cur[-refs  + j] - cur[+refs  - j])
+                     + ABS(cur[-refs+1+ j] - cur[+refs+1- j]);
+            if(score >= spatial_score)
+                break;
+            spatial_score= score;
+            spatial_pred= (cur[-refs  + j] + cur[+refs  - j])>>1;
+        }
+        for(j=1; j<=2; j++){
+            int score= ABS(cur[-refs-1+ j] - cur[+refs-1- j])
+                     + ABS(cur[-refs  + j] - cur[+refs  - j])
+                     + ABS(cur[-refs+1+ j] - cur[+refs+1- j]);
+            if(score >= spatial_score)
+                break;
+            spatial_score= score;
+            spatial_pred= (cur[-refs  + j] + cur[+refs  - j])>>1;
+        }
+
+        if(mode<2){
+            int b= (prev2[-2*refs] + next2[-2*refs])>>1;
+            int f= (prev2[+2*refs] + next2[+2*refs])>>1;
+            int max= MAX3(d-e, d-c, MIN(b-c, f-e));
+            int min= MIN3(d-e, d-c, MAX(b-c, f-e));
+
+            diff= MAX3(diff, min, -max);
+        }
+
+        if(spatial_pred > d + diff)
+           spatial_pred = d + diff;
+        else if(spatial_pred < d - diff)
+           spatial_pred = d - diff;
+
+        dst[0] = spatial_pred;
+
+        dst++;
+        cur++;
+        prev++;
+        next++;
+        prev2++;
+        next2++;
+    }
+}
+
 static void interpolate(uint8_t *dst, const uint8_t *cur0,  const uint8_t *cur2, int w)
 {
     int x;
@@ -355,10 +420,23 @@ static void interpolate(uint8_t *dst, const uint8_t *cur0,  const uint8_t *cur2,
     }
 }
 
-void filter_plane(int mode, uint8_t *dst, int dst_stride, const uint8_t *prev0, const uint8_t *cur0, const uint8_t *next0, int refs, int w, int h, int parity, int tff, int cpu){
+static void interpolate16(uint16_t *dst, const uint16_t *cur0,  const uint16_t *cur2, int w)
+{
+    int x;
+    for (x=0; x<w; x++) {
+        dst[x] = (cur0[x] + cur2[x] + 1)>>1; // simple average
+    }
+}
+
+/* Deinterlace the rows y0 to y1 - 1 of a plane that is h rows high.
+ * The plane pointers address row row0 and rows row0 to h - 1 are readable,
+ * which lets a slice hold only the rows around the ones it outputs.
+ * Rows y0 - 2 to y1 + 1 must be present, clipped to the plane.
+ */
+void filter_plane_rows(int mode, uint8_t *dst, int dst_stride, const uint8_t *prev0, const uint8_t *cur0, const uint8_t *next0, int refs, int w, int h, int parity, int tff, int cpu, int row0, int y0, int y1){
 
 	int y;
-	filter_line = filter_line_c;
+	filter_line_func filter_line = filter_line_c;
 #ifdef __GNUC__
 #if (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__>1)
 #ifdef USE_SSE3
@@ -377,41 +455,23 @@ void filter_plane(int mode, uint8_t *dst, int dst_stride, const uint8_t *prev0,
 		filter_line = filter_line_mmx2;
 #endif
 #endif // GNUC
-        y=0;
-        if(((y ^ parity) & 1)){
-            memcpy(dst, cur0 + refs, w);// duplicate 1
-        }else{
-            memcpy(dst, cur0, w);
-        }
-        y=1;
-        if(((y ^ parity) & 1)){
-            interpolate(dst + dst_stride, cur0, cur0 + refs*2, w);   // interpolate 0 and 2
-        }else{
-            memcpy(dst + dst_stride, cur0 + refs, w); // copy original
-        }
-        for(y=2; y<h-2; y++){
-            if(((y ^ parity) & 1)){
-                const uint8_t *prev= prev0 + y*refs;
-                const uint8_t *cur = cur0 + y*refs;
-                const uint8_t *next= next0 + y*refs;
-                uint8_t *dst2= dst + y*dst_stride;
-                filter_line(mode, dst2, prev, cur, next, w, refs, (parity ^ tff));
+        for(y=y0; y<y1; y++){
+            uint8_t *dst2= dst + (y-row0)*dst_stride;
+            const uint8_t *cur= cur0 + (y-row0)*refs;
+            if(!((y ^ parity) & 1)){
+                memcpy(dst2, cur, w); // copy original
+            }else if(y==0){
+                memcpy(dst2, cur + refs, w);// duplicate 1
+            }else if(y==1 || y==h-2){
+                interpolate(dst2, cur - refs, cur + refs, w);   // interpolate the neighbours
+            }else if(y==h-1){
+                memcpy(dst2, cur - refs, w); // duplicate h-2
             }else{
-                memcpy(dst + y*dst_stride, cur0 + y*refs, w); // copy original
+                const uint8_t *prev= prev0 + (y-row0)*refs;
+                const uint8_t *next= next0 + (y-row0)*refs;
+                filter_line(mode, dst2, prev, cur, next, w, refs, (parity ^ tff));
             }
         }
-       y=h-2;
-        if(((y ^ parity) & 1)){
-            interpolate(dst + (h-2)*dst_stride, cur0 + (h-3)*refs, cur0 + (h-1)*refs, w);   // interpolate h-3 and h-1
-        }else{
-            memcpy(dst + (h-2)*dst_stride, cur0 + (h-2)*refs, w); // copy original
-        }
-        y=h-1;
-        if(((y ^ parity) & 1)){
-            memcpy(dst + (h-1)*dst_stride, cur0 + (h-2)*refs, w); // duplicate h-2
-        }else{
-            memcpy(dst + (h-1)*dst_stride, cur0 + (h-1)*refs, w); // copy original
-        }
 
 #if defined(__GNUC__) && defined(USE_SSE)
 	if (cpu >= AVS_CPU_INTEGER_SSE)
@@ -419,6 +479,35 @@ void filter_plane(int mode, uint8_t *dst, int dst_stride, const uint8_t *prev0,
 #endif
 }
 
+void filter_plane(int mode, uint8_t *dst, int dst_stride, const uint8_t *prev0, const uint8_t *cur0, const uint8_t *next0, int refs, int w, int h, int parity, int tff, int cpu){
+	filter_plane_rows(mode, dst, dst_stride, prev0, cur0, next0, refs, w, h, parity, tff, cpu, 0, 0, h);
+}
+
+/* The same as filter_plane_rows for planes of 16-bit samples.
+ * The strides are in samples.
+ */
+void filter_plane16_rows(int mode, uint16_t *dst, int dst_stride, const uint16_t *prev0, const uint16_t *cur0, const uint16_t *next0, int refs, int w, int h, int parity, int tff, int row0, int y0, int y1){
+
+	int y;
+        for(y=y0; y<y1; y++){
+            uint16_t *dst2= dst + (y-row0)*dst_stride;
+            const uint16_t *cur= cur0 + (y-row0)*refs;
+            if(!((y ^ parity) & 1)){
+                memcpy(dst2, cur, w * 2); // copy original
+            }else if(y==0){
+                memcpy(dst2, cur + refs, w * 2);// duplicate 1
+            }else if(y==1 || y==h-2){
+                interpolate16(dst2, cur - refs, cur + refs, w);   // interpolate the neighbours
+            }else if(y==h-1){
+                memcpy(dst2, cur - refs, w * 2); // duplicate h-2
+            }else{
+                const uint16_t *prev= prev0 + (y-row0)*refs;
+                const uint16_t *next= next0 + (y-row0)*refs;
+                filter_line_c16(mode, dst2, prev, cur, next, w, refs, (parity ^ tff));
+            }
+        }
+}
+
 #if defined(__GNUC__) && defined(USE_SSE) && !defined(PIC)
 static attribute_align_arg void  YUY2ToPlanes_mmx(const unsigned char *srcYUY2, int pitch_yuy2, int width, int height,
                     unsigned char *py, int pitch_y,
@@ -499,6 +588,58 @@ static attribute_align_arg void YUY2FromPlanes_mmx(unsigned char *dstYUY2, int p
 }
 #endif // GNUC, USE_SSE, !PIC
 
+#ifdef USE_SSE2
+static void YUY2ToPlanes_sse2(const unsigned char *srcYUY2, int pitch_yuy2, int width, int height,
+                    unsigned char *py, int pitch_y,
+                    unsigned char *pu, unsigned char *pv,  int pitch_uv)
+{ /* process by 32 bytes (16 pixels), so width is assumed mod 16 */
+    const __m128i ymask = _mm_set1_epi16(0x00ff);
+    int h, w;
+    for (h=0; h<height; h++)
+    {
+        for (w=0; w<width; w+=16)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *) (srcYUY2 + w * 2));
+            __m128i b = _mm_loadu_si128((const __m128i *) (srcYUY2 + w * 2 + 16));
+            __m128i y = _mm_packus_epi16(_mm_and_si128(a, ymask), _mm_and_si128(b, ymask));
+            __m128i uv = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+            __m128i u = _mm_packus_epi16(_mm_and_si128(uv, ymask), uv);
+            __m128i v = _mm_packus_epi16(_mm_srli_epi16(uv, 8), uv);
+            _mm_storeu_si128((__m128i *) (py + w), y);
+            _mm_storel_epi64((__m128i *) (pu + (w>>1)), u);
+            _mm_storel_epi64((__m128i *) (pv + (w>>1)), v);
+        }
+        srcYUY2 += pitch_yuy2;
+        py += pitch_y;
+        pu += pitch_uv;
+        pv += pitch_uv;
+    }
+}
+
+static void YUY2FromPlanes_sse2(unsigned char *dstYUY2, int pitch_yuy2, int width, int height,
+                    const unsigned char *py, int pitch_y,
+                    const unsigned char *pu, const unsigned char *pv,  int pitch_uv)
+{
+    int h, w;
+    for (h=0; h<height; h++)
+    {
+        for (w=0; w<width; w+=16)
+        {
+            __m128i y = _mm_loadu_si128((const __m128i *) (py + w));
+            __m128i u = _mm_loadl_epi64((const __m128i *) (pu + (w>>1)));
+            __m128i v = _mm_loadl_epi64((const __m128i *) (pv + (w>>1)));
+            __m128i uv = _mm_unpacklo_epi8(u, v);
+            _mm_storeu_si128((__m128i *) (dstYUY2 + w * 2), _mm_unpacklo_epi8(y, uv));
+            _mm_storeu_si128((__m128i *) (dstYUY2 + w * 2 + 16), _mm_unpackhi_epi8(y, uv));
+        }
+        py += pitch_y;
+        pu += pitch_uv;
+        pv += pitch_uv;
+        dstYUY2 += pitch_yuy2;
+    }
+}
+#endif // USE_SSE2
+
 //----------------------------------------------------------------------------------------------
 
 void YUY2ToPlanes(const unsigned char *pSrcYUY2, int nSrcPitchYUY2, int nWidth, int nHeight,
@@ -513,6 +654,11 @@ void YUY2ToPlanes(const unsigned char *pSrcYUY2, int nSrcPitchYUY2, int nWidth,
         w0 = (nWidth/8)*8;
         YUY2ToPlanes_mmx(pSrcYUY2, nSrcPitchYUY2, w0, nHeight, pSrcY, srcPitchY, pSrcU, pSrcV, srcPitchUV);
     }
+#elif defined(USE_SSE2)
+    if (cpu & AVS_CPU_SSE2) {
+        w0 = (nWidth/16)*16;
+        YUY2ToPlanes_sse2(pSrcYUY2, nSrcPitchYUY2, w0, nHeight, pSrcY, srcPitchY, pSrcU, pSrcV, srcPitchUV);
+    }
 #endif
 	for (h=0; h<nHeight; h++)
 	{
@@ -544,6 +690,11 @@ void YUY2FromPlanes(unsigned char *pSrcYUY2, int nSrcPitchYUY2, int nWidth, int
         w0 = (nWidth/8)*8;
         YUY2FromPlanes_mmx(pSrcYUY2, nSrcPitchYUY2, w0, nHeight, pSrcY, srcPitchY, pSrcU, pSrcV, srcPitchUV);
     }
+#elif defined(USE_SSE2)
+    if (cpu & AVS_CPU_SSE2) {
+        w0 = (nWidth/16)*16;
+        YUY2FromPlanes_sse2(pSrcYUY2, nSrcPitchYUY2, w0, nHeight, pSrcY, srcPitchY, pSrcU, pSrcV, srcPitchUV);
+    }
 #endif
   for (h=0; h<nHeight; h++)
 	{
@@ -53,6 +53,8 @@ typedef struct yadif_filter  {
 } yadif_filter;
 
 void filter_plane(int mode, uint8_t *dst, int dst_stride, const uint8_t *prev0, const uint8_t *cur0, const uint8_t *next0, int refs, int w, int h, int parity, int tff, int cpu);
+void filter_plane_rows(int mode, uint8_t *dst, int dst_stride, const uint8_t *prev0, const uint8_t *cur0, const uint8_t *next0, int refs, int w, int h, int parity, int tff, int cpu, int row0, int y0, int y1);
+void filter_plane16_rows(int mode, uint16_t *dst, int dst_stride, const uint16_t *prev0, const uint16_t *cur0, const uint16_t *next0, int refs, int w, int h, int parity, int tff, int row0, int y0, int y1);
 void YUY2ToPlanes(const unsigned char *pSrcYUY2, int nSrcPitchYUY2, int nWidth, int nHeight,
 							   unsigned char * pSrcY, int srcPitchY,
 							   unsigned char * pSrcU,  unsigned char * pSrcV, int srcPitchUV, int cpu);
@@ -34,6 +34,52 @@
 #define _x (const xmlChar *)
 #define _s (const char *)
 
+// The deepest indentation used by xmlsave when formatting
+#define XML_MAX_INDENT 30
+
+typedef enum {
+    xml_writer_tree,   ///< build a libxml2 document
+    xml_writer_stream, ///< write the text directly to a file or buffer
+    xml_writer_record, ///< record the document to write it later
+    xml_writer_dry,    ///< only find the attributes that are added after content
+} xml_writer_type;
+
+struct xml_element_s
+{
+    const char *name;
+    xmlNodePtr node;
+    int index;
+    int content;
+};
+
+struct xml_attribute_s
+{
+    int index;
+    char *name;
+    char *value;
+};
+
+// This is the output of the serialiser
+struct xml_writer_s
+{
+    xml_writer_type type;
+    xmlDocPtr doc;
+    struct xml_element_s *stack;
+    int depth;
+    int stack_size;
+    int count;
+    struct xml_attribute_s *late;
+    int late_count;
+    int late_size;
+    FILE *file;
+    char *buffer;
+    size_t size;
+    size_t alloc;
+    int format;
+    int ascii;
+};
+typedef struct xml_writer_s *xml_writer;
+
 // This maintains counters for adding ids to elements
 struct serialise_context_s
 {
@@ -53,6 +99,7 @@ struct serialise_context_s
     int no_meta;
     mlt_profile profile;
     mlt_time_format time_format;
+    xml_writer writer;
 };
 typedef struct serialise_context_s *serialise_context;
 
@@ -64,7 +111,7 @@ static int consumer_stop(mlt_consumer parent);
 static int consumer_is_stopped(mlt_consumer consumer);
 static void consumer_close(mlt_consumer parent);
 static void *consumer_thread(void *arg);
-static void serialise_service(serialise_context context, mlt_service service, xmlNode *node);
+static void serialise_service(serialise_context context, mlt_service service);
 
 typedef enum {
     xml_existing,
@@ -184,10 +231,374 @@ mlt_consumer consumer_xml_init(mlt_profile profile, mlt_service_type type, const
     return NULL;
 }
 
-static void serialise_properties(serialise_context context, mlt_properties properties, xmlNode *node)
+/** Write text to the output of a writer.
+*/
+
+static void xml_writer_write(xml_writer writer, const char *text, size_t length)
+{
+    if (writer->file) {
+        fwrite(text, 1, length, writer->file);
+    } else {
+        if (writer->size + length + 1 > writer->alloc) {
+            writer->alloc = (writer->size + length + 1) * 2;
+            writer->buffer = realloc(writer->buffer, writer->alloc);
+        }
+        memcpy(writer->buffer + writer->size, text, length);
+        writer->size += length;
+        writer->buffer[writer->size] = '\0';
+    }
+}
+
+/** Write text escaped the same way as xmlsave does for attribute values or text content.
+*/
+
+static void xml_writer_escape(xml_writer writer, const char *text, int attribute)
+{
+    const unsigned char *s = (const unsigned char *) text;
+    const unsigned char *run = s;
+    char temp[16];
+
+    while (*s) {
+        const char *entity = NULL;
+        int length = 1;
+
+        if (*s == '<')
+            entity = "&lt;";
+        else if (*s == '>')
+            entity = "&gt;";
+        else if (*s == '&')
+            entity = "&amp;";
+        else if (*s == '\r')
+            entity = "&#13;";
+        else if (attribute && *s == '"')
+            entity = "&quot;";
+        else if (attribute && *s == '\n')
+            entity = "&#10;";
+        else if (attribute && *s == '\t')
+            entity = "&#9;";
+        else if (writer->ascii && *s >= 0x80) {
+            // Without an encoding the output is ASCII with character references
+            unsigned int c = 0;
+            if ((*s & 0xe0) == 0xc0 && (s[1] & 0xc0) == 0x80) {
+                c = ((s[0] & 0x1f) << 6) | (s[1] & 0x3f);
+                length = 2;
+            } else if ((*s & 0xf0) == 0xe0 && (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80) {
+                c = ((s[0] & 0x0f) << 12) | ((s[1] & 0x3f) << 6) | (s[2] & 0x3f);
+                length = 3;
+            } else if ((*s & 0xf8) == 0xf0 && (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80
+                       && (s[3] & 0xc0) == 0x80) {
+                c = ((s[0] & 0x07) << 18) | ((s[1] & 0x3f) << 12) | ((s[2] & 0x3f) << 6)
+                    | (s[3] & 0x3f);
+                length = 4;
+            }
+            if (c) {
+                snprintf(temp, sizeof(temp), "&#x%X;", c);
+                entity = temp;
+            }
+        }
+        if (entity) {
+            xml_writer_write(writer, (const char *) run, s - run);
+            xml_writer_write(writer, entity, strlen(entity));
+            run = s + length;
+        }
+        s += length;
+    }
+    xml_writer_write(writer, (const char *) run, s - run);
+}
+
+/** Write the indentation for the current depth when formatting.
+*/
+
+static void xml_writer_indent(xml_writer writer)
+{
+    static const char spaces[] = "                                                            ";
+    if (writer->format) {
+        int depth = writer->depth > XML_MAX_INDENT ? XML_MAX_INDENT : writer->depth;
+        xml_writer_write(writer, spaces, depth * 2);
+    }
+}
+
+/** Append an operation with its strings to a recording.
+*/
+
+static void xml_writer_append(xml_writer writer, char op, const char *a, const char *b)
+{
+    xml_writer_write(writer, &op, 1);
+    if (a)
+        xml_writer_write(writer, a, strlen(a) + 1);
+    if (b)
+        xml_writer_write(writer, b, strlen(b) + 1);
+}
+
+/** Write the attributes that were added to an element after its content.
+*/
+
+static void xml_writer_late_attributes(xml_writer writer, int index)
+{
+    int i;
+    for (i = 0; i < writer->late_count; i++) {
+        if (writer->late[i].index == index) {
+            xml_writer_write(writer, " ", 1);
+            xml_writer_write(writer, writer->late[i].name, strlen(writer->late[i].name));
+            xml_writer_write(writer, "=\"", 2);
+            xml_writer_escape(writer, writer->late[i].value, 1);
+            xml_writer_write(writer, "\"", 1);
+        }
+    }
+}
+
+/** Complete the start tag of the current element before it gets any content.
+*/
+
+static void xml_writer_content(xml_writer writer)
+{
+    if (writer->depth > 0 && !writer->stack[writer->depth - 1].content) {
+        struct xml_element_s *element = &writer->stack[writer->depth - 1];
+        element->content = 1;
+        if (writer->type == xml_writer_stream) {
+            xml_writer_late_attributes(writer, element->index);
+            xml_writer_write(writer, ">", 1);
+            if (writer->format)
+                xml_writer_write(writer, "\n", 1);
+        }
+    }
+}
+
+static void xml_writer_push(xml_writer writer, const char *name, xmlNodePtr node, int counted)
+{
+    if (writer->depth == writer->stack_size) {
+        writer->stack_size = writer->stack_size * 2 + 16;
+        writer->stack = realloc(writer->stack, writer->stack_size * sizeof(*writer->stack));
+    }
+    writer->stack[writer->depth].name = name;
+    writer->stack[writer->depth].node = node;
+    writer->stack[writer->depth].index = counted ? writer->count++ : -1;
+    writer->stack[writer->depth].content = 0;
+    writer->depth++;
+}
+
+/** Start a child element of the current element.
+ *
+ * The "property" and "properties" elements are not counted because a dry run does
+ * not produce them.
+ */
+
+static void xml_writer_start_element(xml_writer writer, const char *name, int counted)
+{
+    xmlNodePtr node = NULL;
+
+    xml_writer_content(writer);
+    switch (writer->type) {
+    case xml_writer_tree:
+        if (writer->depth) {
+            node = xmlNewChild(writer->stack[writer->depth - 1].node, NULL, _x(name), NULL);
+        } else {
+            node = xmlNewNode(NULL, _x(name));
+            xmlDocSetRootElement(writer->doc, node);
+        }
+        break;
+    case xml_writer_stream:
+        xml_writer_indent(writer);
+        xml_writer_write(writer, "<", 1);
+        xml_writer_write(writer, name, strlen(name));
+        break;
+    case xml_writer_record:
+        xml_writer_append(writer, counted ? 'S' : 'Q', name, NULL);
+        break;
+    case xml_writer_dry:
+        break;
+    }
+    xml_writer_push(writer, name, node, counted);
+}
+
+static void xml_writer_start(xml_writer writer, const char *name)
+{
+    xml_writer_start_element(writer, name, 1);
+}
+
+/** Add an attribute to the current element.
+*/
+
+static void xml_writer_attribute(xml_writer writer, const char *name, const char *value)
+{
+    struct xml_element_s *element = &writer->stack[writer->depth - 1];
+
+    // libxml writes a missing value as empty
+    if (!value)
+        value = "";
+
+    switch (writer->type) {
+    case xml_writer_tree:
+        xmlNewProp(element->node, _x(name), _x(value));
+        return;
+    case xml_writer_record:
+        xml_writer_append(writer, 'A', name, value);
+        break;
+    case xml_writer_stream:
+        // Attributes added after the content were written with the start tag.
+        if (!element->content) {
+            xml_writer_write(writer, " ", 1);
+            xml_writer_write(writer, name, strlen(name));
+            xml_writer_write(writer, "=\"", 2);
+            xml_writer_escape(writer, value, 1);
+            xml_writer_write(writer, "\"", 1);
+        }
+        return;
+    case xml_writer_dry:
+        break;
+    }
+
+    // Remember the attributes added after the content for the stream
+    if (element->content) {
+        if (writer->late_count == writer->late_size) {
+            writer->late_size = writer->late_size * 2 + 4;
+            writer->late = realloc(writer->late, writer->late_size * sizeof(*writer->late));
+        }
+        writer->late[writer->late_count].index = element->index;
+        writer->late[writer->late_count].name = strdup(name);
+        writer->late[writer->late_count].value = strdup(value);
+        writer->late_count++;
+    }
+}
+
+/** Add a property element with text content to the current element.
+*/
+
+static void xml_writer_property(xml_writer writer, const char *name, const char *value)
+{
+    xmlNodePtr node;
+
+    xml_writer_content(writer);
+    switch (writer->type) {
+    case xml_writer_tree:
+        node = xmlNewTextChild(writer->stack[writer->depth - 1].node,
+                               NULL,
+                               _x("property"),
+                               _x(value));
+        xmlNewProp(node, _x("name"), _x(name));
+        break;
+    case xml_writer_stream:
+        xml_writer_indent(writer);
+        xml_writer_write(writer, "<property name=\"", 16);
+        xml_writer_escape(writer, name, 1);
+        xml_writer_write(writer, "\">", 2);
+        xml_writer_escape(writer, value, 0);
+        xml_writer_write(writer, "</property>", 11);
+        if (writer->format)
+            xml_writer_write(writer, "\n", 1);
+        break;
+    case xml_writer_record:
+        xml_writer_append(writer, 'P', name, value);
+        break;
+    case xml_writer_dry:
+        break;
+    }
+}
+
+/** Start a properties element for nested properties.
+*/
+
+static void xml_writer_start_properties(xml_writer writer, const char *name)
+{
+    xml_writer_start_element(writer, "properties", 0);
+    xml_writer_attribute(writer, "name", name);
+}
+
+/** End the current element.
+*/
+
+static void xml_writer_end(xml_writer writer)
+{
+    struct xml_element_s *element = &writer->stack[writer->depth - 1];
+
+    if (writer->type == xml_writer_stream) {
+        if (!element->content) {
+            xml_writer_late_attributes(writer, element->index);
+            xml_writer_write(writer, "/>", 2);
+        } else {
+            writer->depth--;
+            xml_writer_indent(writer);
+            writer->depth++;
+            xml_writer_write(writer, "</", 2);
+            xml_writer_write(writer, element->name, strlen(element->name));
+            xml_writer_write(writer, ">", 1);
+        }
+        if (writer->format)
+            xml_writer_write(writer, "\n", 1);
+    } else if (writer->type == xml_writer_record) {
+        xml_writer_append(writer, 'E', NULL, NULL);
+    }
+    writer->depth--;
+}
+
+/** Play a recording of a document into another writer.
+*/
+
+static void xml_writer_replay(xml_writer writer, const char *ops, size_t size)
+{
+    const char *end = ops + size;
+
+    while (ops < end) {
+        char op = *ops++;
+        const char *a = ops;
+        const char *b = NULL;
+
+        if (op != 'E')
+            ops += strlen(ops) + 1;
+        if (op == 'A' || op == 'P') {
+            b = ops;
+            ops += strlen(ops) + 1;
+        }
+        switch (op) {
+        case 'S':
+            xml_writer_start_element(writer, a, 1);
+            break;
+        case 'Q':
+            xml_writer_start_element(writer, a, 0);
+            break;
+        case 'A':
+            xml_writer_attribute(writer, a, b);
+            break;
+        case 'P':
+            xml_writer_property(writer, a, b);
+            break;
+        case 'E':
+            xml_writer_end(writer);
+            break;
+        }
+    }
+}
+
+static void xml_writer_close(xml_writer writer)
 {
     int i;
-    xmlNode *p;
+    for (i = 0; i < writer->late_count; i++) {
+        free(writer->late[i].name);
+        free(writer->late[i].value);
+    }
+    free(writer->late);
+    free(writer->stack);
+    free(writer->buffer);
+}
+
+static void xml_writer_free(xml_writer writer)
+{
+    xml_writer_close(writer);
+    free(writer);
+}
+
+/** Get the name of the current element.
+*/
+
+static const char *xml_writer_name(xml_writer writer)
+{
+    return writer->depth ? writer->stack[writer->depth - 1].name : "";
+}
+
+static void serialise_properties(serialise_context context, mlt_properties properties)
+{
+    int i;
+    xml_writer writer = context->writer;
 
     // Enumerate the properties
     for (i = 0; i < mlt_properties_count(properties); i++) {
@@ -205,6 +616,12 @@ static void serialise_properties(serialise_context context, mlt_properties prope
                 const char *value_orig = value;
                 size_t prefix_size = mlt_xml_prefix_size(properties, name, value);
 
+                // A dry run only needs to know that there is content.
+                if (writer->type == xml_writer_dry) {
+                    xml_writer_content(writer);
+                    return;
+                }
+
                 // Strip off prefix.
                 if (prefix_size)
                     value += prefix_size;
@@ -221,64 +638,65 @@ static void serialise_properties(serialise_context context, mlt_properties prope
                         char *s = calloc(1, strlen(value_orig) - rootlen + 1);
                         strncat(s, value_orig, prefix_size);
                         strcat(s, value + rootlen + 1);
-                        p = xmlNewTextChild(node, NULL, _x("property"), _x(s));
+                        xml_writer_property(writer, name, s);
                         free(s);
                     } else {
-                        p = xmlNewTextChild(node,
-                                            NULL,
-                                            _x("property"),
-                                            _x(value_orig + rootlen + 1));
+                        xml_writer_property(writer, name, value_orig + rootlen + 1);
                     }
                 } else
-                    p = xmlNewTextChild(node, NULL, _x("property"), _x(value_orig));
-                xmlNewProp(p, _x("name"), _x(name));
+                    xml_writer_property(writer, name, value_orig);
             }
         } else if (mlt_properties_get_properties_at(properties, i) != NULL) {
             mlt_properties child_properties = mlt_properties_get_properties_at(properties, i);
-            p = xmlNewChild(node, NULL, _x("properties"), NULL);
-            xmlNewProp(p, _x("name"), _x(name));
-            serialise_properties(context, child_properties, p);
+            if (writer->type == xml_writer_dry) {
+                xml_writer_content(writer);
+                return;
+            }
+            xml_writer_start_properties(writer, name);
+            serialise_properties(context, child_properties);
+            xml_writer_end(writer);
         }
     }
 }
 
 static void serialise_store_properties(serialise_context context,
                                        mlt_properties properties,
-                                       xmlNode *node,
                                        const char *store)
 {
     int i;
-    xmlNode *p;
+    xml_writer writer = context->writer;
 
     // Enumerate the properties
     for (i = 0; store != NULL && i < mlt_properties_count(properties); i++) {
         char *name = mlt_properties_get_name(properties, i);
         if (!strncmp(name, store, strlen(store))) {
             char *value = mlt_properties_get_value_tf(properties, i, context->time_format);
+            if (writer->type == xml_writer_dry
+                && (value || mlt_properties_get_properties_at(properties, i))) {
+                xml_writer_content(writer);
+                return;
+            }
             if (value) {
                 int rootlen = strlen(context->root);
                 // convert absolute path to relative
                 if (rootlen && !strncmp(value, context->root, rootlen) && value[rootlen] == '/')
-                    p = xmlNewTextChild(node, NULL, _x("property"), _x(value + rootlen + 1));
+                    xml_writer_property(writer, name, value + rootlen + 1);
                 else
-                    p = xmlNewTextChild(node, NULL, _x("property"), _x(value));
-                xmlNewProp(p, _x("name"), _x(name));
+                    xml_writer_property(writer, name, value);
             } else if (mlt_properties_get_properties_at(properties, i) != NULL) {
                 mlt_properties child_properties = mlt_properties_get_properties_at(properties, i);
-                p = xmlNewChild(node, NULL, _x("properties"), NULL);
-                xmlNewProp(p, _x("name"), _x(name));
-                serialise_properties(context, child_properties, p);
+                xml_writer_start_properties(writer, name);
+                serialise_properties(context, child_properties);
+                xml_writer_end(writer);
             }
         }
     }
 }
 
-static inline void serialise_service_filters(serialise_context context,
-                                             mlt_service service,
-                                             xmlNode *node)
+static inline void serialise_service_filters(serialise_context context, mlt_service service)
 {
     int i;
-    xmlNode *p;
+    xml_writer writer = context->writer;
     mlt_filter filter = NULL;
 
     // Enumerate the filters
@@ -288,28 +706,33 @@ static inline void serialise_service_filters(serialise_context context,
             // Get a new id - if already allocated, do nothing
             char *id = xml_get_id(context, MLT_FILTER_SERVICE(filter), xml_filter);
             if (id != NULL) {
-                p = xmlNewChild(node, NULL, _x("filter"), NULL);
-                xmlNewProp(p, _x("id"), _x(id));
+                xml_writer_start(writer, "filter");
+                xml_writer_attribute(writer, "id", id);
                 if (mlt_properties_get(properties, "title"))
-                    xmlNewProp(p, _x("title"), _x(mlt_properties_get(properties, "title")));
+                    xml_writer_attribute(writer, "title", mlt_properties_get(properties, "title"));
                 if (mlt_properties_get_position(properties, "in"))
-                    xmlNewProp(p,
-                               _x("in"),
-                               _x(mlt_properties_get_time(properties, "in", context->time_format)));
+                    xml_writer_attribute(writer,
+                                         "in",
+                                         mlt_properties_get_time(properties,
+                                                                 "in",
+                                                                 context->time_format));
                 if (mlt_properties_get_position(properties, "out"))
-                    xmlNewProp(p,
-                               _x("out"),
-                               _x(mlt_properties_get_time(properties, "out", context->time_format)));
-                serialise_properties(context, properties, p);
-                serialise_service_filters(context, MLT_FILTER_SERVICE(filter), p);
+                    xml_writer_attribute(writer,
+                                         "out",
+                                         mlt_properties_get_time(properties,
+                                                                 "out",
+                                                                 context->time_format));
+                serialise_properties(context, properties);
+                serialise_service_filters(context, MLT_FILTER_SERVICE(filter));
+                xml_writer_end(writer);
             }
         }
     }
 }
 
-static void serialise_producer(serialise_context context, mlt_service service, xmlNode *node)
+static void serialise_producer(serialise_context context, mlt_service service)
 {
-    xmlNode *child = node;
+    xml_writer writer = context->writer;
     mlt_service parent = MLT_SERVICE(mlt_producer_cut_parent(MLT_PRODUCER(service)));
 
     if (context->pass == 0) {
@@ -319,18 +742,18 @@ static void serialise_producer(serialise_context context, mlt_service service, x
         if (id == NULL)
             return;
 
-        child = xmlNewChild(node, NULL, _x("producer"), NULL);
+        xml_writer_start(writer, "producer");
 
         // Set the id
-        xmlNewProp(child, _x("id"), _x(id));
+        xml_writer_attribute(writer, "id", id);
         if (mlt_properties_get(properties, "title"))
-            xmlNewProp(child, _x("title"), _x(mlt_properties_get(properties, "title")));
-        xmlNewProp(child,
-                   _x("in"),
-                   _x(mlt_properties_get_time(properties, "in", context->time_format)));
-        xmlNewProp(child,
-                   _x("out"),
-                   _x(mlt_properties_get_time(properties, "out", context->time_format)));
+            xml_writer_attribute(writer, "title", mlt_properties_get(properties, "title"));
+        xml_writer_attribute(writer,
+                             "in",
+                             mlt_properties_get_time(properties, "in", context->time_format));
+        xml_writer_attribute(writer,
+                             "out",
+                             mlt_properties_get_time(properties, "out", context->time_format));
 
         // If the xml producer fails to load a producer, it creates a text producer that says INVALID
         // and sets the xml_mlt_service property to the original service.
@@ -340,36 +763,38 @@ static void serialise_producer(serialise_context context, mlt_service service, x
             mlt_properties_set(properties, "mlt_service", xml_mlt_service);
         }
 
-        serialise_properties(context, properties, child);
-        serialise_service_filters(context, service, child);
+        serialise_properties(context, properties);
+        serialise_service_filters(context, service);
+        xml_writer_end(writer);
 
         // Add producer to the map
         mlt_properties_set_int(context->hide_map, id, mlt_properties_get_int(properties, "hide"));
     } else {
         char *id = xml_get_id(context, parent, xml_existing);
         mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
-        xmlNewProp(node, _x("parent"), _x(id));
-        xmlNewProp(node,
-                   _x("in"),
-                   _x(mlt_properties_get_time(properties, "in", context->time_format)));
-        xmlNewProp(node,
-                   _x("out"),
-                   _x(mlt_properties_get_time(properties, "out", context->time_format)));
+        xml_writer_attribute(writer, "parent", id);
+        xml_writer_attribute(writer,
+                             "in",
+                             mlt_properties_get_time(properties, "in", context->time_format));
+        xml_writer_attribute(writer,
+                             "out",
+                             mlt_properties_get_time(properties, "out", context->time_format));
     }
 }
 
-static void serialise_tractor(serialise_context context, mlt_service service, xmlNode *node);
+static void serialise_tractor(serialise_context context, mlt_service service);
 
-static void serialise_multitrack(serialise_context context, mlt_service service, xmlNode *node)
+static void serialise_multitrack(serialise_context context, mlt_service service)
 {
     int i;
+    xml_writer writer = context->writer;
 
     if (context->pass == 0) {
         // Iterate over the tracks to collect the producers
         for (i = 0; i < mlt_multitrack_count(MLT_MULTITRACK(service)); i++) {
             mlt_producer producer = mlt_producer_cut_parent(
                 mlt_multitrack_track(MLT_MULTITRACK(service), i));
-            serialise_service(context, MLT_SERVICE(producer), node);
+            serialise_service(context, MLT_SERVICE(producer));
         }
     } else {
         // Get a new id - if already allocated, do nothing
@@ -379,7 +804,6 @@ static void serialise_multitrack(serialise_context context, mlt_service service,
 
         // Serialise the tracks
         for (i = 0; i < mlt_multitrack_count(MLT_MULTITRACK(service)); i++) {
-            xmlNode *track = xmlNewChild(node, NULL, _x("track"), NULL);
             int hide = 0;
             mlt_producer producer = mlt_multitrack_track(MLT_MULTITRACK(service), i);
             mlt_properties properties = MLT_PRODUCER_PROPERTIES(producer);
@@ -387,44 +811,48 @@ static void serialise_multitrack(serialise_context context, mlt_service service,
             mlt_service parent = MLT_SERVICE(mlt_producer_cut_parent(producer));
 
             char *id = xml_get_id(context, MLT_SERVICE(parent), xml_existing);
-            xmlNewProp(track, _x("producer"), _x(id));
+            xml_writer_start(writer, "track");
+            xml_writer_attribute(writer, "producer", id);
+            if (mlt_producer_is_cut(producer)) {
+                xml_writer_attribute(writer,
+                                     "in",
+                                     mlt_properties_get_time(properties,
+                                                             "in",
+                                                             context->time_format));
+                xml_writer_attribute(writer,
+                                     "out",
+                                     mlt_properties_get_time(properties,
+                                                             "out",
+                                                             context->time_format));
+            }
+
+            hide = mlt_properties_get_int(context->hide_map, id);
+            if (hide)
+                xml_writer_attribute(writer,
+                                     "hide",
+                                     hide == 1 ? "video" : (hide == 2 ? "audio" : "both"));
+
             if (mlt_producer_is_cut(producer)) {
-                xmlNewProp(track,
-                           _x("in"),
-                           _x(mlt_properties_get_time(properties, "in", context->time_format)));
-                xmlNewProp(track,
-                           _x("out"),
-                           _x(mlt_properties_get_time(properties, "out", context->time_format)));
                 serialise_store_properties(context,
                                            MLT_PRODUCER_PROPERTIES(producer),
-                                           track,
                                            context->store);
-                serialise_store_properties(context,
-                                           MLT_PRODUCER_PROPERTIES(producer),
-                                           track,
-                                           "xml_");
+                serialise_store_properties(context, MLT_PRODUCER_PROPERTIES(producer), "xml_");
                 if (!context->no_meta)
                     serialise_store_properties(context,
                                                MLT_PRODUCER_PROPERTIES(producer),
-                                               track,
                                                "meta.");
-                serialise_service_filters(context, MLT_PRODUCER_SERVICE(producer), track);
+                serialise_service_filters(context, MLT_PRODUCER_SERVICE(producer));
             }
-
-            hide = mlt_properties_get_int(context->hide_map, id);
-            if (hide)
-                xmlNewProp(track,
-                           _x("hide"),
-                           _x(hide == 1 ? "video" : (hide == 2 ? "audio" : "both")));
+            xml_writer_end(writer);
         }
-        serialise_service_filters(context, service, node);
+        serialise_service_filters(context, service);
     }
 }
 
-static void serialise_playlist(serialise_context context, mlt_service service, xmlNode *node)
+static void serialise_playlist(serialise_context context, mlt_service service)
 {
     int i;
-    xmlNode *child = node;
+    xml_writer writer = context->writer;
     mlt_playlist_clip_info info;
     mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
 
@@ -444,25 +872,25 @@ static void serialise_playlist(serialise_context context, mlt_service service, x
                     char *resource_s = mlt_properties_get(MLT_PRODUCER_PROPERTIES(producer),
                                                           "resource");
                     if (resource_s != NULL && !strcmp(resource_s, "<playlist>"))
-                        serialise_playlist(context, MLT_SERVICE(producer), node);
+                        serialise_playlist(context, MLT_SERVICE(producer));
                     else if (service_s != NULL && strcmp(service_s, "blank") != 0)
-                        serialise_service(context, MLT_SERVICE(producer), node);
+                        serialise_service(context, MLT_SERVICE(producer));
                 }
             }
         }
 
-        child = xmlNewChild(node, NULL, _x("playlist"), NULL);
+        xml_writer_start(writer, "playlist");
 
         // Set the id
-        xmlNewProp(child, _x("id"), _x(id));
+        xml_writer_attribute(writer, "id", id);
         if (mlt_properties_get(properties, "title"))
-            xmlNewProp(child, _x("title"), _x(mlt_properties_get(properties, "title")));
+            xml_writer_attribute(writer, "title", mlt_properties_get(properties, "title"));
 
         // Store application specific properties
-        serialise_store_properties(context, properties, child, context->store);
-        serialise_store_properties(context, properties, child, "xml_");
+        serialise_store_properties(context, properties, context->store);
+        serialise_store_properties(context, properties, "xml_");
         if (!context->no_meta)
-            serialise_store_properties(context, properties, child, "meta.");
+            serialise_store_properties(context, properties, "meta.");
 
         // Add producer to the map
         mlt_properties_set_int(context->hide_map, id, mlt_properties_get_int(properties, "hide"));
@@ -474,7 +902,7 @@ static void serialise_playlist(serialise_context context, mlt_service service, x
                 mlt_properties producer_props = MLT_PRODUCER_PROPERTIES(producer);
                 char *service_s = mlt_properties_get(producer_props, "mlt_service");
                 if (service_s != NULL && strcmp(service_s, "blank") == 0) {
-                    xmlNode *entry = xmlNewChild(child, NULL, _x("blank"), NULL);
+                    xml_writer_start(writer, "blank");
                     mlt_properties_set_data(producer_props,
                                             "_profile",
                                             context->profile,
@@ -482,107 +910,108 @@ static void serialise_playlist(serialise_context context, mlt_service service, x
                                             NULL,
                                             NULL);
                     mlt_properties_set_position(producer_props, TIME_PROPERTY, info.frame_count);
-                    xmlNewProp(entry,
-                               _x("length"),
-                               _x(mlt_properties_get_time(producer_props,
-                                                          TIME_PROPERTY,
-                                                          context->time_format)));
+                    xml_writer_attribute(writer,
+                                         "length",
+                                         mlt_properties_get_time(producer_props,
+                                                                 TIME_PROPERTY,
+                                                                 context->time_format));
+                    xml_writer_end(writer);
                 } else {
                     char temp[20];
-                    xmlNode *entry = xmlNewChild(child, NULL, _x("entry"), NULL);
+                    xml_writer_start(writer, "entry");
                     id = xml_get_id(context, MLT_SERVICE(producer), xml_existing);
-                    xmlNewProp(entry, _x("producer"), _x(id));
+                    xml_writer_attribute(writer, "producer", id);
                     mlt_properties_set_position(producer_props, TIME_PROPERTY, info.frame_in);
-                    xmlNewProp(entry,
-                               _x("in"),
-                               _x(mlt_properties_get_time(producer_props,
-                                                          TIME_PROPERTY,
-                                                          context->time_format)));
+                    xml_writer_attribute(writer,
+                                         "in",
+                                         mlt_properties_get_time(producer_props,
+                                                                 TIME_PROPERTY,
+                                                                 context->time_format));
                     mlt_properties_set_position(producer_props, TIME_PROPERTY, info.frame_out);
-                    xmlNewProp(entry,
-                               _x("out"),
-                               _x(mlt_properties_get_time(producer_props,
-                                                          TIME_PROPERTY,
-                                                          context->time_format)));
+                    xml_writer_attribute(writer,
+                                         "out",
+                                         mlt_properties_get_time(producer_props,
+                                                                 TIME_PROPERTY,
+                                                                 context->time_format));
                     if (info.repeat > 1) {
                         sprintf(temp, "%d", info.repeat);
-                        xmlNewProp(entry, _x("repeat"), _x(temp));
+                        xml_writer_attribute(writer, "repeat", temp);
                     }
                     if (mlt_producer_is_cut(info.cut)) {
                         serialise_store_properties(context,
                                                    MLT_PRODUCER_PROPERTIES(info.cut),
-                                                   entry,
                                                    context->store);
                         serialise_store_properties(context,
                                                    MLT_PRODUCER_PROPERTIES(info.cut),
-                                                   entry,
                                                    "xml_");
                         if (!context->no_meta)
                             serialise_store_properties(context,
                                                        MLT_PRODUCER_PROPERTIES(info.cut),
-                                                       entry,
                                                        "meta.");
-                        serialise_service_filters(context, MLT_PRODUCER_SERVICE(info.cut), entry);
+                        serialise_service_filters(context, MLT_PRODUCER_SERVICE(info.cut));
                     }
+                    xml_writer_end(writer);
                 }
             }
         }
 
-        serialise_service_filters(context, service, child);
-    } else if (xmlStrcmp(node->name, _x("tractor")) != 0) {
+        serialise_service_filters(context, service);
+        xml_writer_end(writer);
+    } else if (strcmp(xml_writer_name(writer), "tractor") != 0) {
         char *id = xml_get_id(context, service, xml_existing);
-        xmlNewProp(node, _x("producer"), _x(id));
+        xml_writer_attribute(writer, "producer", id);
     }
 }
 
-static void serialise_tractor(serialise_context context, mlt_service service, xmlNode *node)
+static void serialise_tractor(serialise_context context, mlt_service service)
 {
-    xmlNode *child = node;
+    xml_writer writer = context->writer;
     mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
 
     if (context->pass == 0) {
         // Recurse on connected producer
-        serialise_service(context, mlt_service_producer(service), node);
+        serialise_service(context, mlt_service_producer(service));
     } else {
         // Get a new id - if already allocated, do nothing
         char *id = xml_get_id(context, service, xml_tractor);
         if (id == NULL)
             return;
 
-        child = xmlNewChild(node, NULL, _x("tractor"), NULL);
+        xml_writer_start(writer, "tractor");
 
         // Set the id
-        xmlNewProp(child, _x("id"), _x(id));
+        xml_writer_attribute(writer, "id", id);
         if (mlt_properties_get(properties, "title"))
-            xmlNewProp(child, _x("title"), _x(mlt_properties_get(properties, "title")));
+            xml_writer_attribute(writer, "title", mlt_properties_get(properties, "title"));
         if (mlt_properties_get_position(properties, "in") >= 0)
-            xmlNewProp(child,
-                       _x("in"),
-                       _x(mlt_properties_get_time(properties, "in", context->time_format)));
+            xml_writer_attribute(writer,
+                                 "in",
+                                 mlt_properties_get_time(properties, "in", context->time_format));
         if (mlt_properties_get_position(properties, "out") >= 0)
-            xmlNewProp(child,
-                       _x("out"),
-                       _x(mlt_properties_get_time(properties, "out", context->time_format)));
+            xml_writer_attribute(writer,
+                                 "out",
+                                 mlt_properties_get_time(properties, "out", context->time_format));
 
         // Store application specific properties
-        serialise_store_properties(context, MLT_SERVICE_PROPERTIES(service), child, context->store);
-        serialise_store_properties(context, MLT_SERVICE_PROPERTIES(service), child, "xml_");
+        serialise_store_properties(context, MLT_SERVICE_PROPERTIES(service), context->store);
+        serialise_store_properties(context, MLT_SERVICE_PROPERTIES(service), "xml_");
         if (!context->no_meta)
-            serialise_store_properties(context, MLT_SERVICE_PROPERTIES(service), child, "meta.");
+            serialise_store_properties(context, MLT_SERVICE_PROPERTIES(service), "meta.");
 
         // Recurse on connected producer
-        serialise_service(context, mlt_service_producer(service), child);
-        serialise_service_filters(context, service, child);
+        serialise_service(context, mlt_service_producer(service));
+        serialise_service_filters(context, service);
+        xml_writer_end(writer);
     }
 }
 
-static void serialise_filter(serialise_context context, mlt_service service, xmlNode *node)
+static void serialise_filter(serialise_context context, mlt_service service)
 {
-    xmlNode *child = node;
+    xml_writer writer = context->writer;
     mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
 
     // Recurse on connected producer
-    serialise_service(context, mlt_service_producer(service), node);
+    serialise_service(context, mlt_service_producer(service));
 
     if (context->pass == 1) {
         // Get a new id - if already allocated, do nothing
@@ -590,33 +1019,34 @@ static void serialise_filter(serialise_context context, mlt_service service, xml
         if (id == NULL)
             return;
 
-        child = xmlNewChild(node, NULL, _x("filter"), NULL);
+        xml_writer_start(writer, "filter");
 
         // Set the id
-        xmlNewProp(child, _x("id"), _x(id));
+        xml_writer_attribute(writer, "id", id);
         if (mlt_properties_get(properties, "title"))
-            xmlNewProp(child, _x("title"), _x(mlt_properties_get(properties, "title")));
+            xml_writer_attribute(writer, "title", mlt_properties_get(properties, "title"));
         if (mlt_properties_get_position(properties, "in"))
-            xmlNewProp(child,
-                       _x("in"),
-                       _x(mlt_properties_get_time(properties, "in", context->time_format)));
+            xml_writer_attribute(writer,
+                                 "in",
+                                 mlt_properties_get_time(properties, "in", context->time_format));
         if (mlt_properties_get_position(properties, "out"))
-            xmlNewProp(child,
-                       _x("out"),
-                       _x(mlt_properties_get_time(properties, "out", context->time_format)));
+            xml_writer_attribute(writer,
+                                 "out",
+                                 mlt_properties_get_time(properties, "out", context->time_format));
 
-        serialise_properties(context, properties, child);
-        serialise_service_filters(context, service, child);
+        serialise_properties(context, properties);
+        serialise_service_filters(context, service);
+        xml_writer_end(writer);
     }
 }
 
-static void serialise_transition(serialise_context context, mlt_service service, xmlNode *node)
+static void serialise_transition(serialise_context context, mlt_service service)
 {
-    xmlNode *child = node;
+    xml_writer writer = context->writer;
     mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
 
     // Recurse on connected producer
-    serialise_service(context, MLT_SERVICE(MLT_TRANSITION(service)->producer), node);
+    serialise_service(context, MLT_SERVICE(MLT_TRANSITION(service)->producer));
 
     if (context->pass == 1) {
         // Get a new id - if already allocated, do nothing
@@ -624,29 +1054,30 @@ static void serialise_transition(serialise_context context, mlt_service service,
         if (id == NULL)
             return;
 
-        child = xmlNewChild(node, NULL, _x("transition"), NULL);
+        xml_writer_start(writer, "transition");
 
         // Set the id
-        xmlNewProp(child, _x("id"), _x(id));
+        xml_writer_attribute(writer, "id", id);
         if (mlt_properties_get(properties, "title"))
-            xmlNewProp(child, _x("title"), _x(mlt_properties_get(properties, "title")));
+            xml_writer_attribute(writer, "title", mlt_properties_get(properties, "title"));
         if (mlt_properties_get_position(properties, "in"))
-            xmlNewProp(child,
-                       _x("in"),
-                       _x(mlt_properties_get_time(properties, "in", context->time_format)));
+            xml_writer_attribute(writer,
+                                 "in",
+                                 mlt_properties_get_time(properties, "in", context->time_format));
         if (mlt_properties_get_position(properties, "out"))
-            xmlNewProp(child,
-                       _x("out"),
-                       _x(mlt_properties_get_time(properties, "out", context->time_format)));
+            xml_writer_attribute(writer,
+                                 "out",
+                                 mlt_properties_get_time(properties, "out", context->time_format));
 
-        serialise_properties(context, properties, child);
-        serialise_service_filters(context, service, child);
+        serialise_properties(context, properties);
+        serialise_service_filters(context, service);
+        xml_writer_end(writer);
     }
 }
 
-static void serialise_link(serialise_context context, mlt_service service, xmlNode *node)
+static void serialise_link(serialise_context context, mlt_service service)
 {
-    xmlNode *child = node;
+    xml_writer writer = context->writer;
     mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
 
     if (context->pass == 0) {
@@ -655,30 +1086,31 @@ static void serialise_link(serialise_context context, mlt_service service, xmlNo
         if (id == NULL)
             return;
 
-        child = xmlNewChild(node, NULL, _x("link"), NULL);
+        xml_writer_start(writer, "link");
 
         // Set the id
-        xmlNewProp(child, _x("id"), _x(id));
+        xml_writer_attribute(writer, "id", id);
         if (mlt_properties_get(properties, "title"))
-            xmlNewProp(child, _x("title"), _x(mlt_properties_get(properties, "title")));
+            xml_writer_attribute(writer, "title", mlt_properties_get(properties, "title"));
         if (mlt_properties_get_position(properties, "in"))
-            xmlNewProp(child,
-                       _x("in"),
-                       _x(mlt_properties_get_time(properties, "in", context->time_format)));
+            xml_writer_attribute(writer,
+                                 "in",
+                                 mlt_properties_get_time(properties, "in", context->time_format));
         if (mlt_properties_get_position(properties, "out"))
-            xmlNewProp(child,
-                       _x("out"),
-                       _x(mlt_properties_get_time(properties, "out", context->time_format)));
+            xml_writer_attribute(writer,
+                                 "out",
+                                 mlt_properties_get_time(properties, "out", context->time_format));
 
-        serialise_properties(context, properties, child);
-        serialise_service_filters(context, service, child);
+        serialise_properties(context, properties);
+        serialise_service_filters(context, service);
+        xml_writer_end(writer);
     }
 }
 
-static void serialise_chain(serialise_context context, mlt_service service, xmlNode *node)
+static void serialise_chain(serialise_context context, mlt_service service)
 {
     int i = 0;
-    xmlNode *child = node;
+    xml_writer writer = context->writer;
     mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
 
     if (context->pass == 0) {
@@ -687,36 +1119,37 @@ static void serialise_chain(serialise_context context, mlt_service service, xmlN
         if (id == NULL)
             return;
 
-        child = xmlNewChild(node, NULL, _x("chain"), NULL);
+        xml_writer_start(writer, "chain");
 
         // Set the id
-        xmlNewProp(child, _x("id"), _x(id));
+        xml_writer_attribute(writer, "id", id);
         if (mlt_properties_get(properties, "title"))
-            xmlNewProp(child, _x("title"), _x(mlt_properties_get(properties, "title")));
+            xml_writer_attribute(writer, "title", mlt_properties_get(properties, "title"));
         if (mlt_properties_get_position(properties, "in"))
-            xmlNewProp(child,
-                       _x("in"),
-                       _x(mlt_properties_get_time(properties, "in", context->time_format)));
+            xml_writer_attribute(writer,
+                                 "in",
+                                 mlt_properties_get_time(properties, "in", context->time_format));
         if (mlt_properties_get_position(properties, "out"))
-            xmlNewProp(child,
-                       _x("out"),
-                       _x(mlt_properties_get_time(properties, "out", context->time_format)));
+            xml_writer_attribute(writer,
+                                 "out",
+                                 mlt_properties_get_time(properties, "out", context->time_format));
 
-        serialise_properties(context, properties, child);
+        serialise_properties(context, properties);
 
         // Serialize links
         for (i = 0; i < mlt_chain_link_count(MLT_CHAIN(service)); i++) {
             mlt_link link = mlt_chain_link(MLT_CHAIN(service), i);
             if (link && mlt_properties_get_int(MLT_LINK_PROPERTIES(link), "_loader") == 0) {
-                serialise_link(context, MLT_LINK_SERVICE(link), child);
+                serialise_link(context, MLT_LINK_SERVICE(link));
             }
         }
 
-        serialise_service_filters(context, service, child);
+        serialise_service_filters(context, service);
+        xml_writer_end(writer);
     }
 }
 
-static void serialise_service(serialise_context context, mlt_service service, xmlNode *node)
+static void serialise_service(serialise_context context, mlt_service service)
 {
     // Iterate over consumer/producer connections
     while (service != NULL) {
@@ -729,13 +1162,13 @@ static void serialise_service(serialise_context context, mlt_service service, xm
             if (mlt_properties_get(properties, "xml") == NULL
                 && (mlt_service != NULL && !strcmp(mlt_service, "tractor"))) {
                 context->pass = 0;
-                serialise_tractor(context, service, node);
+                serialise_tractor(context, service);
                 context->pass = 1;
-                serialise_tractor(context, service, node);
+                serialise_tractor(context, service);
                 context->pass = 0;
                 break;
             } else {
-                serialise_producer(context, service, node);
+                serialise_producer(context, service);
             }
             if (mlt_properties_get(properties, "xml") != NULL)
                 break;
@@ -747,21 +1180,21 @@ static void serialise_service(serialise_context context, mlt_service service, xm
 
             // Recurse on multitrack's tracks
             if (resource && strcmp(resource, "<multitrack>") == 0) {
-                serialise_multitrack(context, service, node);
+                serialise_multitrack(context, service);
                 break;
             }
 
             // Recurse on playlist's clips
             else if (resource && strcmp(resource, "<playlist>") == 0) {
-                serialise_playlist(context, service, node);
+                serialise_playlist(context, service);
             }
 
             // Recurse on tractor's producer
             else if (resource && strcmp(resource, "<tractor>") == 0) {
                 context->pass = 0;
-                serialise_tractor(context, service, node);
+                serialise_tractor(context, service);
                 context->pass = 1;
-                serialise_tractor(context, service, node);
+                serialise_tractor(context, service);
                 context->pass = 0;
                 break;
             }
@@ -769,7 +1202,7 @@ static void serialise_service(serialise_context context, mlt_service service, xm
             // Treat it as a normal chain
             else if (mlt_properties_get_int(properties, "_original_type")
                      == mlt_service_chain_type) {
-                serialise_chain(context, service, node);
+                serialise_chain(context, service);
                 mlt_properties_set(properties, "mlt_type", "chain");
                 if (mlt_properties_get(properties, "xml") != NULL)
                     break;
@@ -777,7 +1210,7 @@ static void serialise_service(serialise_context context, mlt_service service, xm
 
             // Treat it as a normal producer
             else {
-                serialise_producer(context, service, node);
+                serialise_producer(context, service);
                 if (mlt_properties_get(properties, "xml") != NULL)
                     break;
             }
@@ -785,19 +1218,19 @@ static void serialise_service(serialise_context context, mlt_service service, xm
 
         // Tell about a chain
         else if (strcmp(mlt_type, "chain") == 0) {
-            serialise_chain(context, service, node);
+            serialise_chain(context, service);
             break;
         }
 
         // Tell about a filter
         else if (strcmp(mlt_type, "filter") == 0) {
-            serialise_filter(context, service, node);
+            serialise_filter(context, service);
             break;
         }
 
         // Tell about a transition
         else if (strcmp(mlt_type, "transition") == 0) {
-            serialise_transition(context, service, node);
+            serialise_transition(context, service);
             break;
         }
 
@@ -806,9 +1239,7 @@ static void serialise_service(serialise_context context, mlt_service service, xm
     }
 }
 
-static void serialise_other(mlt_properties properties,
-                            struct serialise_context_s *context,
-                            xmlNodePtr root)
+static void serialise_other(mlt_properties properties, struct serialise_context_s *context)
 {
     int i;
     for (i = 0; i < mlt_properties_count(properties); i++) {
@@ -817,26 +1248,28 @@ static void serialise_other(mlt_properties properties,
             mlt_service service = mlt_properties_get_data_at(properties, i, NULL);
             if (service) {
                 mlt_properties_set_int(MLT_SERVICE_PROPERTIES(service), "xml_retain", 1);
-                serialise_service(context, service, root);
+                serialise_service(context, service);
             }
         }
     }
 }
 
-xmlDocPtr xml_make_doc(mlt_consumer consumer, mlt_service service)
+/** Serialise a service network to a writer.
+*/
+
+static void serialise_document(mlt_consumer consumer, mlt_service service, xml_writer writer)
 {
     mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
-    xmlDocPtr doc = xmlNewDoc(_x("1.0"));
-    xmlNodePtr root = xmlNewNode(NULL, _x("mlt"));
     struct serialise_context_s *context = calloc(1, sizeof(struct serialise_context_s));
     mlt_profile profile = mlt_service_profile(MLT_CONSUMER_SERVICE(consumer));
     char tmpstr[32];
 
-    xmlDocSetRootElement(doc, root);
+    context->writer = writer;
+    xml_writer_start(writer, "mlt");
 
     // Indicate the numeric locale
     if (mlt_properties_get_lcnumeric(properties))
-        xmlNewProp(root, _x("LC_NUMERIC"), _x(mlt_properties_get_lcnumeric(properties)));
+        xml_writer_attribute(writer, "LC_NUMERIC", mlt_properties_get_lcnumeric(properties));
     else
 #ifdef _WIN32
     {
@@ -845,19 +1278,19 @@ xmlDocPtr xml_make_doc(mlt_consumer consumer, mlt_service service)
         free(lcnumeric);
         mlt_properties_to_utf8(properties, "_xml_lcnumeric_in", "_xml_lcnumeric_out");
         lcnumeric = mlt_properties_get(properties, "_xml_lcnumeric_out");
-        xmlNewProp(root, _x("LC_NUMERIC"), _x(lcnumeric));
+        xml_writer_attribute(writer, "LC_NUMERIC", lcnumeric);
     }
 #else
-        xmlNewProp(root, _x("LC_NUMERIC"), _x(setlocale(LC_NUMERIC, NULL)));
+        xml_writer_attribute(writer, "LC_NUMERIC", setlocale(LC_NUMERIC, NULL));
 #endif
 
     // Indicate the version
-    xmlNewProp(root, _x("version"), _x(mlt_version_get_string()));
+    xml_writer_attribute(writer, "version", mlt_version_get_string());
 
     // If we have root, then deal with it now
     if (mlt_properties_get(properties, "root") != NULL) {
         if (!mlt_properties_get_int(MLT_CONSUMER_PROPERTIES(consumer), "no_root"))
-            xmlNewProp(root, _x("root"), _x(mlt_properties_get(properties, "root")));
+            xml_writer_attribute(writer, "root", mlt_properties_get(properties, "root"));
         context->root = strdup(mlt_properties_get(properties, "root"));
     } else {
         context->root = strdup("");
@@ -878,34 +1311,35 @@ xmlDocPtr xml_make_doc(mlt_consumer consumer, mlt_service service)
 
     // Assign a title property
     if (mlt_properties_get(properties, "title") != NULL)
-        xmlNewProp(root, _x("title"), _x(mlt_properties_get(properties, "title")));
+        xml_writer_attribute(writer, "title", mlt_properties_get(properties, "title"));
 
     // Add a profile child element
     if (profile) {
         if (!mlt_properties_get_int(MLT_CONSUMER_PROPERTIES(consumer), "no_profile")) {
-            xmlNodePtr profile_node = xmlNewChild(root, NULL, _x("profile"), NULL);
+            xml_writer_start(writer, "profile");
             if (profile->description)
-                xmlNewProp(profile_node, _x("description"), _x(profile->description));
+                xml_writer_attribute(writer, "description", profile->description);
             sprintf(tmpstr, "%d", profile->width);
-            xmlNewProp(profile_node, _x("width"), _x(tmpstr));
+            xml_writer_attribute(writer, "width", tmpstr);
             sprintf(tmpstr, "%d", profile->height);
-            xmlNewProp(profile_node, _x("height"), _x(tmpstr));
+            xml_writer_attribute(writer, "height", tmpstr);
             sprintf(tmpstr, "%d", profile->progressive);
-            xmlNewProp(profile_node, _x("progressive"), _x(tmpstr));
+            xml_writer_attribute(writer, "progressive", tmpstr);
             sprintf(tmpstr, "%d", profile->sample_aspect_num);
-            xmlNewProp(profile_node, _x("sample_aspect_num"), _x(tmpstr));
+            xml_writer_attribute(writer, "sample_aspect_num", tmpstr);
             sprintf(tmpstr, "%d", profile->sample_aspect_den);
-            xmlNewProp(profile_node, _x("sample_aspect_den"), _x(tmpstr));
+            xml_writer_attribute(writer, "sample_aspect_den", tmpstr);
             sprintf(tmpstr, "%d", profile->display_aspect_num);
-            xmlNewProp(profile_node, _x("display_aspect_num"), _x(tmpstr));
+            xml_writer_attribute(writer, "display_aspect_num", tmpstr);
             sprintf(tmpstr, "%d", profile->display_aspect_den);
-            xmlNewProp(profile_node, _x("display_aspect_den"), _x(tmpstr));
+            xml_writer_attribute(writer, "display_aspect_den", tmpstr);
             sprintf(tmpstr, "%d", profile->frame_rate_num);
-            xmlNewProp(profile_node, _x("frame_rate_num"), _x(tmpstr));
+            xml_writer_attribute(writer, "frame_rate_num", tmpstr);
             sprintf(tmpstr, "%d", profile->frame_rate_den);
-            xmlNewProp(profile_node, _x("frame_rate_den"), _x(tmpstr));
+            xml_writer_attribute(writer, "frame_rate_den", tmpstr);
             sprintf(tmpstr, "%d", profile->colorspace);
-            xmlNewProp(profile_node, _x("colorspace"), _x(tmpstr));
+            xml_writer_attribute(writer, "colorspace", tmpstr);
+            xml_writer_end(writer);
         }
         context->profile = profile;
     }
@@ -920,34 +1354,46 @@ xmlDocPtr xml_make_doc(mlt_consumer consumer, mlt_service service)
 
     // In pass one, we serialise the end producers and playlists,
     // adding them to a map keyed by address.
-    serialise_other(MLT_SERVICE_PROPERTIES(service), context, root);
-    serialise_service(context, service, root);
+    serialise_other(MLT_SERVICE_PROPERTIES(service), context);
+    serialise_service(context, service);
 
     // In pass two, we serialise the tractor and reference the
     // producers and playlists
     context->pass++;
-    serialise_other(MLT_SERVICE_PROPERTIES(service), context, root);
-    serialise_service(context, service, root);
+    serialise_other(MLT_SERVICE_PROPERTIES(service), context);
+    serialise_service(context, service);
+    xml_writer_end(writer);
 
     // Cleanup resource
     mlt_properties_close(context->id_map);
     mlt_properties_close(context->hide_map);
     free(context->root);
     free(context);
+}
+
+xmlDocPtr xml_make_doc(mlt_consumer consumer, mlt_service service)
+{
+    struct xml_writer_s writer = {.type = xml_writer_tree};
 
-    return doc;
+    writer.doc = xmlNewDoc(_x("1.0"));
+    serialise_document(consumer, service, &writer);
+    xml_writer_close(&writer);
+
+    return writer.doc;
 }
 
-static void output_xml(mlt_consumer consumer)
+/** Prepare the service for serialisation with the consumer properties.
+*/
+
+static mlt_service prepare_service(mlt_consumer consumer)
 {
     // Get the producer service
     mlt_service service = mlt_service_producer(MLT_CONSUMER_SERVICE(consumer));
     mlt_properties properties = MLT_CONSUMER_PROPERTIES(consumer);
     char *resource = mlt_properties_get(properties, "resource");
-    xmlDocPtr doc = NULL;
 
     if (!service)
-        return;
+        return NULL;
 
     // Set the title if provided
     if (mlt_properties_get(properties, "title"))
@@ -968,6 +1414,100 @@ static void output_xml(mlt_consumer consumer)
         mlt_properties_set(MLT_SERVICE_PROPERTIES(service), "root", cwd);
         free(cwd);
     }
+    return service;
+}
+
+/** Write a document with a streaming writer to the resource.
+ *
+ * \param late the attributes that follow content from a dry run or recording
+ * \param ops a recording to play, or NULL to serialise the service
+ */
+
+static void output_stream(mlt_consumer consumer,
+                          mlt_service service,
+                          const char *resource,
+                          xml_writer late,
+                          const char *ops,
+                          size_t size)
+{
+    struct xml_writer_s writer = {.type = xml_writer_stream, .format = 1};
+
+    // This is the same as xmlDocFormatDump(), xmlDocDumpMemoryEnc() and xmlSaveFormatFileEnc().
+    if (resource == NULL || !strcmp(resource, "")) {
+        writer.file = stdout;
+        writer.ascii = 1;
+    } else if (strchr(resource, '.') == NULL) {
+        writer.format = 0;
+    } else {
+        writer.file = mlt_fopen(resource, "wb");
+        if (!writer.file) {
+            mlt_log_error(MLT_CONSUMER_SERVICE(consumer), "Failed to open %s\n", resource);
+            return;
+        }
+    }
+    if (writer.ascii)
+        xml_writer_write(&writer, "<?xml version=\"1.0\"?>\n", 22);
+    else
+        xml_writer_write(&writer, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n", 39);
+    writer.late = late->late;
+    writer.late_count = late->late_count;
+
+    if (ops)
+        xml_writer_replay(&writer, ops, size);
+    else
+        serialise_document(consumer, service, &writer);
+    if (!writer.format)
+        xml_writer_write(&writer, "\n", 1);
+
+    if (writer.file == stdout)
+        fflush(stdout);
+    else if (writer.file)
+        fclose(writer.file);
+    else
+        mlt_properties_set(MLT_CONSUMER_PROPERTIES(consumer), resource, writer.buffer);
+    writer.late = NULL;
+    writer.late_count = 0;
+    xml_writer_close(&writer);
+}
+
+static void *writer_thread(void *arg)
+{
+    mlt_consumer consumer = arg;
+    mlt_properties properties = MLT_CONSUMER_PROPERTIES(consumer);
+    xml_writer recording = mlt_properties_get_data(properties, "_recording", NULL);
+
+    output_stream(consumer,
+                  NULL,
+                  mlt_properties_get(properties, "_recording.resource"),
+                  recording,
+                  recording->buffer,
+                  recording->size);
+
+    // Indicate that the consumer is stopped
+    mlt_properties_set_int(properties, "running", 0);
+    mlt_consumer_stopped(consumer);
+
+    return NULL;
+}
+
+static void output_xml(mlt_consumer consumer)
+{
+    mlt_service service = prepare_service(consumer);
+    mlt_properties properties = MLT_CONSUMER_PROPERTIES(consumer);
+    char *resource = mlt_properties_get(properties, "resource");
+    xmlDocPtr doc = NULL;
+
+    if (!service)
+        return;
+
+    if (mlt_properties_get_int(properties, "stream")) {
+        // A dry run finds the attributes that follow content, which must be written first.
+        struct xml_writer_s dry = {.type = xml_writer_dry};
+        serialise_document(consumer, service, &dry);
+        output_stream(consumer, service, resource, &dry, NULL, 0);
+        xml_writer_close(&dry);
+        return;
+    }
 
     // Make the document
     doc = xml_make_doc(consumer, service);
@@ -992,6 +1532,41 @@ static void output_xml(mlt_consumer consumer)
     // Close the document
     xmlFreeDoc(doc);
 }
+
+/** Record the document and write it on a thread.
+ *
+ * \return true if there is nothing to write
+ */
+
+static int output_background(mlt_consumer consumer)
+{
+    mlt_service service = prepare_service(consumer);
+    mlt_properties properties = MLT_CONSUMER_PROPERTIES(consumer);
+
+    if (!service)
+        return 1;
+
+    xml_writer recording = calloc(1, sizeof(struct xml_writer_s));
+    recording->type = xml_writer_record;
+    serialise_document(consumer, service, recording);
+    mlt_properties_set_data(properties,
+                            "_recording",
+                            recording,
+                            0,
+                            (mlt_destructor) xml_writer_free,
+                            NULL);
+    mlt_properties_set(properties,
+                       "_recording.resource",
+                       mlt_properties_get(properties, "resource"));
+
+    pthread_t *thread = calloc(1, sizeof(pthread_t));
+    mlt_properties_set_data(properties, "thread", thread, sizeof(pthread_t), free, NULL);
+    mlt_properties_set_int(properties, "running", 1);
+    mlt_properties_set_int(properties, "joined", 0);
+    pthread_create(thread, NULL, writer_thread, consumer);
+    return 0;
+}
+
 static int consumer_start(mlt_consumer consumer)
 {
     mlt_properties properties = MLT_CONSUMER_PROPERTIES(consumer);
@@ -1012,6 +1587,13 @@ static int consumer_start(mlt_consumer consumer)
             // Create the thread
             pthread_create(thread, NULL, consumer_thread, consumer);
         }
+    } else if (mlt_properties_get_int(properties, "background")) {
+        // Finish the previous write so that this newer snapshot is not lost
+        consumer_stop(consumer);
+        if (output_background(consumer)) {
+            mlt_consumer_stop(consumer);
+            mlt_consumer_stopped(consumer);
+        }
     } else {
         output_xml(consumer);
         mlt_consumer_stop(consumer);
@@ -1023,6 +1605,10 @@ static int consumer_start(mlt_consumer consumer)
 static int consumer_is_stopped(mlt_consumer consumer)
 {
     mlt_properties properties = MLT_CONSUMER_PROPERTIES(consumer);
+    // A background write does not prevent taking the next snapshot
+    if (mlt_properties_get_int(properties, "background")
+        && !mlt_properties_get_int(properties, "all"))
+        return 1;
     return !mlt_properties_get_int(properties, "running");
 }
 
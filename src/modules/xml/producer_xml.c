@@ -25,8 +25,10 @@
 #include <ctype.h>
 #include <framework/mlt.h>
 #include <framework/mlt_log.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 
 #include <libxml/parser.h>
@@ -90,6 +92,9 @@ struct deserialise_context_s
     int consumer_count;
     int seekable;
     mlt_consumer qglsl;
+    mlt_deque preload;
+    int preload_depth;
+    mlt_properties preloaded;
 };
 typedef struct deserialise_context_s *deserialise_context;
 
@@ -279,6 +284,105 @@ static inline void qualify_property(deserialise_context context,
     }
 }
 
+/** Get the argument for mlt_factory_producer() from the properties of a producer or chain.
+ *
+ * This qualifies the resource (or src) property, which is returned in \p resource.
+ * The result must be freed, and it is NULL when the producer can only be tried
+ * from its resource.
+ */
+
+static char *producer_argument(deserialise_context context,
+                               mlt_properties properties,
+                               char **resource)
+{
+    char *result = NULL;
+
+    qualify_property(context, properties, "resource");
+    *resource = mlt_properties_get(properties, "resource");
+
+    // Let Kino-SMIL src be a synonym for resource
+    if (*resource == NULL) {
+        qualify_property(context, properties, "src");
+        *resource = mlt_properties_get(properties, "src");
+    }
+
+    if (mlt_properties_get(properties, "mlt_service") != NULL) {
+        char *service_name = trim(mlt_properties_get(properties, "mlt_service"));
+        if (*resource) {
+            // If a document was saved as +INVALID.txt (see below), then ignore the mlt_service and
+            // try to load it just from the resource. This is an attempt to recover the failed
+            // producer in case, for example, a file returns.
+            if (!strcmp("qtext", service_name)) {
+                const char *text = mlt_properties_get(properties, "text");
+                if (text && !strcmp("INVALID", text)) {
+                    service_name = NULL;
+                }
+            } else if (!strcmp("pango", service_name)) {
+                const char *markup = mlt_properties_get(properties, "markup");
+                if (markup && !strcmp("INVALID", markup)) {
+                    service_name = NULL;
+                }
+            }
+            if (service_name) {
+                result = calloc(1, strlen(service_name) + strlen(*resource) + 2);
+                strcat(result, service_name);
+                strcat(result, ":");
+                strcat(result, *resource);
+            }
+        } else {
+            result = strdup(service_name);
+        }
+    }
+    return result;
+}
+
+/** The value preloaded for an argument when its producer failed to load.
+*/
+
+static char preload_failed;
+
+/** Take a producer that was created ahead of the second pass for an argument.
+ *
+ * \return true if the argument was preloaded, and the producer may be NULL if it failed
+ */
+
+static int take_preloaded(deserialise_context context, const char *argument, mlt_producer *producer)
+{
+    mlt_deque producers = NULL;
+    void *preloaded = NULL;
+
+    if (context->preloaded)
+        producers = mlt_properties_get_data(context->preloaded, argument, NULL);
+    if (producers)
+        preloaded = mlt_deque_pop_front(producers);
+    *producer = preloaded == &preload_failed ? NULL : preloaded;
+    return preloaded != NULL;
+}
+
+/** Instantiate the producer for a producer or chain element.
+*/
+
+static mlt_producer create_producer(deserialise_context context,
+                                    mlt_properties properties,
+                                    char **resource)
+{
+    mlt_producer producer = NULL;
+    char *argument = producer_argument(context, properties, resource);
+
+    if (argument) {
+        if (!take_preloaded(context, argument, &producer))
+            producer = mlt_factory_producer(context->profile, NULL, argument);
+        free(argument);
+    }
+
+    // Just in case the plugin requested doesn't exist...
+    if (!producer && *resource) {
+        if (!take_preloaded(context, *resource, &producer))
+            producer = mlt_factory_producer(context->profile, NULL, *resource);
+    }
+    return producer;
+}
+
 /** This function adds a producer to a playlist or multitrack when
     there is no entry or track element.
 */
@@ -604,51 +708,8 @@ static void on_end_chain(deserialise_context context, const xmlChar *name)
         mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
         mlt_position in = -1;
         mlt_position out = -1;
-        mlt_producer source = NULL;
-
-        qualify_property(context, properties, "resource");
-        char *resource = mlt_properties_get(properties, "resource");
-
-        // Let Kino-SMIL src be a synonym for resource
-        if (resource == NULL) {
-            qualify_property(context, properties, "src");
-            resource = mlt_properties_get(properties, "src");
-        }
-
-        // Instantiate the producer
-        if (mlt_properties_get(properties, "mlt_service") != NULL) {
-            char *service_name = trim(mlt_properties_get(properties, "mlt_service"));
-            if (resource) {
-                // If a document was saved as +INVALID.txt (see below), then ignore the mlt_service and
-                // try to load it just from the resource. This is an attempt to recover the failed
-                // producer in case, for example, a file returns.
-                if (!strcmp("qtext", service_name)) {
-                    const char *text = mlt_properties_get(properties, "text");
-                    if (text && !strcmp("INVALID", text)) {
-                        service_name = NULL;
-                    }
-                } else if (!strcmp("pango", service_name)) {
-                    const char *markup = mlt_properties_get(properties, "markup");
-                    if (markup && !strcmp("INVALID", markup)) {
-                        service_name = NULL;
-                    }
-                }
-                if (service_name) {
-                    char *temp = calloc(1, strlen(service_name) + strlen(resource) + 2);
-                    strcat(temp, service_name);
-                    strcat(temp, ":");
-                    strcat(temp, resource);
-                    source = mlt_factory_producer(context->profile, NULL, temp);
-                    free(temp);
-                }
-            } else {
-                source = mlt_factory_producer(context->profile, NULL, service_name);
-            }
-        }
-
-        // Just in case the plugin requested doesn't exist...
-        if (!source && resource)
-            source = mlt_factory_producer(context->profile, NULL, resource);
+        char *resource = NULL;
+        mlt_producer source = create_producer(context, properties, &resource);
         if (!source) {
             mlt_log_error(NULL, "[producer_xml] failed to load chain \"%s\"\n", resource);
             source = mlt_factory_producer(context->profile, NULL, "+INVALID.txt");
@@ -773,51 +834,8 @@ static void on_end_producer(deserialise_context context, const xmlChar *name)
     mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
 
     if (service != NULL && type == mlt_dummy_producer_type) {
-        mlt_service producer = NULL;
-
-        qualify_property(context, properties, "resource");
-        char *resource = mlt_properties_get(properties, "resource");
-
-        // Let Kino-SMIL src be a synonym for resource
-        if (resource == NULL) {
-            qualify_property(context, properties, "src");
-            resource = mlt_properties_get(properties, "src");
-        }
-
-        // Instantiate the producer
-        if (mlt_properties_get(properties, "mlt_service") != NULL) {
-            char *service_name = trim(mlt_properties_get(properties, "mlt_service"));
-            if (resource) {
-                // If a document was saved as +INVALID.txt (see below), then ignore the mlt_service and
-                // try to load it just from the resource. This is an attempt to recover the failed
-                // producer in case, for example, a file returns.
-                if (!strcmp("qtext", service_name)) {
-                    const char *text = mlt_properties_get(properties, "text");
-                    if (text && !strcmp("INVALID", text)) {
-                        service_name = NULL;
-                    }
-                } else if (!strcmp("pango", service_name)) {
-                    const char *markup = mlt_properties_get(properties, "markup");
-                    if (markup && !strcmp("INVALID", markup)) {
-                        service_name = NULL;
-                    }
-                }
-                if (service_name) {
-                    char *temp = calloc(1, strlen(service_name) + strlen(resource) + 2);
-                    strcat(temp, service_name);
-                    strcat(temp, ":");
-                    strcat(temp, resource);
-                    producer = MLT_SERVICE(mlt_factory_producer(context->profile, NULL, temp));
-                    free(temp);
-                }
-            } else {
-                producer = MLT_SERVICE(mlt_factory_producer(context->profile, NULL, service_name));
-            }
-        }
-
-        // Just in case the plugin requested doesn't exist...
-        if (!producer && resource)
-            producer = MLT_SERVICE(mlt_factory_producer(context->profile, NULL, resource));
+        char *resource = NULL;
+        mlt_service producer = MLT_SERVICE(create_producer(context, properties, &resource));
         if (!producer) {
             mlt_log_error(NULL, "[producer_xml] failed to load producer \"%s\"\n", resource);
             producer = MLT_SERVICE(mlt_factory_producer(context->profile, NULL, "+INVALID.txt"));
@@ -1548,6 +1566,184 @@ static void on_end_properties(deserialise_context context, const xmlChar *name)
     }
 }
 
+/** Check whether a producer may be created ahead of the second pass on another thread.
+ *
+ * Nested XML and the consumer producer are excluded because they may change the profile.
+ */
+
+static int is_preloadable(mlt_properties properties, const char *resource)
+{
+    const char *service = mlt_properties_get(properties, "mlt_service");
+    const char *extension = resource ? strrchr(resource, '.') : NULL;
+
+    if (service && (!strncmp(service, "xml", 3) || !strcmp(service, "consumer")))
+        return 0;
+    return !extension || (strcasecmp(extension, ".mlt") && strcasecmp(extension, ".xml"));
+}
+
+/** Collect the properties of a producer or chain during the first pass.
+*/
+
+static void on_start_preload(deserialise_context context, const xmlChar *name, const xmlChar **atts)
+{
+    context->preload_depth++;
+    if (xmlStrcmp(name, _x("producer")) == 0 || xmlStrcmp(name, _x("video")) == 0
+        || xmlStrcmp(name, _x("chain")) == 0) {
+        mlt_properties properties = mlt_properties_new();
+        for (; atts != NULL && *atts != NULL; atts += 2)
+            mlt_properties_set_string(properties,
+                                      (const char *) atts[0],
+                                      atts[1] == NULL ? "" : (const char *) atts[1]);
+        mlt_properties_set_int(properties, "_xml.depth", context->preload_depth);
+        mlt_deque_push_back(context->stack_properties, properties);
+    } else if (xmlStrcmp(name, _x("property")) == 0
+               && mlt_deque_count(context->stack_properties)) {
+        // Only properties of the producer itself, not of its filters or links
+        mlt_properties properties = mlt_deque_peek_back(context->stack_properties);
+        if (mlt_properties_get_int(properties, "_xml.depth") == context->preload_depth - 1) {
+            const char *value = NULL;
+            for (; atts != NULL && *atts != NULL; atts += 2) {
+                if (xmlStrcmp(atts[0], _x("name")) == 0 && context->property == NULL)
+                    context->property = strdup(_s(atts[1]));
+                else if (xmlStrcmp(atts[0], _x("value")) == 0)
+                    value = _s(atts[1]);
+            }
+            if (context->property != NULL)
+                mlt_properties_set_string(properties,
+                                          context->property,
+                                          value == NULL ? "" : value);
+        }
+    }
+}
+
+/** Queue the argument of a producer or chain at its end during the first pass.
+*/
+
+static void on_end_preload(deserialise_context context, const xmlChar *name)
+{
+    if ((xmlStrcmp(name, _x("producer")) == 0 || xmlStrcmp(name, _x("video")) == 0
+         || xmlStrcmp(name, _x("chain")) == 0)
+        && mlt_deque_count(context->stack_properties)) {
+        mlt_properties properties = mlt_deque_pop_back(context->stack_properties);
+        char *resource = NULL;
+        char *argument = producer_argument(context, properties, &resource);
+
+        if (!argument && resource)
+            argument = strdup(resource);
+        if (argument && is_preloadable(properties, resource))
+            mlt_deque_push_back(context->preload, argument);
+        else
+            free(argument);
+        mlt_properties_close(properties);
+    } else if (xmlStrcmp(name, _x("property")) == 0) {
+        free(context->property);
+        context->property = NULL;
+    }
+    context->preload_depth--;
+}
+
+struct preload_s
+{
+    deserialise_context context;
+    char **arguments;
+    mlt_producer *producers;
+    int count;
+    int next;
+    pthread_mutex_t mutex;
+};
+
+static void *preload_worker(void *arg)
+{
+    struct preload_s *preload = arg;
+
+    while (1) {
+        pthread_mutex_lock(&preload->mutex);
+        int i = preload->next++;
+        pthread_mutex_unlock(&preload->mutex);
+        if (i >= preload->count)
+            break;
+        preload->producers[i] = mlt_factory_producer(preload->context->profile,
+                                                     NULL,
+                                                     preload->arguments[i]);
+    }
+    return NULL;
+}
+
+static void close_preloaded(mlt_deque producers)
+{
+    mlt_producer producer;
+    while ((producer = mlt_deque_pop_front(producers)))
+        if (producer != (mlt_producer) &preload_failed)
+            mlt_producer_close(producer);
+    mlt_deque_close(producers);
+}
+
+/** Create the producers collected in the first pass using a pool of threads.
+ *
+ * The second pass takes them in place of calling mlt_factory_producer() with the
+ * same argument, and builds everything else, including filters, links and the
+ * references between services, in document order as before.
+ */
+
+static void preload_producers(deserialise_context context, int threads)
+{
+    struct preload_s preload;
+    int i, started = 0;
+
+    preload.context = context;
+    preload.count = mlt_deque_count(context->preload);
+    preload.next = 0;
+    if (threads > preload.count)
+        threads = preload.count;
+    if (threads < 2)
+        return;
+
+    preload.arguments = calloc(preload.count, sizeof(char *));
+    preload.producers = calloc(preload.count, sizeof(mlt_producer));
+    pthread_mutex_init(&preload.mutex, NULL);
+    for (i = 0; i < preload.count; i++)
+        preload.arguments[i] = mlt_deque_pop_front(context->preload);
+
+    // This thread is one of the workers
+    pthread_t *workers = calloc(threads - 1, sizeof(pthread_t));
+    for (started = 0; started < threads - 1; started++)
+        if (pthread_create(&workers[started], NULL, preload_worker, &preload))
+            break;
+    preload_worker(&preload);
+    for (i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+    free(workers);
+    pthread_mutex_destroy(&preload.mutex);
+
+    // Producers with the same argument are taken in document order
+    context->preloaded = mlt_properties_new();
+    for (i = 0; i < preload.count; i++) {
+        mlt_deque producers = mlt_properties_get_data(context->preloaded,
+                                                      preload.arguments[i],
+                                                      NULL);
+        if (!producers) {
+            producers = mlt_deque_init();
+            mlt_properties_set_data(context->preloaded,
+                                    preload.arguments[i],
+                                    producers,
+                                    0,
+                                    (mlt_destructor) close_preloaded,
+                                    NULL);
+        }
+        // Remember failures so they are not tried again with the same argument
+        mlt_deque_push_back(producers,
+                            preload.producers[i] ? (void *) preload.producers[i]
+                                                 : &preload_failed);
+        free(preload.arguments[i]);
+    }
+    free(preload.arguments);
+    free(preload.producers);
+    mlt_log_verbose(NULL,
+                    "[producer_xml] preloaded %d producers with %d threads\n",
+                    preload.count,
+                    started + 1);
+}
+
 static void on_start_element(void *ctx, const xmlChar *name, const xmlChar **atts)
 {
     struct _xmlParserCtxt *xmlcontext = (struct _xmlParserCtxt *) ctx;
@@ -1559,6 +1755,8 @@ static void on_start_element(void *ctx, const xmlChar *name, const xmlChar **att
             on_start_profile(context, name, atts);
         if (xmlStrcmp(name, _x("consumer")) == 0)
             context->multi_consumer++;
+        if (context->preload)
+            on_start_preload(context, name, atts);
 
         // Check for a service beginning with glsl. or movit.
         for (; atts != NULL && *atts != NULL; atts += 2) {
@@ -1634,6 +1832,11 @@ static void on_end_element(void *ctx, const xmlChar *name)
     struct _xmlParserCtxt *xmlcontext = (struct _xmlParserCtxt *) ctx;
     deserialise_context context = (deserialise_context) (xmlcontext->_private);
 
+    if (context->pass == 0) {
+        if (context->preload)
+            on_end_preload(context, name);
+        return;
+    }
     if (context->is_value == 1 && context->pass == 1 && xmlStrcmp(name, _x("property")) != 0)
         context_pop_node(context);
     else if (xmlStrcmp(name, _x("multitrack")) == 0)
@@ -1984,6 +2187,12 @@ static void context_close(deserialise_context context)
     mlt_deque_close(context->stack_branch);
     xmlFreeDoc(context->entity_doc);
     free(context->lc_numeric);
+    if (context->preload) {
+        while (mlt_deque_count(context->preload))
+            free(mlt_deque_pop_back(context->preload));
+        mlt_deque_close(context->preload);
+    }
+    mlt_properties_close(context->preloaded);
     free(context);
 }
 
@@ -2056,9 +2265,17 @@ mlt_producer producer_xml_init(mlt_profile profile,
     // We need to track the number of registered filters
     mlt_properties_set_int(context->destructors, "registered", 0);
 
+    // Producers may be created by a pool of threads before the second pass
+    int threads = getenv("MLT_XML_THREADS") ? atoi(getenv("MLT_XML_THREADS")) : 0;
+    if (mlt_properties_get(context->params, "threads"))
+        threads = mlt_properties_get_int(context->params, "threads");
+    if (threads > 1)
+        context->preload = mlt_deque_init();
+
     // Setup SAX callbacks for first pass
     sax = calloc(1, sizeof(xmlSAXHandler));
     sax->startElement = on_start_element;
+    sax->endElement = on_end_element;
     sax->characters = on_characters;
     sax->warning = on_error;
     sax->error = on_error;
@@ -2136,8 +2353,11 @@ mlt_producer producer_xml_init(mlt_profile profile,
         && !mlt_properties_get_data(mlt_global_properties(), "glslManager", NULL))
         context->qglsl = mlt_factory_consumer(profile, "qglsl", NULL);
 
+    // Only an explicit profile is left alone by the producers.
+    if (context->preload && profile->is_explicit)
+        preload_producers(context, threads);
+
     // Setup SAX callbacks for second pass
-    sax->endElement = on_end_element;
     sax->cdataBlock = on_characters;
     sax->internalSubset = on_internal_subset;
     sax->entityDecl = on_entity_declaration;
@@ -8,6 +8,8 @@ CONFIG   += c++11
 QMAKE_CXXFLAGS += -std=c++11
 TEMPLATE = app
 DEFINES  += SRCDIR=\\\"$$PWD/\\\"
+# Build with 'qmake CONFIG+=benchmarks' to include the benchmarks
+benchmarks: DEFINES += MLT_BENCHMARKS
 
 win32 {
     INCLUDEPATH += $$PWD/..
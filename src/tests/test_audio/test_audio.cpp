@@ -17,6 +17,7 @@
  */
 
 #include <QString>
+#include <QVector>
 #include <QtTest>
 
 #include <mlt++/Mlt.h>
@@ -51,6 +52,289 @@ private Q_SLOTS:
         free(data);
         a.set_data(nullptr);
     }
+
+    void ConvertSamplesChangesLayout()
+    {
+        const int channels = 3, samples = 11;
+        QVector<int16_t> s16(samples * channels);
+        for (int i = 0; i < s16.size(); i++)
+            s16[i] = (i * 2731) % 65536 - 32768;
+        QVector<float> planar(samples * channels);
+        QCOMPARE(mlt_audio_convert_samples(planar.data(),
+                                           mlt_audio_float,
+                                           s16.constData(),
+                                           mlt_audio_s16,
+                                           samples,
+                                           channels),
+                 0);
+        for (int s = 0; s < samples; s++)
+            for (int c = 0; c < channels; c++)
+                QCOMPARE(planar[c * samples + s], s16[s * channels + c] / 32768.0f);
+
+        QVector<int32_t> s32le(samples * channels);
+        QCOMPARE(mlt_audio_convert_samples(s32le.data(),
+                                           mlt_audio_s32le,
+                                           planar.constData(),
+                                           mlt_audio_float,
+                                           samples,
+                                           channels),
+                 0);
+        for (int i = 0; i < s32le.size(); i++)
+            QCOMPARE(s32le[i], (int32_t) s16[i] << 16);
+    }
+
+    void ConvertSamplesClampsFullScale()
+    {
+        const float f32le[] = {1.0f, -1.0f, 2.0f, -2.0f, 0.5f, 0.0f, 0.25f, -0.5f};
+        int32_t s32le[8];
+        int16_t s16[8];
+        QCOMPARE(mlt_audio_convert_samples(s32le, mlt_audio_s32le, f32le, mlt_audio_f32le, 4, 2),
+                 0);
+        QCOMPARE(s32le[0], INT32_MAX);
+        QCOMPARE(s32le[1], INT32_MIN);
+        QCOMPARE(s32le[2], INT32_MAX);
+        QCOMPARE(s32le[3], INT32_MIN);
+        QCOMPARE(s32le[4], 1073741824);
+        QCOMPARE(mlt_audio_convert_samples(s16, mlt_audio_s16, f32le, mlt_audio_f32le, 4, 2), 0);
+        QCOMPARE(s16[0], (int16_t) 32767);
+        QCOMPARE(s16[1], (int16_t) -32767);
+        QCOMPARE(s16[4], (int16_t) 16383);
+        QVERIFY(mlt_audio_convert_samples(s16, mlt_audio_none, f32le, mlt_audio_f32le, 4, 2));
+    }
+
+    void InterleaveRoundTrip_data()
+    {
+        QTest::addColumn<int>("channels");
+        QTest::addColumn<int>("bytes");
+        for (int channels : {1, 2, 3, 4, 8, 16}) {
+            for (int bytes : {1, 2, 4}) {
+                QString name = QString("%1 channels %2 bytes").arg(channels).arg(bytes);
+                QTest::newRow(name.toUtf8().constData()) << channels << bytes;
+            }
+        }
+    }
+
+    void InterleaveRoundTrip()
+    {
+        QFETCH(int, channels);
+        QFETCH(int, bytes);
+        const int samples = 37;
+        QByteArray interleaved(samples * channels * bytes, 0);
+        for (int i = 0; i < interleaved.size(); i++)
+            interleaved[i] = char(i * 7 + 3);
+        QByteArray planar(interleaved.size(), 0);
+        QVector<uint8_t *> planes(channels);
+        for (int c = 0; c < channels; c++)
+            planes[c] = (uint8_t *) planar.data() + c * samples * bytes;
+
+        mlt_audio_deinterleave(planes.data(),
+                               (const uint8_t *) interleaved.constData(),
+                               samples,
+                               channels,
+                               bytes);
+        for (int c = 0; c < channels; c++)
+            QCOMPARE(memcmp(planes[c] + 5 * bytes,
+                            interleaved.constData() + (5 * channels + c) * bytes,
+                            bytes),
+                     0);
+        QByteArray result(interleaved.size(), 0);
+        mlt_audio_interleave((uint8_t *) result.data(), planes.data(), samples, channels, bytes);
+        QCOMPARE(result, interleaved);
+    }
+
+    void MixRampsWeight()
+    {
+        const int channels = 6, samples = 101;
+        QVector<float> a(samples * channels), b(samples * channels);
+        for (int i = 0; i < a.size(); i++) {
+            a[i] = 0.25f;
+            b[i] = -0.75f;
+        }
+        QVector<float> mixed = a;
+        mlt_audio_mix_float(mixed.data(), b.constData(), channels, channels, 4, samples, 0.0, 1.0);
+        QVector<float> summed = a;
+        mlt_audio_sum_float(summed.data(), b.constData(), channels, channels, 4, samples, 1.0, 0.0);
+        QVector<float> gained = a;
+        mlt_audio_gain_float(gained.data(), channels, samples, 2.0, 0.0);
+        for (int s = 0; s < samples; s++) {
+            double w = double(s) / samples;
+            for (int c = 0; c < channels; c++) {
+                int i = s * channels + c;
+                if (c < 4) {
+                    QVERIFY(qAbs(mixed[i] - (w * b[i] + (1.0 - w) * a[i])) < 1e-6);
+                    QVERIFY(qAbs(summed[i] - ((1.0 - w) * b[i] + a[i])) < 1e-6);
+                } else {
+                    // Channels beyond the mixed ones are left alone
+                    QCOMPARE(mixed[i], a[i]);
+                    QCOMPARE(summed[i], a[i]);
+                }
+                QVERIFY(qAbs(gained[i] - 2.0 * (1.0 - w) * a[i]) < 1e-6);
+            }
+        }
+    }
+
+#ifdef MLT_BENCHMARKS
+    void BenchmarkMix()
+    {
+        // Mix 32 tracks of 16 channels at 48 kHz and 25 fps
+        const int tracks = 32, channels = 16, samples = 1920;
+        QVector<float> mix(samples * channels, 0.0f);
+        QVector<float> track(samples * channels, 0.1f);
+        QBENCHMARK
+        {
+            for (int i = 0; i < tracks; i++)
+                mlt_audio_mix_float(
+                    mix.data(), track.constData(), channels, channels, channels, samples, 0.4, 0.6);
+        }
+    }
+
+    void BenchmarkConvert_data()
+    {
+        QTest::addColumn<int>("from");
+        QTest::addColumn<int>("to");
+        QTest::newRow("s16 to f32le") << int(mlt_audio_s16) << int(mlt_audio_f32le);
+        QTest::newRow("f32le to s16") << int(mlt_audio_f32le) << int(mlt_audio_s16);
+        QTest::newRow("s16 to float") << int(mlt_audio_s16) << int(mlt_audio_float);
+        QTest::newRow("float to f32le") << int(mlt_audio_float) << int(mlt_audio_f32le);
+        QTest::newRow("s32 to s32le") << int(mlt_audio_s32) << int(mlt_audio_s32le);
+    }
+
+    void BenchmarkConvert()
+    {
+        QFETCH(int, from);
+        QFETCH(int, to);
+        const int channels = 16, samples = 1920;
+        QByteArray src(samples * channels * 4, 0);
+        QByteArray dest(samples * channels * 4, 0);
+        QBENCHMARK
+        {
+            QCOMPARE(mlt_audio_convert_samples(dest.data(),
+                                               mlt_audio_format(to),
+                                               src.constData(),
+                                               mlt_audio_format(from),
+                                               samples,
+                                               channels),
+                     0);
+        }
+    }
+#endif
+
+    void PeaksMatchSamplesAtAnyZoom()
+    {
+        // A little more than 1000 blocks of a sine on the left and a click on the right
+        const int channels = 2, samples = 256 * 1000 + 100;
+        QVector<float> audio(samples * channels);
+        for (int s = 0; s < samples; s++) {
+            audio[s * channels] = 0.5f * sinf(s * 0.01f);
+            audio[s * channels + 1] = s == 100000 ? -0.9f : 0.1f;
+        }
+        mlt_peaks peaks = mlt_peaks_new(48000, channels);
+        for (int s = 0; s < samples; s += 1000)
+            mlt_peaks_add(peaks, audio.constData() + s * channels, qMin(1000, samples - s));
+        QCOMPARE(mlt_peaks_samples(peaks), int64_t(samples));
+
+        // Whole blocks at every zoom give the extremes of the samples
+        for (int64_t length = 256; length < samples; length *= 3) {
+            const int64_t start = 1024;
+            const int64_t end = qMin(start + length, int64_t(samples));
+            mlt_peak peak;
+            QCOMPARE(mlt_peaks_get(peaks, 0, start - start % 256, end - end % 256, &peak, 1), 0);
+            float min = 1.0f, max = -1.0f;
+            for (int64_t s = start - start % 256; s < end - end % 256; s++) {
+                min = qMin(min, audio[s * channels]);
+                max = qMax(max, audio[s * channels]);
+            }
+            QVERIFY(qAbs(peak.min - min) < 1e-4);
+            QVERIFY(qAbs(peak.max - max) < 1e-4);
+        }
+
+        // The click is only in the part that has it
+        mlt_peak parts[4];
+        QCOMPARE(mlt_peaks_get(peaks, 1, 0, samples, parts, 4), 0);
+        QVERIFY(qAbs(parts[1].min + 0.9f) < 1e-4);
+        for (int i : {0, 2, 3}) {
+            QVERIFY(qAbs(parts[i].min - 0.1f) < 1e-4);
+            QVERIFY(qAbs(parts[i].rms - 0.1f) < 1e-4);
+        }
+
+        // The sine has an RMS of its amplitude over the square root of 2
+        QCOMPARE(mlt_peaks_get(peaks, 0, 0, samples, parts, 1), 0);
+        QVERIFY(qAbs(parts[0].rms - 0.5f / sqrtf(2.0f)) < 1e-3);
+
+        // Beyond the end is silence
+        QCOMPARE(mlt_peaks_get(peaks, -1, samples, samples + 1000, parts, 1), 0);
+        QCOMPARE(parts[0].max, 0.0f);
+        QVERIFY(mlt_peaks_get(peaks, channels, 0, samples, parts, 1) != 0);
+        mlt_peaks_close(peaks);
+    }
+
+    void PeaksSaveAndLoad()
+    {
+        const int channels = 3, samples = 100000;
+        QVector<float> audio(samples * channels);
+        for (int i = 0; i < audio.size(); i++)
+            audio[i] = float(i % 1999) / 1000.0f - 1.0f;
+        mlt_peaks peaks = mlt_peaks_new(44100, channels);
+        mlt_peaks_add(peaks, audio.constData(), samples);
+
+        QTemporaryDir dir;
+        QString filename = dir.filePath("test.peaks");
+        QCOMPARE(mlt_peaks_save(peaks, filename.toUtf8().constData()), 0);
+        mlt_peaks loaded = mlt_peaks_load(filename.toUtf8().constData());
+        QVERIFY(loaded != nullptr);
+        QCOMPARE(mlt_peaks_frequency(loaded), 44100);
+        QCOMPARE(mlt_peaks_channels(loaded), channels);
+        QCOMPARE(mlt_peaks_samples(loaded), int64_t(samples));
+        for (int count = 1; count < 5000; count *= 7) {
+            QVector<mlt_peak> a(count), b(count);
+            QCOMPARE(mlt_peaks_get(peaks, -1, 0, samples, a.data(), count), 0);
+            QCOMPARE(mlt_peaks_get(loaded, -1, 0, samples, b.data(), count), 0);
+            for (int i = 0; i < count; i++) {
+                QCOMPARE(a[i].min, b[i].min);
+                QCOMPARE(a[i].max, b[i].max);
+                QCOMPARE(a[i].rms, b[i].rms);
+            }
+        }
+        mlt_peaks_close(loaded);
+        mlt_peaks_close(peaks);
+
+        // A truncated file is not an index
+        QFile file(filename);
+        QVERIFY(file.resize(100));
+        QVERIFY(mlt_peaks_load(filename.toUtf8().constData()) == nullptr);
+    }
+
+    void PeaksOfOtherAudioAreMadeAgain()
+    {
+        Factory::init();
+        Profile profile;
+        Producer producer(profile, "tone");
+        producer.set("length", 50);
+        producer.set_in_and_out(0, 49);
+
+        // An index saved for other audio in the file that the producer names
+        QTemporaryDir dir;
+        QString filename = dir.filePath("tone.peaks");
+        mlt_peaks other = mlt_peaks_new(48000, 2);
+        QVector<float> silence(2 * 1000, 0.0f);
+        mlt_peaks_add(other, silence.constData(), 1000);
+        mlt_peaks_set_source(other, "other audio");
+        QCOMPARE(mlt_peaks_save(other, filename.toUtf8().constData()), 0);
+        mlt_peaks_close(other);
+        producer.set("peaks", filename.toUtf8().constData());
+
+        mlt_peaks peaks = nullptr;
+        for (int i = 0; i < 1000 && !peaks; i++) {
+            peaks = mlt_peaks_for_producer(producer.get_producer());
+            if (!peaks)
+                QTest::qSleep(10);
+        }
+        QVERIFY(peaks != nullptr);
+        QVERIFY(mlt_peaks_source(peaks) != nullptr);
+        QVERIFY(qstrcmp(mlt_peaks_source(peaks), "other audio"));
+        QVERIFY(mlt_peaks_samples(peaks) > 1000);
+        mlt_peaks_stop_jobs();
+    }
 };
 
 QTEST_APPLESS_MAIN(TestAudio)
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with consumer library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <QtTest>
+
+#include <mlt++/Mlt.h>
+using namespace Mlt;
+
+class TestComposite : public QObject
+{
+    Q_OBJECT
+    Profile profile;
+
+public:
+    TestComposite()
+        : profile("uhd_2160p_25")
+    {
+        Factory::init();
+    }
+
+private:
+    QByteArray render(Tractor &tractor, int position)
+    {
+        tractor.seek(position);
+        Frame *frame = tractor.get_frame();
+        mlt_image_format format = mlt_image_yuv422;
+        int width = profile.width();
+        int height = profile.height();
+        const uint8_t *image = frame->get_image(format, width, height);
+        QByteArray result;
+        if (image)
+            result = QByteArray(reinterpret_cast<const char *>(image), width * height * 2);
+        delete frame;
+        return result;
+    }
+
+    void setUp(Tractor &tractor, Producer &a, Producer &b, Transition &transition)
+    {
+        tractor.set_track(a, 0);
+        tractor.set_track(b, 1);
+        transition.set("in", 0);
+        transition.set("out", 49);
+        transition.set("geometry", "0=0%/0%:100%x100%:0%;49=0%/0%:100%x100%:100%");
+        tractor.plant_transition(transition, 0, 1);
+    }
+
+private Q_SLOTS:
+
+    void SlicedMatchesUnsliced()
+    {
+        QByteArray results[2];
+        for (int sliced = 0; sliced < 2; sliced++) {
+            Tractor tractor(profile);
+            Producer a(profile, "colour", "red");
+            Producer b(profile, "colour", "0x0000ff80");
+            Transition transition(profile, "composite");
+            transition.set("luma", "%luma01.pgm");
+            transition.set("softness", 0.3);
+            transition.set("sliced_composite", sliced);
+            setUp(tractor, a, b, transition);
+            results[sliced] = render(tractor, 25);
+        }
+        QVERIFY(!results[0].isEmpty());
+        QCOMPARE(results[1], results[0]);
+    }
+
+    void SimdMatchesC_data()
+    {
+        QTest::addColumn<QString>("luma");
+        QTest::addColumn<QString>("op");
+        QTest::addColumn<int>("tolerance");
+        // The older x86_64 assembly for plain dissolves rounds differently
+        QTest::newRow("dissolve") << QString() << QString() << 1;
+        QTest::newRow("luma wipe") << QString("%luma01.pgm") << QString() << 0;
+        QTest::newRow("or") << QString() << QString("or") << 0;
+        QTest::newRow("and") << QString() << QString("and") << 0;
+        QTest::newRow("xor") << QString() << QString("xor") << 0;
+        QTest::newRow("luma wipe or") << QString("%luma01.pgm") << QString("or") << 0;
+        QTest::newRow("luma wipe and") << QString("%luma01.pgm") << QString("and") << 0;
+        QTest::newRow("luma wipe xor") << QString("%luma01.pgm") << QString("xor") << 0;
+    }
+
+    void SimdMatchesC()
+    {
+        QFETCH(QString, luma);
+        QFETCH(QString, op);
+        QFETCH(int, tolerance);
+        QByteArray results[2];
+        for (int simd = 0; simd < 2; simd++) {
+            Tractor tractor(profile);
+            Producer a(profile, "colour", "red");
+            Producer b(profile, "colour", "0x0000ff80");
+            Transition transition(profile, "composite");
+            if (!luma.isEmpty()) {
+                transition.set("luma", luma.toUtf8().constData());
+                transition.set("softness", 0.3);
+            }
+            if (!op.isEmpty())
+                transition.set("operator", op.toUtf8().constData());
+            transition.set("simd", simd);
+            setUp(tractor, a, b, transition);
+            results[simd] = render(tractor, 25);
+        }
+        QVERIFY(!results[0].isEmpty());
+        QCOMPARE(results[1].size(), results[0].size());
+        int difference = 0;
+        for (int i = 0; i < results[0].size(); i++)
+            difference = qMax(difference,
+                              qAbs(uint8_t(results[1][i]) - uint8_t(results[0][i])));
+        QVERIFY(difference <= tolerance);
+    }
+
+#ifdef MLT_BENCHMARKS
+    void BenchmarkComposite_data()
+    {
+        QTest::addColumn<QString>("luma");
+        QTest::addColumn<QString>("op");
+        QTest::newRow("dissolve") << QString() << QString();
+        QTest::newRow("luma wipe") << QString("%luma01.pgm") << QString();
+        QTest::newRow("luma wipe xor") << QString("%luma01.pgm") << QString("xor");
+        QTest::newRow("or") << QString() << QString("or");
+    }
+
+    void BenchmarkComposite()
+    {
+        QFETCH(QString, luma);
+        QFETCH(QString, op);
+        Tractor tractor(profile);
+        Producer a(profile, "colour", "red");
+        Producer b(profile, "colour", "0x0000ff80");
+        Transition transition(profile, "composite");
+        if (!luma.isEmpty()) {
+            transition.set("luma", luma.toUtf8().constData());
+            transition.set("softness", 0.2);
+        }
+        if (!op.isEmpty())
+            transition.set("operator", op.toUtf8().constData());
+        transition.set("sliced_composite", 1);
+        setUp(tractor, a, b, transition);
+        QBENCHMARK
+        {
+            QVERIFY(!render(tractor, 25).isEmpty());
+        }
+    }
+#endif
+};
+
+QTEST_APPLESS_MAIN(TestComposite)
+
+#include "test_composite.moc"
@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = test_composite
+SOURCES += test_composite.cpp
@@ -18,8 +18,36 @@
 
 #include <mlt++/Mlt.h>
 #include <QtTest>
+#include <atomic>
 using namespace Mlt;
 
+#if defined(__GLIBC__)
+// Count the allocations of the process so that the frame pool can be measured
+#define COUNT_ALLOCATIONS
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+static std::atomic<long> allocations(0);
+
+extern "C" void *malloc(size_t size) noexcept
+{
+    ++allocations;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) noexcept
+{
+    ++allocations;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) noexcept
+{
+    ++allocations;
+    return __libc_realloc(ptr, size);
+}
+#endif
+
 class TestFrame : public QObject
 {
     Q_OBJECT
@@ -27,6 +55,19 @@ class TestFrame : public QObject
 public:
     TestFrame() {}
 
+private:
+    static void countDestroyed(void *count) { ++*static_cast<int *>(count); }
+
+    static void initClose()
+    {
+        mlt_frame frame = mlt_frame_init(NULL);
+        mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+        mlt_properties_set_int(properties, "progressive", 1);
+        mlt_properties_set_double(properties, "aspect_ratio", 1.0);
+        mlt_frame_push_get_image(frame, NULL);
+        mlt_frame_close(frame);
+    }
+
 private Q_SLOTS:
     void FrameConstructorAddsReference()
     {
@@ -93,6 +134,97 @@ private Q_SLOTS:
         QCOMPARE(f1.ref_count(), 2);
         mlt_frame_close(frame);
     }
+
+    void ClosedFrameIsReusedEmpty()
+    {
+        int destroyed = 0;
+        mlt_frame frame = mlt_frame_init(NULL);
+        mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+        int count = mlt_properties_count(properties);
+        mlt_properties_set(properties, "foo", "bar");
+        mlt_properties_set_data(properties, "data", &destroyed, 0, countDestroyed, NULL);
+        mlt_properties_set_lcnumeric(properties, "C");
+        mlt_frame_push_get_image(frame, NULL);
+        mlt_frame_push_audio(frame, NULL);
+        mlt_frame_push_service(frame, NULL);
+        mlt_frame_close(frame);
+        QCOMPARE(destroyed, 1);
+
+        frame = mlt_frame_init(NULL);
+        properties = MLT_FRAME_PROPERTIES(frame);
+        QCOMPARE(mlt_properties_ref_count(properties), 1);
+        QCOMPARE(mlt_properties_count(properties), count);
+        QCOMPARE(mlt_properties_get(properties, "foo"), (char *) 0);
+        QCOMPARE(mlt_properties_get_data(properties, "data", NULL), (void *) 0);
+        QCOMPARE(mlt_properties_get_lcnumeric(properties), (char *) 0);
+        QCOMPARE(mlt_properties_get_int(properties, "width"), 720);
+        QCOMPARE(mlt_deque_count(MLT_FRAME_IMAGE_STACK(frame)), 0);
+        QCOMPARE(mlt_deque_count(MLT_FRAME_AUDIO_STACK(frame)), 0);
+        QCOMPARE(mlt_deque_count(MLT_FRAME_SERVICE_STACK(frame)), 0);
+        mlt_frame_close(frame);
+        QCOMPARE(destroyed, 1);
+    }
+
+    void RecycledFrameDoesNotAllocate()
+    {
+#ifdef COUNT_ALLOCATIONS
+        if (qgetenv("MLT_FRAME_POOL") == "0")
+            QSKIP("The frame pool is disabled");
+        initClose();
+        long before = allocations;
+        initClose();
+        QCOMPARE(allocations - before, 0L);
+#else
+        QSKIP("Allocations are only counted with glibc");
+#endif
+    }
+
+#ifdef MLT_BENCHMARKS
+    void BenchmarkInitClose()
+    {
+        QBENCHMARK
+        {
+            mlt_frame frame = mlt_frame_init(NULL);
+            mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+            mlt_properties_set_int(properties, "progressive", 1);
+            mlt_properties_set(properties, "consumer.rescale", "bilinear");
+            mlt_frame_push_get_image(frame, NULL);
+            mlt_frame_close(frame);
+        }
+    }
+
+    void BenchmarkAllocationsPerFrame()
+    {
+#ifdef COUNT_ALLOCATIONS
+        // Publish the allocations of a rendered frame once the pool is warm
+        Factory::init();
+        Profile profile;
+        Tractor tractor(profile);
+        Producer a(profile, "colour", "red");
+        Producer b(profile, "colour", "0x0000ff80");
+        Transition transition(profile, "composite");
+        tractor.set_track(a, 0);
+        tractor.set_track(b, 1);
+        tractor.plant_transition(transition, 0, 1);
+        const int frames = 10;
+        long before = 0;
+        for (int i = 0; i < 2 * frames; i++) {
+            if (i == frames)
+                before = allocations;
+            Frame *frame = tractor.get_frame();
+            frame->set("consumer.rescale", "bilinear");
+            mlt_image_format format = mlt_image_yuv422;
+            int width = profile.width();
+            int height = profile.height();
+            QVERIFY(frame->get_image(format, width, height) != nullptr);
+            delete frame;
+        }
+        QTest::setBenchmarkResult(qreal(allocations - before) / frames, QTest::Events);
+#else
+        QSKIP("Allocations are only counted with glibc");
+#endif
+    }
+#endif
 };
 
 QTEST_APPLESS_MAIN(TestFrame)
@@ -59,6 +59,49 @@ private Q_SLOTS:
 
         delete cutService;
     }
+
+    void CloneBeforeCopiesPrecedingFilters()
+    {
+        Profile profile;
+        Producer producer(profile, "color:red");
+        producer.set("foo", "bar");
+        Filter first(profile, "brightness");
+        first.set("level", 0.5);
+        Filter target(profile, "crop");
+        Filter detached(profile, "crop");
+        producer.attach(first);
+        producer.attach(target);
+
+        mlt_producer clone = mlt_producer_clone_before(producer.get_producer(),
+                                                       profile.get_profile(),
+                                                       target.get_filter());
+        QVERIFY(clone != nullptr);
+        Producer copy(clone);
+        mlt_producer_close(clone);
+        QCOMPARE(copy.get("resource"), "red");
+        QCOMPARE(copy.get("foo"), "bar");
+        int brightness = 0, others = 0;
+        for (int i = 0; i < copy.filter_count(); i++) {
+            Filter *filter = copy.filter(i);
+            if (!filter->get_int("_loader")) {
+                if (!qstrcmp(filter->get("mlt_service"), "brightness")) {
+                    QCOMPARE(filter->get_double("level"), 0.5);
+                    brightness++;
+                } else {
+                    others++;
+                }
+            }
+            delete filter;
+        }
+        QCOMPARE(brightness, 1);
+        QCOMPARE(others, 0);
+
+        // Not attached to the producer
+        QVERIFY(mlt_producer_clone_before(producer.get_producer(),
+                                          profile.get_profile(),
+                                          detached.get_filter())
+                == nullptr);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestProducer)
@@ -1510,6 +1510,67 @@ private Q_SLOTS:
         QCOMPARE(p.get_int("foo"), 123);
         QCOMPARE(p.get_double("foo"), 123.4);
     }
+
+    void LookupResolvesPrefixedProperties()
+    {
+        Properties parent;
+        parent.set("consumer.rescale", "bilinear");
+        parent.set("consumer.progressive", 1);
+        parent.set("other", "x");
+        Properties child;
+        child.set("consumer.progressive", 0);
+        mlt_properties_set_lookup(child.get_properties(), parent.get_properties(), "consumer.");
+
+        // Matching properties come from the parent, others do not
+        QCOMPARE(child.get("consumer.rescale"), "bilinear");
+        QCOMPARE(child.get_int("consumer.progressive"), 1);
+        QCOMPARE(child.get("other"), (char *) 0);
+        QCOMPARE(child.count(), 1);
+
+        // Setting a property hides the parent
+        child.set("consumer.rescale", "nearest");
+        QCOMPARE(child.get("consumer.rescale"), "nearest");
+        QCOMPARE(parent.get("consumer.rescale"), "bilinear");
+
+        // Copies include the properties resolved by the lookup
+        parent.set("consumer.deinterlacer", "yadif");
+        Properties copy;
+        mlt_properties_copy(copy.get_properties(), child.get_properties(), "consumer.");
+        QCOMPARE(copy.get("consumer.rescale"), "nearest");
+        QCOMPARE(copy.get("consumer.deinterlacer"), "yadif");
+        QCOMPARE(copy.get_int("consumer.progressive"), 1);
+
+        mlt_properties_set_lookup(child.get_properties(), NULL, NULL);
+        QCOMPARE(child.get("consumer.deinterlacer"), (char *) 0);
+        QCOMPARE(child.get("consumer.rescale"), "nearest");
+    }
+
+    void GenerationIgnoresUnchangedValues()
+    {
+        Properties p;
+        mlt_properties properties = p.get_properties();
+        p.set("resource", "a.mp4");
+        p.set("width", 1920);
+        p.set("aspect", 1.5);
+        mlt_properties_set_int64(properties, "length", 100);
+        mlt_properties_set_position(properties, "out", 99);
+        int generation = mlt_properties_generation(properties);
+
+        // Setting the same values again does not change the generation
+        p.set("resource", "a.mp4");
+        p.set("width", 1920);
+        p.set("aspect", 1.5);
+        mlt_properties_set_int64(properties, "length", 100);
+        mlt_properties_set_position(properties, "out", 99);
+        QCOMPARE(mlt_properties_generation(properties), generation);
+
+        // A different value does
+        p.set("aspect", 1.25);
+        QVERIFY(mlt_properties_generation(properties) != generation);
+        generation = mlt_properties_generation(properties);
+        p.set("resource", "b.mp4");
+        QVERIFY(mlt_properties_generation(properties) != generation);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestProperties)
@@ -49,6 +49,42 @@ private Q_SLOTS:
             QVERIFY(consumers->count() > 0);
         delete consumers;
     }
+
+    void ManifestLoadsModulesOnDemand()
+    {
+        Factory::init();
+        QTemporaryDir dir;
+        QByteArray manifest = dir.filePath("manifest").toUtf8();
+        qputenv("MLT_REPOSITORY_MANIFEST", manifest);
+
+        // The first repository loads every module and writes the manifest
+        mlt_repository full = mlt_repository_init(mlt_factory_directory());
+        QVERIFY(QFile::exists(manifest));
+
+        // The second one reads it and loads modules on demand
+        mlt_repository lazy = mlt_repository_init(mlt_factory_directory());
+        qunsetenv("MLT_REPOSITORY_MANIFEST");
+        QCOMPARE(mlt_properties_count(mlt_repository_producers(lazy)),
+                 mlt_properties_count(mlt_repository_producers(full)));
+        QCOMPARE(mlt_properties_count(mlt_repository_filters(lazy)),
+                 mlt_properties_count(mlt_repository_filters(full)));
+
+        Profile profile;
+        mlt_producer producer = (mlt_producer) mlt_repository_create(lazy,
+                                                                     profile.get_profile(),
+                                                                     mlt_service_producer_type,
+                                                                     "color",
+                                                                     "red");
+        QVERIFY(producer != nullptr);
+        QCOMPARE(mlt_properties_get(MLT_PRODUCER_PROPERTIES(producer), "resource"), "red");
+        mlt_producer_close(producer);
+        QVERIFY(mlt_repository_metadata(lazy, mlt_service_producer_type, "color") != nullptr);
+        QVERIFY(mlt_repository_create(lazy, NULL, mlt_service_filter_type, "not-a-filter", NULL)
+                == nullptr);
+
+        mlt_repository_close(lazy);
+        mlt_repository_close(full);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestRepository)
@@ -20,6 +20,23 @@
 #include <QtTest>
 using namespace Mlt;
 
+// A producer that sets its properties on every frame, as avformat does
+static int get_frame_setting_properties(mlt_producer producer, mlt_frame_ptr frame, int index)
+{
+    mlt_properties properties = MLT_PRODUCER_PROPERTIES(producer);
+    int fetches = mlt_properties_get_int(properties, "_fetches") + 1;
+    mlt_properties_set_int(properties, "_fetches", fetches);
+    // The size only becomes known while fetching the first next frame
+    if (fetches >= 3) {
+        mlt_properties_set_int(properties, "width", 1920);
+        mlt_properties_set_int(properties, "height", 1080);
+    }
+    *frame = mlt_frame_init(MLT_PRODUCER_SERVICE(producer));
+    mlt_frame_set_position(*frame, mlt_producer_position(producer));
+    mlt_producer_prepare_next(producer);
+    return 0;
+}
+
 class TestService : public QObject
 {
     Q_OBJECT
@@ -65,6 +82,113 @@ private Q_SLOTS:
         QCOMPARE(mlt_service_identify(MLT_CONSUMER_SERVICE(consumer)), mlt_service_consumer_type);
     }
 
+    void FrameIsStaleAfterServiceChanges()
+    {
+        Profile profile;
+        Producer producer(profile, "color");
+        Filter filter(profile, "brightness");
+        filter.set("disable", 1);
+        producer.attach(filter);
+        Producer other(profile, "color");
+
+        Frame *frame = producer.get_frame();
+        QVERIFY(!mlt_frame_is_stale(frame->get_frame()));
+        producer.set("_private", 1);
+        other.set("resource", "blue");
+        QVERIFY(!mlt_frame_is_stale(frame->get_frame()));
+        filter.set("disable", 0);
+        QVERIFY(mlt_frame_is_stale(frame->get_frame()));
+        delete frame;
+
+        frame = producer.get_frame();
+        QVERIFY(!mlt_frame_is_stale(frame->get_frame()));
+        producer.detach(filter);
+        QVERIFY(mlt_frame_is_stale(frame->get_frame()));
+        delete frame;
+    }
+
+    void GraphHashFollowsServiceState()
+    {
+        Profile profile;
+        Producer producer(profile, "color");
+        Frame *frame = producer.get_frame();
+        uint64_t hash = mlt_frame_graph_hash(frame->get_frame());
+        QVERIFY(hash != 0);
+        delete frame;
+
+        producer.seek(0);
+        producer.set("resource", producer.get("resource"));
+        frame = producer.get_frame();
+        QCOMPARE(mlt_frame_graph_hash(frame->get_frame()), hash);
+        delete frame;
+
+        // The hash follows the content rather than the instance
+        Producer copy(profile, "color");
+        frame = copy.get_frame();
+        QCOMPARE(mlt_frame_graph_hash(frame->get_frame()), hash);
+        delete frame;
+
+        frame = producer.get_frame();
+        QVERIFY(mlt_frame_graph_hash(frame->get_frame()) != hash);
+        delete frame;
+
+        producer.seek(0);
+        producer.set("resource", "blue");
+        frame = producer.get_frame();
+        QVERIFY(mlt_frame_graph_hash(frame->get_frame()) != hash);
+        delete frame;
+    }
+
+    void NeighbourFramesAreReused()
+    {
+        Profile profile;
+        Producer producer(profile, "color");
+        producer.set("_need_previous_next", 1);
+
+        Frame *first = producer.get_frame();
+        Frame *second = producer.get_frame();
+        Frame *third = producer.get_frame();
+        mlt_frame next = (mlt_frame) first->get_data("next frame");
+        mlt_frame previous = (mlt_frame) third->get_data("previous frame");
+        QVERIFY(next != nullptr);
+        QCOMPARE(mlt_frame_get_position(next), 1);
+        QCOMPARE(previous, next);
+        QCOMPARE(mlt_frame_get_position((mlt_frame) second->get_data("next frame")), 2);
+        delete first;
+        delete second;
+        delete third;
+
+        producer.set("resource", "blue");
+        Frame *fourth = producer.get_frame();
+        QVERIFY((mlt_frame) fourth->get_data("previous frame") != next);
+        delete fourth;
+    }
+
+    void NeighbourFramesAreReusedWhenPropertiesAreSetAgain()
+    {
+        Profile profile;
+        mlt_producer self = mlt_producer_new(profile.get_profile());
+        self->get_frame = get_frame_setting_properties;
+        Producer producer(self);
+        mlt_producer_close(self);
+        producer.set("length", 100);
+        producer.set("out", 99);
+        producer.set("_need_previous_next", 1);
+
+        Frame *first = producer.get_frame();
+        Frame *second = producer.get_frame();
+        int fetches = producer.get_int("_fetches");
+        Frame *third = producer.get_frame();
+
+        // Only the current frame and the new next frame are fetched
+        QCOMPARE(producer.get_int("_fetches"), fetches + 2);
+        QCOMPARE((mlt_frame) third->get_data("previous frame"),
+                 (mlt_frame) first->get_data("next frame"));
+        delete first;
+        delete second;
+        delete third;
+    }
+
 private:
     Repository *repo;
 };
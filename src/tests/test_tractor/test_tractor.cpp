@@ -402,6 +402,29 @@ private Q_SLOTS:
         QCOMPARE(t.count(), 1);
         QCOMPARE(filter.get_track(), 0);
     }
+
+#ifdef MLT_BENCHMARKS
+    void BenchmarkManyTracks()
+    {
+        Tractor t(profile);
+        for (int i = 0; i < 30; i++) {
+            Producer p(profile, "colour", i ? "0x0000ff10" : "black");
+            t.set_track(p, i);
+        }
+        QBENCHMARK
+        {
+            t.seek(0);
+            Frame *frame = t.get_frame();
+            frame->set("consumer.rescale", "bilinear");
+            frame->set("consumer.progressive", 1);
+            mlt_image_format format = mlt_image_yuv422;
+            int width = profile.width();
+            int height = profile.height();
+            QVERIFY(frame->get_image(format, width, height) != nullptr);
+            delete frame;
+        }
+    }
+#endif
 };
 
 QTEST_APPLESS_MAIN(TestTractor)
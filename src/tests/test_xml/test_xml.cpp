@@ -70,6 +70,80 @@ private Q_SLOTS:
         delete pchild1;
         delete pchild2;
     }
+
+    void StreamMatchesTree()
+    {
+        Profile profile;
+        Producer producer(profile, "noise");
+        producer.set("test & \"quoted\"", "<a>\r\n\tb\xc3\xa9");
+        Properties child;
+        child.set("test_param", "C1");
+        producer.set("child", child);
+        Playlist playlist(profile);
+        playlist.append(producer, 0, 9);
+        playlist.blank(4);
+        playlist.append(producer, 10, 19);
+        Tractor tractor(profile);
+        tractor.set_track(playlist, 0);
+        tractor.set_track(producer, 1);
+
+        Consumer tree(profile, "xml", "string");
+        tree.connect(tractor);
+        tree.start();
+        QVERIFY(tree.get("string") != nullptr);
+
+        Consumer stream(profile, "xml", "string");
+        stream.set("stream", 1);
+        stream.connect(tractor);
+        stream.start();
+        QCOMPARE(stream.get("string"), tree.get("string"));
+    }
+
+    void BackgroundMatchesTree()
+    {
+        Profile profile;
+        Producer producer(profile, "noise");
+        Playlist playlist(profile);
+        playlist.append(producer, 0, 9);
+        playlist.set("title", "Title \xc3\xa9");
+
+        Consumer tree(profile, "xml", "string");
+        tree.connect(playlist);
+        tree.start();
+
+        Consumer background(profile, "xml", "string");
+        background.set("background", 1);
+        background.connect(playlist);
+        background.start();
+        // Changes after start are not in the snapshot
+        playlist.append(producer, 10, 19);
+        background.stop();
+        QVERIFY(background.is_stopped());
+        QCOMPARE(background.get("string"), tree.get("string"));
+    }
+
+    void BackgroundKeepsTheLastSave()
+    {
+        Profile profile;
+        Producer producer(profile, "noise");
+        Playlist playlist(profile);
+        playlist.append(producer, 0, 9);
+
+        Consumer background(profile, "xml", "string");
+        background.set("background", 1);
+        background.connect(playlist);
+        background.start();
+        // Saving again at once must not be dropped while the first write runs
+        playlist.append(producer, 10, 19);
+        background.start();
+        background.stop();
+
+        Consumer tree(profile, "xml", "string");
+        tree.connect(playlist);
+        tree.start();
+        QVERIFY(background.is_stopped());
+        QCOMPARE(background.get("string"), tree.get("string"));
+    }
 };
 
 QTEST_APPLESS_MAIN(TestXml)
@@ -1,5 +1,6 @@
 TEMPLATE = subdirs
 SUBDIRS = test_audio \
+    test_composite \
     test_filter \
     test_events \
     test_frame \